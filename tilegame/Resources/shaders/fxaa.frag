@@ -0,0 +1,48 @@
+#version 430 core
+
+// FXAA in the style of the "console" variant: one luma edge test on the
+// four diagonal neighbours, then two or four taps along the edge direction.
+
+out vec4 FragColor;
+
+in vec2 uv;
+
+uniform sampler2D source;
+uniform vec2 uv_scale;
+uniform vec2 texel;
+
+#define FXAA_REDUCE_MIN (1.0 / 128.0)
+#define FXAA_REDUCE_MUL (1.0 / 8.0)
+#define FXAA_SPAN_MAX 8.0
+
+vec3 fetch(vec2 p)
+{
+	return texture(source, clamp(p, texel * 0.5, uv_scale - texel * 0.5)).rgb;
+}
+
+void main()
+{
+	vec2 p = uv * uv_scale;
+	const vec3 luma = vec3(0.299, 0.587, 0.114);
+
+	vec3 rgb_m = fetch(p);
+	float luma_nw = dot(fetch(p + vec2(-1.0, -1.0) * texel), luma);
+	float luma_ne = dot(fetch(p + vec2(1.0, -1.0) * texel), luma);
+	float luma_sw = dot(fetch(p + vec2(-1.0, 1.0) * texel), luma);
+	float luma_se = dot(fetch(p + vec2(1.0, 1.0) * texel), luma);
+	float luma_m = dot(rgb_m, luma);
+
+	float luma_min = min(luma_m, min(min(luma_nw, luma_ne), min(luma_sw, luma_se)));
+	float luma_max = max(luma_m, max(max(luma_nw, luma_ne), max(luma_sw, luma_se)));
+
+	vec2 dir = vec2(-((luma_nw + luma_ne) - (luma_sw + luma_se)), (luma_nw + luma_sw) - (luma_ne + luma_se));
+	float dir_reduce = max((luma_nw + luma_ne + luma_sw + luma_se) * 0.25 * FXAA_REDUCE_MUL, FXAA_REDUCE_MIN);
+	float rcp_dir_min = 1.0 / (min(abs(dir.x), abs(dir.y)) + dir_reduce);
+	dir = clamp(dir * rcp_dir_min, vec2(-FXAA_SPAN_MAX), vec2(FXAA_SPAN_MAX)) * texel;
+
+	vec3 rgb_a = 0.5 * (fetch(p + dir * (1.0 / 3.0 - 0.5)) + fetch(p + dir * (2.0 / 3.0 - 0.5)));
+	vec3 rgb_b = rgb_a * 0.5 + 0.25 * (fetch(p + dir * -0.5) + fetch(p + dir * 0.5));
+	float luma_b = dot(rgb_b, luma);
+
+	FragColor = vec4((luma_b < luma_min || luma_b > luma_max) ? rgb_a : rgb_b, 1.0);
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#version 430 core
+
+// Colours the layer counts of the overdraw view and sums them into the
+// counter buffer. Drawn with present.vert over exactly the view, so every
+// pixel is visited once.
+out vec4 FragColor;
+
+in vec2 uv;
+
+uniform sampler2D counts;
+
+// OverdrawCounters in overdraw.h
+layout(std430, binding = 0) buffer Counters {
+	uint fragments;
+	uint covered_pixels;
+	uint max_layers;
+	uint histogram[8];
+};
+
+// 1, 2, 3, 4, 5-8, 9-16, 17-32 and 33+ layers, as overdraw_bucket_color()
+const vec3 ramp[8] = vec3[8](
+	vec3(0.0, 0.0, 0.5),
+	vec3(0.0, 0.3, 1.0),
+	vec3(0.0, 0.8, 0.8),
+	vec3(0.0, 0.8, 0.0),
+	vec3(1.0, 1.0, 0.0),
+	vec3(1.0, 0.5, 0.0),
+	vec3(1.0, 0.0, 0.0),
+	vec3(1.0, 1.0, 1.0)
+);
+
+void main()
+{
+	uint layers = uint(texelFetch(counts, ivec2(gl_FragCoord.xy), 0).r + 0.5);
+	if (layers == 0u) {
+		FragColor = vec4(0.0, 0.0, 0.0, 1.0);
+		return;
+	}
+
+	int bucket = layers <= 4u ? int(layers) - 1 : min(7, findMSB(layers - 1u) + 2);
+	atomicAdd(fragments, layers);
+	atomicAdd(covered_pixels, 1u);
+	atomicMax(max_layers, layers);
+	atomicAdd(histogram[bucket], 1u);
+	FragColor = vec4(ramp[bucket], 1.0);
+}
@@ -0,0 +1,51 @@
+#version 430 core
+
+// Adds up the point lights of a pixel of the light buffer over the ambient
+// term. Drawn with present.vert over the whole buffer; each pixel only
+// walks the light list of the view tile it falls in.
+out vec4 FragColor;
+
+in vec2 uv;
+
+// PointLight in lighting.h
+struct Light {
+	vec4 position_radius_intensity;
+	vec4 color;
+};
+
+layout(std430, binding = 0) readonly buffer Lights {
+	Light lights[];
+};
+
+// offset and count of each tile's list in light_indices
+layout(std430, binding = 1) readonly buffer Tiles {
+	uvec2 tile_ranges[];
+};
+
+layout(std430, binding = 2) readonly buffer TileLights {
+	uint light_indices[];
+};
+
+uniform vec2 view_size;
+uniform vec2 buffer_size;
+uniform ivec2 tiles;
+uniform float tile_size;
+uniform vec3 ambient;
+
+void main()
+{
+	// view pixels, y down, at the centre of this light buffer pixel
+	vec2 p = vec2(gl_FragCoord.x, buffer_size.y - gl_FragCoord.y) * (view_size / buffer_size);
+	ivec2 tile = clamp(ivec2(p / tile_size), ivec2(0), tiles - 1);
+	uvec2 range = tile_ranges[tile.y * tiles.x + tile.x];
+
+	vec3 light = ambient;
+	for (uint i = 0u; i < range.y; i++) {
+		Light l = lights[light_indices[range.x + i]];
+		vec2 d = p - l.position_radius_intensity.xy;
+		float radius = l.position_radius_intensity.z;
+		float falloff = clamp(1.0 - dot(d, d) / (radius * radius), 0.0, 1.0);
+		light += l.color.rgb * (l.position_radius_intensity.w * falloff * falloff);
+	}
+	FragColor = vec4(light, 1.0);
+}
@@ -0,0 +1,14 @@
+#version 430 core
+
+// Upsamples the light buffer over the world. Blended with
+// (GL_DST_COLOR, GL_ZERO), so the world is multiplied by the light.
+out vec4 FragColor;
+
+in vec2 uv;
+
+uniform sampler2D light;
+
+void main()
+{
+	FragColor = vec4(texture(light, uv).rgb, 1.0);
+}
@@ -0,0 +1,15 @@
+#version 430 core
+
+// Counting variant of tilegame.frag for the overdraw view. Drawn with
+// additive blending into a single float channel, every fragment shaded adds
+// one whatever its colour or alpha, so each pixel ends up holding the number
+// of layers drawn over it.
+out vec4 FragColor;
+
+in vec3 ourColor;
+in vec2 TexCoord;
+
+void main()
+{
+	FragColor = vec4(1.0);
+}
@@ -0,0 +1,18 @@
+#version 430 core
+
+// ImGui vertices (ImDrawVert) for the overdraw view, feeding overdraw.frag.
+layout(location = 0) in vec2 Position;
+layout(location = 1) in vec2 UV;
+layout(location = 2) in vec4 Color;
+
+uniform mat4 ProjMtx;
+
+out vec3 ourColor;
+out vec2 TexCoord;
+
+void main()
+{
+	ourColor = Color.rgb;
+	TexCoord = UV;
+	gl_Position = ProjMtx * vec4(Position, 0.0, 1.0);
+}
@@ -0,0 +1,12 @@
+#version 430 core
+
+// Round, soft particle, blended additively.
+out vec4 FragColor;
+
+in vec2 local;
+in vec4 color;
+
+void main()
+{
+	FragColor = vec4(color.rgb, color.a * max(1.0 - dot(local, local), 0.0));
+}
@@ -0,0 +1,24 @@
+#version 430 core
+
+// Expands one instance of the particle buffer into a quad from
+// gl_VertexID. Particles waiting to be launched or past their lifetime
+// collapse to nothing; the rest shrink and fade as they age.
+layout(location = 0) in vec3 particle;		// view pixels, age over lifetime
+layout(location = 1) in uint color_size;	// 0xBBGGRR colour, size << 24
+
+out vec2 local;
+out vec4 color;
+
+uniform vec2 view_size;
+
+void main()
+{
+	float t = particle.z;
+	bool alive = t >= 0.0 && t < 1.0;
+	float size = alive ? float(color_size >> 24) * (1.0 - 0.5 * t) : 0.0;
+
+	local = vec2(gl_VertexID & 1, gl_VertexID >> 1) * 2.0 - 1.0;
+	vec2 pos = particle.xy + local * (0.5 * size);
+	gl_Position = vec4(pos / view_size * vec2(2.0, -2.0) + vec2(-1.0, 1.0), 0.0, 1.0);
+	color = vec4(unpackUnorm4x8(color_size).rgb, 1.0 - t);
+}
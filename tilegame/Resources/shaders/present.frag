@@ -0,0 +1,16 @@
+#version 430 core
+
+out vec4 FragColor;
+
+in vec2 uv;
+
+uniform sampler2D source;
+// part of the source texture covered by the scaled frame, and its texel size
+uniform vec2 uv_scale;
+uniform vec2 texel;
+
+void main()
+{
+	vec2 p = clamp(uv * uv_scale, texel * 0.5, uv_scale - texel * 0.5);
+	FragColor = texture(source, p);
+}
\ No newline at end of file
@@ -0,0 +1,11 @@
+#version 430 core
+
+// Full-screen triangle generated from gl_VertexID, no vertex buffer needed.
+out vec2 uv;
+
+void main()
+{
+	vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+	uv = pos;
+	gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
\ No newline at end of file
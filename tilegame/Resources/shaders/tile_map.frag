@@ -0,0 +1,32 @@
+#version 430 core
+
+// Tile layer over the view, drawn with present.vert. The tiles are one byte
+// palette indices in blocks of 64x64, each block's rows one after another
+// (TILE_MAP_BLOCK in tile_map.h).
+out vec4 FragColor;
+
+in vec2 uv;
+
+uniform usamplerBuffer tiles;
+uniform sampler2D palette;
+uniform vec2 view_size;
+uniform vec2 origin;		// view pixels of tile (0, 0), y down
+uniform float tile_size;
+uniform ivec2 map_size;
+uniform int blocks_x;
+uniform float opacity;
+
+void main()
+{
+	vec2 view = vec2(uv.x, 1.0 - uv.y) * view_size;
+	ivec2 tile = ivec2(floor((view - origin) / tile_size));
+	if (any(lessThan(tile, ivec2(0))) || any(greaterThanEqual(tile, map_size)))
+		discard;
+
+	ivec2 block = tile >> 6;
+	ivec2 local = tile & 63;
+	int index = ((block.y * blocks_x + block.x) << 12) + (local.y << 6) + local.x;
+	uint id = texelFetch(tiles, index).r;
+	vec4 color = texelFetch(palette, ivec2(int(id), 0), 0);
+	FragColor = vec4(color.rgb, color.a * opacity);
+}
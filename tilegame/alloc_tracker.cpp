@@ -0,0 +1,214 @@
+#include "stdafx.h"
+#include "alloc_tracker.h"
+
+#include <string.h>
+#include <new>
+
+#ifdef TILEGAME_TRACK_ALLOCS
+
+// Per thread, so that loader and writer threads are not charged to the frame.
+// Plain integers need no TLS initialisation, which keeps them safe to touch
+// from inside the allocator.
+static thread_local uint64_t thread_allocs = 0;
+static thread_local uint64_t thread_frees = 0;
+static uint64_t frame_start_allocs = 0;
+static uint64_t frame_start_frees = 0;
+static uint32_t frame_index = 0;
+static uint32_t violations = 0;
+
+#ifdef __GLIBC__
+
+// glibc lets the program replace malloc and friends, so every C allocation
+// in the process is counted here, operator new, SDL and ImGui included.
+extern "C" {
+
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* ptr, size_t size);
+void __libc_free(void* ptr);
+
+void* malloc(size_t size) noexcept
+{
+	thread_allocs++;
+	return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) noexcept
+{
+	thread_allocs++;
+	return __libc_calloc(count, size);
+}
+
+void* realloc(void* ptr, size_t size) noexcept
+{
+	thread_allocs++;
+	return __libc_realloc(ptr, size);
+}
+
+void free(void* ptr) noexcept
+{
+	if (ptr)
+		thread_frees++;
+	__libc_free(ptr);
+}
+
+}
+
+void alloc_tracker_install()
+{
+}
+
+// already counted by malloc() and free()
+void alloc_tracker_count_alloc()
+{
+}
+
+void alloc_tracker_count_free()
+{
+}
+
+#else
+
+static void* counted_malloc(size_t size)
+{
+	thread_allocs++;
+	return malloc(size);
+}
+
+static void counted_free(void* ptr)
+{
+	if (ptr)
+		thread_frees++;
+	free(ptr);
+}
+
+void* operator new(size_t size)
+{
+	void* ptr = counted_malloc(size ? size : 1);
+	if (!ptr)
+		throw std::bad_alloc();
+	return ptr;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	counted_free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	counted_free(ptr);
+}
+
+void operator delete(void* ptr, size_t size) noexcept
+{
+	counted_free(ptr);
+}
+
+void operator delete[](void* ptr, size_t size) noexcept
+{
+	counted_free(ptr);
+}
+
+#ifndef TILEGAME_HEADLESS
+static void* counted_calloc(size_t count, size_t size)
+{
+	thread_allocs++;
+	return calloc(count, size);
+}
+
+static void* counted_realloc(void* ptr, size_t size)
+{
+	thread_allocs++;
+	return realloc(ptr, size);
+}
+#endif
+
+void alloc_tracker_install()
+{
+#ifndef TILEGAME_HEADLESS
+	SDL_SetMemoryFunctions(counted_malloc, counted_calloc, counted_realloc, counted_free);
+#endif
+}
+
+void alloc_tracker_count_alloc()
+{
+	thread_allocs++;
+}
+
+void alloc_tracker_count_free()
+{
+	thread_frees++;
+}
+
+#endif // __GLIBC__
+
+void alloc_tracker_begin_frame()
+{
+	frame_start_allocs = thread_allocs;
+	frame_start_frees = thread_frees;
+}
+
+bool alloc_tracker_end_frame(AllocFrameStats* stats)
+{
+	uint32_t allocs = (uint32_t)(thread_allocs - frame_start_allocs);
+	uint32_t frees = (uint32_t)(thread_frees - frame_start_frees);
+	bool ok = frame_index < ALLOC_TRACKER_WARMUP_FRAMES || allocs == 0;
+
+	if (!ok) {
+		violations++;
+		printf("Frame %u allocated %u times after warmup\n", frame_index, allocs);
+	}
+
+	if (stats) {
+		stats->frame = frame_index;
+		stats->allocs = allocs;
+		stats->frees = frees;
+		stats->steady_state_violations = violations;
+	}
+
+	frame_index++;
+	return ok;
+}
+
+uint64_t alloc_tracker_total_allocs()
+{
+	return thread_allocs;
+}
+
+#else
+
+void alloc_tracker_install()
+{
+}
+
+void alloc_tracker_begin_frame()
+{
+}
+
+bool alloc_tracker_end_frame(AllocFrameStats* stats)
+{
+	if (stats)
+		memset(stats, 0, sizeof(AllocFrameStats));
+	return true;
+}
+
+uint64_t alloc_tracker_total_allocs()
+{
+	return 0;
+}
+
+void alloc_tracker_count_alloc()
+{
+}
+
+void alloc_tracker_count_free()
+{
+}
+
+#endif // TILEGAME_TRACK_ALLOCS
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+//----------------------------------------------------------------------------
+//
+//  Allocation tracking mode, enabled by building with TILEGAME_TRACK_ALLOCS.
+//    With glibc it replaces malloc, calloc, realloc and free, so every heap
+//    allocation is counted, whoever makes it. Elsewhere it replaces global
+//    operator new/delete and installs counting allocators for SDL, and ImGui
+//    allocations are counted by the allocator mem_stats installs; direct
+//    malloc calls go uncounted there.
+//
+//  Counts are kept per thread and a frame is charged with the allocations
+//    its own thread, the one that calls alloc_tracker_begin_frame(), made
+//    while it ran. Worker threads (chunk loaders, the save writer, hot
+//    reload) allocate freely.
+//
+//  After ALLOC_TRACKER_WARMUP_FRAMES the frame loop is expected to be
+//    allocation free; alloc_tracker_end_frame() reports any frame that still
+//    allocates. Without TILEGAME_TRACK_ALLOCS all calls are no-ops.
+//    tests/frame_allocs.cpp checks this headless under ctest.
+//
+
+#define ALLOC_TRACKER_WARMUP_FRAMES 120
+
+typedef struct AllocFrameStats {
+	uint32_t frame;
+	uint32_t allocs;
+	uint32_t frees;
+	uint32_t steady_state_violations;
+} AllocFrameStats;
+
+// Must run before SDL_Init().
+void
+alloc_tracker_install();
+
+void
+alloc_tracker_begin_frame();
+
+// Returns false when a frame past the warmup period allocated.
+bool
+alloc_tracker_end_frame(AllocFrameStats* stats);
+
+// Allocations made so far by the calling thread.
+uint64_t
+alloc_tracker_total_allocs();
+
+// For allocators that bypass the hooks above, such as the ImGui allocator
+// installed by mem_stats. No-ops where malloc itself is counted.
+void
+alloc_tracker_count_alloc();
+
+void
+alloc_tracker_count_free();
@@ -0,0 +1,107 @@
+#include "stdafx.h"
+#include "batch_pool.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Workers sleep until a batch is posted, then take jobs off the shared
+// counter until it runs out, like the calling thread.
+struct BatchWorkers {
+	std::thread threads[BATCH_POOL_MAX_WORKERS];
+	int count;
+	std::mutex lock;
+	std::condition_variable posted;
+	std::condition_variable finished;
+	uint64_t generation;
+	int done;
+	bool stopping;
+
+	BatchJob job;
+	void* user;
+	uint32_t job_count;
+	std::atomic<uint32_t> next;
+};
+
+static void
+run_jobs(BatchWorkers* w)
+{
+	for (uint32_t i = w->next++; i < w->job_count; i = w->next++)
+		w->job(w->user, i);
+}
+
+static void
+worker_main(BatchWorkers* w)
+{
+	uint64_t seen = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(w->lock);
+			w->posted.wait(lock, [w, &seen] { return w->stopping || w->generation != seen; });
+			if (w->stopping)
+				return;
+			seen = w->generation;
+		}
+		run_jobs(w);
+		std::lock_guard<std::mutex> guard(w->lock);
+		if (++w->done == w->count)
+			w->finished.notify_one();
+	}
+}
+
+bool batch_pool_start(BatchPool* pool, int threads)
+{
+	batch_pool_stop(pool);
+	if (threads <= 0)
+		return true;
+
+	BatchWorkers* w = new BatchWorkers();
+	threads = threads < BATCH_POOL_MAX_WORKERS ? threads : BATCH_POOL_MAX_WORKERS;
+	for (int i = 0; i < threads; i++) {
+		w->threads[i] = std::thread(worker_main, w);
+		w->count++;
+	}
+	pool->workers = w;
+	return true;
+}
+
+void batch_pool_stop(BatchPool* pool)
+{
+	BatchWorkers* w = pool->workers;
+	if (!w)
+		return;
+	{
+		std::lock_guard<std::mutex> guard(w->lock);
+		w->stopping = true;
+	}
+	w->posted.notify_all();
+	for (int i = 0; i < w->count; i++)
+		w->threads[i].join();
+	delete w;
+	pool->workers = NULL;
+}
+
+void batch_pool_run(BatchPool* pool, BatchJob job, void* user, uint32_t count)
+{
+	BatchWorkers* w = pool->workers;
+	if (!w) {
+		for (uint32_t i = 0; i < count; i++)
+			job(user, i);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> guard(w->lock);
+		w->job = job;
+		w->user = user;
+		w->job_count = count;
+		w->next = 0;
+		w->done = 0;
+		w->generation++;
+	}
+	w->posted.notify_all();
+	run_jobs(w);
+	std::unique_lock<std::mutex> lock(w->lock);
+	w->finished.wait(lock, [w] { return w->done == w->count; });
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+//----------------------------------------------------------------------------
+//
+//  Pool of worker threads for batches of independent jobs, shared by the
+//    FOV and world generation batches. batch_pool_run() posts a batch of
+//    'count' jobs and runs it with the workers; every thread takes job
+//    indices off a shared counter until it runs out, and the call returns
+//    when all of them are done. Workers sleep between batches.
+//
+//  Without workers a batch runs on the calling thread alone. One batch
+//    runs at a time per pool, and only one thread may post to a pool.
+//
+
+#define BATCH_POOL_MAX_WORKERS 16
+
+struct BatchWorkers;
+
+typedef struct BatchPool {
+	BatchWorkers* workers;		// NULL until started
+} BatchPool;
+
+// Runs job 'index' of a batch. Called concurrently from several threads.
+typedef void (*BatchJob)(void* user, uint32_t index);
+
+// Starts 'threads' workers, at most BATCH_POOL_MAX_WORKERS, stopping any
+// already running.
+bool
+batch_pool_start(BatchPool* pool, int threads);
+
+void
+batch_pool_stop(BatchPool* pool);
+
+void
+batch_pool_run(BatchPool* pool, BatchJob job, void* user, uint32_t count);
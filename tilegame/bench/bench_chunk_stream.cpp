@@ -0,0 +1,239 @@
+#include <benchmark/benchmark.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <thread>
+
+#include "../chunk_stream.h"
+#include "../vfs.h"
+
+// A camera flying diagonally across a 100k x 100k tile world at range(0)
+// tiles per frame, keeping a radius of range(1) chunks resident in a budget
+// of twice that many chunks. Each iteration is one frame of BENCH_FRAME_MS:
+// the update, then a read of every tile of a 40x23 tile view around the
+// camera, then a sleep until the frame ends. The time reported is that of
+// the update and the read. holes counts view tiles whose chunk had not
+// arrived yet; the loader thread never blocks a frame, so a camera faster
+// than the loader shows holes instead of stalling.
+//
+// BM_ChunkFlythrough generates chunks in memory, which measures the
+// manager itself. BM_ChunkFiles reads them from chunk files written to a
+// temporary directory over a 2048x2048 tile corridor, after checking that
+// a changed tile is saved when its chunk is evicted and read back when it
+// returns.
+#define BENCH_WORLD_TILES 100000
+#define BENCH_FRAME_MS 4
+#define BENCH_FRAMES 1000
+#define BENCH_VIEW_W 40
+#define BENCH_VIEW_H 23
+#define BENCH_FILE_CHUNKS 32
+
+typedef struct BenchFiles {
+	bool ready;
+	char root[64];
+	ChunkFileSource files;
+} BenchFiles;
+
+static BenchFiles bench;
+
+static uint32_t tile_hash(int32_t x, int32_t y)
+{
+	uint32_t h = (uint32_t)x * 0x9e3779b1u ^ (uint32_t)y * 0x85ebca77u;
+	h ^= h >> 13;
+	h *= 0xc2b2ae35u;
+	return h ^ (h >> 16);
+}
+
+// Rooms with pillars; outside the world everything is wall.
+static void generate_chunk(int32_t cx, int32_t cy, uint8_t* tiles)
+{
+	for (int y = 0; y < CHUNK_SIZE; y++) {
+		for (int x = 0; x < CHUNK_SIZE; x++) {
+			int32_t tx = cx * CHUNK_SIZE + x, ty = cy * CHUNK_SIZE + y;
+			bool outside = tx < 0 || ty < 0 || tx >= BENCH_WORLD_TILES || ty >= BENCH_WORLD_TILES;
+			bool wall = x == 0 || y == 0 || tile_hash(tx, ty) % 100 < 4;
+			tiles[y * CHUNK_SIZE + x] = outside || wall ? CHUNK_TILE_WALL : CHUNK_TILE_FLOOR;
+		}
+	}
+}
+
+static bool generate_source(void*, int32_t cx, int32_t cy, uint8_t* tiles)
+{
+	generate_chunk(cx, cy, tiles);
+	return true;
+}
+
+static void remove_root()
+{
+	char path[CHUNK_MAX_PATH];
+	for (int cy = 0; cy < BENCH_FILE_CHUNKS; cy++) {
+		for (int cx = 0; cx < BENCH_FILE_CHUNKS; cx++) {
+			snprintf(path, sizeof(path), "%s/%d_%d.chunk", bench.root, cx, cy);
+			remove(path);
+		}
+	}
+	remove(bench.root);
+}
+
+static bool setup_files()
+{
+	static bool tried = false;
+	if (tried)
+		return bench.ready;
+	tried = true;
+
+	snprintf(bench.root, sizeof(bench.root), "/tmp/tilegame_chunks_XXXXXX");
+	if (!mkdtemp(bench.root))
+		return false;
+	atexit(remove_root);
+	uint8_t tiles[CHUNK_TILES];
+	char path[CHUNK_MAX_PATH];
+	for (int cy = 0; cy < BENCH_FILE_CHUNKS; cy++) {
+		for (int cx = 0; cx < BENCH_FILE_CHUNKS; cx++) {
+			generate_chunk(cx, cy, tiles);
+			snprintf(path, sizeof(path), "%s/%d_%d.chunk", bench.root, cx, cy);
+			if (!chunk_file_write(path, cx, cy, tiles))
+				return false;
+		}
+	}
+	snprintf(bench.files.read_dir, sizeof(bench.files.read_dir), "%s", bench.root);
+	snprintf(bench.files.write_dir, sizeof(bench.files.write_dir), "%s", bench.root);
+	bench.files.fill = CHUNK_TILE_WALL;
+	bench.ready = true;
+	return true;
+}
+
+static void wait_until_idle(ChunkStream* cs, float x, float y)
+{
+	do {
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		chunk_stream_update(cs, x, y);
+	} while (chunk_stream_busy(cs));
+}
+
+// Every resident chunk holds what the source gave it.
+static bool check_resident(const ChunkStream* cs)
+{
+	uint8_t expected[CHUNK_TILES];
+	for (uint32_t i = 0; i < cs->capacity; i++) {
+		const ChunkSlot* slot = &cs->slots[i];
+		if (slot->state != CHUNK_RESIDENT)
+			continue;
+		generate_chunk(slot->cx, slot->cy, expected);
+		if (memcmp(slot->tiles, expected, CHUNK_TILES))
+			return false;
+	}
+	return true;
+}
+
+// A tile changed at the start must survive its chunk being evicted, saved
+// and loaded again; the file is put back afterwards.
+static bool check_save(const ChunkSource* source)
+{
+	ChunkStream cs;
+	if (!chunk_stream_init(&cs, source, 1, 16 * CHUNK_TILES))
+		return false;
+	float home = CHUNK_SIZE * 1.5f, away = CHUNK_SIZE * 20.5f;
+	wait_until_idle(&cs, home, home);
+	bool ok = check_resident(&cs);
+	uint8_t tile = chunk_stream_tile(&cs, CHUNK_SIZE + 5, CHUNK_SIZE + 7, CHUNK_TILE_WALL);
+	ok = ok && chunk_stream_set_tile(&cs, CHUNK_SIZE + 5, CHUNK_SIZE + 7, tile ^ 1);
+	for (float x = home; x < away; x += CHUNK_SIZE)
+		wait_until_idle(&cs, x, home);
+	ok = ok && !chunk_stream_tiles(&cs, 1, 1) && cs.stats.total_evicted > 0;
+	wait_until_idle(&cs, home, home);
+	ok = ok && chunk_stream_tile(&cs, CHUNK_SIZE + 5, CHUNK_SIZE + 7, 0xff) == (tile ^ 1);
+	chunk_stream_set_tile(&cs, CHUNK_SIZE + 5, CHUNK_SIZE + 7, tile);
+	chunk_stream_free(&cs);
+	return ok;
+}
+
+static void flythrough(benchmark::State& st, const ChunkSource* source, float world_tiles)
+{
+	float speed = (float)st.range(0);
+	int radius = (int)st.range(1);
+	uint32_t needed = 0;
+	int r2 = radius * radius + radius;
+	for (int dy = -radius; dy <= radius; dy++) {
+		for (int dx = -radius; dx <= radius; dx++)
+			needed += dx * dx + dy * dy <= r2;
+	}
+	ChunkStream cs;
+	if (!chunk_stream_init(&cs, source, radius, (size_t)2 * needed * CHUNK_TILES)) {
+		st.SkipWithError("chunk stream setup failed");
+		return;
+	}
+
+	float x = 0.0f;
+	uint64_t holes = 0, frames = 0;
+	double update_ms = 0.0, max_update_ms = 0.0;
+	for (auto _ : st) {
+		auto start = std::chrono::steady_clock::now();
+		chunk_stream_update(&cs, x, x);
+		update_ms += cs.stats.update_ms;
+		max_update_ms = cs.stats.update_ms > max_update_ms ? cs.stats.update_ms : max_update_ms;
+		int32_t x0 = (int32_t)x - BENCH_VIEW_W / 2, y0 = (int32_t)x - BENCH_VIEW_H / 2;
+		for (int32_t ty = y0; ty < y0 + BENCH_VIEW_H; ty++) {
+			for (int32_t tx = x0; tx < x0 + BENCH_VIEW_W; tx++)
+				holes += chunk_stream_tile(&cs, tx, ty, 0xff) == 0xff;
+		}
+		auto end = std::chrono::steady_clock::now();
+		st.SetIterationTime(std::chrono::duration<double>(end - start).count());
+		std::this_thread::sleep_until(start + std::chrono::milliseconds(BENCH_FRAME_MS));
+		frames++;
+		x += speed;
+		if (x >= world_tiles)
+			x = 0.0f;
+	}
+	wait_until_idle(&cs, x, x);
+	if (source->load == generate_source && !check_resident(&cs))
+		st.SkipWithError("resident chunk differs from its source");
+
+	st.counters["chunks_loaded"] = (double)cs.stats.total_loaded;
+	st.counters["holes"] = (double)holes / frames;
+	st.counters["resident"] = cs.stats.resident;
+	st.counters["update_ms"] = update_ms / frames;
+	st.counters["max_update_ms"] = max_update_ms;
+	st.counters["latency_avg_ms"] = cs.stats.latency_avg_ms;
+	st.counters["latency_p95_ms"] = cs.stats.latency_p95_ms;
+	st.counters["latency_max_ms"] = cs.stats.latency_max_ms;
+	chunk_stream_free(&cs);
+}
+
+// Arg 0: camera speed in tiles per frame. Arg 1: radius in chunks.
+static void BM_ChunkFlythrough(benchmark::State& st)
+{
+	ChunkSource source = { generate_source, NULL, NULL };
+	flythrough(st, &source, (float)BENCH_WORLD_TILES);
+}
+BENCHMARK(BM_ChunkFlythrough)
+	->ArgsProduct({ { 4, 16, 64 }, { 4, 8 } })
+	->Iterations(BENCH_FRAMES)
+	->UseManualTime()
+	->Unit(benchmark::kMicrosecond);
+
+static void BM_ChunkFiles(benchmark::State& st)
+{
+	ChunkSource source;
+	if (!setup_files()) {
+		st.SkipWithError("unable to write the chunk files");
+		return;
+	}
+	chunk_file_source(&source, &bench.files);
+	if (!check_save(&source)) {
+		st.SkipWithError("changed tile lost across eviction");
+		return;
+	}
+	flythrough(st, &source, (float)(BENCH_FILE_CHUNKS * CHUNK_SIZE));
+}
+BENCHMARK(BM_ChunkFiles)
+	->ArgsProduct({ { 4, 16, 64 }, { 4 } })
+	->Iterations(BENCH_FRAMES)
+	->UseManualTime()
+	->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,236 @@
+#include <benchmark/benchmark.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdint.h>
+#include <chrono>
+#include <vector>
+#include <algorithm>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_image.h"
+
+#include "../draw_queue.h"
+#include "../render_target.h"
+#include "../load_shaders.h"
+#include "../sprite_atlas.h"
+
+// Fragments shaded and world pass time of a dense, layered tile scene drawn
+// in submission order (painter's algorithm, everything blended) against
+// depth sorted (opaque tiles front to back with the depth test, then the
+// blended sprites back to front), on a headless EGL context. Run from the
+// tilegame directory.
+//
+// The scene is range(0) layers of 64x64 opaque wall tiles over the view,
+// the bottom one full and each layer above it covering about 60% of the
+// cells, plus BENCH_SPRITES trimmed 8dir sprites between the layers.
+#define BENCH_WIDTH 1280
+#define BENCH_HEIGHT 640
+#define BENCH_TILE 64
+#define BENCH_SPRITES 500
+#define BENCH_SPRITE_SCALE 2.0f
+
+typedef struct BenchQueue {
+	bool ready;
+	GLuint program;
+	GLuint tile_tex;
+	GLuint sprite_tex;
+	SpriteAtlas atlas;
+	DrawQueue queue;
+	FrameArena arena;
+	RenderTarget target;
+	std::vector<DrawItem> items;	// back to front, as the painter pushes them
+} BenchQueue;
+
+static BenchQueue bench;
+
+static bool create_context()
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	EGLDisplay display = get_platform_display ?
+		get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+		return false;
+
+	eglBindAPI(EGL_OPENGL_API);
+	const EGLint context_attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, context_attribs);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+		return false;
+	return gladLoadGLLoader((GLADloadproc)eglGetProcAddress) != 0;
+}
+
+static GLuint load_program(const char* vert, const char* frag)
+{
+	ShaderInfo shaders[] = {
+		{ GL_VERTEX_SHADER, vert },
+		{ GL_FRAGMENT_SHADER, frag },
+		{ GL_NONE, NULL }
+	};
+	return load_shaders(shaders);
+}
+
+static GLuint create_texture(const uint8_t* rgba, int width, int height)
+{
+	GLuint tex;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, rgba);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	return tex;
+}
+
+static uint32_t next_random(uint32_t* rng)
+{
+	*rng = *rng * 1664525u + 1013904223u;
+	return *rng >> 8;
+}
+
+// Layer 0 is the farthest. Sprites stand just in front of a random layer.
+static void build_scene(int layers)
+{
+	bench.items.clear();
+	uint32_t rng = 1234;
+	float layer_step = 0.8f / layers;
+
+	for (int layer = 0; layer < layers; layer++) {
+		float depth = 0.9f - layer * layer_step;
+		for (int y = 0; y < BENCH_HEIGHT; y += BENCH_TILE) {
+			for (int x = 0; x < BENCH_WIDTH; x += BENCH_TILE) {
+				if (layer > 0 && next_random(&rng) % 10 >= 6)
+					continue;
+				DrawItem tile = { (float)x, (float)y, (float)(x + BENCH_TILE), (float)(y + BENCH_TILE),
+					0.0f, 0.0f, 1.0f, 1.0f, depth, bench.tile_tex, true };
+				bench.items.push_back(tile);
+			}
+		}
+	}
+
+	float cell = 64 * BENCH_SPRITE_SCALE;
+	for (int i = 0; i < BENCH_SPRITES; i++) {
+		float x = (float)(next_random(&rng) % (uint32_t)(BENCH_WIDTH - cell));
+		float y = (float)(next_random(&rng) % (uint32_t)(BENCH_HEIGHT - cell));
+		int frame = (int)(next_random(&rng) % bench.atlas.header.frame_count);
+		int layer = (int)(next_random(&rng) % layers);
+		SpriteQuad q;
+		if (!sprite_frame_quad(&bench.atlas, frame, x, y, BENCH_SPRITE_SCALE, &q))
+			continue;
+		// distinct depths keep the blend order the same in both modes
+		float depth = 0.9f - layer * layer_step - layer_step * 0.5f * (i + 1) / (BENCH_SPRITES + 1);
+		DrawItem sprite = { q.x0, q.y0, q.x1, q.y1, q.u0, q.v0, q.u1, q.v1, depth, bench.sprite_tex, false };
+		bench.items.push_back(sprite);
+	}
+
+	std::stable_sort(bench.items.begin(), bench.items.end(),
+		[](const DrawItem& a, const DrawItem& b) { return a.depth > b.depth; });
+}
+
+static bool setup()
+{
+	static bool tried = false;
+	if (tried)
+		return bench.ready;
+	tried = true;
+
+	int width, height, channels;
+	if (!create_context())
+		return false;
+	uint8_t* wall = stbi_load("Resources/textures/wall.jpg", &width, &height, &channels, 4);
+	if (!wall)
+		return false;
+	bench.tile_tex = create_texture(wall, width, height);
+	stbi_image_free(wall);
+
+	uint8_t* sheet = stbi_load("Resources/textures/8dir.png", &width, &height, &channels, 4);
+	SpriteAtlasStats stats;
+	bool built = sheet && sprite_atlas_build(sheet, width, height, 64, 64, 0, &bench.atlas, &stats);
+	stbi_image_free(sheet);
+	if (!built)
+		return false;
+	bench.sprite_tex = create_texture(bench.atlas.rgba, (int)bench.atlas.header.width, (int)bench.atlas.header.height);
+
+	bench.program = load_program("Resources/shaders/tilegame.vert", "Resources/shaders/tilegame.frag");
+	GLuint present_program = load_program("Resources/shaders/present.vert", "Resources/shaders/present.frag");
+	if (!bench.program || !present_program ||
+		!render_target_init(&bench.target, BENCH_WIDTH, BENCH_HEIGHT, AA_NONE, present_program, 0) ||
+		!draw_queue_init(&bench.queue, 65536) ||
+		!frame_arena_init(&bench.arena, DRAW_QUEUE_FRAME_BYTES(65536)))
+		return false;
+
+	bench.ready = true;
+	return true;
+}
+
+static void render_frame(DrawOrder order)
+{
+	render_target_begin(&bench.target, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+	for (size_t i = 0; i < bench.items.size(); i++)
+		draw_queue_push(&bench.queue, &bench.items[i]);
+	draw_queue_flush(&bench.queue, bench.program, order, BENCH_WIDTH, BENCH_HEIGHT, 0, &bench.arena);
+	frame_arena_reset(&bench.arena);
+	render_target_end(&bench.target);
+}
+
+static std::vector<uint8_t> read_frame(DrawOrder order)
+{
+	render_frame(order);
+	std::vector<uint8_t> pixels((size_t)BENCH_WIDTH * BENCH_HEIGHT * 4);
+	glBindFramebuffer(GL_FRAMEBUFFER, bench.target.fbo);
+	glReadPixels(0, 0, BENCH_WIDTH, BENCH_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	return pixels;
+}
+
+// Arg 0: tile layers. Arg 1: DrawOrder.
+static void BM_LayeredScene(benchmark::State& st)
+{
+	int layers = (int)st.range(0);
+	DrawOrder order = (DrawOrder)st.range(1);
+	if (!setup()) {
+		st.SkipWithError("no headless GL 4.3 context (EGL) or resources not found");
+		return;
+	}
+	build_scene(layers);
+	if (read_frame(DRAW_ORDER_SUBMITTED) != read_frame(DRAW_ORDER_DEPTH_SORTED)) {
+		st.SkipWithError("depth sorted frame differs from the painter's algorithm");
+		return;
+	}
+
+	double world_ms = 0.0;
+	for (auto _ : st) {
+		auto start = std::chrono::steady_clock::now();
+		render_frame(order);
+		glFinish();
+		world_ms += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// every query slot now holds a frame of this mode
+	for (int i = 0; i < RENDER_TARGET_QUERIES; i++)
+		render_frame(order);
+	glFinish();
+	float gpu_ms, frame_scale;
+	if (!render_target_read_timer(&bench.target, &gpu_ms, &frame_scale)) {
+		st.SkipWithError("samples passed query not available");
+		return;
+	}
+
+	const DrawQueueStats* stats = &bench.queue.stats;
+	st.SetLabel(draw_order_name(order));
+	st.counters["world_ms"] = world_ms / st.iterations();
+	st.counters["fragments_per_pixel"] = (double)bench.target.samples_passed / (BENCH_WIDTH * BENCH_HEIGHT);
+	st.counters["items"] = stats->opaque_items + stats->blended_items;
+	st.counters["draw_calls"] = stats->draw_calls;
+}
+BENCHMARK(BM_LayeredScene)
+	->ArgsProduct({ { 1, 4, 8 }, { DRAW_ORDER_SUBMITTED, DRAW_ORDER_DEPTH_SORTED } })
+	->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
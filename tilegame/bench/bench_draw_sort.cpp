@@ -0,0 +1,111 @@
+#include <benchmark/benchmark.h>
+
+#include <stdint.h>
+#include <vector>
+#include <algorithm>
+
+#include "../draw_queue.h"
+#include "../radix_sort.h"
+
+// Sort stage of a frame of top-down sprites: range(0) actors spread over
+// a few layers of a 1280x720 view, each with its depth from its feet and
+// one of a few textures. The radix sort of the packed keys is compared
+// with std::sort of the same keys, tied by push order so both produce the
+// same draw order. time_per_sprite shows how each scales.
+#define BENCH_VIEW_WIDTH 1280
+#define BENCH_VIEW_HEIGHT 720
+#define BENCH_LAYERS 4
+#define BENCH_TEXTURES 4
+#define BENCH_SPRITE_SIZE 128
+
+typedef struct BenchSort {
+	std::vector<uint64_t> keys;
+	std::vector<uint64_t> sorted_keys;
+	std::vector<uint32_t> order;
+	std::vector<uint64_t> scratch_keys;
+	std::vector<uint32_t> scratch_order;
+} BenchSort;
+
+static uint32_t next_random(uint32_t* rng)
+{
+	*rng = *rng * 1664525u + 1013904223u;
+	return *rng >> 8;
+}
+
+static void build_keys(BenchSort* bench, uint32_t count)
+{
+	uint32_t rng = 1234;
+	bench->keys.resize(count);
+	for (uint32_t i = 0; i < count; i++) {
+		float x = (float)(next_random(&rng) % BENCH_VIEW_WIDTH);
+		float y = (float)(next_random(&rng) % (BENCH_VIEW_HEIGHT + BENCH_SPRITE_SIZE));
+		uint32_t layer = next_random(&rng) % BENCH_LAYERS;
+		DrawItem sprite = { x, y - BENCH_SPRITE_SIZE, x + BENCH_SPRITE_SIZE, y, 0.0f, 0.0f, 1.0f, 1.0f,
+			draw_layer_depth(layer, y, BENCH_VIEW_HEIGHT), 1 + next_random(&rng) % BENCH_TEXTURES, false };
+		bench->keys[i] = draw_item_sort_key(&sprite);
+	}
+	bench->sorted_keys.resize(count);
+	bench->order.resize(count);
+	bench->scratch_keys.resize(count);
+	bench->scratch_order.resize(count);
+}
+
+static void radix_order(BenchSort* bench, uint32_t count, int* passes)
+{
+	for (uint32_t i = 0; i < count; i++) {
+		bench->sorted_keys[i] = bench->keys[i];
+		bench->order[i] = i;
+	}
+	*passes = radix_sort_u64(bench->sorted_keys.data(), bench->order.data(), count,
+		bench->scratch_keys.data(), bench->scratch_order.data());
+}
+
+static void std_order(BenchSort* bench, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++)
+		bench->order[i] = i;
+	const uint64_t* keys = bench->keys.data();
+	std::sort(bench->order.begin(), bench->order.end(), [keys](uint32_t a, uint32_t b) {
+		if (keys[a] != keys[b])
+			return keys[a] < keys[b];
+		return a < b;
+	});
+}
+
+// Arg 0: sprites. Arg 1: 0 radix sort, 1 std::sort.
+static void BM_SortSprites(benchmark::State& st)
+{
+	uint32_t count = (uint32_t)st.range(0);
+	bool radix = st.range(1) == 0;
+	BenchSort bench;
+	build_keys(&bench, count);
+
+	int passes = 0;
+	std_order(&bench, count);
+	std::vector<uint32_t> expected = bench.order;
+	radix_order(&bench, count, &passes);
+	if (bench.order != expected) {
+		st.SkipWithError("radix sort order differs from std::sort");
+		return;
+	}
+
+	for (auto _ : st) {
+		if (radix)
+			radix_order(&bench, count, &passes);
+		else
+			std_order(&bench, count);
+		benchmark::DoNotOptimize(bench.order.data());
+	}
+
+	st.SetLabel(radix ? "radix" : "std::sort");
+	st.SetItemsProcessed(st.iterations() * count);
+	st.counters["time_per_sprite"] = benchmark::Counter((double)count * st.iterations(),
+		benchmark::Counter::kIsRate | benchmark::Counter::kInvert);
+	if (radix)
+		st.counters["passes"] = passes;
+}
+BENCHMARK(BM_SortSprites)
+	->ArgsProduct({ { 1000, 10000, 100000 }, { 0, 1 } })
+	->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
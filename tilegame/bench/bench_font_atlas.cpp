@@ -0,0 +1,245 @@
+#include <benchmark/benchmark.h>
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../imgui/imgui.h"
+
+// Startup cost of the ImGui font atlas: what ImGui_ImplOpenGL3_CreateFontsTexture
+// does (Build + RGBA32 expansion), eager on 1..N threads and lazy.
+//
+// The embedded ProggyClean font only covers Latin-1, so the eager benchmarks
+// stack it at several sizes with 3x horizontal oversampling. The large-range
+// benchmarks request the whole BMP. By default they use the embedded font,
+// which measures walking the range but has few glyphs to rasterize; set
+// TILEGAME_BENCH_FONT to a .ttf/.otf (a CJK font shows the seconds spent on
+// U+4E00..U+9FFF) for the full cost.
+#define BENCH_FONT_SIZES 8
+
+static const ImWchar bench_bmp_ranges[] = { 0x0020, 0xFFFF, 0 };
+
+static const char* bench_font_path()
+{
+	return getenv("TILEGAME_BENCH_FONT");
+}
+
+static void add_default_fonts(ImFontAtlas* atlas)
+{
+	for (int i = 0; i < BENCH_FONT_SIZES; i++) {
+		ImFontConfig cfg;
+		cfg.SizePixels = 13.0f + i * 7.0f;
+		cfg.OversampleH = 3;
+		atlas->AddFontDefault(&cfg);
+	}
+}
+
+static bool add_large_range_font(ImFontAtlas* atlas)
+{
+	const char* path = bench_font_path();
+	if (path)
+		return atlas->AddFontFromFileTTF(path, 18.0f, NULL, bench_bmp_ranges) != NULL;
+	ImFontConfig cfg;
+	cfg.SizePixels = 18.0f;
+	cfg.GlyphRanges = bench_bmp_ranges;
+	return atlas->AddFontDefault(&cfg) != NULL;
+}
+
+// A font that was asked for and cannot be loaded is an error, not a skip.
+static void check_large_range_font(benchmark::State& st)
+{
+	ImFontAtlas atlas;
+	if (!add_large_range_font(&atlas)) {
+		fprintf(stderr, "Could not load TILEGAME_BENCH_FONT=%s\n", bench_font_path());
+		exit(1);
+	}
+	st.SetLabel(bench_font_path() ? bench_font_path() : "embedded font");
+}
+
+static void build_rgba(ImFontAtlas* atlas)
+{
+	unsigned char* pixels;
+	int width, height;
+	atlas->GetTexDataAsRGBA32(&pixels, &width, &height);
+	benchmark::DoNotOptimize(pixels);
+}
+
+static bool same_glyph(const ImFontGlyph& a, const ImFontGlyph& b)
+{
+	return a.Codepoint == b.Codepoint && a.AdvanceX == b.AdvanceX &&
+		a.X0 == b.X0 && a.Y0 == b.Y0 && a.X1 == b.X1 && a.Y1 == b.Y1 &&
+		a.U0 == b.U0 && a.V0 == b.V0 && a.U1 == b.U1 && a.V1 == b.V1;
+}
+
+static bool same_glyphs(const ImFont* a, const ImFont* b)
+{
+	if (a->Glyphs.Size != b->Glyphs.Size)
+		return false;
+	for (int i = 0; i < a->Glyphs.Size; i++)
+		if (!same_glyph(a->Glyphs[i], b->Glyphs[i]))
+			return false;
+	return true;
+}
+
+// The threaded build must produce the single-threaded atlas byte for byte.
+static bool threaded_matches_single(bool large_range)
+{
+	ImFontAtlas single, threaded;
+	single.TexBuildThreads = 1;
+	threaded.TexBuildThreads = 4;
+	if (large_range) {
+		if (!add_large_range_font(&single) || !add_large_range_font(&threaded))
+			return false;
+	} else {
+		add_default_fonts(&single);
+		add_default_fonts(&threaded);
+	}
+	single.Build();
+	threaded.Build();
+
+	if (single.TexWidth != threaded.TexWidth || single.TexHeight != threaded.TexHeight ||
+		memcmp(single.TexPixelsAlpha8, threaded.TexPixelsAlpha8, single.TexWidth * single.TexHeight) != 0)
+		return false;
+	for (int i = 0; i < single.Fonts.Size; i++)
+		if (!same_glyphs(single.Fonts[i], threaded.Fonts[i]))
+			return false;
+	return true;
+}
+
+static bool same_bitmap(const ImFontAtlas* a, const ImFontGlyph* ga, const ImFontAtlas* b, const ImFontGlyph* gb)
+{
+	int ax = (int)lroundf(ga->U0 * a->TexWidth), ay = (int)lroundf(ga->V0 * a->TexHeight);
+	int bx = (int)lroundf(gb->U0 * b->TexWidth), by = (int)lroundf(gb->V0 * b->TexHeight);
+	int w = (int)lroundf((ga->U1 - ga->U0) * a->TexWidth), h = (int)lroundf((ga->V1 - ga->V0) * a->TexHeight);
+	for (int y = 0; y < h; y++)
+		if (memcmp(a->TexPixelsAlpha8 + (ay + y) * a->TexWidth + ax, b->TexPixelsAlpha8 + (by + y) * b->TexWidth + bx, w) != 0)
+			return false;
+	return true;
+}
+
+// Lazily rasterized glyphs must match the eager ones: advance before first use,
+// metrics and pixels after.
+static bool lazy_matches_eager()
+{
+	ImFontAtlas eager, lazy;
+	lazy.Flags |= ImFontAtlasFlags_LazyGlyphs;
+	lazy.TexDesiredWidth = 4096;
+	if (!add_large_range_font(&eager) || !add_large_range_font(&lazy))
+		return false;
+	eager.Build();
+	lazy.Build();
+
+	ImFont* ef = eager.Fonts[0];
+	ImFont* lf = lazy.Fonts[0];
+	for (int c = 0; c < ef->IndexAdvanceX.Size; c++)
+		if (ef->GetCharAdvance((ImWchar)c) != lf->GetCharAdvance((ImWchar)c))
+			return false;
+	for (int i = 0; i < ef->Glyphs.Size; i++) {
+		const ImFontGlyph* eg = &ef->Glyphs[i];
+		const ImFontGlyph* lg = lf->FindGlyph(eg->Codepoint);
+		if (!lg || lg->Codepoint != eg->Codepoint || lg->X0 != eg->X0 || lg->Y0 != eg->Y0 ||
+			lg->X1 != eg->X1 || lg->Y1 != eg->Y1 || lg->AdvanceX != eg->AdvanceX)
+			return false;
+		if (eg->Codepoint != '\t' && !same_bitmap(&eager, eg, &lazy, lg))
+			return false;
+	}
+	return true;
+}
+
+static void BM_FontAtlasEager(benchmark::State& st)
+{
+	int threads = (int)st.range(0);
+	if (!threaded_matches_single(false)) {
+		st.SkipWithError("threaded atlas differs from the single-threaded one");
+		return;
+	}
+
+	for (auto _ : st) {
+		ImFontAtlas atlas;
+		atlas.TexBuildThreads = threads;
+		add_default_fonts(&atlas);
+		build_rgba(&atlas);
+	}
+	st.SetLabel(threads == 1 ? "1 thread" : "threaded");
+}
+BENCHMARK(BM_FontAtlasEager)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+static void BM_FontAtlasLargeRangeEager(benchmark::State& st)
+{
+	int threads = (int)st.range(0);
+	check_large_range_font(st);
+	if (!threaded_matches_single(true)) {
+		st.SkipWithError("threaded atlas differs from the single-threaded one");
+		return;
+	}
+
+	int glyphs = 0;
+	for (auto _ : st) {
+		ImFontAtlas atlas;
+		atlas.TexBuildThreads = threads;
+		add_large_range_font(&atlas);
+		build_rgba(&atlas);
+		glyphs = atlas.Fonts[0]->Glyphs.Size;
+	}
+	st.counters["glyphs"] = glyphs;
+}
+BENCHMARK(BM_FontAtlasLargeRangeEager)->Arg(1)->Arg(4)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Startup with the same request in lazy mode: only Latin-1 is rasterized.
+static void BM_FontAtlasLargeRangeLazy(benchmark::State& st)
+{
+	check_large_range_font(st);
+	if (!lazy_matches_eager()) {
+		st.SkipWithError("lazy glyphs differ from the eager atlas");
+		return;
+	}
+
+	for (auto _ : st) {
+		ImFontAtlas atlas;
+		atlas.Flags |= ImFontAtlasFlags_LazyGlyphs;
+		add_large_range_font(&atlas);
+		build_rgba(&atlas);
+	}
+}
+BENCHMARK(BM_FontAtlasLargeRangeLazy)->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// Cost of a frame that shows 64 glyphs never seen before.
+static void BM_FontAtlasLazyFirstUse(benchmark::State& st)
+{
+	// the embedded font has nothing past Latin-1, which lazy mode rasterizes up front
+	if (!bench_font_path()) {
+		st.SkipWithError("needs TILEGAME_BENCH_FONT, the embedded font has no glyphs to rasterize lazily");
+		return;
+	}
+	check_large_range_font(st);
+
+	ImFontAtlas atlas;
+	atlas.Flags |= ImFontAtlasFlags_LazyGlyphs;
+	add_large_range_font(&atlas);
+	build_rgba(&atlas);
+	ImFont* font = atlas.Fonts[0];
+
+	int next = 0x100;
+	for (auto _ : st) {
+		for (int n = 0; n < 64 && next < 0xFFFF; next++)
+			if (font->GetCharAdvance((ImWchar)next) != font->FallbackAdvanceX || font->FindGlyphNoFallback((ImWchar)next)) {
+				benchmark::DoNotOptimize(font->FindGlyph((ImWchar)next));
+				n++;
+			}
+		if (next >= 0xFFFF) {
+			st.PauseTiming();
+			atlas.Clear();
+			add_large_range_font(&atlas);
+			build_rgba(&atlas);
+			font = atlas.Fonts[0];
+			next = 0x100;
+			st.ResumeTiming();
+		}
+		atlas.TexDirtyRect = ImVec4(0.0f, 0.0f, 0.0f, 0.0f);
+	}
+	st.SetItemsProcessed(st.iterations() * 64);
+}
+BENCHMARK(BM_FontAtlasLazyFirstUse)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,202 @@
+#include <benchmark/benchmark.h>
+
+#include <stdint.h>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_image.h"
+
+#include "../fov.h"
+
+// Field of view computations per second (items_per_second) from every
+// floor tile of the 64x64 levels in turn, and from NPCs scattered over a
+// 2048x2048 synthetic map of rooms and pillars, single threaded and in
+// batches on worker threads. BM_FovIncremental moves a few of the NPCs
+// and toggles a door each frame, so most views are reused. Run from the
+// tilegame directory.
+#define BENCH_MAP_SIZE 2048
+#define BENCH_ROOM_SIZE 16
+#define BENCH_NPCS 4096
+
+static const char* bench_levels[] = {
+	"Resources/Levels/level.png",
+	"Resources/Levels/level1.png",
+	"Resources/Levels/level2.png",
+};
+
+static uint32_t next_random(uint32_t* rng)
+{
+	*rng = *rng * 1664525u + 1013904223u;
+	return *rng >> 8;
+}
+
+// Rooms walled on a grid with a doorway in each wall, and a few pillars.
+static bool build_map(FovGrid* grid)
+{
+	if (!fov_grid_init(grid, BENCH_MAP_SIZE, BENCH_MAP_SIZE))
+		return false;
+	uint32_t rng = 1234;
+	for (int y = 0; y < BENCH_MAP_SIZE; y++) {
+		for (int x = 0; x < BENCH_MAP_SIZE; x++) {
+			int rx = x % BENCH_ROOM_SIZE, ry = y % BENCH_ROOM_SIZE;
+			bool wall = (rx == 0 && ry != BENCH_ROOM_SIZE / 2) || (ry == 0 && rx != BENCH_ROOM_SIZE / 2);
+			bool pillar = next_random(&rng) % 100 < 3;
+			grid->opaque[y * BENCH_MAP_SIZE + x] = wall || pillar;
+		}
+	}
+	return true;
+}
+
+static void scatter_npcs(const FovGrid* grid, std::vector<FovView>& views, std::vector<FovRequest>& requests, int radius)
+{
+	uint32_t rng = 99;
+	views.resize(BENCH_NPCS);
+	requests.resize(BENCH_NPCS);
+	for (int i = 0; i < BENCH_NPCS; i++) {
+		int x, y;
+		do {
+			x = (int)(next_random(&rng) % grid->width);
+			y = (int)(next_random(&rng) % grid->height);
+		} while (fov_grid_is_opaque(grid, x, y));
+		fov_view_init(&views[i], radius);
+		requests[i] = { &views[i], x, y };
+	}
+}
+
+// Every tile within the radius of an open grid must be visible, and
+// nothing behind a wall right next to the viewer.
+static bool check_fov(int radius)
+{
+	FovGrid grid;
+	FovView view;
+	fov_grid_init(&grid, 4 * radius, 4 * radius);
+	fov_view_init(&view, radius);
+	int c = 2 * radius;
+	fov_compute(&grid, &view, c, c);
+	bool ok = true;
+	for (int dy = -radius; dy <= radius; dy++) {
+		for (int dx = -radius; dx <= radius; dx++) {
+			if (dx * dx + dy * dy <= radius * radius)
+				ok = ok && fov_is_visible(&view, c + dx, c + dy);
+		}
+	}
+
+	for (int x = c - 2; x <= c + 2; x++)
+		fov_grid_set_opaque(&grid, x, c + 1, true);
+	ok = ok && fov_update(&grid, &view, c, c) && fov_is_visible(&view, c, c + 1) && !fov_is_visible(&view, c, c + 3);
+	fov_view_free(&view);
+	fov_grid_free(&grid);
+	return ok;
+}
+
+// Arg 0: level. Arg 1: radius.
+static void BM_FovLevel(benchmark::State& st)
+{
+	int width, height, channels;
+	uint8_t* rgba = stbi_load(bench_levels[st.range(0)], &width, &height, &channels, 4);
+	FovGrid grid;
+	if (!rgba || !fov_grid_from_level(&grid, rgba, width, height)) {
+		st.SkipWithError("unable to load level");
+		return;
+	}
+	stbi_image_free(rgba);
+	if (!check_fov((int)st.range(1))) {
+		st.SkipWithError("open field of view is not a full disc");
+		return;
+	}
+
+	std::vector<int> floors;
+	for (int i = 0; i < width * height; i++) {
+		if (!grid.opaque[i])
+			floors.push_back(i);
+	}
+	FovView view;
+	fov_view_init(&view, (int)st.range(1));
+	size_t n = 0;
+	uint64_t visible = 0;
+	for (auto _ : st) {
+		int tile = floors[n++ % floors.size()];
+		fov_compute(&grid, &view, tile % width, tile / width);
+		visible += view.visible_count;
+	}
+	st.SetItemsProcessed(st.iterations());
+	st.counters["visible_tiles"] = (double)visible / st.iterations();
+	fov_view_free(&view);
+	fov_grid_free(&grid);
+}
+BENCHMARK(BM_FovLevel)->ArgsProduct({ { 0, 1, 2 }, { 8, 32 } });
+
+// Arg 0: radius. Arg 1: worker threads, 0 for the calling thread alone.
+static void BM_FovBatch(benchmark::State& st)
+{
+	FovGrid grid;
+	if (!build_map(&grid)) {
+		st.SkipWithError("map allocation failed");
+		return;
+	}
+	std::vector<FovView> views;
+	std::vector<FovRequest> requests;
+	scatter_npcs(&grid, views, requests, (int)st.range(0));
+	int threads = (int)st.range(1);
+	if (threads)
+		fov_workers_start(threads);
+
+	FovBatchStats stats;
+	for (auto _ : st) {
+		// every view out of date, as if each NPC had moved
+		for (FovView& view : views)
+			view.valid = false;
+		fov_update_batch(&grid, requests.data(), BENCH_NPCS, &stats);
+	}
+	fov_workers_stop();
+
+	st.SetItemsProcessed(st.iterations() * BENCH_NPCS);
+	st.counters["batch_ms"] = stats.ms;
+	for (FovView& view : views)
+		fov_view_free(&view);
+	fov_grid_free(&grid);
+}
+BENCHMARK(BM_FovBatch)
+	->ArgsProduct({ { 16, 64 }, { 0, 1, 3, 7 } })
+	->Unit(benchmark::kMillisecond)
+	->UseRealTime();
+
+// Arg 0: NPCs that move per frame, out of BENCH_NPCS.
+static void BM_FovIncremental(benchmark::State& st)
+{
+	FovGrid grid;
+	if (!build_map(&grid)) {
+		st.SkipWithError("map allocation failed");
+		return;
+	}
+	std::vector<FovView> views;
+	std::vector<FovRequest> requests;
+	scatter_npcs(&grid, views, requests, 16);
+	FovBatchStats stats;
+	fov_update_batch(&grid, requests.data(), BENCH_NPCS, &stats);
+
+	int movers = (int)st.range(0);
+	uint32_t rng = 7, frame = 0, computed = 0;
+	for (auto _ : st) {
+		for (int i = 0; i < movers; i++) {
+			FovRequest* r = &requests[next_random(&rng) % BENCH_NPCS];
+			int x = r->x + (frame & 1 ? 1 : -1);
+			if (!fov_grid_is_opaque(&grid, x, r->y))
+				r->x = x;
+		}
+		// a doorway of room (5, 5) opens and closes
+		fov_grid_set_opaque(&grid, 5 * BENCH_ROOM_SIZE, 5 * BENCH_ROOM_SIZE + BENCH_ROOM_SIZE / 2, frame & 1);
+		fov_update_batch(&grid, requests.data(), BENCH_NPCS, &stats);
+		computed += stats.computed;
+		frame++;
+	}
+
+	st.SetItemsProcessed(st.iterations() * BENCH_NPCS);
+	st.counters["recomputed"] = (double)computed / st.iterations();
+	for (FovView& view : views)
+		fov_view_free(&view);
+	fov_grid_free(&grid);
+}
+BENCHMARK(BM_FovIncremental)->Arg(0)->Arg(64)->Arg(BENCH_NPCS)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
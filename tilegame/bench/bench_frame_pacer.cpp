@@ -0,0 +1,135 @@
+#include <benchmark/benchmark.h>
+
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+
+#include "../frame_pacer.h"
+
+// Input-to-photon latency of each pacing policy on a simulated 60 Hz
+// display. The game loop is modelled with a virtual clock: input is
+// sampled, BENCH_WORK_US +- BENCH_WORK_JITTER_US of simulation and
+// rendering follow (with a BENCH_SPIKE_US frame every BENCH_SPIKE_EVERY
+// frames), then the swap completes at the time the policy's swap interval
+// allows. Input events arrive at random times; each event's true latency is
+// the time until the middle of the screen shows the first frame that
+// sampled it. The pacer's own estimate must agree with it.
+#define BENCH_REFRESH_HZ 60.0
+#define BENCH_FRAMES 6000
+#define BENCH_EVENTS 20000
+#define BENCH_WORK_US 3000.0
+#define BENCH_WORK_JITTER_US 1000.0
+#define BENCH_SPIKE_US 12000.0
+#define BENCH_SPIKE_EVERY 50
+#define BENCH_MAX_ESTIMATE_ERROR_US 1500.0
+
+static uint32_t bench_rng = 0x9e3779b9u;
+
+static double rand_unit()
+{
+	bench_rng ^= bench_rng << 13;
+	bench_rng ^= bench_rng >> 17;
+	bench_rng ^= bench_rng << 5;
+	return (double)(bench_rng & 0xffffff) / (double)0x1000000;
+}
+
+typedef struct SimFrame {
+	double sample;
+	double photon;
+} SimFrame;
+
+// Swap completion for a swap requested at 't'. Vblanks fall on multiples of
+// 'refresh'. With adaptive vsync a swap that missed the vblank following the
+// previous present goes out immediately.
+static double swap_end_time(int interval, double t, double last_present, double refresh)
+{
+	if (interval == 0)
+		return t;
+	double next_vblank = ceil(t / refresh) * refresh;
+	if (interval < 0 && last_present > 0.0) {
+		double deadline = (floor(last_present / refresh + 1e-6) + 1.0) * refresh;
+		if (t > deadline)
+			return t;
+	}
+	return next_vblank;
+}
+
+static void simulate(FramePacing pacing, std::vector<SimFrame>* frames, FramePacer* pacer)
+{
+	double refresh = 1000000.0 / BENCH_REFRESH_HZ;
+	int interval = frame_pacer_swap_interval(pacing);
+	frame_pacer_init(pacer, pacing, BENCH_REFRESH_HZ);
+	frames->clear();
+
+	double t = 0.0, last_present = 0.0;
+	for (int i = 0; i < BENCH_FRAMES; i++) {
+		t += frame_pacer_input_delay_us(pacer, t);
+		frame_pacer_input_sampled(pacer, t);
+		SimFrame frame;
+		frame.sample = t;
+
+		t += BENCH_WORK_US + (rand_unit() * 2.0 - 1.0) * BENCH_WORK_JITTER_US;
+		if (i % BENCH_SPIKE_EVERY == BENCH_SPIKE_EVERY - 1)
+			t += BENCH_SPIKE_US;
+		frame_pacer_swap_begin(pacer, t);
+
+		t = swap_end_time(interval, t, last_present, refresh);
+		frame_pacer_swap_end(pacer, t);
+		last_present = t;
+
+		frame.photon = t + refresh * 0.5;
+		frames->push_back(frame);
+	}
+}
+
+// Average over random event times of the delay until the first frame that
+// sampled the event reaches the middle of the screen.
+static double true_latency_us(const std::vector<SimFrame>& frames)
+{
+	double start = frames.front().sample;
+	double end = frames.back().sample;
+	double total = 0.0;
+	for (int e = 0; e < BENCH_EVENTS; e++) {
+		double t = start + rand_unit() * (end - start);
+		size_t lo = 0, hi = frames.size() - 1;
+		while (lo < hi) {
+			size_t mid = (lo + hi) / 2;
+			if (frames[mid].sample >= t)
+				hi = mid;
+			else
+				lo = mid + 1;
+		}
+		total += frames[lo].photon - t;
+	}
+	return total / BENCH_EVENTS;
+}
+
+static void BM_FramePacing(benchmark::State& st)
+{
+	FramePacing pacing = (FramePacing)st.range(0);
+	std::vector<SimFrame> frames;
+	frames.reserve(BENCH_FRAMES);
+	FramePacer pacer;
+
+	double latency = 0.0;
+	for (auto _ : st) {
+		simulate(pacing, &frames, &pacer);
+		latency = true_latency_us(frames);
+	}
+
+	double estimate = pacer.stats.latency_avg_us;
+	if (fabs(estimate - latency) > BENCH_MAX_ESTIMATE_ERROR_US) {
+		st.SkipWithError("pacer latency estimate disagrees with the simulated display");
+		return;
+	}
+
+	double seconds = (frames.back().photon - frames.front().sample) / 1000000.0;
+	st.counters["latency_ms"] = latency / 1000.0;
+	st.counters["estimate_ms"] = estimate / 1000.0;
+	st.counters["late_frames"] = (double)pacer.stats.late_frames;
+	st.counters["fps"] = BENCH_FRAMES / seconds;
+	st.SetLabel(frame_pacer_name(pacing));
+}
+BENCHMARK(BM_FramePacing)->DenseRange(0, FRAME_PACING_COUNT - 1)->Iterations(1)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
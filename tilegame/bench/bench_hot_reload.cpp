@@ -0,0 +1,255 @@
+#include <benchmark/benchmark.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_image.h"
+
+#include "../hot_reload.h"
+
+// Reload latency of the PlayerAllAnim frames and of a shader program, from
+// the files being written to the new objects being swapped in, on a
+// headless EGL context. Run from the tilegame directory: the resources are
+// copied to a temporary directory which is watched and rewritten.
+//
+// The main loop is simulated by calling hot_reload_apply() every
+// BENCH_FRAME_MS, so a reload waits up to that long for its frame boundary.
+#define BENCH_FRAME_COUNT 199
+#define BENCH_FRAME_MS 1
+
+typedef struct BenchFile {
+	char path[64];						// relative to the watched root
+	std::vector<uint8_t> data;
+} BenchFile;
+
+typedef struct BenchReload {
+	bool ready;
+	char root[64];
+	BenchFile frames[BENCH_FRAME_COUNT];
+	BenchFile frag;
+	BenchFile vert;
+	GLuint textures[BENCH_FRAME_COUNT];
+	GLuint program;
+} BenchReload;
+
+static BenchReload bench;
+
+static bool create_context()
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	EGLDisplay display = get_platform_display ?
+		get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+		return false;
+
+	eglBindAPI(EGL_OPENGL_API);
+	const EGLint context_attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, context_attribs);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+		return false;
+	return gladLoadGLLoader((GLADloadproc)eglGetProcAddress) != 0;
+}
+
+static bool write_file(const BenchFile* file, const std::vector<uint8_t>& data)
+{
+	char full[128];
+	snprintf(full, sizeof(full), "%s/%s", bench.root, file->path);
+	FILE* f = fopen(full, "wb");
+	if (!f)
+		return false;
+	bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+	return fclose(f) == 0 && ok;
+}
+
+static bool copy_in(const char* source, const char* path, BenchFile* file)
+{
+	size_t size;
+	uint8_t* data = platform_read_file(source, &size);
+	if (!data)
+		return false;
+	snprintf(file->path, sizeof(file->path), "%s", path);
+	file->data.assign(data, data + size);
+	free(data);
+	return write_file(file, file->data);
+}
+
+static void remove_root()
+{
+	hot_reload_shutdown();
+	char full[128];
+	for (int i = 0; i < BENCH_FRAME_COUNT; i++) {
+		snprintf(full, sizeof(full), "%s/%s", bench.root, bench.frames[i].path);
+		remove(full);
+	}
+	const char* paths[] = { bench.vert.path, bench.frag.path, "textures/PlayerAllAnim", "textures", "shaders", "" };
+	for (int i = 0; i < 6; i++) {
+		snprintf(full, sizeof(full), "%s/%s", bench.root, paths[i]);
+		remove(full);
+	}
+}
+
+// Calls hot_reload_apply() once a frame until 'count' objects were replaced
+// or a second passed. Returns the number replaced.
+static int apply_until(int count)
+{
+	int swapped = 0;
+	auto start = std::chrono::steady_clock::now();
+	while (swapped < count && std::chrono::steady_clock::now() - start < std::chrono::seconds(1)) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(BENCH_FRAME_MS));
+		swapped += hot_reload_apply();
+	}
+	return swapped;
+}
+
+// Copies the resources, registers them and checks that a broken shader
+// keeps the running program while a fixed one replaces it.
+static bool setup()
+{
+	static bool tried = false;
+	if (tried)
+		return bench.ready;
+	tried = true;
+
+	snprintf(bench.root, sizeof(bench.root), "/tmp/tilegame_reload_XXXXXX");
+	if (!mkdtemp(bench.root) || !create_context())
+		return false;
+	atexit(remove_root);
+	char dir[128];
+	const char* dirs[] = { "shaders", "textures", "textures/PlayerAllAnim" };
+	for (int i = 0; i < 3; i++) {
+		snprintf(dir, sizeof(dir), "%s/%s", bench.root, dirs[i]);
+		mkdir(dir, 0755);
+	}
+
+	char source[128], path[64];
+	for (int i = 0; i < BENCH_FRAME_COUNT; i++) {
+		snprintf(path, sizeof(path), "textures/PlayerAllAnim/Player_%02d.png", i + 1);
+		snprintf(source, sizeof(source), "Resources/%s", path);
+		if (!copy_in(source, path, &bench.frames[i]))
+			return false;
+	}
+	if (!copy_in("Resources/shaders/tilegame.vert", "shaders/tilegame.vert", &bench.vert) ||
+		!copy_in("Resources/shaders/tilegame.frag", "shaders/tilegame.frag", &bench.frag))
+		return false;
+
+	if (!hot_reload_init(bench.root, NULL))
+		return false;
+
+	glGenTextures(BENCH_FRAME_COUNT, bench.textures);
+	uint32_t pixel = 0xffffffff;
+	for (int i = 0; i < BENCH_FRAME_COUNT; i++) {
+		glBindTexture(GL_TEXTURE_2D, bench.textures[i]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, &pixel);
+		if (!hot_reload_watch_texture(bench.frames[i].path, &bench.textures[i]))
+			return false;
+	}
+
+	char vert[128], frag[128];
+	snprintf(vert, sizeof(vert), "%s/%s", bench.root, bench.vert.path);
+	snprintf(frag, sizeof(frag), "%s/%s", bench.root, bench.frag.path);
+	ShaderInfo shaders[] = {
+		{ GL_VERTEX_SHADER, vert },
+		{ GL_FRAGMENT_SHADER, frag },
+		{ GL_NONE, NULL }
+	};
+	bench.program = load_shaders(shaders);
+	shaders[0].filename = bench.vert.path;
+	shaders[1].filename = bench.frag.path;
+	if (!bench.program || !hot_reload_watch_program(shaders, &bench.program))
+		return false;
+
+	static const char broken[] = "#version 430 core\nvoid main() { syntax error }\n";
+	GLuint before = bench.program;
+	HotReloadStats stats;
+	if (!write_file(&bench.frag, std::vector<uint8_t>(broken, broken + sizeof(broken) - 1)) || apply_until(1) != 0)
+		return false;
+	hot_reload_get_stats(&stats);
+	if (bench.program != before || stats.failures != 1)
+		return false;
+	if (!write_file(&bench.frag, bench.frag.data) || apply_until(1) != 1 || bench.program == before || !glIsProgram(bench.program))
+		return false;
+
+	bench.ready = true;
+	return true;
+}
+
+static void report(benchmark::State& st, const HotReloadStats* before, int reloads)
+{
+	HotReloadStats after;
+	hot_reload_get_stats(&after);
+	uint32_t count = after.reloads - before->reloads;
+	double latency_total = after.latency_avg_ms * after.reloads - before->latency_avg_ms * before->reloads;
+
+	st.counters["reloads"] = benchmark::Counter((double)count, benchmark::Counter::kAvgIterations);
+	st.counters["latency_avg_ms"] = count ? latency_total / count : 0.0;
+	st.counters["latency_max_ms"] = after.latency_max_ms;
+	st.counters["last_decode_ms"] = after.decode_ms;
+	st.counters["last_swap_ms"] = after.apply_ms;
+	if (count != (uint32_t)(reloads * st.iterations()))
+		st.SkipWithError("not every change was reloaded");
+}
+
+// range(0) frames of the animation are saved at once, as an export from a
+// sprite tool does. Time is from the last write to the last swap.
+static void BM_ReloadTextures(benchmark::State& st)
+{
+	int count = (int)st.range(0);
+	if (!setup()) {
+		st.SkipWithError("unable to set up the watched directory or GL context");
+		return;
+	}
+
+	HotReloadStats before;
+	hot_reload_get_stats(&before);
+	for (auto _ : st) {
+		for (int i = 0; i < count; i++)
+			write_file(&bench.frames[i], bench.frames[i].data);
+		auto start = std::chrono::steady_clock::now();
+		int swapped = apply_until(count);
+		glFinish();
+		st.SetIterationTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		if (swapped != count)
+			break;
+	}
+	report(st, &before, count);
+}
+BENCHMARK(BM_ReloadTextures)->Arg(1)->Arg(16)->Arg(BENCH_FRAME_COUNT)->UseManualTime()->Unit(benchmark::kMillisecond)->Iterations(10);
+
+static void BM_ReloadProgram(benchmark::State& st)
+{
+	if (!setup()) {
+		st.SkipWithError("unable to set up the watched directory or GL context");
+		return;
+	}
+
+	HotReloadStats before;
+	hot_reload_get_stats(&before);
+	for (auto _ : st) {
+		write_file(&bench.frag, bench.frag.data);
+		auto start = std::chrono::steady_clock::now();
+		int swapped = apply_until(1);
+		st.SetIterationTime(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		if (swapped != 1)
+			break;
+	}
+	report(st, &before, 1);
+}
+BENCHMARK(BM_ReloadProgram)->UseManualTime()->Unit(benchmark::kMillisecond)->Iterations(10);
+
+BENCHMARK_MAIN();
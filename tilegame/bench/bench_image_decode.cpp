@@ -0,0 +1,116 @@
+#include <benchmark/benchmark.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_image.h"
+
+#include "../image_decode.h"
+
+// Run from the tilegame directory so the resource paths resolve.
+static const char* bench_images[] = {
+	"Resources/textures/8dir.png",
+	"Resources/textures/8dir2.png",
+	"Resources/textures/player_sprites.png",
+	"Resources/textures/tavsan_sprite_sheet.png",
+	"Resources/textures/checkerboard.png",
+	"Resources/textures/DudeWalking.png",
+	"Resources/textures/PlayerAllAnim/Player_01.png",
+	"Resources/Levels/level2.png",
+	"Resources/Levels/test.png",
+	"Resources/textures/wall.jpg",
+};
+
+#define BENCH_IMAGE_COUNT (sizeof(bench_images) / sizeof(bench_images[0]))
+
+static bool read_file(const char* path, std::vector<uint8_t>* out)
+{
+	FILE* f = fopen(path, "rb");
+	if (!f)
+		return false;
+	fseek(f, 0, SEEK_END);
+	out->resize(ftell(f));
+	fseek(f, 0, SEEK_SET);
+	bool ok = fread(out->data(), 1, out->size(), f) == out->size();
+	fclose(f);
+	return ok;
+}
+
+// The fast decoder has to return exactly what stbi_load returns, for every
+// channel count a caller can ask for.
+static bool matches_stb(const std::vector<uint8_t>& file)
+{
+	for (int req = 0; req <= 4; req++) {
+		int sw, sh, sn, fw, fh, fn;
+		image_set_decoder(IMAGE_DECODER_FAST);
+		unsigned char* fast = image_load_from_memory(file.data(), file.size(), &fw, &fh, &fn, req);
+		unsigned char* ref = stbi_load_from_memory(file.data(), (int)file.size(), &sw, &sh, &sn, req);
+
+		bool same = fast && ref && fw == sw && fh == sh && fn == sn &&
+			memcmp(fast, ref, (size_t)sw * sh * (req ? req : sn)) == 0;
+		image_free(fast);
+		stbi_image_free(ref);
+		if (!same)
+			return false;
+	}
+	return true;
+}
+
+static void run_decode(benchmark::State& st, ImageDecoder decoder)
+{
+	const char* path = bench_images[st.range(0)];
+	std::vector<uint8_t> file;
+	if (!read_file(path, &file)) {
+		st.SkipWithError("unable to read image");
+		return;
+	}
+	if (decoder == IMAGE_DECODER_FAST && !matches_stb(file)) {
+		st.SkipWithError("output differs from stbi_load");
+		return;
+	}
+
+	image_set_decoder(decoder);
+	int w = 0, h = 0, n = 0;
+	for (auto _ : st) {
+		unsigned char* pixels = image_load_from_memory(file.data(), file.size(), &w, &h, &n, 4);
+		benchmark::DoNotOptimize(pixels);
+		image_free(pixels);
+	}
+
+	st.SetLabel(path);
+	st.SetBytesProcessed(st.iterations() * (int64_t)w * h * 4);
+}
+
+static void BM_DecodeStb(benchmark::State& st)
+{
+	run_decode(st, IMAGE_DECODER_STB);
+}
+BENCHMARK(BM_DecodeStb)->DenseRange(0, BENCH_IMAGE_COUNT - 1)->Unit(benchmark::kMillisecond);
+
+static void BM_DecodeFast(benchmark::State& st)
+{
+	run_decode(st, IMAGE_DECODER_FAST);
+}
+BENCHMARK(BM_DecodeFast)->DenseRange(0, BENCH_IMAGE_COUNT - 1)->Unit(benchmark::kMillisecond);
+
+static void BM_UnfilterRow(benchmark::State& st)
+{
+	const size_t row_bytes = 1024 * 4;
+	std::vector<uint8_t> src(row_bytes), prior(row_bytes), dst(row_bytes);
+	for (size_t i = 0; i < row_bytes; i++) {
+		src[i] = (uint8_t)(i * 7);
+		prior[i] = (uint8_t)(i * 13);
+	}
+
+	for (auto _ : st) {
+		image_unfilter_row((uint8_t)st.range(0), src.data(), prior.data(), dst.data(), row_bytes, 4);
+		benchmark::ClobberMemory();
+	}
+	st.SetBytesProcessed(st.iterations() * (int64_t)row_bytes);
+}
+BENCHMARK(BM_UnfilterRow)->DenseRange(1, 4);
+
+BENCHMARK_MAIN();
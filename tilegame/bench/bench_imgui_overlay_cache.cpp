@@ -0,0 +1,193 @@
+#include <benchmark/benchmark.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "../imgui/imgui.h"
+#include "../gui_cache.h"
+
+// CPU cost of the "Game stats" overlay per frame, built every frame versus
+// retained through gui_cache. The window mirrors show_overlay_window(): a
+// 256x256 image and a memory table of BENCH_STAT_ROWS categories.
+#define BENCH_STAT_ROWS 8
+#define BENCH_FPS 60
+
+typedef struct BenchStats {
+	int64_t current_bytes[BENCH_STAT_ROWS];
+	int64_t peak_bytes[BENCH_STAT_ROWS];
+	int32_t live_objects[BENCH_STAT_ROWS];
+} BenchStats;
+
+static const char* stat_names[BENCH_STAT_ROWS] = {
+	"GL textures", "GL vertex buffers", "GL index buffers", "SDL textures",
+	"Frame arena", "Pools", "Simulation", "ImGui",
+};
+
+static void create_context()
+{
+	ImGui::CreateContext();
+	ImGuiIO& io = ImGui::GetIO();
+	io.DisplaySize = ImVec2(1280.0f, 720.0f);
+	io.DeltaTime = 1.0f / BENCH_FPS;
+	io.IniFilename = NULL;
+	unsigned char* pixels;
+	int w, h;
+	io.Fonts->GetTexDataAsRGBA32(&pixels, &w, &h);
+	io.Fonts->TexID = (ImTextureID)(intptr_t)1;
+}
+
+static void show_overlay(const BenchStats* stats, const GuiCacheStats* cache_stats)
+{
+	ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
+	ImGui::Begin("Game stats", NULL, ImGuiWindowFlags_NoTitleBar);
+	ImGui::Image((ImTextureID)(intptr_t)2, ImVec2(256, 256), ImVec2(0, 0), ImVec2(1, 1), ImColor(255, 255, 255, 255), ImColor(255, 255, 255, 0));
+
+	ImGui::Separator();
+	ImGui::Columns(4, "memory");
+	ImGui::Text("Memory"); ImGui::NextColumn();
+	ImGui::Text("Current KB"); ImGui::NextColumn();
+	ImGui::Text("Peak KB"); ImGui::NextColumn();
+	ImGui::Text("Objects"); ImGui::NextColumn();
+	ImGui::Separator();
+	for (int c = 0; c < BENCH_STAT_ROWS; c++) {
+		ImGui::Text("%s", stat_names[c]); ImGui::NextColumn();
+		ImGui::Text("%.1f", stats->current_bytes[c] / 1024.0); ImGui::NextColumn();
+		ImGui::Text("%.1f", stats->peak_bytes[c] / 1024.0); ImGui::NextColumn();
+		ImGui::Text("%d", stats->live_objects[c]); ImGui::NextColumn();
+	}
+	ImGui::Columns(1);
+
+	ImGui::Separator();
+	ImGui::Text("GUI windows rebuilt: %llu reused: %llu", (unsigned long long)cache_stats->windows_rebuilt, (unsigned long long)cache_stats->windows_reused);
+	ImGui::End();
+}
+
+static uint64_t overlay_key(const BenchStats* stats, uint32_t second)
+{
+	uint64_t key = gui_cache_hash(GUI_CACHE_HASH_SEED, &second, sizeof(second));
+	return gui_cache_hash(key, stats, sizeof(*stats));
+}
+
+// Runs one overlay frame the way render_gui() does and returns the number of
+// vertex and index bytes the GL backend has to upload for it.
+static size_t overlay_frame(GuiCache* cache, bool retained, const BenchStats* stats, uint32_t second)
+{
+	uint64_t key = overlay_key(stats, second);
+	if (retained && gui_cache_reuse(cache, key))
+		return 0;
+
+	ImGui::NewFrame();
+	show_overlay(stats, &cache->stats);
+	ImGui::Render();
+	ImDrawData* draw_data = ImGui::GetDrawData();
+	gui_cache_store(cache, key, draw_data);
+
+	return draw_data->TotalVtxCount * sizeof(ImDrawVert) + draw_data->TotalIdxCount * sizeof(ImDrawIdx);
+}
+
+static void init_stats(BenchStats* stats)
+{
+	memset(stats, 0, sizeof(*stats));
+	for (int c = 0; c < BENCH_STAT_ROWS; c++) {
+		stats->current_bytes[c] = (c + 1) * 12345;
+		stats->peak_bytes[c] = (c + 1) * 23456;
+		stats->live_objects[c] = c * 3;
+	}
+}
+
+static std::vector<uint8_t> draw_data_bytes()
+{
+	std::vector<uint8_t> bytes;
+	ImDrawData* draw_data = ImGui::GetDrawData();
+	for (int n = 0; n < draw_data->CmdListsCount; n++) {
+		const ImDrawList* list = draw_data->CmdLists[n];
+		const uint8_t* vtx = (const uint8_t*)list->VtxBuffer.Data;
+		const uint8_t* idx = (const uint8_t*)list->IdxBuffer.Data;
+		bytes.insert(bytes.end(), vtx, vtx + list->VtxBuffer.Size * sizeof(ImDrawVert));
+		bytes.insert(bytes.end(), idx, idx + list->IdxBuffer.Size * sizeof(ImDrawIdx));
+	}
+	return bytes;
+}
+
+// A reused frame must draw exactly what rebuilding it would have drawn, a
+// mouse move over the window must rebuild, and one elsewhere must not.
+static bool retained_matches_rebuilt()
+{
+	create_context();
+	GuiCache cache;
+	gui_cache_init(&cache);
+	BenchStats stats;
+	init_stats(&stats);
+	ImGuiIO& io = ImGui::GetIO();
+	io.MousePos = ImVec2(1000.0f, 600.0f);
+
+	// Let the auto-fitting window settle and take the counters out of the
+	// content, since they change on every rebuild.
+	for (int i = 0; i < 4; i++)
+		overlay_frame(&cache, false, &stats, 0);
+	GuiCacheStats frozen = cache.stats;
+
+	bool ok = true;
+	uint64_t key = overlay_key(&stats, 0);
+	ImGui::NewFrame();
+	show_overlay(&stats, &frozen);
+	ImGui::Render();
+	gui_cache_store(&cache, key, ImGui::GetDrawData());
+	std::vector<uint8_t> retained = draw_data_bytes();
+
+	io.MousePos = ImVec2(1100.0f, 650.0f);
+	ok = ok && gui_cache_reuse(&cache, key);
+	ok = ok && draw_data_bytes() == retained;
+
+	gui_cache_invalidate(&cache);
+	ok = ok && !gui_cache_reuse(&cache, key);
+	ImGui::NewFrame();
+	show_overlay(&stats, &frozen);
+	ImGui::Render();
+	gui_cache_store(&cache, key, ImGui::GetDrawData());
+	ok = ok && draw_data_bytes() == retained;
+
+	io.MousePos = ImVec2(20.0f, 20.0f);
+	ok = ok && !gui_cache_reuse(&cache, key);
+
+	ImGui::DestroyContext();
+	return ok;
+}
+
+// Arg 0: 0 = NewFrame()/Render() every frame, 1 = retained.
+// Arg 1: frames between changes of the overlay's inputs (the memory stats
+// and the once-a-second counter refresh), 0 = never.
+static void BM_OverlayFrame(benchmark::State& st)
+{
+	bool retained = st.range(0) != 0;
+	int change_every = (int)st.range(1);
+	if (!retained_matches_rebuilt()) {
+		st.SkipWithError("retained overlay frame differs from a rebuilt one");
+		return;
+	}
+
+	create_context();
+	GuiCache cache;
+	gui_cache_init(&cache);
+	BenchStats stats;
+	init_stats(&stats);
+	ImGui::GetIO().MousePos = ImVec2(1000.0f, 600.0f);
+
+	uint32_t frame = 0;
+	size_t upload_bytes = 0;
+	for (auto _ : st) {
+		uint32_t second = change_every ? frame / change_every : 0;
+		upload_bytes += overlay_frame(&cache, retained, &stats, second);
+		frame++;
+	}
+
+	st.counters["windows_rebuilt"] = (double)cache.stats.windows_rebuilt;
+	st.counters["windows_reused"] = (double)cache.stats.windows_reused;
+	st.counters["upload_bytes_per_frame"] = (double)upload_bytes / (double)frame;
+	st.SetLabel(retained ? "retained" : "immediate");
+	ImGui::DestroyContext();
+}
+BENCHMARK(BM_OverlayFrame)->Args({ 0, 0 })->Args({ 1, BENCH_FPS })->Args({ 1, 1 })->Args({ 1, 0 })->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
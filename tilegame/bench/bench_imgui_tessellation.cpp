@@ -0,0 +1,165 @@
+#include <benchmark/benchmark.h>
+
+#include <math.h>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include "../imgui/imgui.h"
+#include "../imgui/imgui_internal.h"
+
+// A debug overlay full of graphs: BENCH_PLOTS line plots of BENCH_PLOT_POINTS
+// samples each (thin and thick strokes), plus filled circle markers.
+#define BENCH_PLOTS 64
+#define BENCH_PLOT_POINTS 256
+#define BENCH_MARKERS 256
+#define BENCH_MARKER_SEGMENTS 24
+
+static uint32_t bench_rng = 0x9e3779b9u;
+
+static float rand_float()
+{
+	bench_rng ^= bench_rng << 13;
+	bench_rng ^= bench_rng >> 17;
+	bench_rng ^= bench_rng << 5;
+	return (float)(bench_rng & 0xffffff) / (float)0x1000000;
+}
+
+static void make_plot(ImVec2* points, int count, float x, float y)
+{
+	for (int i = 0; i < count; i++)
+		points[i] = ImVec2(x + i * 1.5f, y + 20.0f * sinf(i * 0.1f) + 8.0f * rand_float());
+}
+
+static void make_circle(ImVec2* points, int count, float x, float y, float radius)
+{
+	for (int i = 0; i < count; i++) {
+		float a = (float)i * 2.0f * IM_PI / (float)count;
+		points[i] = ImVec2(x + cosf(a) * radius, y + sinf(a) * radius);
+	}
+}
+
+static ImDrawListSharedData* shared_data()
+{
+	static ImDrawListSharedData data;
+	data.TexUvWhitePixel = ImVec2(0.25f, 0.75f);
+	return &data;
+}
+
+static void begin_list(ImDrawList* list, bool vectorized)
+{
+	list->Clear();
+	list->PushClipRectFullScreen();
+	list->PushTextureID(NULL);
+	if (!vectorized)
+		list->Flags &= ~ImDrawListFlags_VectorizedTessellation;
+}
+
+// Emits the same shapes into a scalar and a vectorized list and compares the
+// buffers byte for byte. Covers open/closed, thin/thick, short point counts
+// (all tail) and repeated points (zero-length edges).
+static bool vectorized_matches_scalar()
+{
+	ImDrawList scalar(shared_data()), vectorized(shared_data());
+	begin_list(&scalar, false);
+	begin_list(&vectorized, true);
+
+	ImVec2 points[64];
+	for (int shape = 0; shape < 2000; shape++) {
+		int count = 2 + shape % 41;
+		for (int i = 0; i < count; i++)
+			points[i] = ImVec2(rand_float() * 500.0f, rand_float() * 500.0f);
+		if (shape % 7 == 0)
+			points[count / 2] = points[count / 2 - 1];
+		bool closed = (shape & 1) != 0;
+		float thickness = (shape & 2) ? 1.0f : 1.0f + rand_float() * 4.0f;
+		ImU32 col = IM_COL32(255, shape & 0xff, 0, 255);
+
+		scalar.AddPolyline(points, count, col, closed, thickness);
+		vectorized.AddPolyline(points, count, col, closed, thickness);
+		if (count >= 3) {
+			make_circle(points, count, 250.0f, 250.0f, 1.0f + rand_float() * 100.0f);
+			scalar.AddConvexPolyFilled(points, count, col);
+			vectorized.AddConvexPolyFilled(points, count, col);
+		}
+	}
+
+	return scalar.VtxBuffer.Size == vectorized.VtxBuffer.Size &&
+		scalar.IdxBuffer.Size == vectorized.IdxBuffer.Size &&
+		memcmp(scalar.VtxBuffer.Data, vectorized.VtxBuffer.Data, scalar.VtxBuffer.Size * sizeof(ImDrawVert)) == 0 &&
+		memcmp(scalar.IdxBuffer.Data, vectorized.IdxBuffer.Data, scalar.IdxBuffer.Size * sizeof(ImDrawIdx)) == 0;
+}
+
+static void BM_TessellatePolyline(benchmark::State& st)
+{
+	bool vectorized = st.range(0) != 0;
+	float thickness = (float)st.range(1);
+	if (!vectorized_matches_scalar()) {
+		st.SkipWithError("vectorized tessellation differs from the scalar path");
+		return;
+	}
+
+	std::vector<ImVec2> points(BENCH_PLOTS * BENCH_PLOT_POINTS);
+	for (int p = 0; p < BENCH_PLOTS; p++)
+		make_plot(&points[p * BENCH_PLOT_POINTS], BENCH_PLOT_POINTS, 10.0f, 10.0f + p * 12.0f);
+
+	ImDrawList list(shared_data());
+	for (auto _ : st) {
+		begin_list(&list, vectorized);
+		for (int p = 0; p < BENCH_PLOTS; p++)
+			list.AddPolyline(&points[p * BENCH_PLOT_POINTS], BENCH_PLOT_POINTS, IM_COL32_WHITE, false, thickness);
+		benchmark::DoNotOptimize(list.VtxBuffer.Data);
+	}
+	st.SetItemsProcessed(st.iterations() * BENCH_PLOTS * BENCH_PLOT_POINTS);
+	st.SetLabel(vectorized ? "sse2" : "scalar");
+}
+BENCHMARK(BM_TessellatePolyline)->ArgsProduct({ { 0, 1 }, { 1, 3 } })->Unit(benchmark::kMicrosecond);
+
+static void BM_TessellateConvexFill(benchmark::State& st)
+{
+	bool vectorized = st.range(0) != 0;
+
+	std::vector<ImVec2> points(BENCH_MARKERS * BENCH_MARKER_SEGMENTS);
+	for (int m = 0; m < BENCH_MARKERS; m++)
+		make_circle(&points[m * BENCH_MARKER_SEGMENTS], BENCH_MARKER_SEGMENTS, 20.0f + m * 3.0f, 40.0f, 4.0f);
+
+	ImDrawList list(shared_data());
+	for (auto _ : st) {
+		begin_list(&list, vectorized);
+		for (int m = 0; m < BENCH_MARKERS; m++)
+			list.AddConvexPolyFilled(&points[m * BENCH_MARKER_SEGMENTS], BENCH_MARKER_SEGMENTS, IM_COL32_WHITE);
+		benchmark::DoNotOptimize(list.VtxBuffer.Data);
+	}
+	st.SetItemsProcessed(st.iterations() * BENCH_MARKERS * BENCH_MARKER_SEGMENTS);
+	st.SetLabel(vectorized ? "sse2" : "scalar");
+}
+BENCHMARK(BM_TessellateConvexFill)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+// Whole overlay: graph strokes, the frame around each graph and markers.
+static void BM_TessellateOverlay(benchmark::State& st)
+{
+	bool vectorized = st.range(0) != 0;
+
+	std::vector<ImVec2> plots(BENCH_PLOTS * BENCH_PLOT_POINTS);
+	std::vector<ImVec2> markers(BENCH_MARKERS * BENCH_MARKER_SEGMENTS);
+	for (int p = 0; p < BENCH_PLOTS; p++)
+		make_plot(&plots[p * BENCH_PLOT_POINTS], BENCH_PLOT_POINTS, 10.0f, 10.0f + p * 12.0f);
+	for (int m = 0; m < BENCH_MARKERS; m++)
+		make_circle(&markers[m * BENCH_MARKER_SEGMENTS], BENCH_MARKER_SEGMENTS, 20.0f + m * 3.0f, 40.0f, 4.0f);
+
+	ImDrawList list(shared_data());
+	for (auto _ : st) {
+		begin_list(&list, vectorized);
+		for (int p = 0; p < BENCH_PLOTS; p++) {
+			list.AddPolyline(&plots[p * BENCH_PLOT_POINTS], BENCH_PLOT_POINTS, IM_COL32_WHITE, false, p & 1 ? 2.0f : 1.0f);
+			list.AddRect(ImVec2(8.0f, 8.0f + p * 12.0f), ImVec2(400.0f, 20.0f + p * 12.0f), IM_COL32(128, 128, 128, 255), 4.0f);
+		}
+		for (int m = 0; m < BENCH_MARKERS; m++)
+			list.AddConvexPolyFilled(&markers[m * BENCH_MARKER_SEGMENTS], BENCH_MARKER_SEGMENTS, IM_COL32(255, 0, 0, 255));
+		benchmark::DoNotOptimize(list.VtxBuffer.Data);
+	}
+	st.SetLabel(vectorized ? "sse2" : "scalar");
+}
+BENCHMARK(BM_TessellateOverlay)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,229 @@
+#include <benchmark/benchmark.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdint.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_image.h"
+
+#include "../lighting.h"
+#include "../draw_queue.h"
+#include "../render_target.h"
+#include "../load_shaders.h"
+
+// Frame time against point light count: a 1280x720 world (one textured
+// ground quad) lit by range(0) lights of 48-160 pixel radius scattered over
+// the view, with the light buffer at 1/range(1) of the view resolution.
+// frame_ms covers the world pass, binning, light accumulation and the
+// composite; light_ms only the lighting. Before timing, the binned light
+// buffer is checked against every light summed on the CPU. Run from the
+// tilegame directory on a headless EGL context (llvmpipe without a GPU).
+#define BENCH_WIDTH 1280
+#define BENCH_HEIGHT 720
+#define BENCH_MIN_RADIUS 48
+#define BENCH_MAX_RADIUS 160
+#define BENCH_CHECK_STEP 7
+
+typedef struct BenchLighting {
+	bool ready;
+	GLuint world_program;
+	GLuint accumulate_program;
+	GLuint composite_program;
+	GLuint ground_tex;
+	DrawQueue queue;
+	FrameArena arena;
+	RenderTarget target;
+} BenchLighting;
+
+static BenchLighting bench;
+
+static bool create_context()
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	EGLDisplay display = get_platform_display ?
+		get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+		return false;
+
+	eglBindAPI(EGL_OPENGL_API);
+	const EGLint context_attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, context_attribs);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+		return false;
+	return gladLoadGLLoader((GLADloadproc)eglGetProcAddress) != 0;
+}
+
+static GLuint load_program(const char* vert, const char* frag)
+{
+	ShaderInfo shaders[] = {
+		{ GL_VERTEX_SHADER, vert },
+		{ GL_FRAGMENT_SHADER, frag },
+		{ GL_NONE, NULL }
+	};
+	return load_shaders(shaders);
+}
+
+static bool setup()
+{
+	static bool tried = false;
+	if (tried)
+		return bench.ready;
+	tried = true;
+
+	if (!create_context())
+		return false;
+	int width, height, channels;
+	uint8_t* wall = stbi_load("Resources/textures/wall.jpg", &width, &height, &channels, 4);
+	if (!wall)
+		return false;
+	glGenTextures(1, &bench.ground_tex);
+	glBindTexture(GL_TEXTURE_2D, bench.ground_tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, wall);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	stbi_image_free(wall);
+
+	bench.world_program = load_program("Resources/shaders/tilegame.vert", "Resources/shaders/tilegame.frag");
+	bench.accumulate_program = load_program("Resources/shaders/present.vert", "Resources/shaders/light_accumulate.frag");
+	bench.composite_program = load_program("Resources/shaders/present.vert", "Resources/shaders/light_composite.frag");
+	GLuint present_program = load_program("Resources/shaders/present.vert", "Resources/shaders/present.frag");
+	if (!bench.world_program || !bench.accumulate_program || !bench.composite_program || !present_program ||
+		!render_target_init(&bench.target, BENCH_WIDTH, BENCH_HEIGHT, AA_NONE, present_program, 0) ||
+		!draw_queue_init(&bench.queue, 16) ||
+		!frame_arena_init(&bench.arena, DRAW_QUEUE_FRAME_BYTES(16)))
+		return false;
+
+	bench.ready = true;
+	return true;
+}
+
+static uint32_t next_random(uint32_t* rng)
+{
+	*rng = *rng * 1664525u + 1013904223u;
+	return *rng >> 8;
+}
+
+static void add_lights(LightBuffer* lb, int count)
+{
+	uint32_t rng = 1234;
+	lighting_clear(lb);
+	for (int i = 0; i < count; i++) {
+		PointLight light = {};
+		light.x = (float)(next_random(&rng) % BENCH_WIDTH);
+		light.y = (float)(next_random(&rng) % BENCH_HEIGHT);
+		light.radius = (float)(BENCH_MIN_RADIUS + next_random(&rng) % (BENCH_MAX_RADIUS - BENCH_MIN_RADIUS));
+		light.intensity = 0.5f + (next_random(&rng) % 100) / 100.0f;
+		light.r = 1.0f;
+		light.g = 0.5f + (next_random(&rng) % 50) / 100.0f;
+		light.b = (next_random(&rng) % 100) / 100.0f;
+		lighting_add(lb, &light);
+	}
+}
+
+// The light buffer against every light summed at the same points.
+static bool check_light_buffer(const LightBuffer* lb)
+{
+	std::vector<float> texels((size_t)lb->width * lb->height * 4);
+	glBindFramebuffer(GL_FRAMEBUFFER, lb->fbo);
+	glReadPixels(0, 0, lb->width, lb->height, GL_RGBA, GL_FLOAT, texels.data());
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	float sx = (float)lb->view_width / lb->width, sy = (float)lb->view_height / lb->height;
+	for (int y = 0; y < lb->height; y += BENCH_CHECK_STEP) {
+		for (int x = 0; x < lb->width; x += BENCH_CHECK_STEP) {
+			float px = (x + 0.5f) * sx, py = (lb->height - y - 0.5f) * sy;
+			float expected[3] = { lb->ambient[0], lb->ambient[1], lb->ambient[2] };
+			for (uint32_t i = 0; i < lb->light_count; i++) {
+				const PointLight* l = &lb->lights[i];
+				float dx = px - l->x, dy = py - l->y;
+				float falloff = 1.0f - (dx * dx + dy * dy) / (l->radius * l->radius);
+				if (falloff <= 0.0f)
+					continue;
+				float k = l->intensity * falloff * falloff;
+				expected[0] += l->r * k;
+				expected[1] += l->g * k;
+				expected[2] += l->b * k;
+			}
+			const float* got = &texels[((size_t)y * lb->width + x) * 4];
+			for (int c = 0; c < 3; c++) {
+				if (fabsf(got[c] - expected[c]) > 0.01f * fmaxf(1.0f, expected[c]))
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+static void render_world()
+{
+	DrawItem ground = { 0.0f, 0.0f, (float)BENCH_WIDTH, (float)BENCH_HEIGHT, 0.0f, 0.0f, 1.0f, 1.0f, 0.5f, bench.ground_tex, true };
+	render_target_begin(&bench.target, 1.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+	draw_queue_push(&bench.queue, &ground);
+	draw_queue_flush(&bench.queue, bench.world_program, DRAW_ORDER_DEPTH_SORTED, BENCH_WIDTH, BENCH_HEIGHT, 0, &bench.arena);
+	frame_arena_reset(&bench.arena);
+}
+
+// Arg 0: lights. Arg 1: light buffer downscale.
+static void BM_Lighting(benchmark::State& st)
+{
+	int light_count = (int)st.range(0);
+	int downscale = (int)st.range(1);
+	if (!setup()) {
+		st.SkipWithError("no headless GL 4.3 context (EGL) or resources not found");
+		return;
+	}
+
+	LightBuffer lb;
+	if (!lighting_init(&lb, BENCH_WIDTH, BENCH_HEIGHT, downscale, (uint32_t)light_count, bench.accumulate_program, bench.composite_program)) {
+		st.SkipWithError("light buffer setup failed");
+		return;
+	}
+	add_lights(&lb, light_count);
+	lighting_render(&lb);
+	if (lb.stats.dropped || !check_light_buffer(&lb)) {
+		lighting_free(&lb);
+		st.SkipWithError("binned light buffer differs from the sum of every light");
+		return;
+	}
+
+	double frame_ms = 0.0, light_ms = 0.0, bin_ms = 0.0;
+	for (auto _ : st) {
+		auto start = std::chrono::steady_clock::now();
+		render_world();
+		glFinish();
+		auto lit = std::chrono::steady_clock::now();
+		lighting_render(&lb);
+		glBindFramebuffer(GL_FRAMEBUFFER, bench.target.fbo);
+		glViewport(0, 0, BENCH_WIDTH, BENCH_HEIGHT);
+		lighting_composite(&lb);
+		render_target_end(&bench.target);
+		glFinish();
+		auto end = std::chrono::steady_clock::now();
+		frame_ms += std::chrono::duration<double, std::milli>(end - start).count();
+		light_ms += std::chrono::duration<double, std::milli>(end - lit).count();
+		bin_ms += lb.stats.bin_ms;
+	}
+
+	st.counters["frame_ms"] = frame_ms / st.iterations();
+	st.counters["light_ms"] = light_ms / st.iterations();
+	st.counters["bin_ms"] = bin_ms / st.iterations();
+	st.counters["tile_entries"] = lb.stats.tile_entries;
+	st.counters["max_tile_lights"] = lb.stats.max_tile_lights;
+	lighting_free(&lb);
+}
+BENCHMARK(BM_Lighting)
+	->ArgsProduct({ { 16, 64, 256, 1024, 4096 }, { 1, 2, 4 } })
+	->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
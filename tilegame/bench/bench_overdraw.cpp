@@ -0,0 +1,189 @@
+#include <benchmark/benchmark.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdint.h>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_image.h"
+
+#include "../load_shaders.h"
+#include "../overdraw.h"
+#include "../sprite_atlas.h"
+
+// Overdraw of a crowd of 8dir sprites drawn as full 64x64 cells, as the game
+// draws them, against the trimmed quads of their atlas, on a headless EGL
+// context. Run from the tilegame directory. Each iteration counts the frame
+// and draws the heatmap; the counters are those of the last frame.
+#define BENCH_VIEW_WIDTH 1280
+#define BENCH_VIEW_HEIGHT 640
+#define BENCH_SPRITES 2000
+#define BENCH_SCALE 2.0f
+
+typedef struct BenchOverdraw {
+	bool ready;
+	OverdrawView view;
+	SpriteAtlas atlas;
+	GLuint vao;
+	GLuint vbo;
+	GLuint heatmap_tex;			// a surfaceless context has no default framebuffer
+	GLuint heatmap_fbo;
+} BenchOverdraw;
+
+static BenchOverdraw bench;
+
+static bool create_context()
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	EGLDisplay display = get_platform_display ?
+		get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+		return false;
+
+	eglBindAPI(EGL_OPENGL_API);
+	const EGLint context_attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, context_attribs);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+		return false;
+	return gladLoadGLLoader((GLADloadproc)eglGetProcAddress) != 0;
+}
+
+static GLuint load_program(const char* vert, const char* frag)
+{
+	ShaderInfo shaders[] = {
+		{ GL_VERTEX_SHADER, vert },
+		{ GL_FRAGMENT_SHADER, frag },
+		{ GL_NONE, NULL }
+	};
+	return load_shaders(shaders);
+}
+
+static bool setup()
+{
+	static bool tried = false;
+	if (tried)
+		return bench.ready;
+	tried = true;
+
+	int width, height, channels;
+	unsigned char* rgba = stbi_load("Resources/textures/8dir.png", &width, &height, &channels, 4);
+	if (!rgba || !create_context())
+		return false;
+	SpriteAtlasStats stats;
+	bool built = sprite_atlas_build(rgba, width, height, 64, 64, 0, &bench.atlas, &stats);
+	stbi_image_free(rgba);
+
+	GLuint count_program = load_program("Resources/shaders/tilegame.vert", "Resources/shaders/overdraw.frag");
+	GLuint heatmap_program = load_program("Resources/shaders/present.vert", "Resources/shaders/heatmap.frag");
+	if (!built || !count_program || !heatmap_program ||
+		!overdraw_init(&bench.view, BENCH_VIEW_WIDTH, BENCH_VIEW_HEIGHT, count_program, 0, heatmap_program))
+		return false;
+
+	glGenVertexArrays(1, &bench.vao);
+	glGenBuffers(1, &bench.vbo);
+	glBindVertexArray(bench.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, bench.vbo);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+
+	glGenTextures(1, &bench.heatmap_tex);
+	glBindTexture(GL_TEXTURE_2D, bench.heatmap_tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, BENCH_VIEW_WIDTH, BENCH_VIEW_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glGenFramebuffers(1, &bench.heatmap_fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, bench.heatmap_fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, bench.heatmap_tex, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		return false;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	bench.ready = true;
+	return true;
+}
+
+static void push_quad(std::vector<float>* vertices, const SpriteQuad* q)
+{
+	float l = q->x0 / BENCH_VIEW_WIDTH * 2.0f - 1.0f, r = q->x1 / BENCH_VIEW_WIDTH * 2.0f - 1.0f;
+	float t = 1.0f - q->y0 / BENCH_VIEW_HEIGHT * 2.0f, b = 1.0f - q->y1 / BENCH_VIEW_HEIGHT * 2.0f;
+	const float corners[6][4] = {
+		{ l, t, q->u0, q->v0 }, { l, b, q->u0, q->v1 }, { r, b, q->u1, q->v1 },
+		{ l, t, q->u0, q->v0 }, { r, b, q->u1, q->v1 }, { r, t, q->u1, q->v0 },
+	};
+	for (int i = 0; i < 6; i++) {
+		const float vertex[8] = { corners[i][0], corners[i][1], 0.0f, 1.0f, 1.0f, 1.0f, corners[i][2], corners[i][3] };
+		vertices->insert(vertices->end(), vertex, vertex + 8);
+	}
+}
+
+// The same scattered sprites, positions and frames from a fixed LCG, as
+// full cells or as trimmed quads. Returns the vertex count; 'area' is the
+// pixels the quads cover, which whole-pixel sized quads shade exactly once.
+static size_t build_sprites(bool trimmed, uint64_t* area)
+{
+	*area = 0;
+	std::vector<float> vertices;
+	uint32_t rng = 1234;
+	float cell = 64 * BENCH_SCALE;
+	for (int i = 0; i < BENCH_SPRITES; i++) {
+		rng = rng * 1664525u + 1013904223u;
+		float x = (float)(rng >> 8 & 0xffff) / 0xffff * (BENCH_VIEW_WIDTH - cell);
+		rng = rng * 1664525u + 1013904223u;
+		float y = (float)(rng >> 8 & 0xffff) / 0xffff * (BENCH_VIEW_HEIGHT - cell);
+		int frame = (int)(rng >> 24) % (int)bench.atlas.header.frame_count;
+
+		SpriteQuad quad = { x, y, x + cell, y + cell, 0.0f, 0.0f, 1.0f, 1.0f };
+		if (trimmed && !sprite_frame_quad(&bench.atlas, frame, x, y, BENCH_SCALE, &quad))
+			continue;
+		push_quad(&vertices, &quad);
+		*area += (uint64_t)((quad.x1 - quad.x0) * (quad.y1 - quad.y0) + 0.5f);
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, bench.vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+	return vertices.size() / 8;
+}
+
+static void BM_CountSprites(benchmark::State& st)
+{
+	if (!setup()) {
+		st.SkipWithError("unable to load the sprites or create the GL context");
+		return;
+	}
+	bool trimmed = st.range(0) != 0;
+	uint64_t area;
+	GLsizei vertex_count = (GLsizei)build_sprites(trimmed, &area);
+
+	for (auto _ : st) {
+		overdraw_begin(&bench.view);
+		glUseProgram(bench.view.count_program);
+		glBindVertexArray(bench.vao);
+		glDrawArrays(GL_TRIANGLES, 0, vertex_count);
+		overdraw_end(&bench.view);
+		overdraw_present(&bench.view, bench.heatmap_fbo);
+		glFinish();
+	}
+
+	const OverdrawStats* stats = &bench.view.stats;
+	if (!overdraw_wait_stats(&bench.view) || stats->fragments != area || stats->covered_pixels > stats->pixels) {
+		st.SkipWithError("overdraw counters are inconsistent");
+		return;
+	}
+
+	st.SetLabel(trimmed ? "trimmed quads" : "full cells");
+	st.counters["fragments"] = (double)stats->fragments;
+	st.counters["overdraw"] = stats->overdraw;
+	st.counters["max_layers"] = stats->max_layers;
+}
+BENCHMARK(BM_CountSprites)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,264 @@
+#include <benchmark/benchmark.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+#include "../particles.h"
+#include "../load_shaders.h"
+
+// Simulate and render cost of range(1) particles on each path: 256
+// emitters scattered over a 1280x720 view, stepped at 60 Hz and drawn as
+// additive quads into an offscreen framebuffer. simulate_ms and render_ms
+// are wall clock times up to a glFinish() after each step. Before timing,
+// the SIMD path must match the scalar one exactly and the compute shader
+// must stay within a tolerance of both, and the game's torches must leave
+// an idle view skipping most frames. Run from the tilegame directory on a
+// headless EGL context (llvmpipe without a GPU).
+#define BENCH_WIDTH 1280
+#define BENCH_HEIGHT 720
+#define BENCH_EMITTERS 256
+#define BENCH_DT (1.0f / 60.0f)
+#define BENCH_CHECK_PARTICLES 16384
+#define BENCH_CHECK_STEPS 120
+#define BENCH_CHECK_TOLERANCE 0.5f
+// the torches of the game: every 512 pixels over 8192, 256 embers each
+#define BENCH_TORCH_SPACING 512
+#define BENCH_TORCH_WORLD 8192
+#define BENCH_EMBERS_PER_TORCH 256
+
+typedef struct BenchParticles {
+	bool ready;
+	bool checked;
+	GLuint simulate_program;
+	GLuint render_program;
+	GLuint fbo;
+	GLuint color_tex;
+} BenchParticles;
+
+static BenchParticles bench;
+
+static bool create_context()
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	EGLDisplay display = get_platform_display ?
+		get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+		return false;
+
+	eglBindAPI(EGL_OPENGL_API);
+	const EGLint context_attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, context_attribs);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+		return false;
+	return gladLoadGLLoader((GLADloadproc)eglGetProcAddress) != 0;
+}
+
+static bool setup()
+{
+	static bool tried = false;
+	if (tried)
+		return bench.ready;
+	tried = true;
+
+	if (!create_context())
+		return false;
+	ShaderInfo simulate_shaders[] = {
+		{ GL_COMPUTE_SHADER, "Resources/shaders/particles.comp" },
+		{ GL_NONE, NULL }
+	};
+	ShaderInfo render_shaders[] = {
+		{ GL_VERTEX_SHADER, "Resources/shaders/particle.vert" },
+		{ GL_FRAGMENT_SHADER, "Resources/shaders/particle.frag" },
+		{ GL_NONE, NULL }
+	};
+	bench.simulate_program = load_shaders(simulate_shaders);
+	bench.render_program = load_shaders(render_shaders);
+	if (!bench.simulate_program || !bench.render_program)
+		return false;
+
+	// the surfaceless context has no default framebuffer
+	glGenTextures(1, &bench.color_tex);
+	glBindTexture(GL_TEXTURE_2D, bench.color_tex);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, BENCH_WIDTH, BENCH_HEIGHT);
+	glGenFramebuffers(1, &bench.fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, bench.fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, bench.color_tex, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		return false;
+	glViewport(0, 0, BENCH_WIDTH, BENCH_HEIGHT);
+
+	bench.ready = true;
+	return true;
+}
+
+static uint32_t next_random(uint32_t* rng)
+{
+	*rng = *rng * 1664525u + 1013904223u;
+	return *rng >> 8;
+}
+
+static ParticleSystem* create_system(uint32_t count, ParticlePath path)
+{
+	ParticleSystem* ps = new ParticleSystem;
+	if (!particles_init(ps, count, bench.simulate_program, bench.render_program)) {
+		delete ps;
+		return NULL;
+	}
+	uint32_t rng = 1234;
+	for (int i = 0; i < BENCH_EMITTERS; i++) {
+		ParticleEmitter e = {};
+		e.x = (float)(next_random(&rng) % BENCH_WIDTH);
+		e.y = (float)(next_random(&rng) % BENCH_HEIGHT);
+		e.direction = -1.5708f;
+		e.spread = 0.5f + (next_random(&rng) % 100) / 40.0f;
+		e.speed = 40.0f + next_random(&rng) % 160;
+		e.lifetime = 0.5f + (next_random(&rng) % 100) / 50.0f;
+		e.gravity = 60.0f;
+		e.color = next_random(&rng) & 0xffffff;
+		e.size = 2 + next_random(&rng) % 6;
+		particles_add_emitter(ps, &e, count / BENCH_EMITTERS);
+	}
+	particles_set_path(ps, path);
+	return ps;
+}
+
+static void destroy_system(ParticleSystem* ps)
+{
+	particles_free(ps);
+	delete ps;
+}
+
+static std::vector<float> run_steps(ParticlePath path)
+{
+	ParticleSystem* ps = create_system(BENCH_CHECK_PARTICLES, path);
+	std::vector<float> instances((size_t)BENCH_CHECK_PARTICLES * 4);
+	if (!ps)
+		return std::vector<float>();
+	for (int i = 0; i < BENCH_CHECK_STEPS; i++)
+		particles_simulate(ps, BENCH_DT);
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBuffer(GL_ARRAY_BUFFER, ps->instance_ssbo);
+	glGetBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(float), instances.data());
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	destroy_system(ps);
+	return instances;
+}
+
+// The instance buffers of every path after the same steps. The CPU paths do
+// the same float operations, the compute shader has its own cos and sin.
+static bool check_paths()
+{
+	std::vector<float> gpu = run_steps(PARTICLE_PATH_GPU);
+	std::vector<float> simd = run_steps(PARTICLE_PATH_CPU_SIMD);
+	std::vector<float> scalar = run_steps(PARTICLE_PATH_CPU_SCALAR);
+	if (gpu.empty() || simd.size() != scalar.size() || memcmp(simd.data(), scalar.data(), simd.size() * sizeof(float)))
+		return false;
+	for (size_t i = 0; i < gpu.size(); i += 4) {
+		if (fabsf(gpu[i] - scalar[i]) > BENCH_CHECK_TOLERANCE || fabsf(gpu[i + 1] - scalar[i + 1]) > BENCH_CHECK_TOLERANCE ||
+			fabsf(gpu[i + 2] - scalar[i + 2]) > 1e-4f || memcmp(&gpu[i + 3], &scalar[i + 3], sizeof(float)))
+			return false;
+	}
+	return true;
+}
+
+// A second of an idle loop with the game's torches in view, at one check a
+// millisecond: every particle is owned, yet only PARTICLE_IDLE_FPS frames
+// are drawn and the rest are skipped. With the torches out of view none is.
+static bool check_idle()
+{
+	uint32_t torches = (BENCH_TORCH_WORLD / BENCH_TORCH_SPACING) * (BENCH_TORCH_WORLD / BENCH_TORCH_SPACING);
+	ParticleSystem* ps = new ParticleSystem;
+	if (!particles_init(ps, torches * BENCH_EMBERS_PER_TORCH, 0, bench.render_program)) {
+		delete ps;
+		return false;
+	}
+	for (int y = BENCH_TORCH_SPACING / 2; y < BENCH_TORCH_WORLD; y += BENCH_TORCH_SPACING) {
+		for (int x = BENCH_TORCH_SPACING / 2; x < BENCH_TORCH_WORLD; x += BENCH_TORCH_SPACING) {
+			ParticleEmitter embers = { (float)x, (float)y, -1.5708f, 1.2f, 40.0f, 1.5f, -20.0f, 0x1060ff, 4 };
+			particles_add_emitter(ps, &embers, BENCH_EMBERS_PER_TORCH);
+		}
+	}
+
+	int drawn = 0, skipped = 0;
+	double last_ms = 0.0;
+	for (int ms = 1; ms <= 1000; ms++) {
+		if (particles_idle_frame_ms(ps, BENCH_WIDTH, BENCH_HEIGHT, ms - last_ms) == 0) {
+			drawn++;
+			last_ms = ms;
+		} else {
+			skipped++;
+		}
+	}
+	bool ok = ps->count == ps->capacity && drawn <= PARTICLE_IDLE_FPS && skipped >= 1000 - PARTICLE_IDLE_FPS;
+
+	for (uint32_t i = 0; i < ps->emitter_count; i++)
+		particles_move_emitter(ps, (int)i, ps->emitters[i].x + 4.0f * BENCH_TORCH_WORLD, ps->emitters[i].y);
+	ok = ok && particles_idle_frame_ms(ps, BENCH_WIDTH, BENCH_HEIGHT, 1000.0) == PARTICLE_NO_FRAME;
+	destroy_system(ps);
+	return ok;
+}
+
+// Arg 0: ParticlePath. Arg 1: particles.
+static void BM_Particles(benchmark::State& st)
+{
+	ParticlePath path = (ParticlePath)st.range(0);
+	uint32_t count = (uint32_t)st.range(1);
+	if (!setup()) {
+		st.SkipWithError("no headless GL 4.3 context (EGL) or shaders not found");
+		return;
+	}
+	if (!bench.checked) {
+		if (!check_paths()) {
+			st.SkipWithError("particle paths disagree");
+			return;
+		}
+		if (!check_idle()) {
+			st.SkipWithError("particles keep an idle view redrawing");
+			return;
+		}
+		bench.checked = true;
+	}
+	ParticleSystem* ps = create_system(count, path);
+	if (!ps) {
+		st.SkipWithError("particle system setup failed");
+		return;
+	}
+	st.SetLabel(particle_path_name(path));
+
+	glBindFramebuffer(GL_FRAMEBUFFER, bench.fbo);
+	double simulate_ms = 0.0, render_ms = 0.0;
+	for (auto _ : st) {
+		auto start = std::chrono::steady_clock::now();
+		particles_simulate(ps, BENCH_DT);
+		glFinish();
+		auto simulated = std::chrono::steady_clock::now();
+		glClear(GL_COLOR_BUFFER_BIT);
+		particles_render(ps, BENCH_WIDTH, BENCH_HEIGHT);
+		glFinish();
+		auto end = std::chrono::steady_clock::now();
+		simulate_ms += std::chrono::duration<double, std::milli>(simulated - start).count();
+		render_ms += std::chrono::duration<double, std::milli>(end - simulated).count();
+	}
+
+	st.SetItemsProcessed(st.iterations() * ps->count);
+	st.counters["simulate_ms"] = simulate_ms / st.iterations();
+	st.counters["render_ms"] = render_ms / st.iterations();
+	destroy_system(ps);
+}
+BENCHMARK(BM_Particles)
+	->ArgsProduct({ { PARTICLE_PATH_GPU, PARTICLE_PATH_CPU_SIMD, PARTICLE_PATH_CPU_SCALAR }, { 65536, 262144, 1048576 } })
+	->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,281 @@
+#include <benchmark/benchmark.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <chrono>
+#include <vector>
+
+#include "../render_target.h"
+#include "../load_shaders.h"
+
+// World pass cost against resolution scale and anti-aliasing mode, on a
+// headless EGL context (no window or display server needed; Mesa's
+// llvmpipe works). Run from the tilegame directory so the shaders load.
+//
+// The world is BENCH_LAYERS blended full-screen quads of a 256x256 checker
+// texture drawn with tilegame.vert/tilegame.frag, which makes the pass fill
+// bound the way a screen full of layered tiles is.
+#define BENCH_WIDTH 1280
+#define BENCH_HEIGHT 720
+#define BENCH_LAYERS 4
+#define BENCH_CHECKER 256
+#define BENCH_DYNAMIC_FRAMES 60
+
+typedef struct BenchGL {
+	bool ready;
+	EGLDisplay display;
+	EGLContext context;
+	GLuint world_program;
+	GLuint world_vao;
+	GLuint world_vbo;
+	GLuint world_ebo;
+	GLuint world_tex;
+	GLuint dst_fbo;
+	GLuint dst_tex;
+	RenderTarget target;
+} BenchGL;
+
+static BenchGL bench_gl;
+
+static bool create_context()
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	EGLDisplay display = get_platform_display ?
+		get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+		return false;
+
+	eglBindAPI(EGL_OPENGL_API);
+	const EGLint context_attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, context_attribs);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+		return false;
+
+	bench_gl.display = display;
+	bench_gl.context = context;
+	return gladLoadGLLoader((GLADloadproc)eglGetProcAddress) != 0;
+}
+
+static GLuint load_program(const char* vert, const char* frag)
+{
+	ShaderInfo shaders[] = {
+		{ GL_VERTEX_SHADER, vert },
+		{ GL_FRAGMENT_SHADER, frag },
+		{ GL_NONE, NULL }
+	};
+	return load_shaders(shaders);
+}
+
+static void create_world()
+{
+	// position, colour, uv; the quad covers the whole viewport
+	const float vertices[] = {
+		1.0f, 1.0f, 0.0f, 1.0f, 1.0f, 1.0f, 8.0f, 8.0f,
+		1.0f, -1.0f, 0.0f, 1.0f, 1.0f, 1.0f, 8.0f, 0.0f,
+		-1.0f, -1.0f, 0.0f, 1.0f, 1.0f, 1.0f, 0.0f, 0.0f,
+		-1.0f, 1.0f, 0.0f, 1.0f, 1.0f, 1.0f, 0.0f, 8.0f,
+	};
+	const unsigned int indices[] = { 0, 1, 3, 1, 2, 3 };
+
+	glGenVertexArrays(1, &bench_gl.world_vao);
+	glGenBuffers(1, &bench_gl.world_vbo);
+	glGenBuffers(1, &bench_gl.world_ebo);
+	glBindVertexArray(bench_gl.world_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, bench_gl.world_vbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, bench_gl.world_ebo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+	glEnableVertexAttribArray(0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+	glEnableVertexAttribArray(1);
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+	glEnableVertexAttribArray(2);
+	glBindVertexArray(0);
+
+	std::vector<uint8_t> checker(BENCH_CHECKER * BENCH_CHECKER * 4);
+	for (int y = 0; y < BENCH_CHECKER; y++) {
+		for (int x = 0; x < BENCH_CHECKER; x++) {
+			uint8_t* p = &checker[(y * BENCH_CHECKER + x) * 4];
+			uint8_t v = ((x / 16 + y / 16) & 1) ? 220 : 40;
+			p[0] = v;
+			p[1] = (uint8_t)(x * 255 / BENCH_CHECKER);
+			p[2] = (uint8_t)(y * 255 / BENCH_CHECKER);
+			p[3] = 160;
+		}
+	}
+	glGenTextures(1, &bench_gl.world_tex);
+	glBindTexture(GL_TEXTURE_2D, bench_gl.world_tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, BENCH_CHECKER, BENCH_CHECKER, 0, GL_RGBA, GL_UNSIGNED_BYTE, checker.data());
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+	// stands in for the window's default framebuffer
+	glGenTextures(1, &bench_gl.dst_tex);
+	glBindTexture(GL_TEXTURE_2D, bench_gl.dst_tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, BENCH_WIDTH, BENCH_HEIGHT, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glGenFramebuffers(1, &bench_gl.dst_fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, bench_gl.dst_fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, bench_gl.dst_tex, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+static bool init_gl()
+{
+	if (bench_gl.ready)
+		return true;
+	if (!create_context())
+		return false;
+
+	bench_gl.world_program = load_program("Resources/shaders/tilegame.vert", "Resources/shaders/tilegame.frag");
+	GLuint present_program = load_program("Resources/shaders/present.vert", "Resources/shaders/present.frag");
+	GLuint fxaa_program = load_program("Resources/shaders/present.vert", "Resources/shaders/fxaa.frag");
+	if (!bench_gl.world_program || !present_program || !fxaa_program)
+		return false;
+
+	create_world();
+	if (!render_target_init(&bench_gl.target, BENCH_WIDTH, BENCH_HEIGHT, AA_NONE, present_program, fxaa_program))
+		return false;
+
+	bench_gl.ready = true;
+	return true;
+}
+
+static void draw_world()
+{
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glUseProgram(bench_gl.world_program);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, bench_gl.world_tex);
+	glBindVertexArray(bench_gl.world_vao);
+	for (int i = 0; i < BENCH_LAYERS; i++)
+		glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+	glBindVertexArray(0);
+	glDisable(GL_BLEND);
+}
+
+// Renders one frame through the target and returns the wall time of the
+// world pass (llvmpipe runs on the CPU, so this is the GPU time).
+static double render_frame(float scale)
+{
+	RenderTarget* target = &bench_gl.target;
+	auto start = std::chrono::steady_clock::now();
+	render_target_begin(target, scale, 0.0f, 0.0f, 0.0f, 1.0f);
+	draw_world();
+	render_target_end(target);
+	glFinish();
+	std::chrono::duration<double, std::milli> world = std::chrono::steady_clock::now() - start;
+
+	render_target_present(target, bench_gl.dst_fbo, BENCH_WIDTH, BENCH_HEIGHT);
+	glFinish();
+	return world.count();
+}
+
+static std::vector<uint8_t> read_pixels(GLuint fbo)
+{
+	std::vector<uint8_t> pixels(BENCH_WIDTH * BENCH_HEIGHT * 4);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glReadPixels(0, 0, BENCH_WIDTH, BENCH_HEIGHT, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	return pixels;
+}
+
+// At scale 1 without AA the present pass samples texel centres, so the
+// window must show exactly what drawing the world straight into it gives.
+static bool full_scale_matches_direct()
+{
+	render_target_resize(&bench_gl.target, BENCH_WIDTH, BENCH_HEIGHT, AA_NONE);
+	render_frame(1.0f);
+	std::vector<uint8_t> presented = read_pixels(bench_gl.dst_fbo);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, bench_gl.dst_fbo);
+	glViewport(0, 0, BENCH_WIDTH, BENCH_HEIGHT);
+	glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	glClear(GL_COLOR_BUFFER_BIT);
+	draw_world();
+	std::vector<uint8_t> direct = read_pixels(bench_gl.dst_fbo);
+
+	return presented == direct;
+}
+
+// Arg 0: resolution scale in percent. Arg 1: AntiAliasing mode.
+static void BM_RenderScale(benchmark::State& st)
+{
+	float scale = st.range(0) / 100.0f;
+	AntiAliasing aa = (AntiAliasing)st.range(1);
+	if (!init_gl()) {
+		st.SkipWithError("no headless GL 4.3 context (EGL) or shaders not found");
+		return;
+	}
+	if (!full_scale_matches_direct()) {
+		st.SkipWithError("full scale render target differs from drawing straight to the framebuffer");
+		return;
+	}
+	if (!render_target_resize(&bench_gl.target, BENCH_WIDTH, BENCH_HEIGHT, aa)) {
+		st.SkipWithError("render target incomplete");
+		return;
+	}
+
+	double world_ms = 0.0;
+	for (auto _ : st)
+		world_ms += render_frame(scale);
+
+	st.counters["world_ms"] = world_ms / st.iterations();
+	st.counters["pixels"] = (double)bench_gl.target.width * bench_gl.target.height;
+	st.SetLabel(render_target_aa_name(aa));
+}
+BENCHMARK(BM_RenderScale)
+	->ArgsProduct({ { 50, 75, 100 }, { AA_NONE, AA_MSAA_4X, AA_FXAA } })
+	->Unit(benchmark::kMillisecond);
+
+// Closed loop: the scaler holds the world pass at 'budget' percent of its
+// full resolution cost. Reports where the scale settled and the frame time
+// it gives.
+static void BM_DynamicResolution(benchmark::State& st)
+{
+	float budget = st.range(0) / 100.0f;
+	if (!init_gl() || !render_target_resize(&bench_gl.target, BENCH_WIDTH, BENCH_HEIGHT, AA_FXAA)) {
+		st.SkipWithError("no headless GL 4.3 context (EGL) or shaders not found");
+		return;
+	}
+
+	double full_ms = 0.0;
+	for (int i = 0; i < 3; i++)
+		full_ms += render_frame(1.0f) / 3.0;
+
+	ResolutionScaler scaler;
+	double settled_ms = 0.0;
+	for (auto _ : st) {
+		resolution_scaler_init(&scaler, (float)(full_ms * budget), 0.25f, 1.0f);
+		double total = 0.0;
+		for (int frame = 0; frame < BENCH_DYNAMIC_FRAMES; frame++) {
+			float scale = scaler.scale;
+			double ms = render_frame(scale);
+			resolution_scaler_update(&scaler, (float)ms, scale);
+			if (frame >= BENCH_DYNAMIC_FRAMES / 2)
+				total += ms;
+		}
+		settled_ms = total / (BENCH_DYNAMIC_FRAMES - BENCH_DYNAMIC_FRAMES / 2);
+	}
+
+	st.counters["full_ms"] = full_ms;
+	st.counters["target_ms"] = full_ms * budget;
+	st.counters["settled_ms"] = settled_ms;
+	st.counters["scale"] = scaler.scale;
+}
+BENCHMARK(BM_DynamicResolution)->Arg(80)->Arg(50)->Arg(30)->Iterations(1)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
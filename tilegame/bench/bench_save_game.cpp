@@ -0,0 +1,194 @@
+#include <benchmark/benchmark.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "../save_game.h"
+
+// Saving and loading a world of BENCH_ENTITIES entities. BM_SaveSubmit
+// times what a frame pays to save in the background, the snapshot into the
+// writer's image, and reports the writer thread's time as write_ms;
+// BM_SaveSync writes on the calling thread. BM_LoadMapped maps a save and
+// sums the positions where they lie in the mapping, with and without
+// checking the hash; BM_LoadRestore copies the save into a live state.
+// Before timing, a restored state must hash the same as the one saved,
+// and a save of another schema version must be refused.
+#define BENCH_ENTITIES (1 << 20)
+
+typedef struct BenchSaves {
+	bool ready;
+	char path[64];
+	SimState* state;
+} BenchSaves;
+
+static BenchSaves bench;
+
+static void remove_save()
+{
+	remove(bench.path);
+	sim_state_destroy(bench.state);
+}
+
+static bool check_round_trip()
+{
+	SaveFile file;
+	if (!save_file_open(&file, bench.path, true))
+		return false;
+	SimState* restored = sim_state_create(BENCH_ENTITIES, 1);
+	bool ok = restored && save_file_restore_sim(&file, restored) && file.world->seed == 1234 &&
+		sim_state_hash(restored) == sim_state_hash(bench.state);
+	save_file_close(&file);
+	sim_state_destroy(restored);
+	return ok;
+}
+
+// A save whose header claims another version is refused.
+static bool check_version()
+{
+	char path[80];
+	snprintf(path, sizeof(path), "%s.old", bench.path);
+	SimState* small = sim_state_create(4, 1);
+	sim_spawn(small, 1, 2, PLAYER_STANCE_UP);
+	SaveWorld world = {};
+	bool ok = small && save_game_write(path, small, &world);
+	sim_state_destroy(small);
+	FILE* f = ok ? fopen(path, "r+b") : NULL;
+	if (f) {
+		SaveFileHeader header;
+		ok = fread(&header, sizeof(header), 1, f) == 1;
+		header.version = SAVE_SCHEMA_VERSION + 1;
+		ok = ok && fseek(f, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, f) == 1;
+		fclose(f);
+	}
+	SaveFile file;
+	ok = ok && !save_file_open(&file, path, false);
+	remove(path);
+	return ok;
+}
+
+static bool setup()
+{
+	static bool tried = false;
+	if (tried)
+		return bench.ready;
+	tried = true;
+
+	snprintf(bench.path, sizeof(bench.path), "/tmp/tilegame_save_XXXXXX");
+	int fd = mkstemp(bench.path);
+	if (fd < 0)
+		return false;
+	close(fd);
+	bench.state = sim_state_create(BENCH_ENTITIES, 1234);
+	if (!bench.state)
+		return false;
+	atexit(remove_save);
+	for (uint32_t i = 0; i < BENCH_ENTITIES; i++)
+		sim_spawn(bench.state, (int32_t)(i % 1024) * 64, (int32_t)(i / 1024) * 64, (uint8_t)(i % 8));
+	for (int t = 0; t < 10; t++)
+		sim_step(bench.state);
+
+	SaveWorld world = { 1234 };
+	bench.ready = save_game_write(bench.path, bench.state, &world) && check_round_trip() && check_version();
+	return bench.ready;
+}
+
+static void BM_SaveSubmit(benchmark::State& st)
+{
+	if (!setup()) {
+		st.SkipWithError("save setup or round trip failed");
+		return;
+	}
+	SaveWriter writer;
+	save_writer_init(&writer);
+	SaveWorld world = { 1234 };
+	double write_ms = 0.0;
+	for (auto _ : st) {
+		if (!save_writer_submit(&writer, bench.path, bench.state, &world)) {
+			st.SkipWithError("save refused");
+			break;
+		}
+		st.PauseTiming();
+		save_writer_wait(&writer);
+		SaveStats stats;
+		save_writer_get_stats(&writer, &stats);
+		write_ms += stats.write_ms;
+		st.ResumeTiming();
+	}
+	SaveStats stats;
+	save_writer_get_stats(&writer, &stats);
+	save_writer_free(&writer);
+	if (stats.failed)
+		st.SkipWithError("writer failed");
+	st.SetBytesProcessed(st.iterations() * (int64_t)stats.bytes);
+	st.counters["write_ms"] = write_ms / st.iterations();
+}
+BENCHMARK(BM_SaveSubmit)->Unit(benchmark::kMillisecond);
+
+static void BM_SaveSync(benchmark::State& st)
+{
+	if (!setup()) {
+		st.SkipWithError("save setup or round trip failed");
+		return;
+	}
+	SaveWorld world = { 1234 };
+	for (auto _ : st) {
+		if (!save_game_write(bench.path, bench.state, &world)) {
+			st.SkipWithError("save failed");
+			break;
+		}
+	}
+	uint64_t size = 0;
+	platform_file_size(bench.path, &size);
+	st.SetBytesProcessed(st.iterations() * (int64_t)size);
+}
+BENCHMARK(BM_SaveSync)->Unit(benchmark::kMillisecond);
+
+// Arg 0: 1 to check the hash of the whole file.
+static void BM_LoadMapped(benchmark::State& st)
+{
+	if (!setup()) {
+		st.SkipWithError("save setup or round trip failed");
+		return;
+	}
+	bool verify = st.range(0) != 0;
+	for (auto _ : st) {
+		SaveFile file;
+		if (!save_file_open(&file, bench.path, verify)) {
+			st.SkipWithError("load failed");
+			break;
+		}
+		SaveSimView view;
+		save_file_sim_view(&file, &view);
+		int64_t sum = 0;
+		for (uint32_t i = 0; i < view.header->count; i++)
+			sum += view.pos_x[i] + view.pos_y[i];
+		benchmark::DoNotOptimize(sum);
+		save_file_close(&file);
+	}
+	st.SetItemsProcessed(st.iterations() * BENCH_ENTITIES);
+}
+BENCHMARK(BM_LoadMapped)->Arg(0)->Arg(1)->Unit(benchmark::kMillisecond);
+
+static void BM_LoadRestore(benchmark::State& st)
+{
+	if (!setup()) {
+		st.SkipWithError("save setup or round trip failed");
+		return;
+	}
+	SimState* state = sim_state_create(BENCH_ENTITIES, 1);
+	for (auto _ : st) {
+		SaveFile file;
+		if (!save_file_open(&file, bench.path, false) || !save_file_restore_sim(&file, state)) {
+			st.SkipWithError("load failed");
+			break;
+		}
+		save_file_close(&file);
+	}
+	st.SetItemsProcessed(st.iterations() * BENCH_ENTITIES);
+	sim_state_destroy(state);
+}
+BENCHMARK(BM_LoadRestore)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
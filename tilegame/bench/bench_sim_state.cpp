@@ -0,0 +1,108 @@
+#include <benchmark/benchmark.h>
+
+#include "../sim_state.h"
+
+#define BENCH_ENTITIES 100000
+
+static SimState* make_state(uint32_t count)
+{
+	SimState* state = sim_state_create(count, 1234);
+	for (uint32_t i = 0; i < count; i++)
+		sim_spawn(state, (int32_t)(i % 1024) * 64, (int32_t)(i / 1024) * 64, PLAYER_STANCE_DOWN);
+	for (int t = 0; t < 10; t++)
+		sim_step(state);
+	return state;
+}
+
+static void BM_SimSnapshot(benchmark::State& st)
+{
+	SimState* state = make_state(BENCH_ENTITIES);
+	SimSnapshot snapshot;
+	sim_snapshot_init(&snapshot, state);
+
+	for (auto _ : st) {
+		sim_snapshot_save(&snapshot, state);
+		benchmark::ClobberMemory();
+	}
+	st.SetBytesProcessed(st.iterations() * (int64_t)state->bytes);
+
+	sim_snapshot_free(&snapshot);
+	sim_state_destroy(state);
+}
+BENCHMARK(BM_SimSnapshot)->Unit(benchmark::kMicrosecond);
+
+static void BM_SimRestore(benchmark::State& st)
+{
+	SimState* state = make_state(BENCH_ENTITIES);
+	SimSnapshot snapshot;
+	sim_snapshot_init(&snapshot, state);
+	sim_snapshot_save(&snapshot, state);
+
+	for (auto _ : st) {
+		sim_snapshot_restore(state, &snapshot);
+		benchmark::ClobberMemory();
+	}
+	st.SetBytesProcessed(st.iterations() * (int64_t)state->bytes);
+
+	sim_snapshot_free(&snapshot);
+	sim_state_destroy(state);
+}
+BENCHMARK(BM_SimRestore)->Unit(benchmark::kMicrosecond);
+
+static void BM_SimHash(benchmark::State& st)
+{
+	SimState* state = make_state(BENCH_ENTITIES);
+
+	for (auto _ : st)
+		benchmark::DoNotOptimize(sim_state_hash(state));
+	st.SetBytesProcessed(st.iterations() * (int64_t)state->bytes);
+
+	sim_state_destroy(state);
+}
+BENCHMARK(BM_SimHash)->Unit(benchmark::kMicrosecond);
+
+static void BM_SimStep(benchmark::State& st)
+{
+	SimState* state = make_state(BENCH_ENTITIES);
+
+	for (auto _ : st) {
+		sim_step(state);
+		benchmark::ClobberMemory();
+	}
+	st.SetItemsProcessed(st.iterations() * BENCH_ENTITIES);
+
+	sim_state_destroy(state);
+}
+BENCHMARK(BM_SimStep)->Unit(benchmark::kMicrosecond);
+
+static void BM_SimReplay(benchmark::State& st)
+{
+	const uint32_t ticks = 60;
+	SimState* state = make_state(BENCH_ENTITIES);
+	SimSnapshot start;
+	sim_snapshot_init(&start, state);
+	sim_snapshot_save(&start, state);
+
+	uint8_t inputs[ticks];
+	uint64_t hashes[ticks];
+	for (uint32_t t = 0; t < ticks; t++)
+		inputs[t] = (uint8_t)(1 << (t / 8 % 8));
+	for (uint32_t t = 0; t < ticks; t++) {
+		sim_set_input(state, SIM_PLAYER_ENTITY, inputs[t]);
+		sim_step(state);
+		hashes[t] = sim_state_hash(state);
+	}
+
+	for (auto _ : st) {
+		sim_snapshot_restore(state, &start);
+		if (sim_replay(state, inputs, hashes, ticks) != -1)
+			st.SkipWithError("replay diverged");
+	}
+	st.SetItemsProcessed(st.iterations() * ticks);
+
+	sim_snapshot_free(&start);
+	sim_state_destroy(state);
+}
+BENCHMARK(BM_SimReplay)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
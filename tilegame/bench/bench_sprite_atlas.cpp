@@ -0,0 +1,73 @@
+#include <benchmark/benchmark.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_image.h"
+
+#include "../sprite_atlas.h"
+
+// Run from the tilegame directory so the resource paths resolve.
+typedef struct BenchSheet {
+	const char* path;
+	int cell_width;
+	int cell_height;
+} BenchSheet;
+
+static const BenchSheet bench_sheets[] = {
+	{ "Resources/textures/8dir.png", 64, 64 },
+	{ "Resources/textures/player_sprites.png", 64, 64 },
+	{ "Resources/textures/DudeWalking.png", 28, 49 },
+};
+
+// Builds the atlas of a sheet, checks that every trimmed frame holds the
+// same pixels as its cell and that the quad of each frame covers exactly
+// the opaque part of where the cell would be drawn.
+static void BM_BuildAtlas(benchmark::State& st)
+{
+	const BenchSheet* sheet = &bench_sheets[st.range(0)];
+	int width, height, channels;
+	unsigned char* rgba = stbi_load(sheet->path, &width, &height, &channels, 4);
+	if (!rgba) {
+		st.SkipWithError("unable to load sheet");
+		return;
+	}
+
+	SpriteAtlas atlas;
+	SpriteAtlasStats stats;
+	bool ok = sprite_atlas_build(rgba, width, height, sheet->cell_width, sheet->cell_height, 0, &atlas, &stats);
+	int columns = width / sheet->cell_width;
+	for (uint32_t i = 0; ok && i < atlas.header.frame_count; i++) {
+		const SpriteFrame* f = &atlas.frames[i];
+		int cell_x = (i % columns) * sheet->cell_width, cell_y = (i / columns) * sheet->cell_height;
+		for (int y = 0; ok && y < f->height; y++) {
+			const uint8_t* src = rgba + ((size_t)(cell_y + f->offset_y + y) * width + cell_x + f->offset_x) * 4;
+			const uint8_t* dst = atlas.rgba + ((size_t)(f->y + y) * atlas.header.width + f->x) * 4;
+			ok = memcmp(src, dst, (size_t)f->width * 4) == 0;
+		}
+		SpriteQuad quad;
+		if (ok && sprite_frame_quad(&atlas, i, 10.0f, 20.0f, 2.0f, &quad))
+			ok = quad.x0 == 10.0f + f->offset_x * 2.0f && quad.y1 - quad.y0 == f->height * 2.0f;
+	}
+	sprite_atlas_free(&atlas);
+	if (!ok) {
+		stbi_image_free(rgba);
+		st.SkipWithError("trimmed frames do not match the sheet");
+		return;
+	}
+
+	for (auto _ : st) {
+		sprite_atlas_build(rgba, width, height, sheet->cell_width, sheet->cell_height, 0, &atlas, &stats);
+		sprite_atlas_free(&atlas);
+	}
+	stbi_image_free(rgba);
+
+	st.SetLabel(sheet->path);
+	st.counters["drawn_saved_pct"] = 100.0 * (1.0 - (double)stats.trimmed_pixels / stats.cell_pixels);
+	st.counters["texture_saved_pct"] = 100.0 * (1.0 - (double)stats.atlas_pixels / stats.sheet_pixels);
+}
+BENCHMARK(BM_BuildAtlas)->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,78 @@
+#include <benchmark/benchmark.h>
+
+#include <stdlib.h>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_image.h"
+
+#include "../texture_codec.h"
+
+// Run from the tilegame directory so the resource paths resolve.
+static const char* bench_textures[] = {
+	"Resources/textures/8dir.png",
+	"Resources/textures/tavsan_sprite_sheet.png",
+	"Resources/textures/greenstone.png",
+};
+
+typedef struct BenchImage {
+	int width;
+	int height;
+	std::vector<uint8_t> rgba;
+} BenchImage;
+
+static bool load_image(const char* path, BenchImage* image)
+{
+	int channels;
+	unsigned char* data = stbi_load(path, &image->width, &image->height, &channels, 4);
+	if (!data)
+		return false;
+	image->rgba.assign(data, data + (size_t)image->width * image->height * 4);
+	stbi_image_free(data);
+	return true;
+}
+
+static void BM_EncodeBC7(benchmark::State& st)
+{
+	BenchImage image;
+	if (!load_image(bench_textures[st.range(0)], &image)) {
+		st.SkipWithError("unable to load texture");
+		return;
+	}
+
+	std::vector<uint8_t> blocks(tex_bc7_size(image.width, image.height));
+	for (auto _ : st) {
+		tex_encode_bc7(image.rgba.data(), image.width, image.height, blocks.data());
+		benchmark::ClobberMemory();
+	}
+
+	st.SetLabel(bench_textures[st.range(0)]);
+	st.SetBytesProcessed(st.iterations() * (int64_t)image.rgba.size());
+	st.counters["raw_bytes"] = (double)image.rgba.size();
+	st.counters["bc7_bytes"] = (double)blocks.size();
+}
+BENCHMARK(BM_EncodeBC7)->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+
+static void BM_DecodeBC7(benchmark::State& st)
+{
+	BenchImage image;
+	if (!load_image(bench_textures[st.range(0)], &image)) {
+		st.SkipWithError("unable to load texture");
+		return;
+	}
+
+	std::vector<uint8_t> blocks(tex_bc7_size(image.width, image.height));
+	std::vector<uint8_t> decoded(image.rgba.size());
+	tex_encode_bc7(image.rgba.data(), image.width, image.height, blocks.data());
+
+	for (auto _ : st) {
+		tex_decode_bc7(blocks.data(), image.width, image.height, decoded.data());
+		benchmark::ClobberMemory();
+	}
+
+	st.SetLabel(bench_textures[st.range(0)]);
+	st.SetBytesProcessed(st.iterations() * (int64_t)decoded.size());
+}
+BENCHMARK(BM_DecodeBC7)->DenseRange(0, 2)->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
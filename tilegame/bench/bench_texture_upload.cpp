@@ -0,0 +1,156 @@
+#include <benchmark/benchmark.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_image.h"
+
+#include "../glad/include/glad.h"
+#include "../texture_codec.h"
+
+// Time to get a texture onto the GL, as load_texture_gl() does it, up to a
+// glFinish(). range(1) 0 uploads the RGBA8 source and has the GL build the
+// mips, 1 uploads the cooked BC7 chain with glCompressedTexImage2D, 2 is the
+// fallback for drivers without BC7: decode each level on the CPU and upload
+// it as RGBA8. Run from the tilegame directory on a headless EGL context
+// (llvmpipe without a GPU).
+static const char* bench_textures[] = {
+	"Resources/textures/8dir.png",
+	"Resources/textures/tavsan_sprite_sheet.png",
+	"Resources/textures/greenstone.png",
+};
+
+#define BENCH_TEXTURE_COUNT (sizeof(bench_textures) / sizeof(bench_textures[0]))
+
+typedef struct BenchTexture {
+	int width;
+	int height;
+	std::vector<uint8_t> rgba;
+	CookedTexture cooked;
+} BenchTexture;
+
+typedef struct BenchUpload {
+	bool ready;
+	bool bc7;
+	BenchTexture textures[BENCH_TEXTURE_COUNT];
+} BenchUpload;
+
+static BenchUpload bench;
+
+static bool create_context()
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	EGLDisplay display = get_platform_display ?
+		get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+		return false;
+
+	eglBindAPI(EGL_OPENGL_API);
+	const EGLint context_attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, context_attribs);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+		return false;
+	return gladLoadGLLoader((GLADloadproc)eglGetProcAddress) != 0;
+}
+
+// as gl_supports_compressed_format() in the game
+static bool supports_bc7()
+{
+	GLint supported = GL_FALSE;
+	glGetInternalformativ(GL_TEXTURE_2D, GL_COMPRESSED_RGBA_BPTC_UNORM, GL_INTERNALFORMAT_SUPPORTED, 1, &supported);
+	return supported == GL_TRUE;
+}
+
+static bool setup()
+{
+	static bool tried = false;
+	if (tried)
+		return bench.ready;
+	tried = true;
+
+	if (!create_context())
+		return false;
+	bench.bc7 = supports_bc7();
+
+	for (size_t i = 0; i < BENCH_TEXTURE_COUNT; i++) {
+		BenchTexture* t = &bench.textures[i];
+		int channels;
+		unsigned char* data = stbi_load(bench_textures[i], &t->width, &t->height, &channels, 4);
+		if (!data)
+			return false;
+		t->rgba.assign(data, data + (size_t)t->width * t->height * 4);
+		stbi_image_free(data);
+		if (!tex_cook_bc7(t->rgba.data(), t->width, t->height, &t->cooked))
+			return false;
+	}
+
+	bench.ready = true;
+	return true;
+}
+
+// Arg 0: texture. Arg 1: 0 RGBA8 with generated mips, 1 BC7, 2 BC7 decoded
+// on the CPU.
+static void BM_TextureUpload(benchmark::State& st)
+{
+	if (!setup()) {
+		st.SkipWithError("GL setup or texture cook failed");
+		return;
+	}
+	BenchTexture* t = &bench.textures[st.range(0)];
+	int path = (int)st.range(1);
+	if (path == 1 && !bench.bc7) {
+		st.SkipWithError("driver does not list BC7");
+		return;
+	}
+
+	std::vector<uint8_t> decoded(t->rgba.size());
+	size_t uploaded = 0;
+	for (auto _ : st) {
+		GLuint tex;
+		glGenTextures(1, &tex);
+		glBindTexture(GL_TEXTURE_2D, tex);
+		uploaded = 0;
+		if (path == 0) {
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, t->width, t->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, t->rgba.data());
+			glGenerateMipmap(GL_TEXTURE_2D);
+			uploaded = t->rgba.size();
+		} else {
+			for (uint32_t i = 0; i < t->cooked.level_count; i++) {
+				TextureLevel* l = &t->cooked.levels[i];
+				if (path == 1) {
+					glCompressedTexImage2D(GL_TEXTURE_2D, i, GL_COMPRESSED_RGBA_BPTC_UNORM, l->width, l->height, 0, l->bytes, l->data);
+					uploaded += l->bytes;
+				} else {
+					tex_decode_bc7(l->data, l->width, l->height, decoded.data());
+					glTexImage2D(GL_TEXTURE_2D, i, GL_RGBA, l->width, l->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, decoded.data());
+					uploaded += (size_t)l->width * l->height * 4;
+				}
+			}
+		}
+		glFinish();
+		glDeleteTextures(1, &tex);
+	}
+	if (glGetError() != GL_NO_ERROR)
+		st.SkipWithError("GL error during upload");
+
+	st.SetLabel(bench_textures[st.range(0)]);
+	st.SetBytesProcessed(st.iterations() * (int64_t)uploaded);
+	st.counters["upload_bytes"] = (double)uploaded;
+}
+BENCHMARK(BM_TextureUpload)
+	->ArgsProduct({ { 0, 1, 2 }, { 0, 1, 2 } })
+	->Unit(benchmark::kMillisecond)
+	->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,211 @@
+#include <benchmark/benchmark.h>
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <vector>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_image.h"
+
+#include "../tile_map.h"
+#include "../load_shaders.h"
+
+// Frames of painting on a BENCH_MAP_SIZE square map: each iteration draws
+// a stroke of range(0) tiles radius from where the last one ended, sends
+// the change to the GL and draws a 1280x720 view of the map at 8 pixels a
+// tile into an offscreen framebuffer, up to a glFinish(). range(1) 0
+// uploads the rows the stroke changed, block by block; 1 uploads the
+// whole map every frame, as a rebuild would. Before timing, a level must
+// survive a save and load unchanged, and the GL buffer must hold the same
+// tiles as the map after random strokes. Run from the tilegame directory
+// on a headless EGL context (llvmpipe without a GPU).
+#define BENCH_WIDTH 1280
+#define BENCH_HEIGHT 720
+#define BENCH_MAP_SIZE 4096
+#define BENCH_TILE_PIXELS 8.0f
+#define BENCH_STROKE_STEP 24
+#define BENCH_LEVEL "Resources/Levels/level1.png"
+
+typedef struct BenchTileMap {
+	bool ready;
+	bool checked;
+	GLuint program;
+	GLuint fbo;
+	GLuint color_tex;
+} BenchTileMap;
+
+static BenchTileMap bench;
+
+static bool create_context()
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	EGLDisplay display = get_platform_display ?
+		get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+		return false;
+
+	eglBindAPI(EGL_OPENGL_API);
+	const EGLint context_attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, context_attribs);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+		return false;
+	return gladLoadGLLoader((GLADloadproc)eglGetProcAddress) != 0;
+}
+
+static uint32_t next_random(uint32_t* rng)
+{
+	*rng = *rng * 1664525u + 1013904223u;
+	return *rng >> 8;
+}
+
+// The level, saved and loaded again, has the same size, palette and tiles.
+static bool check_save()
+{
+	TileMap level, copy;
+	if (!tile_map_load(&level, BENCH_LEVEL, bench.program))
+		return false;
+	char path[] = "/tmp/tilegame_level_XXXXXX";
+	int fd = mkstemp(path);
+	bool ok = fd >= 0;
+	if (fd >= 0)
+		close(fd);
+	ok = ok && tile_map_save(&level, path) && tile_map_load(&copy, path, bench.program);
+	if (ok) {
+		size_t bytes = (size_t)level.blocks_x * level.blocks_y * TILE_MAP_BLOCK_TILES;
+		ok = copy.width == level.width && copy.height == level.height && copy.palette_count == level.palette_count &&
+			!memcmp(copy.palette, level.palette, sizeof(level.palette)) && !memcmp(copy.tiles, level.tiles, bytes);
+		tile_map_free(&copy);
+	}
+	remove(path);
+	tile_map_free(&level);
+	return ok;
+}
+
+// After strokes of every size the GL buffer matches the map.
+static bool check_upload(TileMap* map)
+{
+	uint32_t rng = 77;
+	for (int i = 0; i < 64; i++) {
+		int x0 = (int)(next_random(&rng) % BENCH_MAP_SIZE), y0 = (int)(next_random(&rng) % BENCH_MAP_SIZE);
+		int x1 = x0 + (int)(next_random(&rng) % 200) - 100, y1 = y0 + (int)(next_random(&rng) % 200) - 100;
+		tile_map_stroke(map, x0, y0, x1, y1, (int)(next_random(&rng) % 40), (uint8_t)(next_random(&rng) % 2));
+		tile_map_upload(map);
+	}
+	size_t bytes = (size_t)map->blocks_x * map->blocks_y * TILE_MAP_BLOCK_TILES;
+	std::vector<uint8_t> gpu(bytes);
+	glBindBuffer(GL_TEXTURE_BUFFER, map->buffer);
+	glGetBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, gpu.data());
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	return !memcmp(gpu.data(), map->tiles, bytes);
+}
+
+static bool setup()
+{
+	static bool tried = false;
+	if (tried)
+		return bench.ready;
+	tried = true;
+
+	if (!create_context())
+		return false;
+	ShaderInfo shaders[] = {
+		{ GL_VERTEX_SHADER, "Resources/shaders/present.vert" },
+		{ GL_FRAGMENT_SHADER, "Resources/shaders/tile_map.frag" },
+		{ GL_NONE, NULL }
+	};
+	bench.program = load_shaders(shaders);
+	if (!bench.program)
+		return false;
+
+	// the surfaceless context has no default framebuffer
+	glGenTextures(1, &bench.color_tex);
+	glBindTexture(GL_TEXTURE_2D, bench.color_tex);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, BENCH_WIDTH, BENCH_HEIGHT);
+	glGenFramebuffers(1, &bench.fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, bench.fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, bench.color_tex, 0);
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+		return false;
+	glViewport(0, 0, BENCH_WIDTH, BENCH_HEIGHT);
+
+	bench.ready = true;
+	return true;
+}
+
+// Arg 0: brush radius in tiles. Arg 1: 0 uploads the changed rows, 1 the
+// whole map.
+static void BM_TileMapPaint(benchmark::State& st)
+{
+	TileMap map;
+	if (!setup() || !tile_map_init(&map, BENCH_MAP_SIZE, BENCH_MAP_SIZE, bench.program)) {
+		st.SkipWithError("GL setup failed");
+		return;
+	}
+	if (!bench.checked) {
+		if (!check_save() || !check_upload(&map)) {
+			st.SkipWithError("level lost in a save, or buffer differs from the map");
+			tile_map_free(&map);
+			return;
+		}
+		bench.checked = true;
+	}
+	int radius = (int)st.range(0);
+	bool rebuild = st.range(1) != 0;
+
+	// strokes zigzag across the map, alternating floor and wall by row
+	int x = 0, y = BENCH_MAP_SIZE / 2, dx = BENCH_STROKE_STEP;
+	uint8_t tile = TILE_MAP_WALL;
+	uint64_t frames = 0, bytes = 0, calls = 0, changed = 0;
+	double upload_ms = 0.0, max_upload_ms = 0.0;
+	for (auto _ : st) {
+		int nx = x + dx, ny = y;
+		if (nx < 0 || nx >= BENCH_MAP_SIZE) {
+			dx = -dx;
+			nx = x;
+			ny = (y + 2 * radius + 1) % BENCH_MAP_SIZE;
+			tile ^= 1;
+		}
+		changed += tile_map_stroke(&map, x, y, nx, ny, radius, tile);
+		x = nx;
+		y = ny;
+		if (rebuild)
+			tile_map_invalidate(&map);
+		tile_map_upload(&map);
+
+		// the view follows the brush
+		float origin_x = BENCH_WIDTH / 2 - x * BENCH_TILE_PIXELS, origin_y = BENCH_HEIGHT / 2 - y * BENCH_TILE_PIXELS;
+		tile_map_render(&map, origin_x, origin_y, BENCH_TILE_PIXELS, BENCH_WIDTH, BENCH_HEIGHT, 1.0f);
+		glFinish();
+
+		bytes += map.stats.bytes;
+		calls += map.stats.calls;
+		upload_ms += map.stats.upload_ms;
+		max_upload_ms = map.stats.upload_ms > max_upload_ms ? map.stats.upload_ms : max_upload_ms;
+		frames++;
+	}
+
+	st.counters["tiles_changed"] = (double)changed / frames;
+	st.counters["upload_kb"] = bytes / 1024.0 / frames;
+	st.counters["upload_calls"] = (double)calls / frames;
+	st.counters["upload_ms"] = upload_ms / frames;
+	st.counters["max_upload_ms"] = max_upload_ms;
+	tile_map_free(&map);
+}
+BENCHMARK(BM_TileMapPaint)
+	->ArgsProduct({ { 4, 32, 128 }, { 0, 1 } })
+	->Unit(benchmark::kMillisecond)
+	->UseRealTime();
+
+BENCHMARK_MAIN();
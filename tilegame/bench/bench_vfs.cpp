@@ -0,0 +1,180 @@
+#include <benchmark/benchmark.h>
+
+#include <string.h>
+#include <stdlib.h>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "../vfs.h"
+#include "../sim_state.h"
+
+// Run from the tilegame directory so the resource paths resolve. The files
+// are listed in the order a level load would read them, which is also the
+// order they are packed in.
+#define BENCH_ARCHIVE "bench_vfs.pak"
+
+static const char* bench_files[] = {
+	"Resources/shaders/tilegame.vert",
+	"Resources/shaders/tilegame.frag",
+	"Resources/textures/black-brick-wall-texture.bmp",
+	"Resources/textures/8dir.png",
+	"Resources/textures/8dir2.png",
+	"Resources/textures/player_sprites.png",
+	"Resources/textures/checkerboard.bmp",
+	"Resources/textures/wall.jpg",
+	"Resources/textures/greenstone.png",
+	"Resources/textures/tavsan_sprite_sheet.png",
+	"Resources/Levels/level1.png",
+};
+#define BENCH_FILE_COUNT (int)(sizeof(bench_files) / sizeof(bench_files[0]))
+
+// Path of a bench file inside the mounts, without the "Resources/" prefix.
+static const char* mounted_path(const char* path)
+{
+	return path + strlen("Resources/");
+}
+
+// Drops the files from the page cache so every iteration starts cold. Only
+// possible on Linux; elsewhere the reads are warm.
+static void drop_page_cache(const char* path)
+{
+#ifdef __linux__
+	int fd = open(path, O_RDONLY);
+	if (fd >= 0) {
+		fdatasync(fd);
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		close(fd);
+	}
+#else
+	(void)path;
+#endif
+}
+
+static void drop_all(bool archive)
+{
+	if (archive)
+		drop_page_cache(BENCH_ARCHIVE);
+	else
+		for (int i = 0; i < BENCH_FILE_COUNT; i++)
+			drop_page_cache(bench_files[i]);
+}
+
+static bool mount(bool archive)
+{
+	vfs_shutdown();
+	if (!vfs_init())
+		return false;
+	return archive ? vfs_mount_archive(BENCH_ARCHIVE, "") : vfs_mount_dir("Resources", "");
+}
+
+// Packs the archive and checks that both mounts return the same bytes as
+// reading the file directly.
+static bool prepare()
+{
+	static int prepared = 0;
+	if (prepared)
+		return prepared > 0;
+	prepared = -1;
+
+	if (!vfs_pack_archive(BENCH_ARCHIVE, "Resources", bench_files, BENCH_FILE_COUNT))
+		return false;
+
+	for (int archive = 0; archive < 2; archive++) {
+		if (!mount(archive != 0))
+			return false;
+		for (int i = 0; i < BENCH_FILE_COUNT; i++) {
+			size_t size;
+			uint8_t* expected = platform_read_file(bench_files[i], &size);
+			VfsFile file;
+			bool same = expected && vfs_read(mounted_path(bench_files[i]), &file);
+			if (same) {
+				same = file.size == size && memcmp(file.data, expected, size) == 0;
+				vfs_close(&file);
+			}
+			free(expected);
+			if (!same)
+				return false;
+		}
+	}
+	vfs_shutdown();
+	prepared = 1;
+	return true;
+}
+
+// Loads every file in turn and hashes it, standing in for the decode that
+// would follow. range(0): 0 loose files, 1 archive. range(1): prefetch the
+// whole list first so the I/O thread reads while the hashing runs.
+static void BM_LoadFiles(benchmark::State& st)
+{
+	bool archive = st.range(0) != 0;
+	bool prefetch = st.range(1) != 0;
+	if (!prepare()) {
+		st.SkipWithError("loose and archived reads differ");
+		return;
+	}
+
+	uint64_t bytes = 0, hash = 0;
+	double io_wait_ms = 0, cache_hits = 0;
+	for (auto _ : st) {
+		st.PauseTiming();
+		vfs_shutdown();
+		drop_all(archive);
+		if (!mount(archive)) {
+			st.SkipWithError("unable to mount");
+			break;
+		}
+		st.ResumeTiming();
+
+		if (prefetch)
+			for (int i = 0; i < BENCH_FILE_COUNT; i++)
+				vfs_prefetch(mounted_path(bench_files[i]));
+		for (int i = 0; i < BENCH_FILE_COUNT; i++) {
+			VfsFile file;
+			if (!vfs_read(mounted_path(bench_files[i]), &file))
+				continue;
+			hash ^= sim_hash_bytes(file.data, file.size, hash);
+			bytes += file.size;
+			vfs_close(&file);
+		}
+
+		VfsStats frame, total;
+		vfs_get_stats(&frame, &total);
+		io_wait_ms += total.io_wait_ms;
+		cache_hits += total.cache_hits;
+	}
+	vfs_shutdown();
+	benchmark::DoNotOptimize(hash);
+
+	st.SetLabel(archive ? (prefetch ? "archive, prefetch" : "archive") : (prefetch ? "loose, prefetch" : "loose"));
+	st.SetBytesProcessed((int64_t)bytes);
+	st.counters["io_wait_ms"] = benchmark::Counter(io_wait_ms, benchmark::Counter::kAvgIterations);
+	st.counters["cache_hits"] = benchmark::Counter(cache_hits, benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_LoadFiles)->ArgsProduct({ { 0, 1 }, { 0, 1 } })->Unit(benchmark::kMillisecond)->UseRealTime();
+
+// A cached file read straight from the mapped archive against a loose read.
+static void BM_ReadSmall(benchmark::State& st)
+{
+	bool archive = st.range(0) != 0;
+	if (!prepare() || !mount(archive)) {
+		st.SkipWithError("unable to mount");
+		return;
+	}
+
+	const char* path = mounted_path(bench_files[1]);
+	for (auto _ : st) {
+		VfsFile file;
+		vfs_read(path, &file);
+		benchmark::DoNotOptimize(file.data);
+		vfs_close(&file);
+	}
+	vfs_shutdown();
+
+	st.SetLabel(archive ? "archive" : "loose");
+}
+BENCHMARK(BM_ReadSmall)->Arg(0)->Arg(1);
+
+BENCHMARK_MAIN();
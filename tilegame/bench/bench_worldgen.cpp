@@ -0,0 +1,137 @@
+#include <benchmark/benchmark.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <thread>
+#include <vector>
+
+#include "../worldgen.h"
+
+// Generated tiles per second (items_per_second) for one chunk at a time,
+// with and without SSE2, and for batches of BENCH_BATCH chunks on worker
+// threads; tiles_per_core divides the rate by the threads that can run at
+// once. Before timing, the checks require that the SIMD and scalar paths
+// give the same tiles and that a batch gives the same tiles whatever the
+// number of workers and the order of its requests.
+#define BENCH_BATCH 64
+#define BENCH_SEED 1234
+
+static void batch_requests(std::vector<uint8_t>& tiles, std::vector<WorldGenRequest>& requests, bool reversed)
+{
+	tiles.resize((size_t)BENCH_BATCH * CHUNK_TILES);
+	requests.resize(BENCH_BATCH);
+	for (int i = 0; i < BENCH_BATCH; i++) {
+		// a strip of chunks across the origin, negative coordinates included
+		int chunk = reversed ? BENCH_BATCH - 1 - i : i;
+		requests[i].cx = chunk % 8 - 4;
+		requests[i].cy = chunk / 8 - 4;
+		requests[i].tiles = &tiles[(size_t)chunk * CHUNK_TILES];
+	}
+}
+
+static bool check_simd(const WorldGen* gen)
+{
+	WorldGen scalar = *gen;
+	scalar.simd = false;
+	uint8_t a[CHUNK_TILES], b[CHUNK_TILES];
+	for (int32_t cy = -3; cy < 3; cy++) {
+		for (int32_t cx = -3; cx < 3; cx++) {
+			worldgen_chunk(gen, cx, cy, a);
+			worldgen_chunk(&scalar, cx, cy, b);
+			if (memcmp(a, b, CHUNK_TILES))
+				return false;
+		}
+	}
+	return true;
+}
+
+static bool check_batches(const WorldGen* gen)
+{
+	std::vector<uint8_t> expected, tiles;
+	std::vector<WorldGenRequest> requests;
+	WorldGenStats stats;
+	batch_requests(expected, requests, false);
+	worldgen_generate_batch(gen, requests.data(), BENCH_BATCH, &stats);
+	bool ok = true;
+	for (int threads = 1; threads <= 3 && ok; threads += 2) {
+		worldgen_workers_start(threads);
+		batch_requests(tiles, requests, threads == 3);
+		worldgen_generate_batch(gen, requests.data(), BENCH_BATCH, &stats);
+		worldgen_workers_stop();
+		ok = tiles == expected;
+	}
+	return ok;
+}
+
+static bool setup(WorldGen* gen, benchmark::State& st)
+{
+	static int checked = -1;
+	worldgen_init(gen, BENCH_SEED);
+	if (checked < 0)
+		checked = check_simd(gen) && check_batches(gen);
+	if (!checked) {
+		st.SkipWithError("generated tiles differ between paths or threads");
+		return false;
+	}
+	return true;
+}
+
+// Arg 0: 1 for SSE2, 0 for the scalar path.
+static void BM_WorldgenChunk(benchmark::State& st)
+{
+	WorldGen gen;
+	if (!setup(&gen, st))
+		return;
+	gen.simd = st.range(0) != 0;
+	uint8_t tiles[CHUNK_TILES];
+	uint32_t counts[CHUNK_TILE_TREE + 1] = {};
+	int32_t cx = 0;
+	for (auto _ : st) {
+		worldgen_chunk(&gen, cx, cx / 16, tiles);
+		benchmark::DoNotOptimize(tiles);
+		cx++;
+	}
+	for (int i = 0; i < CHUNK_TILES; i++)
+		counts[tiles[i]]++;
+	st.SetItemsProcessed(st.iterations() * CHUNK_TILES);
+	st.counters["floor"] = counts[CHUNK_TILE_FLOOR];
+	st.counters["wall"] = counts[CHUNK_TILE_WALL];
+	st.counters["water"] = counts[CHUNK_TILE_WATER];
+	st.counters["sand"] = counts[CHUNK_TILE_SAND];
+	st.counters["tree"] = counts[CHUNK_TILE_TREE];
+}
+BENCHMARK(BM_WorldgenChunk)->Arg(0)->Arg(1)->Unit(benchmark::kMicrosecond);
+
+// Arg 0: worker threads, 0 for the calling thread alone.
+static void BM_WorldgenBatch(benchmark::State& st)
+{
+	WorldGen gen;
+	if (!setup(&gen, st))
+		return;
+	int threads = (int)st.range(0);
+	if (threads)
+		worldgen_workers_start(threads);
+	std::vector<uint8_t> tiles;
+	std::vector<WorldGenRequest> requests;
+	batch_requests(tiles, requests, false);
+
+	WorldGenStats stats;
+	for (auto _ : st)
+		worldgen_generate_batch(&gen, requests.data(), BENCH_BATCH, &stats);
+	worldgen_workers_stop();
+
+	unsigned cores = std::thread::hardware_concurrency();
+	unsigned running = (unsigned)threads + 1;
+	if (cores && running > cores)
+		running = cores;
+	double tiles_done = (double)st.iterations() * BENCH_BATCH * CHUNK_TILES;
+	st.SetItemsProcessed((int64_t)tiles_done);
+	st.counters["tiles_per_core"] = benchmark::Counter(tiles_done / running, benchmark::Counter::kIsRate);
+	st.counters["batch_ms"] = stats.ms;
+}
+BENCHMARK(BM_WorldgenBatch)
+	->Arg(0)->Arg(1)->Arg(3)->Arg(7)
+	->Unit(benchmark::kMillisecond)
+	->UseRealTime();
+
+BENCHMARK_MAIN();
@@ -0,0 +1,512 @@
+#include "stdafx.h"
+#include "chunk_stream.h"
+#include "mem_stats.h"
+#include "platform.h"
+#include "vfs.h"
+
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+typedef enum ChunkJob {
+	CHUNK_JOB_LOAD,
+	CHUNK_JOB_SAVE,
+} ChunkJob;
+
+// A request on the way to the loader, then its result on the way back.
+typedef struct ChunkRequest {
+	ChunkJob job;
+	uint32_t slot;
+	int32_t cx;
+	int32_t cy;
+	uint8_t* tiles;
+	bool ok;
+} ChunkRequest;
+
+// Only the calling thread queues requests and takes results, so it alone
+// keeps 'in_flight', which bounds both rings.
+struct ChunkLoader {
+	ChunkSource source;
+	std::thread thread;
+	std::mutex lock;
+	std::condition_variable wake;
+	ChunkRequest requests[CHUNK_RING_SIZE];
+	uint32_t request_head;
+	uint32_t request_count;
+	ChunkRequest results[CHUNK_RING_SIZE];
+	uint32_t result_head;
+	uint32_t result_count;
+	uint32_t in_flight;
+	bool stop;
+};
+
+static void
+loader_main(ChunkLoader* loader)
+{
+	std::unique_lock<std::mutex> lock(loader->lock);
+	for (;;) {
+		loader->wake.wait(lock, [loader] { return loader->stop || loader->request_count > 0; });
+		// requests still queued are served before stopping
+		if (!loader->request_count)
+			break;
+
+		ChunkRequest request = loader->requests[loader->request_head];
+		loader->request_head = (loader->request_head + 1) % CHUNK_RING_SIZE;
+		loader->request_count--;
+		lock.unlock();
+
+		const ChunkSource* source = &loader->source;
+		if (request.job == CHUNK_JOB_LOAD)
+			request.ok = source->load(source->user, request.cx, request.cy, request.tiles);
+		else
+			request.ok = source->save(source->user, request.cx, request.cy, request.tiles);
+
+		lock.lock();
+		loader->results[(loader->result_head + loader->result_count) % CHUNK_RING_SIZE] = request;
+		loader->result_count++;
+	}
+}
+
+static uint32_t
+chunk_hash(int32_t cx, int32_t cy)
+{
+	uint32_t h = (uint32_t)cx * 0x9e3779b1u ^ (uint32_t)cy * 0x85ebca77u;
+	h ^= h >> 15;
+	h *= 0x2c1b3c6du;
+	h ^= h >> 12;
+	return h;
+}
+
+static int32_t
+find_slot(const ChunkStream* cs, int32_t cx, int32_t cy)
+{
+	for (uint32_t i = chunk_hash(cx, cy) & cs->table_mask;; i = (i + 1) & cs->table_mask) {
+		int32_t slot = cs->table[i];
+		if (slot < 0 || (cs->slots[slot].cx == cx && cs->slots[slot].cy == cy))
+			return slot;
+	}
+}
+
+static void
+insert_slot(ChunkStream* cs, uint32_t slot)
+{
+	uint32_t i = chunk_hash(cs->slots[slot].cx, cs->slots[slot].cy) & cs->table_mask;
+	while (cs->table[i] >= 0)
+		i = (i + 1) & cs->table_mask;
+	cs->table[i] = (int32_t)slot;
+}
+
+// Linear probing without tombstones: entries after the hole move back
+// into it unless their home lies between the hole and them.
+static void
+remove_slot(ChunkStream* cs, uint32_t slot)
+{
+	uint32_t mask = cs->table_mask;
+	uint32_t i = chunk_hash(cs->slots[slot].cx, cs->slots[slot].cy) & mask;
+	while (cs->table[i] != (int32_t)slot)
+		i = (i + 1) & mask;
+	for (uint32_t j = (i + 1) & mask; cs->table[j] >= 0; j = (j + 1) & mask) {
+		const ChunkSlot* s = &cs->slots[cs->table[j]];
+		uint32_t home = chunk_hash(s->cx, s->cy) & mask;
+		if (((j - home) & mask) >= ((j - i) & mask)) {
+			cs->table[i] = cs->table[j];
+			i = j;
+		}
+	}
+	cs->table[i] = -1;
+}
+
+static void
+release_slot(ChunkStream* cs, uint32_t slot)
+{
+	remove_slot(cs, slot);
+	cs->slots[slot].state = CHUNK_FREE;
+	cs->slots[slot].dirty = false;
+	cs->free_slots[cs->free_count++] = slot;
+}
+
+// Runs 'visit' on every chunk within the radius of (cx, cy), in rings of
+// growing distance so that the nearest chunks come first.
+template <typename Visit>
+static void
+for_each_in_radius(int radius, int32_t cx, int32_t cy, Visit visit)
+{
+	int r2 = radius * radius + radius;
+	for (int d = 0; d <= radius; d++) {
+		for (int dy = -d; dy <= d; dy++) {
+			int step = dy == -d || dy == d ? 1 : 2 * d;
+			for (int dx = -d; dx <= d; dx += step) {
+				if (dx * dx + dy * dy <= r2)
+					visit(cx + dx, cy + dy);
+			}
+		}
+	}
+}
+
+static size_t
+stream_bytes(uint32_t capacity, uint32_t table_size)
+{
+	return (size_t)capacity * (sizeof(ChunkSlot) + CHUNK_TILES + 2 * sizeof(uint32_t)) +
+		table_size * sizeof(int32_t) + 2 * CHUNK_RING_SIZE * sizeof(int32_t);
+}
+
+bool chunk_stream_init(ChunkStream* cs, const ChunkSource* source, int radius, size_t budget_bytes)
+{
+	memset(cs, 0, sizeof(*cs));
+	uint32_t needed = 0;
+	for_each_in_radius(radius, 0, 0, [&needed](int32_t, int32_t) { needed++; });
+	size_t capacity = budget_bytes / CHUNK_TILES;
+	if (capacity < needed || capacity > INT32_MAX / 2) {
+		printf("A chunk budget of %zu bytes holds %zu chunks, a radius of %d needs %u\n", budget_bytes, capacity, radius, needed);
+		return false;
+	}
+
+	uint32_t table_size = 1;
+	while (table_size < 2 * capacity)
+		table_size <<= 1;
+	cs->source = *source;
+	cs->radius = radius;
+	cs->capacity = (uint32_t)capacity;
+	cs->slots = (ChunkSlot*)calloc(capacity, sizeof(ChunkSlot));
+	cs->tiles = (uint8_t*)malloc(capacity * CHUNK_TILES);
+	cs->free_slots = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+	cs->candidates = (uint32_t*)malloc(capacity * sizeof(uint32_t));
+	cs->table = (int32_t*)malloc(table_size * sizeof(int32_t));
+	cs->missing = (int32_t*)malloc(2 * CHUNK_RING_SIZE * sizeof(int32_t));
+	if (!cs->slots || !cs->tiles || !cs->free_slots || !cs->candidates || !cs->table || !cs->missing) {
+		free(cs->slots);
+		free(cs->tiles);
+		free(cs->free_slots);
+		free(cs->candidates);
+		free(cs->table);
+		free(cs->missing);
+		memset(cs, 0, sizeof(*cs));
+		return false;
+	}
+	cs->table_mask = table_size - 1;
+	memset(cs->table, 0xff, table_size * sizeof(int32_t));
+	// handed out from the end, so the first slots go first
+	for (uint32_t i = 0; i < cs->capacity; i++) {
+		cs->slots[i].tiles = cs->tiles + (size_t)i * CHUNK_TILES;
+		cs->free_slots[i] = cs->capacity - 1 - i;
+	}
+	cs->free_count = cs->capacity;
+	cs->stats.capacity = cs->capacity;
+	mem_track_alloc(MEM_CPU_WORLD_CHUNKS, stream_bytes(cs->capacity, table_size));
+
+	cs->loader = new ChunkLoader();
+	cs->loader->source = *source;
+	cs->loader->thread = std::thread(loader_main, cs->loader);
+	return true;
+}
+
+static void
+record_latency(ChunkStream* cs, float ms)
+{
+	cs->latency_ms[cs->latency_count++ % CHUNK_LATENCY_HISTORY] = ms;
+}
+
+static void
+update_latency_stats(ChunkStream* cs)
+{
+	uint32_t n = cs->latency_count < CHUNK_LATENCY_HISTORY ? cs->latency_count : CHUNK_LATENCY_HISTORY;
+	if (!n)
+		return;
+	float sorted[CHUNK_LATENCY_HISTORY];
+	memcpy(sorted, cs->latency_ms, n * sizeof(float));
+	std::sort(sorted, sorted + n);
+	float sum = 0.0f;
+	for (uint32_t i = 0; i < n; i++)
+		sum += sorted[i];
+	cs->stats.latency_avg_ms = sum / n;
+	cs->stats.latency_p95_ms = sorted[(n - 1) * 95 / 100];
+	cs->stats.latency_max_ms = sorted[n - 1];
+}
+
+static void
+take_results(ChunkStream* cs, double now_us)
+{
+	ChunkLoader* loader = cs->loader;
+	ChunkRequest results[CHUNK_RING_SIZE];
+	uint32_t count;
+	{
+		std::lock_guard<std::mutex> guard(loader->lock);
+		count = loader->result_count;
+		for (uint32_t i = 0; i < count; i++)
+			results[i] = loader->results[(loader->result_head + i) % CHUNK_RING_SIZE];
+		loader->result_head = (loader->result_head + count) % CHUNK_RING_SIZE;
+		loader->result_count = 0;
+	}
+	loader->in_flight -= count;
+
+	ChunkStreamStats* stats = &cs->stats;
+	for (uint32_t i = 0; i < count; i++) {
+		const ChunkRequest* r = &results[i];
+		ChunkSlot* slot = &cs->slots[r->slot];
+		if (!r->ok) {
+			printf("Could not %s chunk %d, %d\n", r->job == CHUNK_JOB_LOAD ? "load" : "save", r->cx, r->cy);
+			stats->failed++;
+		}
+		if (r->job == CHUNK_JOB_SAVE) {
+			release_slot(cs, r->slot);
+			stats->saving--;
+			continue;
+		}
+
+		// a chunk that cannot be read is left empty rather than asked for again
+		if (!r->ok)
+			memset(slot->tiles, CHUNK_TILE_FLOOR, CHUNK_TILES);
+		slot->state = CHUNK_RESIDENT;
+		record_latency(cs, (float)((now_us - slot->requested_us) / 1000.0));
+		stats->loading--;
+		stats->resident++;
+		stats->loaded++;
+		stats->total_loaded++;
+	}
+	if (stats->loaded)
+		update_latency_stats(cs);
+}
+
+// Frees up to 'count' slots of the chunks used longest ago, skipping the
+// ones within the radius. Changed chunks are queued to be saved and come
+// free once the loader is done with them.
+static void
+evict(ChunkStream* cs, uint32_t count, ChunkRequest* queued, uint32_t* queued_count)
+{
+	uint32_t* candidates = cs->candidates, candidate_count = 0;
+	for (uint32_t i = 0; i < cs->capacity; i++) {
+		if (cs->slots[i].state == CHUNK_RESIDENT && cs->slots[i].last_update != cs->update)
+			candidates[candidate_count++] = i;
+	}
+	count = count < candidate_count ? count : candidate_count;
+	std::partial_sort(candidates, candidates + count, candidates + candidate_count,
+		[cs](uint32_t a, uint32_t b) { return cs->slots[a].last_update < cs->slots[b].last_update; });
+
+	ChunkLoader* loader = cs->loader;
+	for (uint32_t i = 0; i < count; i++) {
+		ChunkSlot* slot = &cs->slots[candidates[i]];
+		if (slot->dirty && cs->source.save) {
+			if (loader->in_flight == CHUNK_RING_SIZE)
+				continue;
+			ChunkRequest save = { CHUNK_JOB_SAVE, candidates[i], slot->cx, slot->cy, slot->tiles, false };
+			queued[(*queued_count)++] = save;
+			loader->in_flight++;
+			slot->state = CHUNK_SAVING;
+			cs->stats.saving++;
+		} else {
+			release_slot(cs, candidates[i]);
+		}
+		cs->stats.resident--;
+		cs->stats.evicted++;
+		cs->stats.total_evicted++;
+	}
+}
+
+void chunk_stream_update(ChunkStream* cs, float camera_x, float camera_y)
+{
+	double start = platform_time_us();
+	ChunkStreamStats* stats = &cs->stats;
+	stats->requested = 0;
+	stats->loaded = 0;
+	stats->evicted = 0;
+	stats->deferred = 0;
+	stats->failed = 0;
+	take_results(cs, start);
+
+	cs->update++;
+	cs->camera_cx = chunk_coord((int32_t)floorf(camera_x));
+	cs->camera_cy = chunk_coord((int32_t)floorf(camera_y));
+
+	// what is already here stays, the rest is queued while the rings have room
+	ChunkLoader* loader = cs->loader;
+	uint32_t room = CHUNK_RING_SIZE - loader->in_flight, missing_count = 0;
+	for_each_in_radius(cs->radius, cs->camera_cx, cs->camera_cy, [cs, room, &missing_count](int32_t cx, int32_t cy) {
+		int32_t slot = find_slot(cs, cx, cy);
+		if (slot >= 0) {
+			cs->slots[slot].last_update = cs->update;
+		} else if (missing_count < room) {
+			cs->missing[2 * missing_count] = cx;
+			cs->missing[2 * missing_count + 1] = cy;
+			missing_count++;
+		} else {
+			cs->stats.deferred++;
+		}
+	});
+
+	ChunkRequest queued[CHUNK_RING_SIZE];
+	uint32_t queued_count = 0;
+	if (cs->free_count < missing_count)
+		evict(cs, missing_count - cs->free_count, queued, &queued_count);
+	for (uint32_t i = 0; i < missing_count; i++) {
+		if (!cs->free_count || loader->in_flight == CHUNK_RING_SIZE) {
+			stats->deferred += missing_count - i;
+			break;
+		}
+		uint32_t index = cs->free_slots[--cs->free_count];
+		ChunkSlot* slot = &cs->slots[index];
+		slot->cx = cs->missing[2 * i];
+		slot->cy = cs->missing[2 * i + 1];
+		slot->state = CHUNK_LOADING;
+		slot->dirty = false;
+		slot->last_update = cs->update;
+		slot->requested_us = start;
+		insert_slot(cs, index);
+		ChunkRequest load = { CHUNK_JOB_LOAD, index, slot->cx, slot->cy, slot->tiles, false };
+		queued[queued_count++] = load;
+		loader->in_flight++;
+		stats->loading++;
+		stats->requested++;
+	}
+
+	if (queued_count) {
+		{
+			std::lock_guard<std::mutex> guard(loader->lock);
+			for (uint32_t i = 0; i < queued_count; i++)
+				loader->requests[(loader->request_head + loader->request_count + i) % CHUNK_RING_SIZE] = queued[i];
+			loader->request_count += queued_count;
+		}
+		loader->wake.notify_one();
+	}
+	stats->update_ms = (float)((platform_time_us() - start) / 1000.0);
+}
+
+bool chunk_stream_busy(const ChunkStream* cs)
+{
+	return cs->loader && cs->loader->in_flight > 0;
+}
+
+void chunk_stream_free(ChunkStream* cs)
+{
+	if (!cs->loader)
+		return;
+	{
+		std::lock_guard<std::mutex> guard(cs->loader->lock);
+		cs->loader->stop = true;
+	}
+	cs->loader->wake.notify_one();
+	cs->loader->thread.join();
+	take_results(cs, platform_time_us());
+	delete cs->loader;
+
+	if (cs->source.save) {
+		for (uint32_t i = 0; i < cs->capacity; i++) {
+			const ChunkSlot* slot = &cs->slots[i];
+			if (slot->state == CHUNK_RESIDENT && slot->dirty && !cs->source.save(cs->source.user, slot->cx, slot->cy, slot->tiles))
+				printf("Could not save chunk %d, %d\n", slot->cx, slot->cy);
+		}
+	}
+
+	mem_track_free(MEM_CPU_WORLD_CHUNKS, stream_bytes(cs->capacity, cs->table_mask + 1));
+	free(cs->slots);
+	free(cs->tiles);
+	free(cs->free_slots);
+	free(cs->candidates);
+	free(cs->table);
+	free(cs->missing);
+	memset(cs, 0, sizeof(*cs));
+}
+
+const uint8_t* chunk_stream_tiles(const ChunkStream* cs, int32_t cx, int32_t cy)
+{
+	int32_t slot = find_slot(cs, cx, cy);
+	return slot >= 0 && cs->slots[slot].state == CHUNK_RESIDENT ? cs->slots[slot].tiles : NULL;
+}
+
+uint8_t chunk_stream_tile(const ChunkStream* cs, int32_t x, int32_t y, uint8_t missing)
+{
+	int32_t cx = chunk_coord(x), cy = chunk_coord(y);
+	const uint8_t* tiles = chunk_stream_tiles(cs, cx, cy);
+	return tiles ? tiles[(y - cy * CHUNK_SIZE) * CHUNK_SIZE + x - cx * CHUNK_SIZE] : missing;
+}
+
+bool chunk_stream_set_tile(ChunkStream* cs, int32_t x, int32_t y, uint8_t tile)
+{
+	int32_t cx = chunk_coord(x), cy = chunk_coord(y);
+	int32_t slot = find_slot(cs, cx, cy);
+	if (slot < 0 || cs->slots[slot].state != CHUNK_RESIDENT)
+		return false;
+	cs->slots[slot].tiles[(y - cy * CHUNK_SIZE) * CHUNK_SIZE + x - cx * CHUNK_SIZE] = tile;
+	cs->slots[slot].dirty = true;
+	return true;
+}
+
+bool chunk_file_parse(const uint8_t* data, size_t size, int32_t cx, int32_t cy, uint8_t* tiles)
+{
+	ChunkFileHeader header;
+	if (size != sizeof(header) + CHUNK_TILES)
+		return false;
+	memcpy(&header, data, sizeof(header));
+	if (header.magic != CHUNK_FILE_MAGIC || header.version != CHUNK_FILE_VERSION ||
+		header.cx != cx || header.cy != cy || header.size != CHUNK_SIZE)
+		return false;
+	memcpy(tiles, data + sizeof(header), CHUNK_TILES);
+	return true;
+}
+
+bool chunk_file_write(const char* path, int32_t cx, int32_t cy, const uint8_t* tiles)
+{
+	FILE* outfile = platform_fopen(path, "wb");
+
+	if (!outfile)
+		return false;
+
+	ChunkFileHeader header = { CHUNK_FILE_MAGIC, CHUNK_FILE_VERSION, cx, cy, CHUNK_SIZE, 0 };
+	bool ok = fwrite(&header, sizeof(header), 1, outfile) == 1 &&
+		fwrite(tiles, 1, CHUNK_TILES, outfile) == CHUNK_TILES;
+
+	fclose(outfile);
+	return ok;
+}
+
+// Fails rather than truncate, which would read or write another chunk's file.
+static bool
+chunk_file_path(char* path, size_t size, const char* dir, int32_t cx, int32_t cy)
+{
+	int length = snprintf(path, size, "%s/%d_%d.chunk", dir, cx, cy);
+	if (length < 0 || (size_t)length >= size) {
+		printf("Chunk directory %s is too long\n", dir);
+		return false;
+	}
+	return true;
+}
+
+static bool
+load_chunk_file(void* user, int32_t cx, int32_t cy, uint8_t* tiles)
+{
+	const ChunkFileSource* files = (const ChunkFileSource*)user;
+	char path[CHUNK_MAX_PATH];
+	if (!chunk_file_path(path, sizeof(path), files->read_dir, cx, cy))
+		return false;
+	if (!vfs_exists(path)) {
+		if (files->fallback.load)
+			return files->fallback.load(files->fallback.user, cx, cy, tiles);
+		memset(tiles, files->fill, CHUNK_TILES);
+		return true;
+	}
+
+	VfsFile file;
+	if (!vfs_read(path, &file))
+		return false;
+	bool ok = chunk_file_parse(file.data, file.size, cx, cy, tiles);
+	vfs_close(&file);
+	return ok;
+}
+
+static bool
+save_chunk_file(void* user, int32_t cx, int32_t cy, const uint8_t* tiles)
+{
+	const ChunkFileSource* files = (const ChunkFileSource*)user;
+	char path[CHUNK_MAX_PATH];
+	return chunk_file_path(path, sizeof(path), files->write_dir, cx, cy) &&
+		chunk_file_write(path, cx, cy, tiles);
+}
+
+void chunk_file_source(ChunkSource* source, ChunkFileSource* files)
+{
+	source->load = load_chunk_file;
+	source->save = files->write_dir[0] ? save_chunk_file : NULL;
+	source->user = files;
+}
@@ -0,0 +1,180 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+//----------------------------------------------------------------------------
+//
+//  Streamed world of square chunks of tiles, on a grid of signed chunk
+//    coordinates with no bounds. chunk_stream_update() keeps every chunk
+//    within a radius of the camera resident: chunks it is missing are
+//    queued nearest first on a fixed ring of requests to a loader thread,
+//    which fills them from a ChunkSource and hands them back on a second
+//    ring. Nothing on the calling thread waits for the loader; when a ring
+//    is full the rest of the requests wait for the next update, and a chunk
+//    still loading simply reads as not resident.
+//
+//  Chunk memory is one block allocated up front from a byte budget. Chunks
+//    that leave the radius stay resident until the budget needs their
+//    memory, then the least recently used are evicted. Evicting a chunk
+//    whose tiles were changed queues it on the same ring to be saved first.
+//
+//  Latency is measured from the update that queues a chunk to the update
+//    that sees it resident, over the last CHUNK_LATENCY_HISTORY loads.
+//
+//  Chunk file layout (little endian): ChunkFileHeader, then CHUNK_TILES
+//    tile ids row by row.
+//
+
+#define CHUNK_SIZE 64				// tiles per side
+#define CHUNK_TILES (CHUNK_SIZE * CHUNK_SIZE)
+#define CHUNK_RING_SIZE 256
+#define CHUNK_LATENCY_HISTORY 256
+#define CHUNK_MAX_PATH 256
+
+#define CHUNK_FILE_MAGIC 0x4b484754	// "TGHK"
+#define CHUNK_FILE_VERSION 1
+
+// tile ids
+#define CHUNK_TILE_FLOOR 0
+#define CHUNK_TILE_WALL 1
+#define CHUNK_TILE_WATER 2
+#define CHUNK_TILE_SAND 3
+#define CHUNK_TILE_TREE 4
+
+typedef struct ChunkFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	int32_t cx;
+	int32_t cy;
+	uint32_t size;				// CHUNK_SIZE
+	uint32_t unused;
+} ChunkFileHeader;
+
+// Called on the loader thread, one chunk at a time. 'tiles' holds
+// CHUNK_TILES ids. 'save' may be NULL for a world that is never written.
+typedef struct ChunkSource {
+	bool (*load)(void* user, int32_t cx, int32_t cy, uint8_t* tiles);
+	bool (*save)(void* user, int32_t cx, int32_t cy, const uint8_t* tiles);
+	void* user;
+} ChunkSource;
+
+// Chunk files "<cx>_<cy>.chunk" read through the virtual file system from
+// 'read_dir' and written to the directory 'write_dir' on disk, when set.
+// Chunks without a file come from 'fallback' when its load is set, so saved
+// and authored chunks take precedence over generated ones, and are filled
+// with 'fill' otherwise.
+typedef struct ChunkFileSource {
+	char read_dir[CHUNK_MAX_PATH];
+	char write_dir[CHUNK_MAX_PATH];
+	uint8_t fill;
+	ChunkSource fallback;
+} ChunkFileSource;
+
+typedef enum ChunkState {
+	CHUNK_FREE,
+	CHUNK_LOADING,
+	CHUNK_RESIDENT,
+	CHUNK_SAVING,
+} ChunkState;
+
+typedef struct ChunkSlot {
+	int32_t cx;
+	int32_t cy;
+	ChunkState state;
+	bool dirty;					// tiles changed since the chunk was loaded
+	uint32_t last_update;		// last update it was within the radius
+	double requested_us;
+	uint8_t* tiles;
+} ChunkSlot;
+
+typedef struct ChunkStreamStats {
+	uint32_t capacity;			// chunks the budget holds
+	uint32_t resident;
+	uint32_t loading;
+	uint32_t saving;
+	// last update
+	uint32_t requested;
+	uint32_t loaded;
+	uint32_t evicted;
+	uint32_t deferred;			// missing chunks left for a later update
+	uint32_t failed;			// loads or saves the source refused
+	float update_ms;
+	// since chunk_stream_init()
+	uint64_t total_loaded;
+	uint64_t total_evicted;
+	// last CHUNK_LATENCY_HISTORY loads
+	float latency_avg_ms;
+	float latency_p95_ms;
+	float latency_max_ms;
+} ChunkStreamStats;
+
+struct ChunkLoader;
+
+typedef struct ChunkStream {
+	ChunkSource source;
+	int radius;					// chunks kept resident around the camera
+	uint32_t capacity;
+	ChunkSlot* slots;
+	uint8_t* tiles;				// capacity * CHUNK_TILES
+	uint32_t* free_slots;
+	uint32_t free_count;
+	uint32_t* candidates;		// scratch of the eviction
+	int32_t* table;				// chunk to slot, open addressing, -1 when empty
+	uint32_t table_mask;
+	int32_t* missing;			// scratch of chunk_stream_update(), x and y pairs
+	uint32_t update;
+	int32_t camera_cx;
+	int32_t camera_cy;
+	float latency_ms[CHUNK_LATENCY_HISTORY];
+	uint32_t latency_count;
+	ChunkStreamStats stats;
+	ChunkLoader* loader;
+} ChunkStream;
+
+// Fails when 'budget_bytes' does not hold every chunk within 'radius'.
+bool
+chunk_stream_init(ChunkStream* cs, const ChunkSource* source, int radius, size_t budget_bytes);
+
+// Waits for the loader, saves the changed chunks still resident, then
+// frees everything.
+void
+chunk_stream_free(ChunkStream* cs);
+
+// Camera position in tiles. Takes in the chunks the loader finished,
+// evicts what the budget needs and queues the missing chunks.
+void
+chunk_stream_update(ChunkStream* cs, float camera_x, float camera_y);
+
+// Whether the loader has chunks in flight.
+bool
+chunk_stream_busy(const ChunkStream* cs);
+
+// Tiles of a resident chunk, or NULL.
+const uint8_t*
+chunk_stream_tiles(const ChunkStream* cs, int32_t cx, int32_t cy);
+
+// Tile at (x, y) in tiles, or 'missing' when its chunk is not resident.
+uint8_t
+chunk_stream_tile(const ChunkStream* cs, int32_t x, int32_t y, uint8_t missing);
+
+// Changes a tile of a resident chunk and marks the chunk to be saved when
+// it is evicted. Returns false when the chunk is not resident.
+bool
+chunk_stream_set_tile(ChunkStream* cs, int32_t x, int32_t y, uint8_t tile);
+
+static inline int32_t
+chunk_coord(int32_t tile)
+{
+	return tile >= 0 ? tile / CHUNK_SIZE : (tile + 1) / CHUNK_SIZE - 1;
+}
+
+void
+chunk_file_source(ChunkSource* source, ChunkFileSource* files);
+
+bool
+chunk_file_write(const char* path, int32_t cx, int32_t cy, const uint8_t* tiles);
+
+// Checks the header of a chunk file read into memory against (cx, cy).
+bool
+chunk_file_parse(const uint8_t* data, size_t size, int32_t cx, int32_t cy, uint8_t* tiles);
@@ -0,0 +1,224 @@
+#include "stdafx.h"
+#include "draw_queue.h"
+#include "mem_stats.h"
+#include "radix_sort.h"
+
+#include <string.h>
+
+#define DRAW_QUEUE_ITEM_FLOATS (DRAW_QUEUE_FLOATS_PER_VERTEX * DRAW_QUEUE_VERTICES_PER_ITEM)
+
+static const char* draw_order_names[DRAW_ORDER_COUNT] = {
+	"submitted",
+	"depth sorted",
+};
+
+const char* draw_order_name(DrawOrder order)
+{
+	return order < DRAW_ORDER_COUNT ? draw_order_names[order] : "unknown";
+}
+
+bool draw_queue_init(DrawQueue* queue, uint32_t capacity)
+{
+	memset(queue, 0, sizeof(*queue));
+	queue->items = (DrawItem*)malloc(capacity * sizeof(DrawItem));
+	if (!queue->items)
+		return false;
+	queue->capacity = capacity;
+	mem_track_alloc(MEM_CPU_DRAW_QUEUES, (size_t)capacity * sizeof(DrawItem));
+	return true;
+}
+
+static void
+create_buffers(DrawQueue* queue)
+{
+	glGenVertexArrays(1, &queue->vao);
+	glGenBuffers(1, &queue->vbo);
+	glBindVertexArray(queue->vao);
+	glBindBuffer(GL_ARRAY_BUFFER, queue->vbo);
+	// tilegame.vert: position, colour, texture coordinate
+	GLsizei stride = DRAW_QUEUE_FLOATS_PER_VERTEX * sizeof(float);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+	glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, stride, (void*)(3 * sizeof(float)));
+	glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, stride, (void*)(6 * sizeof(float)));
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+	glBindVertexArray(0);
+}
+
+void draw_queue_free(DrawQueue* queue)
+{
+	if (queue->capacity)
+		mem_track_free(MEM_CPU_DRAW_QUEUES, (size_t)queue->capacity * sizeof(DrawItem));
+	if (queue->vbo) {
+		mem_untrack_object(MEM_GL_VERTEX_BUFFERS, queue->vbo);
+		glDeleteBuffers(1, &queue->vbo);
+	}
+	if (queue->vao)
+		glDeleteVertexArrays(1, &queue->vao);
+	free(queue->items);
+	memset(queue, 0, sizeof(*queue));
+}
+
+void draw_queue_clear(DrawQueue* queue)
+{
+	queue->count = 0;
+}
+
+bool draw_queue_push(DrawQueue* queue, const DrawItem* item)
+{
+	if (queue->count == queue->capacity) {
+		queue->stats.dropped++;
+		return false;
+	}
+	queue->items[queue->count++] = *item;
+	return true;
+}
+
+uint64_t draw_item_sort_key(const DrawItem* item)
+{
+	float depth = item->depth > 0.0f ? item->depth : 0.0f;
+	uint32_t bits;
+	memcpy(&bits, &depth, sizeof(bits));
+	uint64_t blended = item->opaque ? 0 : 1;
+	if (blended)
+		bits = ~bits & 0x7fffffffu;
+	return blended << 63 | (uint64_t)bits << 32 | item->texture;
+}
+
+static bool
+sort_by_depth(DrawQueue* queue, FrameArena* arena)
+{
+	uint64_t* keys = FRAME_ALLOC(arena, uint64_t, queue->count);
+	uint64_t* scratch_keys = FRAME_ALLOC(arena, uint64_t, queue->count);
+	uint32_t* scratch_order = FRAME_ALLOC(arena, uint32_t, queue->count);
+	if (!keys || !scratch_keys || !scratch_order)
+		return false;
+	for (uint32_t i = 0; i < queue->count; i++)
+		keys[i] = draw_item_sort_key(&queue->items[i]);
+	queue->stats.sort_passes = radix_sort_u64(keys, queue->order, queue->count, scratch_keys, scratch_order);
+	return true;
+}
+
+static void
+write_vertices(DrawQueue* queue, int view_width, int view_height)
+{
+	float sx = 2.0f / view_width, sy = 2.0f / view_height;
+	float* v = queue->vertices;
+	for (uint32_t n = 0; n < queue->count; n++) {
+		const DrawItem* item = &queue->items[queue->order[n]];
+		float l = item->x0 * sx - 1.0f, r = item->x1 * sx - 1.0f;
+		float t = 1.0f - item->y0 * sy, b = 1.0f - item->y1 * sy;
+		float z = item->depth * 2.0f - 1.0f;
+		const float corners[DRAW_QUEUE_VERTICES_PER_ITEM][4] = {
+			{ l, t, item->u0, item->v0 }, { l, b, item->u0, item->v1 }, { r, b, item->u1, item->v1 },
+			{ l, t, item->u0, item->v0 }, { r, b, item->u1, item->v1 }, { r, t, item->u1, item->v0 },
+		};
+		for (int c = 0; c < DRAW_QUEUE_VERTICES_PER_ITEM; c++) {
+			v[0] = corners[c][0]; v[1] = corners[c][1]; v[2] = z;
+			v[3] = 1.0f; v[4] = 1.0f; v[5] = 1.0f;
+			v[6] = corners[c][2]; v[7] = corners[c][3];
+			v += DRAW_QUEUE_FLOATS_PER_VERTEX;
+		}
+	}
+}
+
+// One draw call per run of items in draw order that share a texture.
+static void
+draw_runs(DrawQueue* queue, uint32_t first, uint32_t last)
+{
+	uint32_t start = first;
+	for (uint32_t n = first; n < last; n++) {
+		GLuint texture = queue->items[queue->order[n]].texture;
+		if (n + 1 < last && queue->items[queue->order[n + 1]].texture == texture)
+			continue;
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glDrawArrays(GL_TRIANGLES, (GLint)(start * DRAW_QUEUE_VERTICES_PER_ITEM), (GLsizei)((n + 1 - start) * DRAW_QUEUE_VERTICES_PER_ITEM));
+		queue->stats.draw_calls++;
+		start = n + 1;
+	}
+}
+
+bool draw_queue_build(DrawQueue* queue, DrawOrder order, int view_width, int view_height, FrameArena* arena)
+{
+	uint32_t dropped = queue->stats.dropped;
+	memset(&queue->stats, 0, sizeof(queue->stats));
+	queue->stats.dropped = dropped;
+	if (queue->count == 0)
+		return true;
+
+	queue->order = FRAME_ALLOC(arena, uint32_t, queue->count);
+	queue->vertices = FRAME_ALLOC(arena, float, (size_t)queue->count * DRAW_QUEUE_ITEM_FLOATS);
+	bool ok = queue->order && queue->vertices;
+	if (ok) {
+		for (uint32_t i = 0; i < queue->count; i++) {
+			queue->order[i] = i;
+			if (queue->items[i].opaque)
+				queue->stats.opaque_items++;
+		}
+		queue->stats.blended_items = queue->count - queue->stats.opaque_items;
+		if (order == DRAW_ORDER_DEPTH_SORTED)
+			ok = sort_by_depth(queue, arena);
+	}
+
+	if (!ok) {
+		memset(&queue->stats, 0, sizeof(queue->stats));
+		queue->stats.dropped = dropped + queue->count;
+		queue->order = NULL;
+		queue->vertices = NULL;
+		queue->count = 0;
+		return false;
+	}
+
+	write_vertices(queue, view_width, view_height);
+	return true;
+}
+
+void draw_queue_flush(DrawQueue* queue, GLuint program, DrawOrder order, int view_width, int view_height, int flags, FrameArena* arena)
+{
+	if (!draw_queue_build(queue, order, view_width, view_height, arena) || queue->count == 0)
+		return;
+	if (!queue->vao)
+		create_buffers(queue);
+
+	uint32_t opaque_count = queue->stats.opaque_items;
+	size_t bytes = (size_t)queue->count * DRAW_QUEUE_ITEM_FLOATS * sizeof(float);
+	glBindVertexArray(queue->vao);
+	glBindBuffer(GL_ARRAY_BUFFER, queue->vbo);
+	glBufferData(GL_ARRAY_BUFFER, bytes, queue->vertices, GL_STREAM_DRAW);
+	mem_track_object(MEM_GL_VERTEX_BUFFERS, queue->vbo, bytes);
+
+	glUseProgram(program);
+	glActiveTexture(GL_TEXTURE0);
+	bool set_blend = !(flags & DRAW_QUEUE_KEEP_BLEND);
+	if (set_blend)
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	if (order == DRAW_ORDER_DEPTH_SORTED) {
+		glEnable(GL_DEPTH_TEST);
+		glDepthFunc(GL_LESS);
+		glDepthMask(GL_TRUE);
+		if (set_blend)
+			glDisable(GL_BLEND);
+		draw_runs(queue, 0, opaque_count);
+
+		glDepthMask(GL_FALSE);
+		if (set_blend)
+			glEnable(GL_BLEND);
+		draw_runs(queue, opaque_count, queue->count);
+		glDepthMask(GL_TRUE);
+		glDisable(GL_DEPTH_TEST);
+	} else {
+		glDisable(GL_DEPTH_TEST);
+		if (set_blend)
+			glEnable(GL_BLEND);
+		draw_runs(queue, 0, queue->count);
+	}
+
+	if (set_blend)
+		glDisable(GL_BLEND);
+	glBindVertexArray(0);
+	queue->count = 0;
+	queue->order = NULL;
+	queue->vertices = NULL;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "glad/include/glad.h"
+#include "frame_arena.h"
+
+//----------------------------------------------------------------------------
+//
+//  Queue of textured quads for one pass. Items are pushed in any order with
+//    a depth, 0 nearest, and drawn by draw_queue_flush() with tilegame.vert,
+//    which takes the depth as the quad's z.
+//
+//  DRAW_ORDER_SUBMITTED is the painter's algorithm: every item is blended
+//    in push order without a depth test, so the caller pushes back to front
+//    and every covered layer is shaded.
+//
+//  DRAW_ORDER_DEPTH_SORTED splits the queue. Opaque items are drawn first,
+//    front to back, with depth writes and blending off, so the depth test
+//    rejects hidden fragments before they are shaded (early-Z; the fragment
+//    shader must not discard or write depth). Blended items follow back to
+//    front with the depth test on and depth writes off, so they are hidden
+//    by the opaque items in front of them and blend over those behind.
+//    Within a depth, items are ordered by texture to batch draw calls.
+//
+//  The sort packs each item into a 64-bit key, blended flag in the top bit,
+//    then the depth's float bits (inverted for blended items), then the
+//    texture, and orders the keys with radix_sort_u64(), so a frame of
+//    100k sprites costs a few linear passes. Non-negative floats order
+//    like their bits, and the sort is stable, so equal keys keep their push
+//    order.
+//
+//  draw_layer_depth() gives top-down sprites their depth: each of
+//    DRAW_LAYERS takes a slice of the depth range, higher layers nearer,
+//    and within a layer a sprite is nearer the lower its bottom edge is in
+//    the view, so actors on a layer are drawn in Y order and overlap the
+//    way they stand.
+//
+//  Item storage is reserved by draw_queue_init() and never grows; pushes
+//    past the capacity are dropped and counted. The draw order, sort keys
+//    and vertices only live for one flush and come from the caller's
+//    FrameArena, DRAW_QUEUE_FRAME_BYTES(capacity) at most. A flush the
+//    arena cannot hold draws nothing and counts its items as dropped. The
+//    GL buffers are created by the first flush, so a queue can be built
+//    without a context.
+//
+
+#define DRAW_QUEUE_FLOATS_PER_VERTEX 8
+#define DRAW_QUEUE_VERTICES_PER_ITEM 6
+
+#define DRAW_LAYERS 16
+// Share of a layer's slice that Y spans, so that layers never meet.
+#define DRAW_LAYER_SPAN 0.99f
+
+// Frame arena bytes one flush of 'count' items takes, alignment included.
+#define DRAW_QUEUE_FRAME_BYTES(count) ((size_t)(count) * (2 * sizeof(uint32_t) + 2 * sizeof(uint64_t) + \
+	DRAW_QUEUE_FLOATS_PER_VERTEX * DRAW_QUEUE_VERTICES_PER_ITEM * sizeof(float)) + 5 * FRAME_ARENA_DEFAULT_ALIGN)
+
+// Leaves the blend state to the caller, for the counting passes of the
+// overdraw view.
+#define DRAW_QUEUE_KEEP_BLEND 1
+
+typedef enum DrawOrder {
+	DRAW_ORDER_SUBMITTED,
+	DRAW_ORDER_DEPTH_SORTED,
+	DRAW_ORDER_COUNT
+} DrawOrder;
+
+typedef struct DrawItem {
+	float x0, y0, x1, y1;		// view pixels, y down
+	float u0, v0, u1, v1;
+	float depth;				// [0, 1), 0 nearest
+	GLuint texture;
+	bool opaque;				// every texel drawn has alpha 1
+} DrawItem;
+
+typedef struct DrawQueueStats {
+	uint32_t opaque_items;
+	uint32_t blended_items;
+	uint32_t draw_calls;
+	uint32_t sort_passes;		// radix passes that moved data
+	uint32_t dropped;			// pushes past the capacity, items of flushes the arena could not hold
+} DrawQueueStats;
+
+typedef struct DrawQueue {
+	DrawItem* items;
+	uint32_t* order;			// item indices in draw order, from the frame arena
+	float* vertices;			// from the frame arena
+	uint32_t count;
+	uint32_t capacity;
+
+	GLuint vao;
+	GLuint vbo;
+	DrawQueueStats stats;		// of the last flush
+} DrawQueue;
+
+bool
+draw_queue_init(DrawQueue* queue, uint32_t capacity);
+
+void
+draw_queue_free(DrawQueue* queue);
+
+void
+draw_queue_clear(DrawQueue* queue);
+
+// Returns false when the queue is full.
+bool
+draw_queue_push(DrawQueue* queue, const DrawItem* item);
+
+// The CPU half of a flush: orders the items and writes their vertices into
+// 'arena', leaving 'order' and 'vertices' valid until the arena is reset.
+// Returns false, counting the items as dropped, when the arena is full.
+bool
+draw_queue_build(DrawQueue* queue, DrawOrder order, int view_width, int view_height, FrameArena* arena);
+
+// Draws and clears the queue into the bound framebuffer, whose viewport
+// covers a view_width x view_height view. The depth test is off afterwards,
+// and so is blending unless 'flags' has DRAW_QUEUE_KEEP_BLEND.
+void
+draw_queue_flush(DrawQueue* queue, GLuint program, DrawOrder order, int view_width, int view_height, int flags, FrameArena* arena);
+
+// Key of DRAW_ORDER_DEPTH_SORTED: opaque items first, nearest first, then
+// blended items, farthest first. Ties go by texture so that runs can share
+// a draw call.
+uint64_t
+draw_item_sort_key(const DrawItem* item);
+
+// Depth of a sprite on 'layer', 0 the farthest, whose bottom edge is at
+// 'y' in a view 'view_height' pixels tall. 'y' is clamped to the view.
+static inline float
+draw_layer_depth(uint32_t layer, float y, float view_height)
+{
+	float t = y <= 0.0f ? 0.0f : y >= view_height ? 1.0f : y / view_height;
+	uint32_t slice = DRAW_LAYERS - 1 - (layer < DRAW_LAYERS ? layer : DRAW_LAYERS - 1);
+	return (slice + (1.0f - t) * DRAW_LAYER_SPAN) / DRAW_LAYERS;
+}
+
+const char*
+draw_order_name(DrawOrder order);
@@ -0,0 +1,200 @@
+#include "stdafx.h"
+#include "fov.h"
+#include "platform.h"
+
+#include <string.h>
+#include <atomic>
+
+// Maps octant coordinates (column dx, row dy) to grid offsets.
+static const int octants[8][4] = {
+	{ 1, 0, 0, 1 }, { 0, 1, 1, 0 }, { 0, -1, 1, 0 }, { -1, 0, 0, 1 },
+	{ -1, 0, 0, -1 }, { 0, -1, -1, 0 }, { 0, 1, -1, 0 }, { 1, 0, 0, -1 },
+};
+
+bool fov_grid_init(FovGrid* grid, int width, int height)
+{
+	memset(grid, 0, sizeof(*grid));
+	grid->opaque = (uint8_t*)calloc((size_t)width * height, 1);
+	if (!grid->opaque)
+		return false;
+	grid->width = width;
+	grid->height = height;
+	return true;
+}
+
+void fov_grid_free(FovGrid* grid)
+{
+	free(grid->opaque);
+	memset(grid, 0, sizeof(*grid));
+}
+
+bool fov_grid_from_level(FovGrid* grid, const uint8_t* rgba, int width, int height)
+{
+	if (!fov_grid_init(grid, width, height))
+		return false;
+	for (int i = 0; i < width * height; i++) {
+		const uint8_t* p = rgba + (size_t)i * 4;
+		grid->opaque[i] = p[0] >= 128 && p[1] < 128 && p[2] < 128;
+	}
+	return true;
+}
+
+void fov_grid_set_opaque(FovGrid* grid, int x, int y, bool opaque)
+{
+	if (x < 0 || y < 0 || x >= grid->width || y >= grid->height || grid->opaque[y * grid->width + x] == opaque)
+		return;
+	grid->opaque[y * grid->width + x] = opaque;
+	FovChange* change = &grid->changes[grid->version % FOV_CHANGE_HISTORY];
+	change->x = x;
+	change->y = y;
+	grid->version++;
+}
+
+bool fov_view_init(FovView* view, int radius)
+{
+	memset(view, 0, sizeof(*view));
+	view->radius = radius;
+	view->size = 2 * radius + 1;
+	view->visible = (uint8_t*)calloc((size_t)view->size * view->size, 1);
+	return view->visible != NULL;
+}
+
+void fov_view_free(FovView* view)
+{
+	free(view->visible);
+	memset(view, 0, sizeof(*view));
+}
+
+static inline void
+mark_visible(FovView* view, int dx, int dy)
+{
+	uint8_t* v = &view->visible[(dy + view->radius) * view->size + dx + view->radius];
+	view->visible_count += !*v;
+	*v = 1;
+}
+
+// Scans the rows of one octant from 'row' outwards between the slopes
+// 'start' and 'end' (1 is the diagonal, 0 the axis). Each opaque run in a
+// row starts a scan of the rows beyond it over the slopes left of the run.
+static void
+cast_octant(const FovGrid* grid, FovView* view, int row, float start, float end, const int* m)
+{
+	if (start < end)
+		return;
+
+	int radius = view->radius, r2 = radius * radius + radius;
+	float new_start = 0.0f;
+	for (int j = row; j <= radius; j++) {
+		bool blocked = false;
+		for (int dx = -j; dx <= 0; dx++) {
+			int dy = -j;
+			float l_slope = (dx - 0.5f) / (dy + 0.5f), r_slope = (dx + 0.5f) / (dy - 0.5f);
+			if (start < r_slope)
+				continue;
+			if (end > l_slope)
+				break;
+
+			int ox = dx * m[0] + dy * m[1], oy = dx * m[2] + dy * m[3];
+			if (dx * dx + dy * dy <= r2)
+				mark_visible(view, ox, oy);
+
+			bool opaque = fov_grid_is_opaque(grid, view->x + ox, view->y + oy);
+			if (blocked) {
+				if (opaque) {
+					new_start = r_slope;
+					continue;
+				}
+				blocked = false;
+				start = new_start;
+			} else if (opaque && j < radius) {
+				blocked = true;
+				cast_octant(grid, view, j + 1, start, l_slope, m);
+				new_start = r_slope;
+			}
+		}
+		if (blocked)
+			break;
+	}
+}
+
+void fov_compute(const FovGrid* grid, FovView* view, int x, int y)
+{
+	memset(view->visible, 0, (size_t)view->size * view->size);
+	view->visible_count = 0;
+	view->x = x;
+	view->y = y;
+	view->valid = true;
+	view->grid_version = grid->version;
+
+	mark_visible(view, 0, 0);
+	for (int o = 0; o < 8; o++)
+		cast_octant(grid, view, 1, 1.0f, 0.0f, octants[o]);
+}
+
+// Whether a tile within the view's radius changed since it was cast.
+static bool
+view_is_stale(const FovGrid* grid, const FovView* view, int x, int y)
+{
+	if (!view->valid || view->x != x || view->y != y)
+		return true;
+	uint32_t changed = grid->version - view->grid_version;
+	if (changed > FOV_CHANGE_HISTORY)
+		return true;
+	for (uint32_t v = view->grid_version; v != grid->version; v++) {
+		const FovChange* change = &grid->changes[v % FOV_CHANGE_HISTORY];
+		if (abs(change->x - x) <= view->radius && abs(change->y - y) <= view->radius)
+			return true;
+	}
+	return false;
+}
+
+bool fov_update(const FovGrid* grid, FovView* view, int x, int y)
+{
+	if (!view_is_stale(grid, view, x, y)) {
+		view->grid_version = grid->version;
+		return false;
+	}
+	fov_compute(grid, view, x, y);
+	return true;
+}
+
+static BatchPool fov_pool;
+
+typedef struct FovBatch {
+	const FovGrid* grid;
+	FovRequest* requests;
+	std::atomic<uint32_t> computed;
+} FovBatch;
+
+static void
+update_request(void* user, uint32_t index)
+{
+	FovBatch* batch = (FovBatch*)user;
+	FovRequest* request = &batch->requests[index];
+	if (fov_update(batch->grid, request->view, request->x, request->y))
+		batch->computed++;
+}
+
+bool fov_workers_start(int threads)
+{
+	return batch_pool_start(&fov_pool, threads);
+}
+
+void fov_workers_stop()
+{
+	batch_pool_stop(&fov_pool);
+}
+
+void fov_update_batch(const FovGrid* grid, FovRequest* requests, uint32_t count, FovBatchStats* stats)
+{
+	double start = platform_time_us();
+	FovBatch batch;
+	batch.grid = grid;
+	batch.requests = requests;
+	batch.computed = 0;
+	batch_pool_run(&fov_pool, update_request, &batch, count);
+
+	stats->computed = batch.computed;
+	stats->reused = count - stats->computed;
+	stats->ms = (float)((platform_time_us() - start) / 1000.0);
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "batch_pool.h"
+
+//----------------------------------------------------------------------------
+//
+//  Field of view on a tile grid by recursive shadowcasting. Each of the
+//    eight octants around the viewer is scanned row by row outwards; an
+//    opaque tile narrows the range of slopes the rows beyond it can see
+//    and splits the scan around it, so every tile within the radius is
+//    visited at most once and walls shadow everything behind them. Tiles
+//    off the grid count as opaque.
+//
+//  FovGrid holds the opacity of the level. Changing a tile bumps the grid
+//    version and records the tile in a short history, so fov_update() can
+//    tell whether a view is still valid: a view is recomputed only when
+//    its viewer moved or a tile within its radius changed, or when more
+//    tiles changed than the history holds.
+//
+//  fov_update_batch() updates many views at once, one per NPC, on the
+//    batch pool workers started by fov_workers_start() and the calling
+//    thread.
+//    Workers take views off a shared counter; the grid is only read, so it
+//    must not change during the batch.
+//
+
+#define FOV_CHANGE_HISTORY 64
+#define FOV_MAX_WORKERS BATCH_POOL_MAX_WORKERS
+
+typedef struct FovChange {
+	int x;
+	int y;
+} FovChange;
+
+typedef struct FovGrid {
+	int width;
+	int height;
+	uint8_t* opaque;			// one byte per tile, row-major
+	uint32_t version;			// changes made since the grid was built
+	FovChange changes[FOV_CHANGE_HISTORY];	// indexed by version
+} FovGrid;
+
+// Tiles within 'radius' of the viewer, in a square window centred on it.
+typedef struct FovView {
+	int radius;
+	int size;					// 2 * radius + 1
+	uint8_t* visible;			// size x size, 1 where visible
+	uint32_t visible_count;
+
+	bool valid;
+	int x;						// viewer of the last computation
+	int y;
+	uint32_t grid_version;		// grid the view is up to date with
+} FovView;
+
+typedef struct FovRequest {
+	FovView* view;
+	int x;
+	int y;
+} FovRequest;
+
+typedef struct FovBatchStats {
+	uint32_t computed;			// views cast again
+	uint32_t reused;			// views still valid
+	float ms;
+} FovBatchStats;
+
+bool
+fov_grid_init(FovGrid* grid, int width, int height);
+
+void
+fov_grid_free(FovGrid* grid);
+
+// Walls are the red pixels of a level image (RGBA8), floors everything else.
+bool
+fov_grid_from_level(FovGrid* grid, const uint8_t* rgba, int width, int height);
+
+void
+fov_grid_set_opaque(FovGrid* grid, int x, int y, bool opaque);
+
+static inline bool
+fov_grid_is_opaque(const FovGrid* grid, int x, int y)
+{
+	return x < 0 || y < 0 || x >= grid->width || y >= grid->height || grid->opaque[y * grid->width + x];
+}
+
+bool
+fov_view_init(FovView* view, int radius);
+
+void
+fov_view_free(FovView* view);
+
+// Casts the view from (x, y) unconditionally.
+void
+fov_compute(const FovGrid* grid, FovView* view, int x, int y);
+
+// Casts the view again only when it is out of date. Returns true when it
+// was cast.
+bool
+fov_update(const FovGrid* grid, FovView* view, int x, int y);
+
+static inline bool
+fov_is_visible(const FovView* view, int x, int y)
+{
+	int vx = x - view->x + view->radius, vy = y - view->y + view->radius;
+	return view->valid && vx >= 0 && vy >= 0 && vx < view->size && vy < view->size && view->visible[vy * view->size + vx];
+}
+
+// Starts 'threads' workers, at most FOV_MAX_WORKERS. Without workers,
+// batches run on the calling thread.
+bool
+fov_workers_start(int threads);
+
+void
+fov_workers_stop();
+
+// fov_update() of every request. The views must be distinct.
+void
+fov_update_batch(const FovGrid* grid, FovRequest* requests, uint32_t count, FovBatchStats* stats);
@@ -0,0 +1,103 @@
+#include "stdafx.h"
+#include "frame_arena.h"
+#include "mem_stats.h"
+
+#include <string.h>
+
+bool frame_arena_init(FrameArena* arena, size_t capacity)
+{
+	memset(arena, 0, sizeof(FrameArena));
+	arena->base = (uint8_t*)malloc(capacity);
+	if (!arena->base)
+		return false;
+	arena->capacity = capacity;
+	mem_track_alloc(MEM_CPU_FRAME_ARENA, capacity);
+	return true;
+}
+
+void frame_arena_free(FrameArena* arena)
+{
+	if (arena->base)
+		mem_track_free(MEM_CPU_FRAME_ARENA, arena->capacity);
+	free(arena->base);
+	memset(arena, 0, sizeof(FrameArena));
+}
+
+void* frame_arena_alloc(FrameArena* arena, size_t size, size_t align)
+{
+	uintptr_t start = (uintptr_t)arena->base + arena->offset;
+	uintptr_t aligned = (start + (align - 1)) & ~(uintptr_t)(align - 1);
+	size_t offset = (size_t)(aligned - (uintptr_t)arena->base);
+
+	if (offset + size > arena->capacity) {
+		arena->failed++;
+		return NULL;
+	}
+
+	arena->offset = offset + size;
+	if (arena->offset > arena->peak)
+		arena->peak = arena->offset;
+
+	return (void*)aligned;
+}
+
+void frame_arena_reset(FrameArena* arena)
+{
+	arena->offset = 0;
+	arena->failed = 0;
+}
+
+bool pool_init(ObjectPool* pool, size_t block_size, uint32_t block_count)
+{
+	memset(pool, 0, sizeof(ObjectPool));
+
+	// every block must be able to hold the free list link
+	if (block_size < sizeof(void*))
+		block_size = sizeof(void*);
+	block_size = (block_size + FRAME_ARENA_DEFAULT_ALIGN - 1) & ~(size_t)(FRAME_ARENA_DEFAULT_ALIGN - 1);
+
+	pool->base = (uint8_t*)malloc(block_size * block_count);
+	if (!pool->base)
+		return false;
+
+	pool->block_size = block_size;
+	pool->block_count = block_count;
+	mem_track_alloc(MEM_CPU_POOLS, block_size * block_count);
+
+	for (uint32_t i = block_count; i > 0; i--) {
+		void* block = pool->base + (size_t)(i - 1) * block_size;
+		*(void**)block = pool->free_list;
+		pool->free_list = block;
+	}
+
+	return true;
+}
+
+void pool_free_all(ObjectPool* pool)
+{
+	if (pool->base)
+		mem_track_free(MEM_CPU_POOLS, pool->block_size * pool->block_count);
+	free(pool->base);
+	memset(pool, 0, sizeof(ObjectPool));
+}
+
+void* pool_alloc(ObjectPool* pool)
+{
+	void* block = pool->free_list;
+	if (!block)
+		return NULL;
+
+	pool->free_list = *(void**)block;
+	pool->used++;
+	memset(block, 0, pool->block_size);
+	return block;
+}
+
+void pool_release(ObjectPool* pool, void* ptr)
+{
+	if (!ptr)
+		return;
+	*(void**)ptr = pool->free_list;
+	pool->free_list = ptr;
+	pool->used--;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <new>
+
+//----------------------------------------------------------------------------
+//
+//  FrameArena is a linear allocator for per-frame scratch memory. Allocation
+//    bumps an offset inside one buffer reserved at startup and
+//    frame_arena_reset() rewinds it in O(1) at the end of the frame, so
+//    nothing handed out may be kept across frames.
+//
+//  ObjectPool hands out fixed-size blocks from one buffer reserved up front
+//    and keeps freed blocks on an intrusive free list. It is meant for
+//    long-lived objects (renderers, players) that would otherwise each be a
+//    separate malloc/new. POOL_NEW() constructs the object in its block and
+//    POOL_DELETE() destroys it before the block goes back to the pool.
+//
+
+#define FRAME_ARENA_DEFAULT_ALIGN 16
+
+typedef struct FrameArena {
+	uint8_t* base;
+	size_t capacity;
+	size_t offset;
+	size_t peak;
+	uint32_t failed;	// allocations that did not fit this frame
+} FrameArena;
+
+typedef struct ObjectPool {
+	uint8_t* base;
+	size_t block_size;
+	uint32_t block_count;
+	uint32_t used;
+	void* free_list;
+} ObjectPool;
+
+bool
+frame_arena_init(FrameArena* arena, size_t capacity);
+
+void
+frame_arena_free(FrameArena* arena);
+
+// Returns NULL when the arena is exhausted; never falls back to the heap.
+void*
+frame_arena_alloc(FrameArena* arena, size_t size, size_t align);
+
+void
+frame_arena_reset(FrameArena* arena);
+
+bool
+pool_init(ObjectPool* pool, size_t block_size, uint32_t block_count);
+
+void
+pool_free_all(ObjectPool* pool);
+
+// Returns a zeroed block, or NULL when the pool is exhausted.
+void*
+pool_alloc(ObjectPool* pool);
+
+void
+pool_release(ObjectPool* pool, void* ptr);
+
+template <typename T> static inline T*
+pool_new(ObjectPool* pool)
+{
+	void* block = pool->block_size >= sizeof(T) ? pool_alloc(pool) : NULL;
+	return block ? new (block) T() : NULL;
+}
+
+template <typename T> static inline void
+pool_delete(ObjectPool* pool, T* ptr)
+{
+	if (!ptr)
+		return;
+	ptr->~T();
+	pool_release(pool, ptr);
+}
+
+#define FRAME_ALLOC(arena, type, count) ((type*)frame_arena_alloc((arena), sizeof(type) * (count), alignof(type)))
+#define POOL_NEW(pool, type) pool_new<type>(pool)
+#define POOL_DELETE(pool, ptr) pool_delete((pool), (ptr))
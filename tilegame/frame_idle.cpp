@@ -0,0 +1,93 @@
+#include "stdafx.h"
+#include "frame_idle.h"
+#include "platform.h"
+
+#include <string.h>
+
+static uint64_t
+elapsed_us(uint64_t start, uint64_t end)
+{
+	return (end - start) * 1000000 / SDL_GetPerformanceFrequency();
+}
+
+void frame_idle_init(FrameIdle* idle, bool enabled)
+{
+	memset(idle, 0, sizeof(*idle));
+	idle->enabled = enabled;
+	idle->dirty = true;
+	idle->sample_start_wall = SDL_GetPerformanceCounter();
+	idle->sample_start_cpu_us = platform_process_cpu_us();
+}
+
+void frame_idle_invalidate(FrameIdle* idle)
+{
+	idle->dirty = true;
+}
+
+// Closes the CPU sample once FRAME_IDLE_SAMPLE_MS of wall time has passed.
+// The idle figure keeps its last value across samples with no blocked time.
+static void
+update_cpu_sample(FrameIdle* idle)
+{
+	uint64_t now = SDL_GetPerformanceCounter();
+	uint64_t wall_us = elapsed_us(idle->sample_start_wall, now);
+	if (wall_us < FRAME_IDLE_SAMPLE_MS * 1000)
+		return;
+
+	uint64_t cpu_us = platform_process_cpu_us();
+	idle->stats.loop_cpu_percent = 100.0f * (float)(cpu_us - idle->sample_start_cpu_us) / (float)wall_us;
+	if (idle->idle_wall_us > 0)
+		idle->stats.idle_cpu_percent = 100.0f * (float)idle->idle_cpu_us / (float)idle->idle_wall_us;
+
+	idle->sample_start_wall = now;
+	idle->sample_start_cpu_us = cpu_us;
+	idle->idle_wall_us = 0;
+	idle->idle_cpu_us = 0;
+}
+
+void frame_idle_wait(FrameIdle* idle, uint32_t timeout_ms)
+{
+	update_cpu_sample(idle);
+	if (!idle->enabled || idle->dirty)
+		return;
+
+	uint64_t cpu_start = platform_process_cpu_us();
+	uint64_t start = SDL_GetPerformanceCounter();
+	int woken = SDL_WaitEventTimeout(NULL, (int)timeout_ms);
+	uint64_t end = SDL_GetPerformanceCounter();
+
+	idle->idle_wall_us += elapsed_us(start, end);
+	idle->idle_cpu_us += platform_process_cpu_us() - cpu_start;
+	idle->stats.waits++;
+
+	if (woken) {
+		idle->woken = true;
+		idle->wake_time = end;
+	}
+}
+
+bool frame_idle_begin_frame(FrameIdle* idle)
+{
+	bool draw = !idle->enabled || idle->dirty;
+	idle->dirty = false;
+	if (!draw)
+		idle->stats.frames_skipped++;
+	return draw;
+}
+
+void frame_idle_frame_presented(FrameIdle* idle)
+{
+	idle->stats.frames_drawn++;
+	if (!idle->woken)
+		return;
+
+	float ms = elapsed_us(idle->wake_time, SDL_GetPerformanceCounter()) / 1000.0f;
+	idle->woken = false;
+	idle->wake_samples++;
+	idle->wake_latency_total_ms += ms;
+
+	idle->stats.wake_latency_ms = ms;
+	if (ms > idle->stats.wake_latency_max_ms)
+		idle->stats.wake_latency_max_ms = ms;
+	idle->stats.wake_latency_avg_ms = (float)(idle->wake_latency_total_ms / idle->wake_samples);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+
+//----------------------------------------------------------------------------
+//
+//  Dirty-frame skipping. Each loop iteration the game marks the frame
+//    dirty when an event arrived, the simulation is not at rest, ImGui
+//    wants another frame or, at a low rate, particles in view want to move
+//    on (particles_idle_frame_ms()). A clean frame is neither drawn nor
+//    swapped, and instead of spinning the loop blocks in
+//    SDL_WaitEventTimeout() until the next event or the next timed redraw.
+//
+//  Two things are measured: the process CPU time per wall-clock time spent
+//    blocked (idle CPU), and the wake-up latency from the wait returning to
+//    the end of the swap of the first frame drawn after it.
+//
+
+#define FRAME_IDLE_MAX_WAIT_MS 1000
+#define FRAME_IDLE_SAMPLE_MS 1000
+
+typedef struct FrameIdleStats {
+	uint64_t frames_drawn;
+	uint64_t frames_skipped;
+	uint64_t waits;
+	float idle_cpu_percent;			// over the blocked time within the last FRAME_IDLE_SAMPLE_MS
+	float loop_cpu_percent;			// over the last FRAME_IDLE_SAMPLE_MS of wall time
+	float wake_latency_ms;
+	float wake_latency_max_ms;
+	float wake_latency_avg_ms;
+} FrameIdleStats;
+
+typedef struct FrameIdle {
+	bool enabled;
+	bool dirty;
+	bool woken;
+	uint64_t wake_time;
+	uint64_t wake_samples;
+	double wake_latency_total_ms;
+
+	uint64_t sample_start_wall;
+	uint64_t sample_start_cpu_us;
+	uint64_t idle_wall_us;
+	uint64_t idle_cpu_us;
+
+	FrameIdleStats stats;
+} FrameIdle;
+
+void
+frame_idle_init(FrameIdle* idle, bool enabled);
+
+// Marks the next frame as different from the last one drawn.
+void
+frame_idle_invalidate(FrameIdle* idle);
+
+// Blocks until an event is queued or 'timeout_ms' passes, when idling is
+// enabled and no frame is dirty. Leaves the event in the queue.
+void
+frame_idle_wait(FrameIdle* idle, uint32_t timeout_ms);
+
+// Returns whether the current frame has to be drawn and clears the flag.
+bool
+frame_idle_begin_frame(FrameIdle* idle);
+
+// Call after the swap of a drawn frame.
+void
+frame_idle_frame_presented(FrameIdle* idle);
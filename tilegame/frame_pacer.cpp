@@ -0,0 +1,133 @@
+#include "stdafx.h"
+#include "frame_pacer.h"
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+static const char* pacing_names[FRAME_PACING_COUNT] = {
+	"vsync",
+	"adaptive vsync",
+	"low latency",
+	"immediate",
+};
+
+void frame_pacer_init(FramePacer* pacer, FramePacing pacing, double refresh_hz)
+{
+	memset(pacer, 0, sizeof(*pacer));
+	pacer->refresh_us = 1000000.0 / (refresh_hz > 0.0 ? refresh_hz : 60.0);
+	frame_pacer_set_pacing(pacer, pacing);
+}
+
+void frame_pacer_set_pacing(FramePacer* pacer, FramePacing pacing)
+{
+	pacer->pacing = pacing;
+	pacer->work_count = 0;
+	pacer->work_next = 0;
+	pacer->target_vblank = 0.0;
+	pacer->latency_total_us = 0.0;
+	memset(&pacer->stats, 0, sizeof(pacer->stats));
+}
+
+int frame_pacer_swap_interval(FramePacing pacing)
+{
+	switch (pacing) {
+	case FRAME_PACING_ADAPTIVE_VSYNC:
+	case FRAME_PACING_LOW_LATENCY:
+		return -1;
+	case FRAME_PACING_IMMEDIATE:
+		return 0;
+	default:
+		return 1;
+	}
+}
+
+const char* frame_pacer_name(FramePacing pacing)
+{
+	return pacing < FRAME_PACING_COUNT ? pacing_names[pacing] : "unknown";
+}
+
+// Input-to-swap time the next frame is paced for: the FRAME_PACER_PERCENTILE
+// of the recent frames plus a margin. Pacing for the very worst frame would
+// let one hitch cancel the gain for the whole history; the rare frame that
+// runs over is swapped late with adaptive vsync instead.
+static double
+predicted_work_us(const FramePacer* pacer)
+{
+	double sorted[FRAME_PACER_HISTORY];
+	int count = pacer->work_count;
+	memcpy(sorted, pacer->work_history, count * sizeof(double));
+	std::sort(sorted, sorted + count);
+	return sorted[(int)((count - 1) * FRAME_PACER_PERCENTILE)] + FRAME_PACER_MARGIN_US;
+}
+
+double frame_pacer_input_delay_us(FramePacer* pacer, double now)
+{
+	pacer->target_vblank = 0.0;
+	if (pacer->pacing != FRAME_PACING_LOW_LATENCY || pacer->work_count == 0 || pacer->last_present == 0.0)
+		return 0.0;
+
+	// first vblank on the phase of the last present that the frame can still make
+	double work = predicted_work_us(pacer);
+	double periods = ceil((now + work - pacer->last_present) / pacer->refresh_us);
+	if (periods < 1.0)
+		periods = 1.0;
+	pacer->target_vblank = pacer->last_present + periods * pacer->refresh_us;
+
+	double delay = pacer->target_vblank - work - now;
+	return delay > 0.0 ? delay : 0.0;
+}
+
+void frame_pacer_input_sampled(FramePacer* pacer, double now)
+{
+	pacer->last_sample = pacer->sample;
+	pacer->sample = now;
+}
+
+void frame_pacer_swap_begin(FramePacer* pacer, double now)
+{
+	pacer->swap_start = now;
+}
+
+void frame_pacer_swap_end(FramePacer* pacer, double now)
+{
+	FramePacerStats* stats = &pacer->stats;
+	double work = pacer->swap_start - pacer->sample;
+
+	pacer->work_history[pacer->work_next] = work;
+	pacer->work_next = (pacer->work_next + 1) % FRAME_PACER_HISTORY;
+	if (pacer->work_count < FRAME_PACER_HISTORY)
+		pacer->work_count++;
+
+	// Paced frames are late when they reach the swap after their target
+	// vblank; free-running ones when a frame started right after the last
+	// present still took more than a refresh to show.
+	bool late;
+	if (pacer->target_vblank > 0.0)
+		late = pacer->swap_start > pacer->target_vblank;
+	else
+		late = pacer->last_present > 0.0 && pacer->sample - pacer->last_present < pacer->refresh_us * 0.5 &&
+			now - pacer->last_present > pacer->refresh_us * 1.5;
+
+	double sample_wait = 0.0;
+	if (pacer->last_sample > 0.0) {
+		sample_wait = pacer->sample - pacer->last_sample;
+		if (sample_wait > pacer->refresh_us)
+			sample_wait = pacer->refresh_us;
+		sample_wait *= 0.5;
+	}
+	double latency = sample_wait + (now - pacer->sample) + pacer->refresh_us * 0.5;
+
+	stats->frames++;
+	if (late)
+		stats->late_frames++;
+	stats->work_us = work;
+	stats->present_us = now - pacer->swap_start;
+	stats->latency_us = latency;
+	if (latency > stats->latency_max_us)
+		stats->latency_max_us = latency;
+	pacer->latency_total_us += latency;
+	stats->latency_avg_us = pacer->latency_total_us / (double)stats->frames;
+
+	pacer->last_present = now;
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <stdint.h>
+
+//----------------------------------------------------------------------------
+//
+//  Frame pacing. The pacer is fed timestamps (microseconds on any
+//    monotonic clock) for input sampling and for the start and end of each
+//    swap. From those it tracks the display refresh phase, how long the
+//    game takes from sampling input to submitting the frame, and an
+//    input-to-photon latency estimate.
+//
+//  FRAME_PACING_LOW_LATENCY delays input sampling and the simulation step
+//    until just before the next vblank minus the predicted work time (a
+//    high percentile of recent frames), so the frame is built from input
+//    that is as fresh as possible. It asks for adaptive vsync (swap
+//    interval -1): a frame that misses its vblank is swapped immediately
+//    and tears, instead of stalling a whole refresh.
+//
+//  Latency estimate per frame: half the interval between input samples
+//    (the average time an event waits to be sampled), plus sample to swap
+//    end, plus half a refresh of scanout to the middle of the screen. Swap
+//    end only marks the vblank when the driver does not queue frames ahead,
+//    so the game finishes the GL queue after each swap in low latency mode.
+//
+
+#define FRAME_PACER_HISTORY 32
+#define FRAME_PACER_MARGIN_US 1000.0
+#define FRAME_PACER_PERCENTILE 0.9
+
+typedef enum FramePacing {
+	FRAME_PACING_VSYNC,
+	FRAME_PACING_ADAPTIVE_VSYNC,
+	FRAME_PACING_LOW_LATENCY,
+	FRAME_PACING_IMMEDIATE,
+	FRAME_PACING_COUNT
+} FramePacing;
+
+typedef struct FramePacerStats {
+	double work_us;				// input sample to swap start, last frame
+	double present_us;			// swap duration, last frame
+	double latency_us;			// estimate, last frame
+	double latency_avg_us;		// running average since the policy was set
+	double latency_max_us;
+	uint64_t frames;
+	uint64_t late_frames;		// swapped after the vblank they were paced for
+} FramePacerStats;
+
+typedef struct FramePacer {
+	FramePacing pacing;
+	double refresh_us;
+
+	double work_history[FRAME_PACER_HISTORY];
+	int work_count;
+	int work_next;
+
+	double last_present;
+	double last_sample;
+	double sample;
+	double swap_start;
+	double target_vblank;
+	double latency_total_us;
+
+	FramePacerStats stats;
+} FramePacer;
+
+void
+frame_pacer_init(FramePacer* pacer, FramePacing pacing, double refresh_hz);
+
+// Switches policy and restarts the statistics.
+void
+frame_pacer_set_pacing(FramePacer* pacer, FramePacing pacing);
+
+// Swap interval the policy asks for: 1, -1 (adaptive) or 0.
+int
+frame_pacer_swap_interval(FramePacing pacing);
+
+const char*
+frame_pacer_name(FramePacing pacing);
+
+// How long to wait at 'now' before sampling input for the next frame.
+// Always 0 outside FRAME_PACING_LOW_LATENCY.
+double
+frame_pacer_input_delay_us(FramePacer* pacer, double now);
+
+void
+frame_pacer_input_sampled(FramePacer* pacer, double now);
+
+void
+frame_pacer_swap_begin(FramePacer* pacer, double now);
+
+void
+frame_pacer_swap_end(FramePacer* pacer, double now);
@@ -0,0 +1,137 @@
+#include "stdafx.h"
+#include "gui_cache.h"
+
+#include "imgui/imgui_internal.h"
+
+// Windows are hit tested with a margin so that moving onto a resize border
+// also rebuilds the frame.
+#define GUI_CACHE_HOVER_MARGIN 4.0f
+
+void gui_cache_init(GuiCache* cache)
+{
+	*cache = GuiCache();
+}
+
+void gui_cache_invalidate(GuiCache* cache)
+{
+	cache->valid = false;
+}
+
+uint64_t gui_cache_hash(uint64_t hash, const void* data, size_t len)
+{
+	const uint8_t* bytes = (const uint8_t*)data;
+	for (size_t i = 0; i < len; i++) {
+		hash ^= bytes[i];
+		hash *= 0x100000001b3ull;
+	}
+	return hash;
+}
+
+static bool
+point_in_window(ImVec2 p)
+{
+	ImGuiContext& g = *GImGui;
+	for (int i = 0; i < g.Windows.Size; i++) {
+		ImGuiWindow* window = g.Windows[i];
+		if (!window->Active || window->Hidden)
+			continue;
+		ImRect rect = window->Rect();
+		rect.Expand(GUI_CACHE_HOVER_MARGIN);
+		if (rect.Contains(p))
+			return true;
+	}
+	return false;
+}
+
+// True when the input since the last built frame could change what a window
+// draws: a widget is active, a popup is open, or the mouse moved, clicked or
+// scrolled over a window.
+static bool
+input_changed(GuiCache* cache)
+{
+	ImGuiContext& g = *GImGui;
+	ImGuiIO& io = g.IO;
+
+	if (g.ActiveId != 0 || g.OpenPopupStack.Size > 0 || io.WantCaptureKeyboard)
+		return true;
+
+	bool over_window = point_in_window(io.MousePos) || point_in_window(cache->mouse_pos);
+	if (!over_window)
+		return false;
+
+	if (io.MousePos.x != cache->mouse_pos.x || io.MousePos.y != cache->mouse_pos.y)
+		return true;
+	if (io.MouseWheel != 0.0f || io.MouseWheelH != 0.0f)
+		return true;
+	for (int i = 0; i < IM_ARRAYSIZE(cache->mouse_down); i++)
+		if (io.MouseDown[i] != cache->mouse_down[i])
+			return true;
+	return false;
+}
+
+// New and auto-resizing windows take a few frames to reach their final
+// size and are hidden for the first one, so their draw data cannot be kept.
+static bool
+windows_settled()
+{
+	ImGuiContext& g = *GImGui;
+	for (int i = 0; i < g.Windows.Size; i++) {
+		ImGuiWindow* window = g.Windows[i];
+		if (!window->Active)
+			continue;
+		if (window->HiddenFramesForResize > 0 || window->HiddenFramesRegular > 0 ||
+			window->AutoFitFramesX > 0 || window->AutoFitFramesY > 0)
+			return false;
+	}
+	return true;
+}
+
+static void
+remember_input(GuiCache* cache)
+{
+	ImGuiIO& io = ImGui::GetIO();
+	cache->mouse_pos = io.MousePos;
+	for (int i = 0; i < IM_ARRAYSIZE(cache->mouse_down); i++)
+		cache->mouse_down[i] = io.MouseDown[i];
+}
+
+bool gui_cache_reuse(GuiCache* cache, uint64_t key)
+{
+	ImGuiIO& io = ImGui::GetIO();
+
+	bool reuse = cache->valid && key == cache->key && ImGui::GetDrawData() != NULL &&
+		io.DisplaySize.x == cache->display_size.x && io.DisplaySize.y == cache->display_size.y &&
+		!input_changed(cache);
+	if (!reuse)
+		return false;
+
+	// Nothing under the mouse consumes these, so drop them here instead of
+	// letting them pile up until the next built frame.
+	io.MouseWheel = io.MouseWheelH = 0.0f;
+	io.ClearInputCharacters();
+
+	remember_input(cache);
+	cache->stats.frames_reused++;
+	cache->stats.windows_reused += cache->window_count;
+	return true;
+}
+
+void gui_cache_store(GuiCache* cache, uint64_t key, const ImDrawData* draw_data)
+{
+	ImGuiIO& io = ImGui::GetIO();
+
+	cache->valid = draw_data != NULL && windows_settled();
+	cache->key = key;
+	cache->display_size = io.DisplaySize;
+	remember_input(cache);
+	cache->window_count = draw_data ? draw_data->CmdListsCount : 0;
+
+	cache->stats.frames_built++;
+	cache->stats.windows_rebuilt += cache->window_count;
+}
+
+bool gui_cache_needs_frame(const GuiCache* cache, uint64_t key)
+{
+	ImGuiContext& g = *GImGui;
+	return !cache->valid || key != cache->key || g.ActiveId != 0 || g.OpenPopupStack.Size > 0;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "imgui/imgui.h"
+
+//----------------------------------------------------------------------------
+//
+//  Retained ImGui frames. The overlay windows draw the same thing frame
+//    after frame, so instead of running NewFrame()/Render() every frame the
+//    caller hashes everything its windows read into a key. When the key and
+//    the mouse/keyboard state the windows could react to are unchanged, the
+//    previous frame's ImDrawData is submitted again: no widget code runs, no
+//    draw list is rebuilt and the GL backend draws from the buffers it
+//    already holds (see ImGui_ImplOpenGL3_GetUploadStats()).
+//
+//  Call gui_cache_reuse() after the platform backend's NewFrame(). When it
+//    returns false, build the frame as usual and pass the result to
+//    gui_cache_store().
+//
+
+typedef struct GuiCacheStats {
+	uint64_t frames_built;
+	uint64_t frames_reused;
+	uint64_t windows_rebuilt;
+	uint64_t windows_reused;
+} GuiCacheStats;
+
+typedef struct GuiCache {
+	bool valid;
+	uint64_t key;
+	ImVec2 display_size;
+	ImVec2 mouse_pos;
+	bool mouse_down[5];
+	int window_count;
+	GuiCacheStats stats;
+} GuiCache;
+
+void
+gui_cache_init(GuiCache* cache);
+
+// Forces the next frame to be built.
+void
+gui_cache_invalidate(GuiCache* cache);
+
+// FNV-1a over 'len' bytes, continuing from 'hash'. Start from GUI_CACHE_HASH_SEED.
+uint64_t
+gui_cache_hash(uint64_t hash, const void* data, size_t len);
+
+#define GUI_CACHE_HASH_SEED 0xcbf29ce484222325ull
+
+bool
+gui_cache_reuse(GuiCache* cache, uint64_t key);
+
+void
+gui_cache_store(GuiCache* cache, uint64_t key, const ImDrawData* draw_data);
+
+// True when the next frame would differ from the stored one even without
+// new input: the key changed, a widget is active, a popup is open or a
+// window has not settled yet. Used to decide whether the main loop may block.
+bool
+gui_cache_needs_frame(const GuiCache* cache, uint64_t key);
@@ -0,0 +1,571 @@
+#include "stdafx.h"
+#include "hot_reload.h"
+#include "image_decode.h"
+#include "mem_stats.h"
+
+#include <string.h>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+typedef enum HotAssetKind {
+	HOT_ASSET_NONE,
+	HOT_ASSET_TEXTURE,
+	HOT_ASSET_PROGRAM
+} HotAssetKind;
+
+// A new version of an asset, decoded on the reload thread.
+typedef struct HotPayload {
+	bool valid;
+	uint8_t* pixels;
+	int width;
+	int height;
+	char* sources[LOAD_SHADERS_MAX_STAGES];
+	GLint lengths[LOAD_SHADERS_MAX_STAGES];
+	double seen_us;
+	double decode_ms;
+} HotPayload;
+
+typedef struct HotAsset {
+	HotAssetKind kind;
+	GLuint* object;
+	uint32_t generation;				// bumped when the slot is reused
+	int path_count;
+	char paths[LOAD_SHADERS_MAX_STAGES][VFS_MAX_PATH];
+	GLenum stages[LOAD_SHADERS_MAX_STAGES];
+	uint64_t mtimes[LOAD_SHADERS_MAX_STAGES];
+	bool changed;
+	double seen_us;						// first change since the last decode
+	double last_change_us;
+	HotPayload ready;
+} HotAsset;
+
+typedef struct HotDir {
+	int wd;
+	char path[VFS_MAX_PATH];			// relative to the root
+} HotDir;
+
+static std::mutex reload_lock;
+static std::condition_variable reload_wake;
+static std::thread reload_thread;
+static bool reload_running = false;
+static bool reload_stop = false;
+static void (*reload_ready)() = NULL;
+static char reload_root[VFS_MAX_PATH];
+
+static HotAsset assets[HOT_RELOAD_MAX_ASSETS];
+static HotDir dirs[HOT_RELOAD_MAX_DIRS];
+static int dir_count = 0;
+static HotReloadStats stats;
+static double latency_total_ms = 0.0;
+
+#ifdef __linux__
+static int inotify_fd = -1;
+static int wake_pipe[2] = { -1, -1 };
+#endif
+
+static void disk_path(const char* path, char* out, size_t size)
+{
+	snprintf(out, size, "%s/%s", reload_root, path);
+}
+
+static void normalize_path(const char* path, char* out)
+{
+	while (*path == '/' || *path == '\\')
+		path++;
+	size_t i = 0;
+	for (; path[i] && i < VFS_MAX_PATH - 1; i++)
+		out[i] = path[i] == '\\' ? '/' : path[i];
+	out[i] = 0;
+}
+
+static void free_payload(HotPayload* payload)
+{
+	if (payload->pixels)
+		image_free(payload->pixels);
+	for (int i = 0; i < LOAD_SHADERS_MAX_STAGES; i++)
+		free(payload->sources[i]);
+	memset(payload, 0, sizeof(*payload));
+}
+
+static void mark_changed(const char* path, double now)
+{
+	std::lock_guard<std::mutex> guard(reload_lock);
+	for (int a = 0; a < HOT_RELOAD_MAX_ASSETS; a++) {
+		HotAsset* asset = &assets[a];
+		for (int i = 0; asset->object && i < asset->path_count; i++) {
+			if (strcmp(asset->paths[i], path) != 0)
+				continue;
+			if (!asset->changed)
+				asset->seen_us = now;
+			asset->changed = true;
+			asset->last_change_us = now;
+		}
+	}
+}
+
+// Milliseconds until the next changed asset has settled, or -1 when none
+// changed. Call with the lock held.
+static int next_settle_ms(double now)
+{
+	int timeout = -1;
+	for (int a = 0; a < HOT_RELOAD_MAX_ASSETS; a++) {
+		if (!assets[a].object || !assets[a].changed)
+			continue;
+		double left_ms = HOT_RELOAD_SETTLE_MS - (now - assets[a].last_change_us) / 1000.0;
+		int ms = left_ms > 0.0 ? (int)left_ms + 1 : 0;
+		if (timeout < 0 || ms < timeout)
+			timeout = ms;
+	}
+	return timeout;
+}
+
+#ifdef __linux__
+static bool watch_dir(const char* dir)
+{
+	for (int i = 0; i < dir_count; i++) {
+		if (strcmp(dirs[i].path, dir) == 0)
+			return true;
+	}
+	if (dir_count == HOT_RELOAD_MAX_DIRS)
+		return false;
+
+	char full[VFS_MAX_PATH * 2];
+	disk_path(dir, full, sizeof(full));
+	int wd = inotify_add_watch(inotify_fd, full, IN_CLOSE_WRITE | IN_MOVED_TO);
+	if (wd < 0) {
+		printf("Unable to watch %s\n", full);
+		return false;
+	}
+	dirs[dir_count].wd = wd;
+	snprintf(dirs[dir_count].path, sizeof(dirs[dir_count].path), "%s", dir);
+	dir_count++;
+	return true;
+}
+
+static void read_events()
+{
+	// inotify_event is followed by its name; keep the buffer aligned for it
+	alignas(struct inotify_event) char buffer[4096];
+	ssize_t bytes = read(inotify_fd, buffer, sizeof(buffer));
+	double now = platform_time_us();
+
+	for (ssize_t offset = 0; offset < bytes; ) {
+		const struct inotify_event* event = (const struct inotify_event*)(buffer + offset);
+		offset += sizeof(struct inotify_event) + event->len;
+		if (!event->len)
+			continue;
+
+		char path[VFS_MAX_PATH * 2];
+		path[0] = 0;
+		{
+			std::lock_guard<std::mutex> guard(reload_lock);
+			for (int i = 0; i < dir_count; i++) {
+				if (dirs[i].wd == event->wd) {
+					snprintf(path, sizeof(path), dirs[i].path[0] ? "%s/%s" : "%s%s", dirs[i].path, event->name);
+					break;
+				}
+			}
+		}
+		if (path[0])
+			mark_changed(path, now);
+	}
+}
+
+// Blocks until a watched directory changes, the reload thread is stopped or
+// 'timeout_ms' passes (-1 waits without a timeout).
+static void wait_for_changes(int timeout_ms)
+{
+	struct pollfd fds[2] = {
+		{ inotify_fd, POLLIN, 0 },
+		{ wake_pipe[0], POLLIN, 0 },
+	};
+	if (poll(fds, 2, timeout_ms) <= 0)
+		return;
+	if (fds[0].revents & POLLIN)
+		read_events();
+	if (fds[1].revents & POLLIN) {
+		char byte;
+		ssize_t ignored = read(wake_pipe[0], &byte, 1);
+		(void)ignored;
+	}
+}
+#else
+// Without change notifications the write time of every watched file is
+// compared every HOT_RELOAD_POLL_MS.
+static void wait_for_changes(int timeout_ms)
+{
+	std::unique_lock<std::mutex> lock(reload_lock);
+	if (timeout_ms < 0 || timeout_ms > HOT_RELOAD_POLL_MS)
+		timeout_ms = HOT_RELOAD_POLL_MS;
+	reload_wake.wait_for(lock, std::chrono::milliseconds(timeout_ms));
+
+	double now = platform_time_us();
+	for (int a = 0; a < HOT_RELOAD_MAX_ASSETS; a++) {
+		HotAsset* asset = &assets[a];
+		for (int i = 0; asset->object && i < asset->path_count; i++) {
+			char full[VFS_MAX_PATH * 2];
+			uint64_t mtime;
+			disk_path(asset->paths[i], full, sizeof(full));
+			if (!platform_file_mtime(full, &mtime) || mtime == asset->mtimes[i])
+				continue;
+			asset->mtimes[i] = mtime;
+			if (!asset->changed)
+				asset->seen_us = now;
+			asset->changed = true;
+			asset->last_change_us = now;
+		}
+	}
+}
+#endif
+
+static bool decode(HotAssetKind kind, int path_count, char (*paths)[VFS_MAX_PATH], HotPayload* payload)
+{
+	char full[VFS_MAX_PATH * 2];
+
+	if (kind == HOT_ASSET_TEXTURE) {
+		int channels;
+		disk_path(paths[0], full, sizeof(full));
+		payload->pixels = image_load(full, &payload->width, &payload->height, &channels, 4);
+		return payload->pixels != NULL;
+	}
+
+	for (int i = 0; i < path_count; i++) {
+		size_t size;
+		disk_path(paths[i], full, sizeof(full));
+		payload->sources[i] = (char*)platform_read_file(full, &size);
+		if (!payload->sources[i])
+			return false;
+		payload->lengths[i] = (GLint)size;
+	}
+	return true;
+}
+
+// Decodes every changed asset that has settled.
+static void decode_settled()
+{
+	for (;;) {
+		int index = -1;
+		uint32_t generation;
+		HotAssetKind kind;
+		int path_count;
+		char paths[LOAD_SHADERS_MAX_STAGES][VFS_MAX_PATH];
+		double seen_us;
+		{
+			std::lock_guard<std::mutex> guard(reload_lock);
+			double now = platform_time_us();
+			for (int a = 0; a < HOT_RELOAD_MAX_ASSETS && index < 0; a++) {
+				HotAsset* asset = &assets[a];
+				if (asset->object && asset->changed && (now - asset->last_change_us) / 1000.0 >= HOT_RELOAD_SETTLE_MS)
+					index = a;
+			}
+			if (index < 0)
+				return;
+
+			HotAsset* asset = &assets[index];
+			asset->changed = false;
+			generation = asset->generation;
+			kind = asset->kind;
+			path_count = asset->path_count;
+			memcpy(paths, asset->paths, sizeof(paths));
+			seen_us = asset->seen_us;
+		}
+
+		HotPayload payload;
+		memset(&payload, 0, sizeof(payload));
+		double start = platform_time_us();
+		bool ok = decode(kind, path_count, paths, &payload);
+		payload.valid = true;
+		payload.seen_us = seen_us;
+		payload.decode_ms = (platform_time_us() - start) / 1000.0;
+
+		{
+			std::lock_guard<std::mutex> guard(reload_lock);
+			HotAsset* asset = &assets[index];
+			if (!ok || !asset->object || asset->generation != generation) {
+				if (!ok) {
+					printf("Unable to reload %s\n", paths[0]);
+					stats.failures++;
+				}
+				free_payload(&payload);
+				continue;
+			}
+			// a version that was not applied yet is replaced, but the
+			// latency still counts from its change
+			if (asset->ready.valid) {
+				payload.seen_us = asset->ready.seen_us;
+				free_payload(&asset->ready);
+			}
+			asset->ready = payload;
+		}
+		if (reload_ready)
+			reload_ready();
+	}
+}
+
+static void reload_thread_main()
+{
+	int timeout_ms = -1;
+	for (;;) {
+		wait_for_changes(timeout_ms);
+		{
+			std::lock_guard<std::mutex> guard(reload_lock);
+			if (reload_stop)
+				break;
+		}
+		decode_settled();
+
+		std::lock_guard<std::mutex> guard(reload_lock);
+		timeout_ms = next_settle_ms(platform_time_us());
+	}
+}
+
+bool hot_reload_init(const char* root, void (*ready)())
+{
+	std::lock_guard<std::mutex> guard(reload_lock);
+	if (reload_running)
+		return true;
+
+	snprintf(reload_root, sizeof(reload_root), "%s", root);
+	reload_ready = ready;
+	reload_stop = false;
+	memset(&stats, 0, sizeof(stats));
+	latency_total_ms = 0.0;
+
+#ifdef __linux__
+	inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (inotify_fd < 0 || pipe(wake_pipe) != 0) {
+		printf("Unable to watch %s for changes\n", root);
+		if (inotify_fd >= 0)
+			close(inotify_fd);
+		inotify_fd = -1;
+		return false;
+	}
+#endif
+
+	reload_thread = std::thread(reload_thread_main);
+	reload_running = true;
+	return true;
+}
+
+void hot_reload_shutdown()
+{
+	{
+		std::lock_guard<std::mutex> guard(reload_lock);
+		if (!reload_running)
+			return;
+		reload_stop = true;
+		reload_wake.notify_all();
+	}
+#ifdef __linux__
+	char byte = 0;
+	ssize_t ignored = write(wake_pipe[1], &byte, 1);
+	(void)ignored;
+#endif
+	reload_thread.join();
+
+	std::lock_guard<std::mutex> guard(reload_lock);
+#ifdef __linux__
+	close(inotify_fd);
+	close(wake_pipe[0]);
+	close(wake_pipe[1]);
+	inotify_fd = wake_pipe[0] = wake_pipe[1] = -1;
+#endif
+	for (int a = 0; a < HOT_RELOAD_MAX_ASSETS; a++)
+		free_payload(&assets[a].ready);
+	memset(assets, 0, sizeof(assets));
+	memset(dirs, 0, sizeof(dirs));
+	dir_count = 0;
+	reload_running = false;
+}
+
+static bool watch(HotAssetKind kind, GLuint* object, const char** paths, const GLenum* stages, int path_count)
+{
+	std::lock_guard<std::mutex> guard(reload_lock);
+	if (!reload_running)
+		return false;
+
+	HotAsset* asset = NULL;
+	for (int a = 0; a < HOT_RELOAD_MAX_ASSETS && !asset; a++) {
+		if (!assets[a].object)
+			asset = &assets[a];
+	}
+	if (!asset) {
+		printf("Too many hot reloaded assets\n");
+		return false;
+	}
+
+	uint32_t generation = asset->generation + 1;
+	memset(asset, 0, sizeof(*asset));
+	asset->kind = kind;
+	asset->generation = generation;
+	asset->path_count = path_count;
+	for (int i = 0; i < path_count; i++) {
+		char full[VFS_MAX_PATH * 2];
+		normalize_path(paths[i], asset->paths[i]);
+		asset->stages[i] = stages ? stages[i] : GL_NONE;
+		disk_path(asset->paths[i], full, sizeof(full));
+		platform_file_mtime(full, &asset->mtimes[i]);
+
+#ifdef __linux__
+		char dir[VFS_MAX_PATH];
+		memcpy(dir, asset->paths[i], sizeof(dir));
+		char* slash = strrchr(dir, '/');
+		if (slash)
+			*slash = 0;
+		else
+			dir[0] = 0;
+		if (!watch_dir(dir))
+			return false;
+#endif
+	}
+	asset->object = object;
+	return true;
+}
+
+bool hot_reload_watch_texture(const char* path, GLuint* texture)
+{
+	return watch(HOT_ASSET_TEXTURE, texture, &path, NULL, 1);
+}
+
+bool hot_reload_watch_program(const ShaderInfo* shaders, GLuint* program)
+{
+	const char* paths[LOAD_SHADERS_MAX_STAGES];
+	GLenum stages[LOAD_SHADERS_MAX_STAGES];
+	int count = 0;
+	for (; shaders[count].type != GL_NONE; count++) {
+		if (count == LOAD_SHADERS_MAX_STAGES)
+			return false;
+		paths[count] = shaders[count].filename;
+		stages[count] = shaders[count].type;
+	}
+	return watch(HOT_ASSET_PROGRAM, program, paths, stages, count);
+}
+
+void hot_reload_unwatch(const GLuint* object)
+{
+	std::lock_guard<std::mutex> guard(reload_lock);
+	for (int a = 0; a < HOT_RELOAD_MAX_ASSETS; a++) {
+		if (assets[a].object != object)
+			continue;
+		free_payload(&assets[a].ready);
+		assets[a].object = NULL;
+		assets[a].changed = false;
+	}
+}
+
+// New texture with the wrap and filter parameters of 'old'.
+static GLuint upload_texture(GLuint old, const HotPayload* payload)
+{
+	GLint wrap_s, wrap_t, min_filter, mag_filter;
+	glBindTexture(GL_TEXTURE_2D, old);
+	glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, &wrap_s);
+	glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, &wrap_t);
+	glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, &min_filter);
+	glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, &mag_filter);
+
+	GLuint tex;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, wrap_s);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, wrap_t);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag_filter);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, payload->width, payload->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, payload->pixels);
+	glGenerateMipmap(GL_TEXTURE_2D);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	mem_track_object(MEM_GL_TEXTURES, tex, mem_texture_bytes(payload->width, payload->height, 4, true));
+	return tex;
+}
+
+int hot_reload_apply()
+{
+	int ready[HOT_RELOAD_MAX_ASSETS];
+	int ready_count = 0;
+	{
+		std::lock_guard<std::mutex> guard(reload_lock);
+		for (int a = 0; a < HOT_RELOAD_MAX_ASSETS; a++) {
+			if (assets[a].object && assets[a].ready.valid)
+				ready[ready_count++] = a;
+		}
+	}
+	if (!ready_count)
+		return 0;
+
+	// Only this thread registers, unregisters and applies, so the assets
+	// found above stay valid; the reload thread may still replace a payload.
+	int swapped = 0;
+	for (int r = 0; r < ready_count; r++) {
+		HotAsset* asset = &assets[ready[r]];
+		HotPayload payload;
+		{
+			std::lock_guard<std::mutex> guard(reload_lock);
+			payload = asset->ready;
+			memset(&asset->ready, 0, sizeof(asset->ready));
+		}
+		if (!payload.valid)
+			continue;
+
+		double start = platform_time_us();
+		bool ok;
+		if (asset->kind == HOT_ASSET_TEXTURE) {
+			GLuint tex = upload_texture(*asset->object, &payload);
+			mem_untrack_object(MEM_GL_TEXTURES, *asset->object);
+			glDeleteTextures(1, asset->object);
+			*asset->object = tex;
+			ok = true;
+		} else {
+			ShaderInfo shaders[LOAD_SHADERS_MAX_STAGES + 1];
+			for (int i = 0; i < asset->path_count; i++)
+				shaders[i] = { asset->stages[i], asset->paths[i], 0 };
+			shaders[asset->path_count] = { GL_NONE, NULL, 0 };
+
+			GLuint program = load_shader_sources(shaders, payload.sources, payload.lengths, asset->path_count);
+			ok = program != 0;
+			if (ok) {
+				glDeleteProgram(*asset->object);
+				*asset->object = program;
+			}
+			for (int i = 0; i < asset->path_count; i++)
+				glDeleteShader(shaders[i].shader);
+		}
+		double end = platform_time_us();
+
+		std::lock_guard<std::mutex> guard(reload_lock);
+		if (ok) {
+			swapped++;
+			stats.reloads++;
+			stats.decode_ms = payload.decode_ms;
+			stats.apply_ms = (end - start) / 1000.0;
+			stats.latency_ms = (end - payload.seen_us) / 1000.0;
+			if (stats.latency_ms > stats.latency_max_ms)
+				stats.latency_max_ms = stats.latency_ms;
+			latency_total_ms += stats.latency_ms;
+			stats.latency_avg_ms = latency_total_ms / stats.reloads;
+			memcpy(stats.path, asset->paths[0], sizeof(stats.path));
+		} else {
+			stats.failures++;
+		}
+		free_payload(&payload);
+	}
+	return swapped;
+}
+
+void hot_reload_get_stats(HotReloadStats* out)
+{
+	std::lock_guard<std::mutex> guard(reload_lock);
+	*out = stats;
+	out->pending = 0;
+	for (int a = 0; a < HOT_RELOAD_MAX_ASSETS; a++) {
+		if (assets[a].object && (assets[a].changed || assets[a].ready.valid))
+			out->pending++;
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <glad/glad.h>
+
+#include "load_shaders.h"
+#include "vfs.h"
+
+//----------------------------------------------------------------------------
+//
+//  Hot reloading of textures and shader programs. Registered files are
+//    watched (inotify on Linux, polling their write time elsewhere) and
+//    when one changes a background thread re-reads it from the loose
+//    directory and decodes it. The GL work happens on the GL thread in
+//    hot_reload_apply(), called at a frame boundary: every reload that is
+//    ready is uploaded or compiled into a new object, and only when that
+//    succeeded is the registered handle switched over and the old object
+//    deleted. A frame therefore sees either the old or the new version of
+//    an asset, never half of one, and a shader with errors leaves the
+//    program that was running in place.
+//
+//  Editors save in several writes or by renaming a temporary file, so a
+//    file is decoded once no further change to it was seen for
+//    HOT_RELOAD_SETTLE_MS. Changes that arrive while an earlier version is
+//    waiting to be applied replace it.
+//
+//  Latency is measured from the first change seen to the end of the swap,
+//    and split into the time spent decoding on the reload thread and the
+//    time spent in hot_reload_apply().
+//
+//  Textures are reloaded from the watched source image even when a cooked
+//    .ctex was uploaded at startup, so changes show up without a re-cook.
+//
+
+#define HOT_RELOAD_MAX_ASSETS 256
+#define HOT_RELOAD_MAX_DIRS 32
+#define HOT_RELOAD_SETTLE_MS 30
+#define HOT_RELOAD_POLL_MS 250
+
+typedef struct HotReloadStats {
+	uint32_t reloads;
+	uint32_t failures;				// unreadable files, bad images and shader errors
+	uint32_t pending;				// changed but not swapped in yet
+	double latency_ms;				// last reload, change seen to swapped in
+	double decode_ms;				// of which reading and decoding
+	double apply_ms;				// of which upload or compile and swap
+	double latency_avg_ms;
+	double latency_max_ms;
+	char path[VFS_MAX_PATH];		// last file reloaded
+} HotReloadStats;
+
+// Starts watching files under 'root', the directory mounted at the root of
+// the VFS. 'ready' is called from the reload thread when a reload is ready
+// to be applied, to wake a main loop that waits for events; it may be NULL.
+bool
+hot_reload_init(const char* root, void (*ready)());
+
+// Stops the reload thread and forgets every registered asset.
+void
+hot_reload_shutdown();
+
+// Replaces *texture with a new texture, with the same wrap and filter
+// parameters, whenever 'path' changes.
+bool
+hot_reload_watch_texture(const char* path, GLuint* texture);
+
+// Replaces *program with a new program whenever one of the shader files
+// changes. 'shaders' ends with a GL_NONE entry like for load_shaders().
+bool
+hot_reload_watch_program(const ShaderInfo* shaders, GLuint* program);
+
+// Stops replacing 'object' before it is deleted.
+void
+hot_reload_unwatch(const GLuint* object);
+
+// Swaps in every reload that is ready. Call on the GL thread between
+// frames. Returns the number of objects that were replaced.
+int
+hot_reload_apply();
+
+void
+hot_reload_get_stats(HotReloadStats* stats);
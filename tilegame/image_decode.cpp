@@ -0,0 +1,491 @@
+#include "stdafx.h"
+#include "image_decode.h"
+#include "vfs.h"
+#include "platform.h"
+
+#include <string.h>
+#include "stb_image.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define IMAGE_DECODE_SSE2 1
+#endif
+
+#define PNG_FILTER_NONE 0
+#define PNG_FILTER_SUB 1
+#define PNG_FILTER_UP 2
+#define PNG_FILTER_AVG 3
+#define PNG_FILTER_PAETH 4
+
+static ImageDecoder active_decoder = IMAGE_DECODER_FAST;
+
+static uint32_t read_be32(const uint8_t* p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+static int paeth(int a, int b, int c)
+{
+	int p = a + b - c;
+	int pa = abs(p - a);
+	int pb = abs(p - b);
+	int pc = abs(p - c);
+	if (pa <= pb && pa <= pc) return a;
+	if (pb <= pc) return b;
+	return c;
+}
+
+static void unfilter_scalar(uint8_t filter, const uint8_t* src, const uint8_t* prior, uint8_t* dst, size_t n, int bpp)
+{
+	size_t i = 0;
+	switch (filter) {
+	case PNG_FILTER_SUB:
+		for (; i < (size_t)bpp; i++) dst[i] = src[i];
+		for (; i < n; i++) dst[i] = (uint8_t)(src[i] + dst[i - bpp]);
+		break;
+	case PNG_FILTER_UP:
+		for (; i < n; i++) dst[i] = (uint8_t)(src[i] + prior[i]);
+		break;
+	case PNG_FILTER_AVG:
+		for (; i < (size_t)bpp; i++) dst[i] = (uint8_t)(src[i] + (prior[i] >> 1));
+		for (; i < n; i++) dst[i] = (uint8_t)(src[i] + ((dst[i - bpp] + prior[i]) >> 1));
+		break;
+	case PNG_FILTER_PAETH:
+		for (; i < (size_t)bpp; i++) dst[i] = (uint8_t)(src[i] + prior[i]);
+		for (; i < n; i++) dst[i] = (uint8_t)(src[i] + paeth(dst[i - bpp], prior[i], prior[i - bpp]));
+		break;
+	default:
+		memmove(dst, src, n);
+		break;
+	}
+}
+
+#ifdef IMAGE_DECODE_SSE2
+
+// the pixel size is a template parameter so these compile to single moves
+template <int BPP>
+static __m128i load_px(const uint8_t* p)
+{
+	uint32_t v = 0;
+	memcpy(&v, p, BPP);
+	return _mm_cvtsi32_si128((int)v);
+}
+
+template <int BPP>
+static void store_px(uint8_t* p, __m128i v)
+{
+	uint32_t t = (uint32_t)_mm_cvtsi128_si32(v);
+	memcpy(p, &t, BPP);
+}
+
+static __m128i abs_epi16(__m128i x)
+{
+	return _mm_max_epi16(x, _mm_sub_epi16(_mm_setzero_si128(), x));
+}
+
+static __m128i select_epi16(__m128i mask, __m128i a, __m128i b)
+{
+	return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+}
+
+// Sub, Avg and Paeth depend on the pixel to the left, so they work one pixel
+// per iteration with all channels of that pixel in one register. Up has no
+// such dependency and runs 16 bytes at a time.
+template <int BPP>
+static void unfilter_sse2(uint8_t filter, const uint8_t* src, const uint8_t* prior, uint8_t* dst, size_t n)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i one = _mm_set1_epi8(1);
+	size_t i = 0;
+
+	switch (filter) {
+	case PNG_FILTER_SUB: {
+		__m128i a = zero;
+		for (; i < n; i += BPP) {
+			a = _mm_add_epi8(a, load_px<BPP>(src + i));
+			store_px<BPP>(dst + i, a);
+		}
+		break;
+	}
+	case PNG_FILTER_UP:
+		for (; i + 16 <= n; i += 16) {
+			__m128i x = _mm_loadu_si128((const __m128i*)(src + i));
+			__m128i b = _mm_loadu_si128((const __m128i*)(prior + i));
+			_mm_storeu_si128((__m128i*)(dst + i), _mm_add_epi8(x, b));
+		}
+		for (; i < n; i++)
+			dst[i] = (uint8_t)(src[i] + prior[i]);
+		break;
+	case PNG_FILTER_AVG: {
+		__m128i a = zero;
+		for (; i < n; i += BPP) {
+			__m128i b = load_px<BPP>(prior + i);
+			// _mm_avg_epu8 rounds up, PNG rounds down
+			__m128i avg = _mm_sub_epi8(_mm_avg_epu8(a, b), _mm_and_si128(_mm_xor_si128(a, b), one));
+			a = _mm_add_epi8(avg, load_px<BPP>(src + i));
+			store_px<BPP>(dst + i, a);
+		}
+		break;
+	}
+	case PNG_FILTER_PAETH: {
+		__m128i a = zero, c = zero;
+		for (; i < n; i += BPP) {
+			__m128i b = _mm_unpacklo_epi8(load_px<BPP>(prior + i), zero);
+			__m128i pa = _mm_sub_epi16(b, c);
+			__m128i pb = _mm_sub_epi16(a, c);
+			__m128i pc = _mm_add_epi16(pa, pb);
+			pa = abs_epi16(pa);
+			pb = abs_epi16(pb);
+			pc = abs_epi16(pc);
+
+			__m128i smallest = _mm_min_epi16(pc, _mm_min_epi16(pa, pb));
+			__m128i nearest = select_epi16(_mm_cmpeq_epi16(smallest, pa), a,
+				select_epi16(_mm_cmpeq_epi16(smallest, pb), b, c));
+
+			__m128i x = _mm_add_epi8(_mm_packus_epi16(nearest, nearest), load_px<BPP>(src + i));
+			store_px<BPP>(dst + i, x);
+
+			a = _mm_unpacklo_epi8(x, zero);
+			c = b;
+		}
+		break;
+	}
+	default:
+		memmove(dst, src, n);
+		break;
+	}
+}
+
+#endif // IMAGE_DECODE_SSE2
+
+bool image_unfilter_row(uint8_t filter, const uint8_t* src, const uint8_t* prior, uint8_t* dst, size_t row_bytes, int bpp)
+{
+	static uint8_t zero_row[1];
+	if (filter > PNG_FILTER_PAETH)
+		return false;
+
+	// the first row behaves as if the row above it were all zeroes
+	if (!prior) {
+		if (filter == PNG_FILTER_UP)
+			filter = PNG_FILTER_NONE;
+		else if (filter == PNG_FILTER_PAETH)
+			filter = PNG_FILTER_SUB;
+		else if (filter == PNG_FILTER_AVG) {
+			for (size_t i = 0; i < row_bytes && i < (size_t)bpp; i++)
+				dst[i] = src[i];
+			for (size_t i = bpp; i < row_bytes; i++)
+				dst[i] = (uint8_t)(src[i] + (dst[i - bpp] >> 1));
+			return true;
+		}
+		prior = zero_row;
+	}
+
+#ifdef IMAGE_DECODE_SSE2
+	if (bpp == 3) {
+		unfilter_sse2<3>(filter, src, prior, dst, row_bytes);
+		return true;
+	}
+	if (bpp == 4) {
+		unfilter_sse2<4>(filter, src, prior, dst, row_bytes);
+		return true;
+	}
+#endif
+	unfilter_scalar(filter, src, prior, dst, row_bytes, bpp);
+	return true;
+}
+
+static uint8_t compute_y(int r, int g, int b)
+{
+	return (uint8_t)(((r * 77) + (g * 150) + (29 * b)) >> 8);
+}
+
+// Same conversions as stb_image's stbi__convert_format for 8-bit data.
+static unsigned char* convert_channels(unsigned char* data, int img_n, int req_comp, uint32_t w, uint32_t h)
+{
+	if (req_comp == img_n)
+		return data;
+
+	unsigned char* good = (unsigned char*)malloc((size_t)req_comp * w * h);
+	if (!good) {
+		free(data);
+		return NULL;
+	}
+
+	size_t count = (size_t)w * h;
+	const unsigned char* src = data;
+	unsigned char* dest = good;
+
+	for (size_t i = 0; i < count; i++, src += img_n, dest += req_comp) {
+		switch (img_n * 8 + req_comp) {
+		case 1 * 8 + 2: dest[0] = src[0]; dest[1] = 255; break;
+		case 1 * 8 + 3: dest[0] = dest[1] = dest[2] = src[0]; break;
+		case 1 * 8 + 4: dest[0] = dest[1] = dest[2] = src[0]; dest[3] = 255; break;
+		case 2 * 8 + 1: dest[0] = src[0]; break;
+		case 2 * 8 + 3: dest[0] = dest[1] = dest[2] = src[0]; break;
+		case 2 * 8 + 4: dest[0] = dest[1] = dest[2] = src[0]; dest[3] = src[1]; break;
+		case 3 * 8 + 4: dest[0] = src[0]; dest[1] = src[1]; dest[2] = src[2]; dest[3] = 255; break;
+		case 3 * 8 + 1: dest[0] = compute_y(src[0], src[1], src[2]); break;
+		case 3 * 8 + 2: dest[0] = compute_y(src[0], src[1], src[2]); dest[1] = 255; break;
+		case 4 * 8 + 1: dest[0] = compute_y(src[0], src[1], src[2]); break;
+		case 4 * 8 + 2: dest[0] = compute_y(src[0], src[1], src[2]); dest[1] = src[3]; break;
+		case 4 * 8 + 3: dest[0] = src[0]; dest[1] = src[1]; dest[2] = src[2]; break;
+		}
+	}
+
+	free(data);
+	return good;
+}
+
+// Returns NULL without touching the outputs when the file is not something
+// the fast path handles; the caller then falls back to stb_image.
+static unsigned char* load_png_fast(const uint8_t* buf, size_t len, int* width, int* height, int* channels_in_file, int desired_channels)
+{
+	static const uint8_t signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+	if (len < 8 + 25 || memcmp(buf, signature, 8) != 0)
+		return NULL;
+	if (desired_channels < 0 || desired_channels > 4)
+		return NULL;
+
+	uint32_t w = 0, h = 0;
+	int img_n = 0;
+	const uint8_t* first_idat = NULL;
+	size_t idat_len = 0, idat_chunks = 0;
+	bool ok = true, seen_end = false;
+
+	// first pass: check the chunks and add up the IDAT lengths
+	size_t pos = 8;
+	while (ok && !seen_end && pos + 12 <= len) {
+		uint32_t chunk_len = read_be32(buf + pos);
+		uint32_t type = read_be32(buf + pos + 4);
+		const uint8_t* data = buf + pos + 8;
+		if (chunk_len > len - pos - 12) {
+			ok = false;
+			break;
+		}
+
+		switch (type) {
+		case 0x49484452: // IHDR
+			if (chunk_len != 13) { ok = false; break; }
+			w = read_be32(data);
+			h = read_be32(data + 4);
+			// 8-bit, deflate, adaptive filtering, no interlace
+			if (data[8] != 8 || data[10] != 0 || data[11] != 0 || data[12] != 0) { ok = false; break; }
+			switch (data[9]) {
+			case 0: img_n = 1; break;
+			case 4: img_n = 2; break;
+			case 2: img_n = 3; break;
+			case 6: img_n = 4; break;
+			default: ok = false; break;
+			}
+			break;
+		case 0x49444154: // IDAT
+			if (!img_n) { ok = false; break; }
+			if (!idat_chunks++)
+				first_idat = data;
+			idat_len += chunk_len;
+			break;
+		case 0x49454E44: // IEND
+			seen_end = true;
+			break;
+		case 0x74524E53: // tRNS
+		case 0x43674249: // CgBI
+			ok = false;
+			break;
+		default:
+			// unknown critical chunks are handled (rejected) by stb_image
+			if (!(buf[pos + 4] & 0x20))
+				ok = false;
+			break;
+		}
+
+		pos += 12 + chunk_len;
+	}
+
+	if (!ok || !seen_end || !idat_len || !w || !h || w > (1 << 24) || h > (1 << 24))
+		return NULL;
+
+	// a single IDAT chunk is inflated where it lies; several are gathered
+	// into one buffer of their summed length
+	const uint8_t* idat = first_idat;
+	uint8_t* gathered = NULL;
+	if (idat_chunks > 1) {
+		gathered = (uint8_t*)malloc(idat_len);
+		if (!gathered)
+			return NULL;
+		size_t at = 0;
+		for (pos = first_idat - 8 - buf; at < idat_len; pos += 12 + read_be32(buf + pos)) {
+			uint32_t chunk_len = read_be32(buf + pos);
+			if (read_be32(buf + pos + 4) == 0x49444154) {
+				memcpy(gathered + at, buf + pos + 8, chunk_len);
+				at += chunk_len;
+			}
+		}
+		idat = gathered;
+	}
+
+	size_t stride = (size_t)w * img_n;
+	size_t raw_len = (stride + 1) * h;
+	uint8_t* raw = (uint8_t*)malloc(raw_len);
+
+	ok = raw && raw_len < 0x7fffffff && idat_len < 0x7fffffff &&
+		stbi_zlib_decode_buffer((char*)raw, (int)raw_len, (const char*)idat, (int)idat_len) == (int)raw_len;
+	free(gathered);
+
+	// rows are unfiltered in place, each moving down over the filter bytes
+	// before it, so no second image sized buffer is touched
+	for (uint32_t y = 0; ok && y < h; y++) {
+		const uint8_t* row = raw + y * (stride + 1);
+		ok = image_unfilter_row(row[0], row + 1, y ? raw + (y - 1) * stride : NULL, raw + y * stride, stride, img_n);
+	}
+	if (!ok) {
+		free(raw);
+		return NULL;
+	}
+	unsigned char* out = (unsigned char*)realloc(raw, stride * h);
+	if (!out)
+		out = raw;
+
+	if (desired_channels)
+		out = convert_channels(out, img_n, desired_channels, w, h);
+	if (!out)
+		return NULL;
+
+	*width = (int)w;
+	*height = (int)h;
+	if (channels_in_file)
+		*channels_in_file = img_n;
+	return out;
+}
+
+void image_set_decoder(ImageDecoder decoder)
+{
+	active_decoder = decoder;
+}
+
+unsigned char* image_load_from_memory(const uint8_t* buffer, size_t len, int* width, int* height, int* channels_in_file, int desired_channels)
+{
+	if (active_decoder == IMAGE_DECODER_FAST) {
+		unsigned char* pixels = load_png_fast(buffer, len, width, height, channels_in_file, desired_channels);
+		if (pixels)
+			return pixels;
+	}
+	return stbi_load_from_memory(buffer, (int)len, width, height, channels_in_file, desired_channels);
+}
+
+unsigned char* image_load(const char* path, int* width, int* height, int* channels_in_file, int desired_channels)
+{
+	VfsFile file;
+	if (!vfs_read(path, &file))
+		return NULL;
+
+	unsigned char* pixels = image_load_from_memory(file.data, file.size, width, height, channels_in_file, desired_channels);
+	vfs_close(&file);
+	return pixels;
+}
+
+void image_free(void* pixels)
+{
+	free(pixels);
+}
+
+static void put_be32(uint8_t* p, uint32_t v)
+{
+	p[0] = (uint8_t)(v >> 24);
+	p[1] = (uint8_t)(v >> 16);
+	p[2] = (uint8_t)(v >> 8);
+	p[3] = (uint8_t)v;
+}
+
+static uint32_t png_crc(uint32_t crc, const uint8_t* p, size_t n)
+{
+	static uint32_t table[256];
+	if (!table[1]) {
+		for (uint32_t i = 0; i < 256; i++) {
+			uint32_t c = i;
+			for (int k = 0; k < 8; k++)
+				c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			table[i] = c;
+		}
+	}
+	for (size_t i = 0; i < n; i++)
+		crc = table[(crc ^ p[i]) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+
+static bool write_png_chunk(FILE* file, const char* type, const uint8_t* data, size_t len)
+{
+	uint8_t head[8], tail[4];
+	put_be32(head, (uint32_t)len);
+	memcpy(head + 4, type, 4);
+	put_be32(tail, png_crc(png_crc(0xffffffffu, head + 4, 4), data, len) ^ 0xffffffffu);
+	return fwrite(head, 1, 8, file) == 8 && (!len || fwrite(data, 1, len, file) == len) && fwrite(tail, 1, 4, file) == 4;
+}
+
+bool image_write_png(const char* path, const uint8_t* rgba, int width, int height)
+{
+	// unfiltered rows, then a zlib stream of stored blocks of at most 65535 bytes
+	size_t row_bytes = (size_t)width * 4, raw_len = (row_bytes + 1) * height;
+	size_t idat_len = 2 + raw_len + (raw_len / 65535 + 1) * 5 + 4;
+	uint8_t* raw = (uint8_t*)malloc(raw_len);
+	uint8_t* idat = (uint8_t*)malloc(idat_len);
+	if (!raw || !idat) {
+		free(raw);
+		free(idat);
+		return false;
+	}
+	for (int y = 0; y < height; y++) {
+		uint8_t* row = raw + (row_bytes + 1) * y;
+		row[0] = PNG_FILTER_NONE;
+		memcpy(row + 1, rgba + row_bytes * y, row_bytes);
+	}
+
+	size_t pos = 0;
+	idat[pos++] = 0x78;
+	idat[pos++] = 0x01;
+	uint32_t a = 1, b = 0;
+	for (size_t done = 0; done < raw_len;) {
+		size_t n = raw_len - done < 65535 ? raw_len - done : 65535;
+		idat[pos++] = done + n == raw_len;
+		idat[pos++] = (uint8_t)n;
+		idat[pos++] = (uint8_t)(n >> 8);
+		idat[pos++] = (uint8_t)~n;
+		idat[pos++] = (uint8_t)(~n >> 8);
+		memcpy(idat + pos, raw + done, n);
+		for (size_t i = 0; i < n; i++) {
+			a += raw[done + i];
+			b += a;
+			// 5552 bytes are the most that cannot overflow before the reduction
+			if ((i % 5552) == 5551) {
+				a %= 65521;
+				b %= 65521;
+			}
+		}
+		a %= 65521;
+		b %= 65521;
+		pos += n;
+		done += n;
+	}
+	put_be32(idat + pos, (b << 16) | a);
+	pos += 4;
+
+	uint8_t header[13];
+	put_be32(header, (uint32_t)width);
+	put_be32(header + 4, (uint32_t)height);
+	header[8] = 8;		// bits per channel
+	header[9] = 6;		// RGBA
+	header[10] = header[11] = header[12] = 0;
+	static const uint8_t signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+
+	FILE* file = platform_fopen(path, "wb");
+	bool ok = file && fwrite(signature, 1, 8, file) == 8 &&
+		write_png_chunk(file, "IHDR", header, sizeof(header)) &&
+		write_png_chunk(file, "IDAT", idat, pos) &&
+		write_png_chunk(file, "IEND", NULL, 0);
+	if (file)
+		ok = fclose(file) == 0 && ok;
+	free(raw);
+	free(idat);
+	if (!ok)
+		printf("Unable to write %s\n", path);
+	return ok;
+}
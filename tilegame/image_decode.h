@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+//----------------------------------------------------------------------------
+//
+//  image_load() has the same contract as stbi_load() and returns the same
+//    bytes; free the result with image_free() (or stbi_image_free(), both
+//    end in free()). The file is read through the VFS.
+//
+//  8-bit, non-interlaced greyscale, grey+alpha, RGB and RGBA PNGs without a
+//    tRNS chunk take a fast path: the IDAT stream is inflated in one pass
+//    into a buffer of the exact raw size and the rows are unfiltered in
+//    place, with SSE2 for 3 and 4 byte pixels. Every other file, and every file when
+//    IMAGE_DECODER_STB is selected, goes through stb_image unchanged.
+//
+//  image_write_png() writes 8-bit RGBA without compression (stored deflate
+//    blocks), enough for the level images the editor saves.
+//
+
+typedef enum ImageDecoder {
+	IMAGE_DECODER_FAST,
+	IMAGE_DECODER_STB,
+} ImageDecoder;
+
+void
+image_set_decoder(ImageDecoder decoder);
+
+unsigned char*
+image_load(const char* path, int* width, int* height, int* channels_in_file, int desired_channels);
+
+unsigned char*
+image_load_from_memory(const uint8_t* buffer, size_t len, int* width, int* height, int* channels_in_file, int desired_channels);
+
+void
+image_free(void* pixels);
+
+// Writes to 'path' on disk.
+bool
+image_write_png(const char* path, const uint8_t* rgba, int width, int height);
+
+// Reverses the PNG row filter 'filter' for one row. 'prior' is the previous
+// unfiltered row, or NULL for the first row. 'dst' may overlap 'src' when it
+// starts at or before it. Exposed for the benchmarks.
+bool
+image_unfilter_row(uint8_t filter, const uint8_t* src, const uint8_t* prior, uint8_t* dst, size_t row_bytes, int bpp);
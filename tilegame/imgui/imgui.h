@@ -1075,6 +1075,7 @@ struct ImGuiStyle
     float       MouseCursorScale;           // Scale software rendered mouse cursor (when io.MouseDrawCursor is enabled). May be removed later.
     bool        AntiAliasedLines;           // Enable anti-aliasing on lines/borders. Disable if you are really tight on CPU/GPU.
     bool        AntiAliasedFill;            // Enable anti-aliasing on filled shapes (rounded rectangles, circles, etc.)
+    bool        VectorizedTessellation;     // Tessellate anti-aliased lines and fills 4 points at a time with SSE2 when available (see IMGUI_DISABLE_SSE). Produces the same vertices as the scalar code.
     float       CurveTessellationTol;       // Tessellation tolerance when using PathBezierCurveTo() without a specific number of segments. Decrease for highly tessellated curves (higher quality, more polygons), increase to reduce quality.
     ImVec4      Colors[ImGuiCol_COUNT];
 
@@ -1645,7 +1646,8 @@ enum ImDrawCornerFlags_
 enum ImDrawListFlags_
 {
     ImDrawListFlags_AntiAliasedLines = 1 << 0,
-    ImDrawListFlags_AntiAliasedFill  = 1 << 1
+    ImDrawListFlags_AntiAliasedFill  = 1 << 1,
+    ImDrawListFlags_VectorizedTessellation = 1 << 2   // Use the SSE2 path for anti-aliased AddPolyline()/AddConvexPolyFilled() when compiled in. Output is identical to the scalar path.
 };
 
 // Draw command list
@@ -1802,7 +1804,8 @@ enum ImFontAtlasFlags_
 {
     ImFontAtlasFlags_None               = 0,
     ImFontAtlasFlags_NoPowerOfTwoHeight = 1 << 0,   // Don't round the height to next power of two
-    ImFontAtlasFlags_NoMouseCursors     = 1 << 1    // Don't build software mouse cursors into the atlas
+    ImFontAtlasFlags_NoMouseCursors     = 1 << 1,   // Don't build software mouse cursors into the atlas
+    ImFontAtlasFlags_LazyGlyphs         = 1 << 2    // Build() only rasterizes U+0000..U+00FF and reserves a TexDesiredWidth (default 1024) square texture. Other glyphs of the requested ranges are rasterized on first use by FindGlyph() into free atlas space and flagged in TexDirtyRect for upload. Keep the CPU-side texture data (don't call ClearTexData()).
 };
 
 // Load and rasterize multiple TTF/OTF fonts into a same texture. The font atlas will build a single texture holding:
@@ -1911,6 +1914,7 @@ struct ImFontAtlas
     ImTextureID                 TexID;              // User data to refer to the texture once it has been uploaded to user's graphic systems. It is passed back to you during rendering via the ImDrawCmd structure.
     int                         TexDesiredWidth;    // Texture width desired by user before Build(). Must be a power-of-two. If have many glyphs your graphics API have texture size restrictions you may want to increase texture width to decrease height.
     int                         TexGlyphPadding;    // Padding between glyphs within texture in pixels. Defaults to 1.
+    int                         TexBuildThreads;    // Threads used by Build() to measure and rasterize glyphs, one glyph range (of at most 256 glyphs) per task. 0 = hardware concurrency, 1 = calling thread only. Workers allocate stb_truetype temporaries with malloc(), not with the ImGui allocator.
 
     // [Internal]
     // NB: Access texture data via GetTexData*() calls! Which will setup a default font for you.
@@ -1924,6 +1928,8 @@ struct ImFontAtlas
     ImVector<CustomRect>        CustomRects;        // Rectangles for packing custom texture data into the atlas.
     ImVector<ImFontConfig>      ConfigData;         // Internal data
     int                         CustomRectIds[1];   // Identifiers of custom texture rectangle used by ImFontAtlas/ImDrawList
+    ImVec4                      TexDirtyRect;       // Pixels (x0,y0,x1,y1) written by ImFontAtlasFlags_LazyGlyphs since the renderer last uploaded them. Empty when z <= x. Renderers re-upload this area and reset it.
+    void*                       LazyBuildData;      // State kept after Build() by ImFontAtlasFlags_LazyGlyphs (packer, font infos).
 };
 
 // Font runtime data and rendering
@@ -2482,6 +2482,7 @@ void ImGui::ShowStyleEditor(ImGuiStyle* ref)
     {
         ImGui::Checkbox("Anti-aliased lines", &style.AntiAliasedLines); ImGui::SameLine(); ShowHelpMarker("When disabling anti-aliasing lines, you'll probably want to disable borders in your style as well.");
         ImGui::Checkbox("Anti-aliased fill", &style.AntiAliasedFill);
+        ImGui::Checkbox("Vectorized tessellation", &style.VectorizedTessellation); ImGui::SameLine(); ShowHelpMarker("SSE2 path for anti-aliased lines and fills. Produces the same vertices as the scalar path.");
         ImGui::PushItemWidth(100);
         ImGui::DragFloat("Curve Tessellation Tolerance", &style.CurveTessellationTol, 0.02f, 0.10f, FLT_MAX, "%.2f", 2.0f);
         if (style.CurveTessellationTol < 0.10f) style.CurveTessellationTol = 0.10f;
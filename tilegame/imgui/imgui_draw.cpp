@@ -31,6 +31,15 @@ Index of this file:
 #include "imgui_internal.h"
 
 #include <stdio.h>      // vsnprintf, sscanf, printf
+#include <stdlib.h>     // malloc, free (font build worker threads)
+#ifndef IMGUI_DISABLE_FONT_BUILD_THREADS
+#include <atomic>
+#include <thread>
+#endif
+#if !defined(IMGUI_DISABLE_SSE) && !defined(IMGUI_OVERRIDE_DRAWVERT_STRUCT_LAYOUT) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>  // SSE2 tessellation, see ImDrawListFlags_VectorizedTessellation (writes pos+uv of the default ImDrawVert layout in one store)
+#define IMGUI_ENABLE_SSE_TESSELLATION
+#endif
 #if !defined(alloca)
 #if defined(__GLIBC__) || defined(__sun) || defined(__CYGWIN__)
 #include <alloca.h>     // alloca (glibc uses <alloca.h>. Note that Cygwin may have _WIN32 defined, so the order matters here)
@@ -125,8 +134,8 @@ namespace IMGUI_STB_NAMESPACE
 
 #ifndef STB_TRUETYPE_IMPLEMENTATION                         // in case the user already have an implementation in the _same_ compilation unit (e.g. unity builds)
 #ifndef IMGUI_DISABLE_STB_TRUETYPE_IMPLEMENTATION
-#define STBTT_malloc(x,u)   ((void)(u), ImGui::MemAlloc(x))
-#define STBTT_free(x,u)     ((void)(u), ImGui::MemFree(x))
+#define STBTT_malloc(x,u)   ((u) ? malloc(x) : ImGui::MemAlloc(x))    // Font infos used by font build worker threads carry a non-NULL userdata, the ImGui allocator is not thread-safe.
+#define STBTT_free(x,u)     ((u) ? free(x) : ImGui::MemFree(x))
 #define STBTT_assert(x)     IM_ASSERT(x)
 #define STBTT_fmod(x,y)     ImFmod(x,y)
 #define STBTT_sqrt(x)       ImSqrt(x)
@@ -342,7 +351,7 @@ void ImDrawList::Clear()
     CmdBuffer.resize(0);
     IdxBuffer.resize(0);
     VtxBuffer.resize(0);
-    Flags = ImDrawListFlags_AntiAliasedLines | ImDrawListFlags_AntiAliasedFill;
+    Flags = ImDrawListFlags_AntiAliasedLines | ImDrawListFlags_AntiAliasedFill | ImDrawListFlags_VectorizedTessellation;
     _VtxCurrentIdx = 0;
     _VtxWritePtr = NULL;
     _IdxWritePtr = NULL;
@@ -640,6 +649,253 @@ void ImDrawList::PrimQuadUV(const ImVec2& a, const ImVec2& b, const ImVec2& c, c
     _IdxWritePtr += 6;
 }
 
+#ifdef IMGUI_ENABLE_SSE_TESSELLATION
+// Vectorized versions of the anti-aliased paths of AddPolyline() and AddConvexPolyFilled(), 4 points per iteration.
+// Every value goes through the same IEEE operations in the same order as the scalar code (no rcp/rsqrt approximations),
+// so the vertex and index buffers are bit-identical to the scalar path. Heads and tails go through the scalar helpers below.
+
+// Scalar reference for one edge normal and one averaged point normal, as written in the scalar paths.
+static inline ImVec2 ImTessEdgeNormal(const ImVec2& p1, const ImVec2& p2)
+{
+    ImVec2 diff = p2 - p1;
+    diff *= ImInvLength(diff, 1.0f);
+    return ImVec2(diff.y, -diff.x);
+}
+
+static inline ImVec2 ImTessAverageNormal(const ImVec2& n0, const ImVec2& n1)
+{
+    ImVec2 dm = (n0 + n1) * 0.5f;
+    float dmr2 = dm.x*dm.x + dm.y*dm.y;
+    if (dmr2 > 0.000001f)
+    {
+        float scale = 1.0f / dmr2;
+        if (scale > 100.0f) scale = 100.0f;
+        dm *= scale;
+    }
+    return dm;
+}
+
+// Normals of the 'count' edges points[i] -> points[(i+1) % points_count].
+static void ImTessEdgeNormalsSSE(const ImVec2* points, int points_count, int count, ImVec2* out_normals)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    int i = 0;
+    for (; i + 4 < points_count && i + 4 <= count; i += 4)
+    {
+        const __m128 a01 = _mm_loadu_ps(&points[i].x), a23 = _mm_loadu_ps(&points[i+2].x);
+        const __m128 b01 = _mm_loadu_ps(&points[i+1].x), b23 = _mm_loadu_ps(&points[i+3].x);
+        __m128 dx = _mm_sub_ps(_mm_shuffle_ps(b01, b23, _MM_SHUFFLE(2,0,2,0)), _mm_shuffle_ps(a01, a23, _MM_SHUFFLE(2,0,2,0)));
+        __m128 dy = _mm_sub_ps(_mm_shuffle_ps(b01, b23, _MM_SHUFFLE(3,1,3,1)), _mm_shuffle_ps(a01, a23, _MM_SHUFFLE(3,1,3,1)));
+
+        // ImInvLength(diff, 1.0f)
+        const __m128 d = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+        const __m128 valid = _mm_cmpgt_ps(d, zero);
+        const __m128 inv = _mm_div_ps(one, _mm_sqrt_ps(d));
+        const __m128 inv_len = _mm_or_ps(_mm_and_ps(valid, inv), _mm_andnot_ps(valid, one));
+        dx = _mm_mul_ps(dx, inv_len);
+        dy = _mm_mul_ps(dy, inv_len);
+
+        // (dy, -dx)
+        const __m128 nx = dy;
+        const __m128 ny = _mm_xor_ps(dx, sign);
+        _mm_storeu_ps(&out_normals[i].x, _mm_unpacklo_ps(nx, ny));
+        _mm_storeu_ps(&out_normals[i+2].x, _mm_unpackhi_ps(nx, ny));
+    }
+    for (; i < count; i++)
+        out_normals[i] = ImTessEdgeNormal(points[i], points[(i+1) == points_count ? 0 : i+1]);
+}
+
+// Averaged normals of points j..j+3 from normals[j-1..j+3], returned as interleaved (x,y) pairs for points j,j+1 and j+2,j+3.
+static inline void ImTessAverageNormalsSSE(const ImVec2* normals, int j, __m128* out_dm01, __m128* out_dm23)
+{
+    const __m128 a01 = _mm_loadu_ps(&normals[j-1].x), a23 = _mm_loadu_ps(&normals[j+1].x);
+    const __m128 b01 = _mm_loadu_ps(&normals[j].x), b23 = _mm_loadu_ps(&normals[j+2].x);
+    const __m128 half = _mm_set1_ps(0.5f);
+    __m128 dmx = _mm_mul_ps(_mm_add_ps(_mm_shuffle_ps(a01, a23, _MM_SHUFFLE(2,0,2,0)), _mm_shuffle_ps(b01, b23, _MM_SHUFFLE(2,0,2,0))), half);
+    __m128 dmy = _mm_mul_ps(_mm_add_ps(_mm_shuffle_ps(a01, a23, _MM_SHUFFLE(3,1,3,1)), _mm_shuffle_ps(b01, b23, _MM_SHUFFLE(3,1,3,1))), half);
+
+    const __m128 dmr2 = _mm_add_ps(_mm_mul_ps(dmx, dmx), _mm_mul_ps(dmy, dmy));
+    const __m128 valid = _mm_cmpgt_ps(dmr2, _mm_set1_ps(0.000001f));
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_min_ps(_mm_div_ps(one, dmr2), _mm_set1_ps(100.0f));
+    const __m128 scale_or_one = _mm_or_ps(_mm_and_ps(valid, scale), _mm_andnot_ps(valid, one));
+    dmx = _mm_mul_ps(dmx, scale_or_one);
+    dmy = _mm_mul_ps(dmy, scale_or_one);
+    *out_dm01 = _mm_unpacklo_ps(dmx, dmy);
+    *out_dm23 = _mm_unpackhi_ps(dmx, dmy);
+}
+
+// Writes pos (the low or high (x,y) pair of 'pair') and uv (both halves of 'uv2') with one store, then the color.
+static inline void ImTessWriteVtxLo(ImDrawVert* vtx, __m128 pair, __m128 uv2, ImU32 col) { _mm_storeu_ps(&vtx->pos.x, _mm_movelh_ps(pair, uv2)); vtx->col = col; }
+static inline void ImTessWriteVtxHi(ImDrawVert* vtx, __m128 pair, __m128 uv2, ImU32 col) { _mm_storeu_ps(&vtx->pos.x, _mm_movehl_ps(uv2, pair)); vtx->col = col; }
+
+static void ImTessPolylineAASSE(ImDrawList* draw_list, const ImVec2* points, const int points_count, const int count, ImU32 col, ImU32 col_trans, bool closed, bool thick_line, float thickness)
+{
+    const float AA_SIZE = 1.0f;
+    const ImVec2 uv = draw_list->_Data->TexUvWhitePixel;
+    const __m128 uv2 = _mm_setr_ps(uv.x, uv.y, uv.x, uv.y);
+
+    ImVec2* temp_normals = (ImVec2*)alloca(points_count * sizeof(ImVec2));
+    ImTessEdgeNormalsSSE(points, points_count, count, temp_normals);
+    if (!closed)
+        temp_normals[points_count-1] = temp_normals[points_count-2];
+
+    // Indexes: identical to the scalar loops
+    const unsigned int vtx_stride = thick_line ? 4 : 3;
+    unsigned int idx1 = draw_list->_VtxCurrentIdx;
+    ImDrawIdx* idx_write = draw_list->_IdxWritePtr;
+    for (int i1 = 0; i1 < count; i1++)
+    {
+        unsigned int idx2 = (i1+1) == points_count ? draw_list->_VtxCurrentIdx : idx1+vtx_stride;
+        if (!thick_line)
+        {
+            idx_write[0] = (ImDrawIdx)(idx2+0); idx_write[1] = (ImDrawIdx)(idx1+0); idx_write[2] = (ImDrawIdx)(idx1+2);
+            idx_write[3] = (ImDrawIdx)(idx1+2); idx_write[4] = (ImDrawIdx)(idx2+2); idx_write[5] = (ImDrawIdx)(idx2+0);
+            idx_write[6] = (ImDrawIdx)(idx2+1); idx_write[7] = (ImDrawIdx)(idx1+1); idx_write[8] = (ImDrawIdx)(idx1+0);
+            idx_write[9] = (ImDrawIdx)(idx1+0); idx_write[10]= (ImDrawIdx)(idx2+0); idx_write[11]= (ImDrawIdx)(idx2+1);
+            idx_write += 12;
+        }
+        else
+        {
+            idx_write[0]  = (ImDrawIdx)(idx2+1); idx_write[1]  = (ImDrawIdx)(idx1+1); idx_write[2]  = (ImDrawIdx)(idx1+2);
+            idx_write[3]  = (ImDrawIdx)(idx1+2); idx_write[4]  = (ImDrawIdx)(idx2+2); idx_write[5]  = (ImDrawIdx)(idx2+1);
+            idx_write[6]  = (ImDrawIdx)(idx2+1); idx_write[7]  = (ImDrawIdx)(idx1+1); idx_write[8]  = (ImDrawIdx)(idx1+0);
+            idx_write[9]  = (ImDrawIdx)(idx1+0); idx_write[10] = (ImDrawIdx)(idx2+0); idx_write[11] = (ImDrawIdx)(idx2+1);
+            idx_write[12] = (ImDrawIdx)(idx2+2); idx_write[13] = (ImDrawIdx)(idx1+2); idx_write[14] = (ImDrawIdx)(idx1+3);
+            idx_write[15] = (ImDrawIdx)(idx1+3); idx_write[16] = (ImDrawIdx)(idx2+3); idx_write[17] = (ImDrawIdx)(idx2+2);
+            idx_write += 18;
+        }
+        idx1 = idx2;
+    }
+    draw_list->_IdxWritePtr = idx_write;
+
+    // Vertexes. Point 0 of an open line keeps its edge normal, every other point gets the average of its two edges.
+    // Thin lines scale the offset by AA_SIZE, thick lines by the inner and outer half widths.
+    const float half_inner_thickness = (thickness - AA_SIZE) * 0.5f;
+    const float scale_in = thick_line ? half_inner_thickness : AA_SIZE;
+    const float scale_out = half_inner_thickness + AA_SIZE;
+    const __m128 scale_in4 = _mm_set1_ps(scale_in);
+    const __m128 scale_out4 = _mm_set1_ps(scale_out);
+    ImDrawVert* vtx = draw_list->_VtxWritePtr;
+    int i = 0;
+    while (i < points_count)
+    {
+        if (i == 0 || i + 4 > points_count)
+        {
+            const ImVec2 dm = (i == 0 && !closed) ? temp_normals[0] : ImTessAverageNormal(temp_normals[i == 0 ? points_count-1 : i-1], temp_normals[i]);
+            const ImVec2 dm_in = dm * scale_in;
+            if (!thick_line)
+            {
+                vtx[0].pos = points[i];         vtx[0].uv = uv; vtx[0].col = col;
+                vtx[1].pos = points[i] + dm_in; vtx[1].uv = uv; vtx[1].col = col_trans;
+                vtx[2].pos = points[i] - dm_in; vtx[2].uv = uv; vtx[2].col = col_trans;
+                vtx += 3;
+            }
+            else
+            {
+                const ImVec2 dm_out = dm * scale_out;
+                vtx[0].pos = points[i] + dm_out; vtx[0].uv = uv; vtx[0].col = col_trans;
+                vtx[1].pos = points[i] + dm_in;  vtx[1].uv = uv; vtx[1].col = col;
+                vtx[2].pos = points[i] - dm_in;  vtx[2].uv = uv; vtx[2].col = col;
+                vtx[3].pos = points[i] - dm_out; vtx[3].uv = uv; vtx[3].col = col_trans;
+                vtx += 4;
+            }
+            i++;
+            continue;
+        }
+
+        __m128 dm01, dm23;
+        ImTessAverageNormalsSSE(temp_normals, i, &dm01, &dm23);
+        const __m128 p01 = _mm_loadu_ps(&points[i].x), p23 = _mm_loadu_ps(&points[i+2].x);
+        const __m128 in01 = _mm_mul_ps(dm01, scale_in4), in23 = _mm_mul_ps(dm23, scale_in4);
+        const __m128 pi01 = _mm_add_ps(p01, in01), pi23 = _mm_add_ps(p23, in23);
+        const __m128 mi01 = _mm_sub_ps(p01, in01), mi23 = _mm_sub_ps(p23, in23);
+        if (!thick_line)
+        {
+            ImTessWriteVtxLo(&vtx[0], p01, uv2, col);  ImTessWriteVtxLo(&vtx[1], pi01, uv2, col_trans);  ImTessWriteVtxLo(&vtx[2], mi01, uv2, col_trans);
+            ImTessWriteVtxHi(&vtx[3], p01, uv2, col);  ImTessWriteVtxHi(&vtx[4], pi01, uv2, col_trans);  ImTessWriteVtxHi(&vtx[5], mi01, uv2, col_trans);
+            ImTessWriteVtxLo(&vtx[6], p23, uv2, col);  ImTessWriteVtxLo(&vtx[7], pi23, uv2, col_trans);  ImTessWriteVtxLo(&vtx[8], mi23, uv2, col_trans);
+            ImTessWriteVtxHi(&vtx[9], p23, uv2, col);  ImTessWriteVtxHi(&vtx[10], pi23, uv2, col_trans); ImTessWriteVtxHi(&vtx[11], mi23, uv2, col_trans);
+            vtx += 12;
+        }
+        else
+        {
+            const __m128 out01 = _mm_mul_ps(dm01, scale_out4), out23 = _mm_mul_ps(dm23, scale_out4);
+            const __m128 po01 = _mm_add_ps(p01, out01), po23 = _mm_add_ps(p23, out23);
+            const __m128 mo01 = _mm_sub_ps(p01, out01), mo23 = _mm_sub_ps(p23, out23);
+            ImTessWriteVtxLo(&vtx[0], po01, uv2, col_trans);  ImTessWriteVtxLo(&vtx[1], pi01, uv2, col);  ImTessWriteVtxLo(&vtx[2], mi01, uv2, col);  ImTessWriteVtxLo(&vtx[3], mo01, uv2, col_trans);
+            ImTessWriteVtxHi(&vtx[4], po01, uv2, col_trans);  ImTessWriteVtxHi(&vtx[5], pi01, uv2, col);  ImTessWriteVtxHi(&vtx[6], mi01, uv2, col);  ImTessWriteVtxHi(&vtx[7], mo01, uv2, col_trans);
+            ImTessWriteVtxLo(&vtx[8], po23, uv2, col_trans);  ImTessWriteVtxLo(&vtx[9], pi23, uv2, col);  ImTessWriteVtxLo(&vtx[10], mi23, uv2, col); ImTessWriteVtxLo(&vtx[11], mo23, uv2, col_trans);
+            ImTessWriteVtxHi(&vtx[12], po23, uv2, col_trans); ImTessWriteVtxHi(&vtx[13], pi23, uv2, col); ImTessWriteVtxHi(&vtx[14], mi23, uv2, col); ImTessWriteVtxHi(&vtx[15], mo23, uv2, col_trans);
+            vtx += 16;
+        }
+        i += 4;
+    }
+    draw_list->_VtxWritePtr = vtx;
+}
+
+static void ImTessConvexPolyFilledAASSE(ImDrawList* draw_list, const ImVec2* points, const int points_count, ImU32 col, ImU32 col_trans)
+{
+    const float AA_SIZE = 1.0f;
+    const ImVec2 uv = draw_list->_Data->TexUvWhitePixel;
+    const __m128 uv2 = _mm_setr_ps(uv.x, uv.y, uv.x, uv.y);
+
+    // Indexes for fill, then for fringes: identical to the scalar loops
+    unsigned int vtx_inner_idx = draw_list->_VtxCurrentIdx;
+    unsigned int vtx_outer_idx = draw_list->_VtxCurrentIdx+1;
+    ImDrawIdx* idx_write = draw_list->_IdxWritePtr;
+    for (int i = 2; i < points_count; i++)
+    {
+        idx_write[0] = (ImDrawIdx)(vtx_inner_idx); idx_write[1] = (ImDrawIdx)(vtx_inner_idx+((i-1)<<1)); idx_write[2] = (ImDrawIdx)(vtx_inner_idx+(i<<1));
+        idx_write += 3;
+    }
+    for (int i0 = points_count-1, i1 = 0; i1 < points_count; i0 = i1++)
+    {
+        idx_write[0] = (ImDrawIdx)(vtx_inner_idx+(i1<<1)); idx_write[1] = (ImDrawIdx)(vtx_inner_idx+(i0<<1)); idx_write[2] = (ImDrawIdx)(vtx_outer_idx+(i0<<1));
+        idx_write[3] = (ImDrawIdx)(vtx_outer_idx+(i0<<1)); idx_write[4] = (ImDrawIdx)(vtx_outer_idx+(i1<<1)); idx_write[5] = (ImDrawIdx)(vtx_inner_idx+(i1<<1));
+        idx_write += 6;
+    }
+    draw_list->_IdxWritePtr = idx_write;
+
+    ImVec2* temp_normals = (ImVec2*)alloca(points_count * sizeof(ImVec2));
+    ImTessEdgeNormalsSSE(points, points_count, points_count, temp_normals);
+
+    const float fringe_scale = AA_SIZE * 0.5f;
+    const __m128 fringe_scale4 = _mm_set1_ps(fringe_scale);
+    ImDrawVert* vtx = draw_list->_VtxWritePtr;
+    int i = 0;
+    while (i < points_count)
+    {
+        if (i == 0 || i + 4 > points_count)
+        {
+            const ImVec2 dm = ImTessAverageNormal(temp_normals[i == 0 ? points_count-1 : i-1], temp_normals[i]) * fringe_scale;
+            vtx[0].pos = (points[i] - dm); vtx[0].uv = uv; vtx[0].col = col;        // Inner
+            vtx[1].pos = (points[i] + dm); vtx[1].uv = uv; vtx[1].col = col_trans;  // Outer
+            vtx += 2;
+            i++;
+            continue;
+        }
+
+        __m128 dm01, dm23;
+        ImTessAverageNormalsSSE(temp_normals, i, &dm01, &dm23);
+        dm01 = _mm_mul_ps(dm01, fringe_scale4);
+        dm23 = _mm_mul_ps(dm23, fringe_scale4);
+        const __m128 p01 = _mm_loadu_ps(&points[i].x), p23 = _mm_loadu_ps(&points[i+2].x);
+        const __m128 inner01 = _mm_sub_ps(p01, dm01), inner23 = _mm_sub_ps(p23, dm23);
+        const __m128 outer01 = _mm_add_ps(p01, dm01), outer23 = _mm_add_ps(p23, dm23);
+        ImTessWriteVtxLo(&vtx[0], inner01, uv2, col); ImTessWriteVtxLo(&vtx[1], outer01, uv2, col_trans);
+        ImTessWriteVtxHi(&vtx[2], inner01, uv2, col); ImTessWriteVtxHi(&vtx[3], outer01, uv2, col_trans);
+        ImTessWriteVtxLo(&vtx[4], inner23, uv2, col); ImTessWriteVtxLo(&vtx[5], outer23, uv2, col_trans);
+        ImTessWriteVtxHi(&vtx[6], inner23, uv2, col); ImTessWriteVtxHi(&vtx[7], outer23, uv2, col_trans);
+        vtx += 8;
+        i += 4;
+    }
+    draw_list->_VtxWritePtr = vtx;
+}
+#endif // IMGUI_ENABLE_SSE_TESSELLATION
+
 // TODO: Thickness anti-aliased lines cap are missing their AA fringe.
 void ImDrawList::AddPolyline(const ImVec2* points, const int points_count, ImU32 col, bool closed, float thickness)
 {
@@ -663,6 +919,15 @@ void ImDrawList::AddPolyline(const ImVec2* points, const int points_count, ImU32
         const int vtx_count = thick_line ? points_count*4 : points_count*3;
         PrimReserve(idx_count, vtx_count);
 
+#ifdef IMGUI_ENABLE_SSE_TESSELLATION
+        if (Flags & ImDrawListFlags_VectorizedTessellation)
+        {
+            ImTessPolylineAASSE(this, points, points_count, count, col, col_trans, closed, thick_line, thickness);
+            _VtxCurrentIdx += (ImDrawIdx)vtx_count;
+            return;
+        }
+#endif
+
         // Temporary buffer
         ImVec2* temp_normals = (ImVec2*)alloca(points_count * (thick_line ? 5 : 3) * sizeof(ImVec2));
         ImVec2* temp_points = temp_normals + points_count;
@@ -836,6 +1101,15 @@ void ImDrawList::AddConvexPolyFilled(const ImVec2* points, const int points_coun
         const int vtx_count = (points_count*2);
         PrimReserve(idx_count, vtx_count);
 
+#ifdef IMGUI_ENABLE_SSE_TESSELLATION
+        if (Flags & ImDrawListFlags_VectorizedTessellation)
+        {
+            ImTessConvexPolyFilledAASSE(this, points, points_count, col, col_trans);
+            _VtxCurrentIdx += (ImDrawIdx)vtx_count;
+            return;
+        }
+#endif
+
         // Add indexes for fill
         unsigned int vtx_inner_idx = _VtxCurrentIdx;
         unsigned int vtx_outer_idx = _VtxCurrentIdx+1;
@@ -1398,6 +1672,7 @@ ImFontAtlas::ImFontAtlas()
     TexID = NULL;
     TexDesiredWidth = 0;
     TexGlyphPadding = 1;
+    TexBuildThreads = 0;
 
     TexPixelsAlpha8 = NULL;
     TexPixelsRGBA32 = NULL;
@@ -1406,6 +1681,8 @@ ImFontAtlas::ImFontAtlas()
     TexUvWhitePixel = ImVec2(0.0f, 0.0f);
     for (int n = 0; n < IM_ARRAYSIZE(CustomRectIds); n++)
         CustomRectIds[n] = -1;
+    TexDirtyRect = ImVec4(0.0f, 0.0f, 0.0f, 0.0f);
+    LazyBuildData = NULL;
 }
 
 ImFontAtlas::~ImFontAtlas()
@@ -1414,9 +1691,12 @@ ImFontAtlas::~ImFontAtlas()
     Clear();
 }
 
+static void ImFontAtlasBuildLazyDestroy(ImFontAtlas* atlas);
+
 void    ImFontAtlas::ClearInputData()
 {
     IM_ASSERT(!Locked && "Cannot modify a locked ImFontAtlas between NewFrame() and EndFrame/Render()!");
+    ImFontAtlasBuildLazyDestroy(this);
     for (int i = 0; i < ConfigData.Size; i++)
         if (ConfigData[i].FontData && ConfigData[i].FontDataOwnedByAtlas)
         {
@@ -1440,6 +1720,8 @@ void    ImFontAtlas::ClearInputData()
 void    ImFontAtlas::ClearTexData()
 {
     IM_ASSERT(!Locked && "Cannot modify a locked ImFontAtlas between NewFrame() and EndFrame/Render()!");
+    ImFontAtlasBuildLazyDestroy(this);
+    TexDirtyRect = ImVec4(0.0f, 0.0f, 0.0f, 0.0f);
     if (TexPixelsAlpha8)
         ImGui::MemFree(TexPixelsAlpha8);
     if (TexPixelsRGBA32)
@@ -1451,6 +1733,7 @@ void    ImFontAtlas::ClearTexData()
 void    ImFontAtlas::ClearFonts()
 {
     IM_ASSERT(!Locked && "Cannot modify a locked ImFontAtlas between NewFrame() and EndFrame/Render()!");
+    ImFontAtlasBuildLazyDestroy(this);
     for (int i = 0; i < Fonts.Size; i++)
         IM_DELETE(Fonts[i]);
     Fonts.clear();
@@ -1705,6 +1988,128 @@ void    ImFontAtlasBuildMultiplyRectAlpha8(const unsigned char table[256], unsig
             data[i] = table[data[i]];
 }
 
+// Build() splits the requested glyph ranges into stbtt_pack_range chunks of at most IM_FONT_BUILD_TASK_GLYPHS glyphs.
+// Each chunk is one task, measured and then rasterized on any thread, so a single large CJK range still spreads over all workers.
+// Packing stays on the calling thread in the original order, the atlas is identical whatever the thread count.
+#define IM_FONT_BUILD_TASK_GLYPHS   256
+#define IM_FONT_BUILD_MAX_THREADS   16
+// Last code point rasterized by Build() with ImFontAtlasFlags_LazyGlyphs (Basic Latin + Latin-1 Supplement)
+#define IM_FONT_LAZY_PRELOAD_LAST   0x00FF
+#define IM_FONT_LAZY_TEX_WIDTH      1024
+
+struct ImFontBuildTask
+{
+    stbtt_pack_context  Spc;            // Copy with the oversampling of the source font
+    const ImFontConfig* Cfg;
+    stbtt_fontinfo      FontInfo;       // Copy, userdata is non-NULL on worker threads (see STBTT_malloc)
+    stbtt_pack_range*   Range;
+    stbrp_rect*         Rects;
+};
+
+struct ImFontAtlasLazyData
+{
+    stbtt_pack_context  Spc;            // Left open after Build(): its skyline packer places the lazily rasterized glyphs
+    stbtt_fontinfo*     FontInfos;      // One per atlas->ConfigData entry
+};
+
+typedef void (*ImFontBuildTaskFunc)(ImFontBuildTask* task);
+
+static int ImFontAtlasBuildWorkerTag = 0;
+
+static void ImFontAtlasBuildGatherTask(ImFontBuildTask* task)
+{
+    stbtt_pack_range& range = *task->Range;
+    stbtt_PackFontRangesGatherRects(&task->Spc, &task->FontInfo, &range, 1, task->Rects);
+
+    // Detect missing glyphs and replace them with a zero-sized box instead of relying on the default glyphs
+    // This allows us merging overlapping icon fonts more easily.
+    for (int char_i = 0; char_i < range.num_chars; char_i++)
+        if (stbtt_FindGlyphIndex(&task->FontInfo, range.first_unicode_codepoint_in_range + char_i) == 0)
+            task->Rects[char_i].w = task->Rects[char_i].h = 0;
+}
+
+static void ImFontAtlasBuildRenderTask(ImFontBuildTask* task)
+{
+    stbtt_PackFontRangesRenderIntoRects(&task->Spc, &task->FontInfo, task->Range, 1, task->Rects);
+    if (task->Cfg->RasterizerMultiply != 1.0f)
+    {
+        unsigned char multiply_table[256];
+        ImFontAtlasBuildMultiplyCalcLookupTable(multiply_table, task->Cfg->RasterizerMultiply);
+        for (const stbrp_rect* r = task->Rects; r != task->Rects + task->Range->num_chars; r++)
+            if (r->was_packed)
+                ImFontAtlasBuildMultiplyRectAlpha8(multiply_table, task->Spc.pixels, r->x, r->y, r->w, r->h, task->Spc.stride_in_bytes);
+    }
+}
+
+#ifndef IMGUI_DISABLE_FONT_BUILD_THREADS
+static void ImFontAtlasBuildWorkerLoop(ImFontBuildTask* tasks, int tasks_count, std::atomic<int>* next_task, ImFontBuildTaskFunc func, bool worker)
+{
+    for (int i = (*next_task)++; i < tasks_count; i = (*next_task)++)
+    {
+        ImFontBuildTask* task = &tasks[i];
+        task->FontInfo.userdata = worker ? &ImFontAtlasBuildWorkerTag : NULL;
+        func(task);
+    }
+}
+#endif
+
+static void ImFontAtlasBuildRunTasks(ImFontAtlas* atlas, ImFontBuildTask* tasks, int tasks_count, ImFontBuildTaskFunc func)
+{
+#ifndef IMGUI_DISABLE_FONT_BUILD_THREADS
+    int threads_count = atlas->TexBuildThreads > 0 ? atlas->TexBuildThreads : (int)std::thread::hardware_concurrency();
+    threads_count = ImMin(ImMin(threads_count, tasks_count), IM_FONT_BUILD_MAX_THREADS);
+    if (threads_count > 1)
+    {
+        // The calling thread takes tasks too, with the regular allocator
+        std::atomic<int> next_task(0);
+        std::thread workers[IM_FONT_BUILD_MAX_THREADS];
+        for (int n = 1; n < threads_count; n++)
+            workers[n] = std::thread(ImFontAtlasBuildWorkerLoop, tasks, tasks_count, &next_task, func, true);
+        ImFontAtlasBuildWorkerLoop(tasks, tasks_count, &next_task, func, false);
+        for (int n = 1; n < threads_count; n++)
+            workers[n].join();
+        return;
+    }
+#else
+    (void)atlas;
+#endif
+    for (int i = 0; i < tasks_count; i++)
+    {
+        tasks[i].FontInfo.userdata = NULL;
+        func(&tasks[i]);
+    }
+}
+
+// Clips an input glyph range to what Build() rasterizes. Returns false when nothing is left.
+static bool ImFontAtlasBuildClipRange(const ImFontAtlas* atlas, const ImWchar* in_range, int* out_first, int* out_last)
+{
+    *out_first = in_range[0];
+    *out_last = in_range[1];
+    if (atlas->Flags & ImFontAtlasFlags_LazyGlyphs)
+        *out_last = ImMin(*out_last, IM_FONT_LAZY_PRELOAD_LAST);
+    return *out_first <= *out_last;
+}
+
+// Adds one packed glyph of 'range' to 'dst_font', with the font offsets, advance clamping and UVs of the source config
+static void ImFontAtlasBuildAddPackedGlyph(ImFontAtlas* atlas, ImFont* dst_font, const ImFontConfig& cfg, stbtt_pack_range& range, int char_idx)
+{
+    const float font_off_x = cfg.GlyphOffset.x;
+    const float font_off_y = cfg.GlyphOffset.y + (float)(int)(dst_font->Ascent + 0.5f);
+    const stbtt_packedchar& pc = range.chardata_for_range[char_idx];
+    const int codepoint = range.first_unicode_codepoint_in_range + char_idx;
+
+    float char_advance_x_org = pc.xadvance;
+    float char_advance_x_mod = ImClamp(char_advance_x_org, cfg.GlyphMinAdvanceX, cfg.GlyphMaxAdvanceX);
+    float char_off_x = font_off_x;
+    if (char_advance_x_org != char_advance_x_mod)
+        char_off_x += cfg.PixelSnapH ? (float)(int)((char_advance_x_mod - char_advance_x_org) * 0.5f) : (char_advance_x_mod - char_advance_x_org) * 0.5f;
+
+    stbtt_aligned_quad q;
+    float dummy_x = 0.0f, dummy_y = 0.0f;
+    stbtt_GetPackedQuad(range.chardata_for_range, atlas->TexWidth, atlas->TexHeight, char_idx, &dummy_x, &dummy_y, &q, 0);
+    dst_font->AddGlyph((ImWchar)codepoint, q.x0 + char_off_x, q.y0 + font_off_y, q.x1 + char_off_x, q.y1 + font_off_y, q.s0, q.t0, q.s1, q.t1, char_advance_x_mod);
+}
+
 bool    ImFontAtlasBuildWithStbTruetype(ImFontAtlas* atlas)
 {
     IM_ASSERT(atlas->ConfigData.Size > 0);
@@ -1716,8 +2121,9 @@ bool    ImFontAtlasBuildWithStbTruetype(ImFontAtlas* atlas)
     atlas->TexUvScale = ImVec2(0.0f, 0.0f);
     atlas->TexUvWhitePixel = ImVec2(0.0f, 0.0f);
     atlas->ClearTexData();
+    const bool lazy = (atlas->Flags & ImFontAtlasFlags_LazyGlyphs) != 0;
 
-    // Count glyphs/ranges
+    // Count glyphs/ranges (after lazy clipping and splitting in tasks)
     int total_glyphs_count = 0;
     int total_ranges_count = 0;
     for (int input_i = 0; input_i < atlas->ConfigData.Size; input_i++)
@@ -1725,13 +2131,23 @@ bool    ImFontAtlasBuildWithStbTruetype(ImFontAtlas* atlas)
         ImFontConfig& cfg = atlas->ConfigData[input_i];
         if (!cfg.GlyphRanges)
             cfg.GlyphRanges = atlas->GetGlyphRangesDefault();
-        for (const ImWchar* in_range = cfg.GlyphRanges; in_range[0] && in_range[1]; in_range += 2, total_ranges_count++)
-            total_glyphs_count += (in_range[1] - in_range[0]) + 1;
+        for (const ImWchar* in_range = cfg.GlyphRanges; in_range[0] && in_range[1]; in_range += 2)
+        {
+            int first, last;
+            if (!ImFontAtlasBuildClipRange(atlas, in_range, &first, &last))
+                continue;
+            total_glyphs_count += (last - first) + 1;
+            total_ranges_count += (last - first + IM_FONT_BUILD_TASK_GLYPHS) / IM_FONT_BUILD_TASK_GLYPHS;
+        }
     }
 
     // We need a width for the skyline algorithm. Using a dumb heuristic here to decide of width. User can override TexDesiredWidth and TexGlyphPadding if they wish.
     // Width doesn't really matter much, but some API/GPU have texture size limitations and increasing width can decrease height.
-    atlas->TexWidth = (atlas->TexDesiredWidth > 0) ? atlas->TexDesiredWidth : (total_glyphs_count > 4000) ? 4096 : (total_glyphs_count > 2000) ? 2048 : (total_glyphs_count > 1000) ? 1024 : 512;
+    // In lazy mode the texture is allocated once, wide enough for the glyphs rasterized later.
+    if (lazy)
+        atlas->TexWidth = (atlas->TexDesiredWidth > 0) ? atlas->TexDesiredWidth : IM_FONT_LAZY_TEX_WIDTH;
+    else
+        atlas->TexWidth = (atlas->TexDesiredWidth > 0) ? atlas->TexDesiredWidth : (total_glyphs_count > 4000) ? 4096 : (total_glyphs_count > 2000) ? 2048 : (total_glyphs_count > 1000) ? 1024 : 512;
     atlas->TexHeight = 0;
 
     // Start packing
@@ -1766,8 +2182,10 @@ bool    ImFontAtlasBuildWithStbTruetype(ImFontAtlas* atlas)
         {
             atlas->TexWidth = atlas->TexHeight = 0; // Reset output on failure
             ImGui::MemFree(tmp_array);
+            stbtt_PackEnd(&spc);
             return false;
         }
+        tmp.FontInfo.userdata = NULL; // stbtt_InitFont() leaves it uninitialized, see STBTT_malloc
     }
 
     // Allocate packing character data and flag packed characters buffer as non-packed (x0=y0=x1=y1=0)
@@ -1775,52 +2193,61 @@ bool    ImFontAtlasBuildWithStbTruetype(ImFontAtlas* atlas)
     stbtt_packedchar* buf_packedchars = (stbtt_packedchar*)ImGui::MemAlloc(total_glyphs_count * sizeof(stbtt_packedchar));
     stbrp_rect* buf_rects = (stbrp_rect*)ImGui::MemAlloc(total_glyphs_count * sizeof(stbrp_rect));
     stbtt_pack_range* buf_ranges = (stbtt_pack_range*)ImGui::MemAlloc(total_ranges_count * sizeof(stbtt_pack_range));
+    ImFontBuildTask* tasks = (ImFontBuildTask*)ImGui::MemAlloc(total_ranges_count * sizeof(ImFontBuildTask));
     memset(buf_packedchars, 0, total_glyphs_count * sizeof(stbtt_packedchar));
     memset(buf_rects, 0, total_glyphs_count * sizeof(stbrp_rect));              // Unnecessary but let's clear this for the sake of sanity.
     memset(buf_ranges, 0, total_ranges_count * sizeof(stbtt_pack_range));
 
-    // First font pass: pack all glyphs (no rendering at this point, we are working with rectangles in an infinitely tall texture at this point)
+    // Setup ranges and one task per range
     for (int input_i = 0; input_i < atlas->ConfigData.Size; input_i++)
     {
         ImFontConfig& cfg = atlas->ConfigData[input_i];
         ImFontTempBuildData& tmp = tmp_array[input_i];
+        stbtt_PackSetOversampling(&spc, cfg.OversampleH, cfg.OversampleV);
 
-        // Setup ranges
-        int font_glyphs_count = 0;
-        int font_ranges_count = 0;
-        for (const ImWchar* in_range = cfg.GlyphRanges; in_range[0] && in_range[1]; in_range += 2, font_ranges_count++)
-            font_glyphs_count += (in_range[1] - in_range[0]) + 1;
         tmp.Ranges = buf_ranges + buf_ranges_n;
-        tmp.RangesCount = font_ranges_count;
-        buf_ranges_n += font_ranges_count;
-        for (int i = 0; i < font_ranges_count; i++)
+        tmp.Rects = buf_rects + buf_rects_n;
+        tmp.RangesCount = tmp.RectsCount = 0;
+        for (const ImWchar* in_range = cfg.GlyphRanges; in_range[0] && in_range[1]; in_range += 2)
         {
-            const ImWchar* in_range = &cfg.GlyphRanges[i * 2];
-            stbtt_pack_range& range = tmp.Ranges[i];
-            range.font_size = cfg.SizePixels;
-            range.first_unicode_codepoint_in_range = in_range[0];
-            range.num_chars = (in_range[1] - in_range[0]) + 1;
-            range.chardata_for_range = buf_packedchars + buf_packedchars_n;
-            buf_packedchars_n += range.num_chars;
+            int first, last;
+            if (!ImFontAtlasBuildClipRange(atlas, in_range, &first, &last))
+                continue;
+            for (int chunk_first = first; chunk_first <= last; chunk_first += IM_FONT_BUILD_TASK_GLYPHS)
+            {
+                stbtt_pack_range& range = buf_ranges[buf_ranges_n];
+                range.font_size = cfg.SizePixels;
+                range.first_unicode_codepoint_in_range = chunk_first;
+                range.num_chars = ImMin(last - chunk_first + 1, IM_FONT_BUILD_TASK_GLYPHS);
+                range.chardata_for_range = buf_packedchars + buf_packedchars_n;
+
+                ImFontBuildTask& task = tasks[buf_ranges_n];
+                task.Spc = spc;
+                task.Cfg = &cfg;
+                task.FontInfo = tmp.FontInfo;
+                task.Range = &range;
+                task.Rects = buf_rects + buf_rects_n;
+
+                buf_packedchars_n += range.num_chars;
+                buf_rects_n += range.num_chars;
+                buf_ranges_n++;
+                tmp.RangesCount++;
+                tmp.RectsCount += range.num_chars;
+            }
         }
+    }
+    IM_ASSERT(buf_rects_n == total_glyphs_count);
+    IM_ASSERT(buf_packedchars_n == total_glyphs_count);
+    IM_ASSERT(buf_ranges_n == total_ranges_count);
 
-        // Gather the sizes of all rectangle we need
-        tmp.Rects = buf_rects + buf_rects_n;
-        tmp.RectsCount = font_glyphs_count;
-        buf_rects_n += font_glyphs_count;
-        stbtt_PackSetOversampling(&spc, cfg.OversampleH, cfg.OversampleV);
-        int n = stbtt_PackFontRangesGatherRects(&spc, &tmp.FontInfo, tmp.Ranges, tmp.RangesCount, tmp.Rects);
-        IM_ASSERT(n == font_glyphs_count);
-
-        // Detect missing glyphs and replace them with a zero-sized box instead of relying on the default glyphs
-        // This allows us merging overlapping icon fonts more easily.
-        int rect_i = 0;
-        for (int range_i = 0; range_i < tmp.RangesCount; range_i++)
-            for (int char_i = 0; char_i < tmp.Ranges[range_i].num_chars; char_i++, rect_i++)
-                if (stbtt_FindGlyphIndex(&tmp.FontInfo, tmp.Ranges[range_i].first_unicode_codepoint_in_range + char_i) == 0)
-                    tmp.Rects[rect_i].w = tmp.Rects[rect_i].h = 0;
-
-        // Pack
+    // First font pass: gather the sizes of all glyphs, on all threads
+    ImFontAtlasBuildRunTasks(atlas, tasks, total_ranges_count, ImFontAtlasBuildGatherTask);
+
+    // Pack all glyphs (no rendering at this point, we are working with rectangles in an infinitely tall texture at this point)
+    for (int input_i = 0; input_i < atlas->ConfigData.Size; input_i++)
+    {
+        ImFontTempBuildData& tmp = tmp_array[input_i];
+        const int n = tmp.RectsCount;
         stbrp_pack_rects((stbrp_context*)spc.pack_info, tmp.Rects, n);
 
         // Extend texture height
@@ -1833,38 +2260,43 @@ bool    ImFontAtlasBuildWithStbTruetype(ImFontAtlas* atlas)
                 atlas->TexHeight = ImMax(atlas->TexHeight, tmp.Rects[i].y + tmp.Rects[i].h);
         }
     }
-    IM_ASSERT(buf_rects_n == total_glyphs_count);
-    IM_ASSERT(buf_packedchars_n == total_glyphs_count);
-    IM_ASSERT(buf_ranges_n == total_ranges_count);
 
     // Create texture
     atlas->TexHeight = (atlas->Flags & ImFontAtlasFlags_NoPowerOfTwoHeight) ? (atlas->TexHeight + 1) : ImUpperPowerOfTwo(atlas->TexHeight);
+    if (lazy)
+        atlas->TexHeight = ImMax(atlas->TexHeight, atlas->TexWidth);
     atlas->TexUvScale = ImVec2(1.0f / atlas->TexWidth, 1.0f / atlas->TexHeight);
     atlas->TexPixelsAlpha8 = (unsigned char*)ImGui::MemAlloc(atlas->TexWidth * atlas->TexHeight);
     memset(atlas->TexPixelsAlpha8, 0, atlas->TexWidth * atlas->TexHeight);
     spc.pixels = atlas->TexPixelsAlpha8;
     spc.height = atlas->TexHeight;
 
-    // Second pass: render font characters
-    for (int input_i = 0; input_i < atlas->ConfigData.Size; input_i++)
+    // Second pass: render font characters, on all threads (each task writes its own rectangles)
+    for (int task_i = 0; task_i < total_ranges_count; task_i++)
     {
-        ImFontConfig& cfg = atlas->ConfigData[input_i];
-        ImFontTempBuildData& tmp = tmp_array[input_i];
-        stbtt_PackSetOversampling(&spc, cfg.OversampleH, cfg.OversampleV);
-        stbtt_PackFontRangesRenderIntoRects(&spc, &tmp.FontInfo, tmp.Ranges, tmp.RangesCount, tmp.Rects);
-        if (cfg.RasterizerMultiply != 1.0f)
-        {
-            unsigned char multiply_table[256];
-            ImFontAtlasBuildMultiplyCalcLookupTable(multiply_table, cfg.RasterizerMultiply);
-            for (const stbrp_rect* r = tmp.Rects; r != tmp.Rects + tmp.RectsCount; r++)
-                if (r->was_packed)
-                    ImFontAtlasBuildMultiplyRectAlpha8(multiply_table, spc.pixels, r->x, r->y, r->w, r->h, spc.stride_in_bytes);
-        }
-        tmp.Rects = NULL;
+        tasks[task_i].Spc.pixels = spc.pixels;
+        tasks[task_i].Spc.height = spc.height;
     }
+    ImFontAtlasBuildRunTasks(atlas, tasks, total_ranges_count, ImFontAtlasBuildRenderTask);
+    for (int input_i = 0; input_i < atlas->ConfigData.Size; input_i++)
+        tmp_array[input_i].Rects = NULL;
 
-    // End packing
-    stbtt_PackEnd(&spc);
+    // End packing. In lazy mode the packer stays open, bounded by the texture we just allocated.
+    if (lazy)
+    {
+        ((stbrp_context*)spc.pack_info)->height = atlas->TexHeight;
+        ImFontAtlasLazyData* lazy_data = (ImFontAtlasLazyData*)ImGui::MemAlloc(sizeof(ImFontAtlasLazyData));
+        lazy_data->Spc = spc;
+        lazy_data->FontInfos = (stbtt_fontinfo*)ImGui::MemAlloc((size_t)atlas->ConfigData.Size * sizeof(stbtt_fontinfo));
+        for (int input_i = 0; input_i < atlas->ConfigData.Size; input_i++)
+            lazy_data->FontInfos[input_i] = tmp_array[input_i].FontInfo;
+        atlas->LazyBuildData = lazy_data;
+    }
+    else
+    {
+        stbtt_PackEnd(&spc);
+    }
+    ImGui::MemFree(tasks);
     ImGui::MemFree(buf_rects);
     buf_rects = NULL;
 
@@ -1884,8 +2316,6 @@ bool    ImFontAtlasBuildWithStbTruetype(ImFontAtlas* atlas)
         const float ascent = ImFloor(unscaled_ascent * font_scale + ((unscaled_ascent > 0.0f) ? +1 : -1));
         const float descent = ImFloor(unscaled_descent * font_scale + ((unscaled_descent > 0.0f) ? +1 : -1));
         ImFontAtlasBuildSetupFont(atlas, dst_font, &cfg, ascent, descent);
-        const float font_off_x = cfg.GlyphOffset.x;
-        const float font_off_y = cfg.GlyphOffset.y + (float)(int)(dst_font->Ascent + 0.5f);
 
         for (int i = 0; i < tmp.RangesCount; i++)
         {
@@ -1900,16 +2330,7 @@ bool    ImFontAtlasBuildWithStbTruetype(ImFontAtlas* atlas)
                 if (cfg.MergeMode && dst_font->FindGlyphNoFallback((ImWchar)codepoint))
                     continue;
 
-                float char_advance_x_org = pc.xadvance;
-                float char_advance_x_mod = ImClamp(char_advance_x_org, cfg.GlyphMinAdvanceX, cfg.GlyphMaxAdvanceX);
-                float char_off_x = font_off_x;
-                if (char_advance_x_org != char_advance_x_mod)
-                    char_off_x += cfg.PixelSnapH ? (float)(int)((char_advance_x_mod - char_advance_x_org) * 0.5f) : (char_advance_x_mod - char_advance_x_org) * 0.5f;
-
-                stbtt_aligned_quad q;
-                float dummy_x = 0.0f, dummy_y = 0.0f;
-                stbtt_GetPackedQuad(range.chardata_for_range, atlas->TexWidth, atlas->TexHeight, char_idx, &dummy_x, &dummy_y, &q, 0);
-                dst_font->AddGlyph((ImWchar)codepoint, q.x0 + char_off_x, q.y0 + font_off_y, q.x1 + char_off_x, q.y1 + font_off_y, q.s0, q.t0, q.s1, q.t1, char_advance_x_mod);
+                ImFontAtlasBuildAddPackedGlyph(atlas, dst_font, cfg, range, char_idx);
             }
         }
     }
@@ -1924,6 +2345,141 @@ bool    ImFontAtlasBuildWithStbTruetype(ImFontAtlas* atlas)
     return true;
 }
 
+//-----------------------------------------------------------------------------
+// Lazy glyphs (ImFontAtlasFlags_LazyGlyphs)
+//-----------------------------------------------------------------------------
+
+static void ImFontAtlasBuildLazyDestroy(ImFontAtlas* atlas)
+{
+    ImFontAtlasLazyData* lazy_data = (ImFontAtlasLazyData*)atlas->LazyBuildData;
+    if (!lazy_data)
+        return;
+    stbtt_PackEnd(&lazy_data->Spc);
+    ImGui::MemFree(lazy_data->FontInfos);
+    ImGui::MemFree(lazy_data);
+    atlas->LazyBuildData = NULL;
+}
+
+// True when 'c' is requested by 'cfg' but was left out of Build()
+static bool ImFontAtlasBuildIsLazyCodepoint(const ImFontConfig& cfg, int c)
+{
+    if (c <= IM_FONT_LAZY_PRELOAD_LAST)
+        return false;
+    for (const ImWchar* in_range = cfg.GlyphRanges; in_range[0] && in_range[1]; in_range += 2)
+        if (c >= in_range[0] && c <= in_range[1])
+            return true;
+    return false;
+}
+
+// Fills IndexAdvanceX for the lazy code points of 'font' that have a glyph in one of its sources, so text layout
+// (CalcTextSize) is correct before the glyphs are rasterized. Same arithmetic as stb_truetype + AddGlyph().
+static void ImFontAtlasBuildLazyAdvanceX(ImFontAtlas* atlas, ImFont* font)
+{
+    ImFontAtlasLazyData* lazy_data = (ImFontAtlasLazyData*)atlas->LazyBuildData;
+    for (int input_i = 0; input_i < atlas->ConfigData.Size; input_i++)
+    {
+        const ImFontConfig& cfg = atlas->ConfigData[input_i];
+        if (cfg.DstFont != font || !cfg.GlyphRanges)
+            continue;
+        const stbtt_fontinfo* info = &lazy_data->FontInfos[input_i];
+        const float scale = stbtt_ScaleForPixelHeight(info, cfg.SizePixels);
+        for (const ImWchar* in_range = cfg.GlyphRanges; in_range[0] && in_range[1]; in_range += 2)
+        {
+            if (in_range[1] <= IM_FONT_LAZY_PRELOAD_LAST)
+                continue;
+            font->GrowIndex(in_range[1] + 1);
+            for (int c = ImMax((int)in_range[0], IM_FONT_LAZY_PRELOAD_LAST + 1); c <= in_range[1]; c++)
+            {
+                if (font->IndexLookup[c] != (ImWchar)-1 || font->IndexAdvanceX[c] >= 0.0f)
+                    continue;
+                const int glyph = stbtt_FindGlyphIndex(info, c);
+                if (glyph == 0)
+                    continue;
+                int advance, lsb;
+                stbtt_GetGlyphHMetrics(info, glyph, &advance, &lsb);
+                const float advance_x = ImClamp(scale * advance, cfg.GlyphMinAdvanceX, cfg.GlyphMaxAdvanceX) + font->ConfigData->GlyphExtraSpacing.x;
+                font->IndexAdvanceX[c] = font->ConfigData->PixelSnapH ? (float)(int)(advance_x + 0.5f) : advance_x;
+            }
+        }
+    }
+}
+
+// Copies an area of the alpha atlas to the RGBA32 copy (if any) and grows TexDirtyRect over it
+static void ImFontAtlasBuildMarkDirty(ImFontAtlas* atlas, int x, int y, int w, int h)
+{
+    if (atlas->TexPixelsRGBA32)
+        for (int py = y; py < y + h; py++)
+        {
+            const unsigned char* src = atlas->TexPixelsAlpha8 + py * atlas->TexWidth + x;
+            unsigned int* dst = atlas->TexPixelsRGBA32 + py * atlas->TexWidth + x;
+            for (int px = 0; px < w; px++)
+                dst[px] = IM_COL32(255, 255, 255, (unsigned int)src[px]);
+        }
+
+    ImVec4& r = atlas->TexDirtyRect;
+    if (r.z <= r.x)
+        r = ImVec4((float)x, (float)y, (float)(x + w), (float)(y + h));
+    else
+        r = ImVec4(ImMin(r.x, (float)x), ImMin(r.y, (float)y), ImMax(r.z, (float)(x + w)), ImMax(r.w, (float)(y + h)));
+}
+
+// Rasterizes 'c' from the first source of 'font' that has it, into free atlas space. Called by ImFont::FindGlyph() on a miss.
+// Returns the fallback glyph when no source has 'c' or the atlas is full, and remembers that in IndexLookup.
+static const ImFontGlyph* ImFontAtlasBuildLazyGlyph(ImFontAtlas* atlas, ImFont* font, ImWchar c)
+{
+    ImFontAtlasLazyData* lazy_data = (ImFontAtlasLazyData*)atlas->LazyBuildData;
+    bool added = false;
+    for (int input_i = 0; input_i < atlas->ConfigData.Size && !added; input_i++)
+    {
+        const ImFontConfig& cfg = atlas->ConfigData[input_i];
+        if (cfg.DstFont != font || !ImFontAtlasBuildIsLazyCodepoint(cfg, c))
+            continue;
+        stbtt_fontinfo* info = &lazy_data->FontInfos[input_i];
+        if (stbtt_FindGlyphIndex(info, c) == 0)
+            continue;
+
+        stbtt_packedchar packed_char = {};
+        stbtt_pack_range range = {};
+        range.font_size = cfg.SizePixels;
+        range.first_unicode_codepoint_in_range = c;
+        range.num_chars = 1;
+        range.chardata_for_range = &packed_char;
+
+        ImFontBuildTask task;
+        task.Spc = lazy_data->Spc;
+        stbtt_PackSetOversampling(&task.Spc, cfg.OversampleH, cfg.OversampleV);
+        task.Cfg = &cfg;
+        task.FontInfo = *info;
+        task.Range = &range;
+        stbrp_rect rect = {};
+        task.Rects = &rect;
+        ImFontAtlasBuildGatherTask(&task);
+        stbrp_pack_rects((stbrp_context*)task.Spc.pack_info, &rect, 1);
+        if (!rect.was_packed)
+            break;
+        const int rect_x = rect.x, rect_y = rect.y, rect_w = rect.w, rect_h = rect.h;
+        ImFontAtlasBuildRenderTask(&task);
+        ImFontAtlasBuildMarkDirty(atlas, rect_x, rect_y, rect_w, rect_h);
+
+        ImFontAtlasBuildAddPackedGlyph(atlas, font, cfg, range, 0);
+        added = true;
+    }
+
+    font->GrowIndex(c + 1);
+    if (added)
+    {
+        IM_ASSERT(font->Glyphs.Size < 0xFFFF); // -1 is reserved
+        font->IndexLookup[c] = (ImWchar)(font->Glyphs.Size - 1);
+        font->IndexAdvanceX[c] = font->Glyphs.back().AdvanceX;
+        font->FallbackGlyph = font->FindGlyphNoFallback(font->FallbackChar); // Glyphs may have been reallocated
+        return &font->Glyphs.back();
+    }
+    if (font->FallbackGlyph)
+        font->IndexLookup[c] = (ImWchar)(font->FallbackGlyph - font->Glyphs.Data);
+    font->IndexAdvanceX[c] = font->FallbackAdvanceX;
+    return font->FallbackGlyph;
+}
+
 void ImFontAtlasBuildRegisterDefaultCustomRects(ImFontAtlas* atlas)
 {
     if (atlas->CustomRectIds[0] >= 0)
@@ -2336,9 +2892,13 @@ void ImFont::BuildLookupTable()
         IndexLookup[(int)tab_glyph.Codepoint] = (ImWchar)(Glyphs.Size-1);
     }
 
+    // Glyphs not rasterized yet still have their final advance
+    if (ContainerAtlas && ContainerAtlas->LazyBuildData)
+        ImFontAtlasBuildLazyAdvanceX(ContainerAtlas, this);
+
     FallbackGlyph = FindGlyphNoFallback(FallbackChar);
     FallbackAdvanceX = FallbackGlyph ? FallbackGlyph->AdvanceX : 0.0f;
-    for (int i = 0; i < max_codepoint + 1; i++)
+    for (int i = 0; i < IndexAdvanceX.Size; i++)
         if (IndexAdvanceX[i] < 0.0f)
             IndexAdvanceX[i] = FallbackAdvanceX;
 }
@@ -2400,12 +2960,14 @@ void ImFont::AddRemapChar(ImWchar dst, ImWchar src, bool overwrite_dst)
 
 const ImFontGlyph* ImFont::FindGlyph(ImWchar c) const
 {
-    if (c >= IndexLookup.Size)
-        return FallbackGlyph;
-    const ImWchar i = IndexLookup[c];
-    if (i == (ImWchar)-1)
+    if (c >= IndexLookup.Size || IndexLookup[c] == (ImWchar)-1)
+    {
+        // Lazily rasterized glyphs are a cache fill, hence the const_cast
+        if (ContainerAtlas && ContainerAtlas->LazyBuildData)
+            return ImFontAtlasBuildLazyGlyph(ContainerAtlas, const_cast<ImFont*>(this), c);
         return FallbackGlyph;
-    return &Glyphs.Data[i];
+    }
+    return &Glyphs.Data[IndexLookup[c]];
 }
 
 const ImFontGlyph* ImFont::FindGlyphNoFallback(ImWchar c) const
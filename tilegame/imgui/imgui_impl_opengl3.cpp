@@ -96,7 +96,22 @@ static GLuint       g_FontTexture = 0;
 static GLuint       g_ShaderHandle = 0, g_VertHandle = 0, g_FragHandle = 0;
 static int          g_AttribLocationTex = 0, g_AttribLocationProjMtx = 0;
 static int          g_AttribLocationPosition = 0, g_AttribLocationUV = 0, g_AttribLocationColor = 0;
-static unsigned int g_VboHandle = 0, g_ElementsHandle = 0;
+
+// Vertex/index buffers, one pair per draw list slot. Draw lists only change between NewFrame() and Render(), so when the
+// same list is submitted again without an ImGui frame in between (ImGui::GetFrameCount() unchanged) the buffers already
+// hold its data and the upload is skipped. This is what lets the application re-submit the previous ImDrawData when none
+// of its windows' inputs changed.
+struct ImGui_ImplOpenGL3_ListBuffers
+{
+    GLuint              VboHandle;
+    GLuint              ElementsHandle;
+    const ImDrawList*   List;
+    int                 FrameCount;
+    int                 VtxCount;
+    int                 IdxCount;
+};
+static ImVector<ImGui_ImplOpenGL3_ListBuffers> g_ListBuffers;
+static int          g_ListsUploaded = 0, g_ListsReused = 0;
 
 // Functions
 bool    ImGui_ImplOpenGL3_Init(const char* glsl_version)
@@ -126,6 +141,31 @@ void    ImGui_ImplOpenGL3_NewFrame()
         ImGui_ImplOpenGL3_CreateDeviceObjects();
 }
 
+void    ImGui_ImplOpenGL3_GetUploadStats(int* lists_uploaded, int* lists_reused)
+{
+    if (lists_uploaded) *lists_uploaded = g_ListsUploaded;
+    if (lists_reused) *lists_reused = g_ListsReused;
+}
+
+// Upload the part of the font atlas written since the last frame (glyphs rasterized on first use with ImFontAtlasFlags_LazyGlyphs)
+static void ImGui_ImplOpenGL3_UpdateFontsTexture()
+{
+    ImFontAtlas* atlas = ImGui::GetIO().Fonts;
+    const ImVec4 dirty = atlas->TexDirtyRect;
+    if (!g_FontTexture || dirty.z <= dirty.x)
+        return;
+
+    unsigned char* pixels;
+    int width, height;
+    atlas->GetTexDataAsRGBA32(&pixels, &width, &height);
+    glBindTexture(GL_TEXTURE_2D, g_FontTexture);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+    glTexSubImage2D(GL_TEXTURE_2D, 0, (GLint)dirty.x, (GLint)dirty.y, (GLsizei)(dirty.z - dirty.x), (GLsizei)(dirty.w - dirty.y), GL_RGBA, GL_UNSIGNED_BYTE,
+        pixels + ((int)dirty.y * width + (int)dirty.x) * 4);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    atlas->TexDirtyRect = ImVec4(0.0f, 0.0f, 0.0f, 0.0f);
+}
+
 // OpenGL3 Render function.
 // (this used to be set in io.RenderDrawListsFn and called by ImGui::Render(), but you can now call this directly from your main loop)
 // Note that this implementation is little overcomplicated because we are saving/setting up/restoring every OpenGL state explicitly, in order to be able to run within any OpenGL engine that doesn't do so.
@@ -137,7 +177,8 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
     int fb_height = (int)(draw_data->DisplaySize.y * io.DisplayFramebufferScale.y);
     if (fb_width <= 0 || fb_height <= 0)
         return;
-    draw_data->ScaleClipRects(io.DisplayFramebufferScale);
+    // Clip rectangles are scaled while drawing rather than with ScaleClipRects(), which would modify a draw data that may be submitted again.
+    ImVec2 clip_scale = io.DisplayFramebufferScale;
 
     // Backup GL state
     GLenum last_active_texture; glGetIntegerv(GL_ACTIVE_TEXTURE, (GLint*)&last_active_texture);
@@ -147,6 +188,7 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
 #ifdef GL_SAMPLER_BINDING
     GLint last_sampler; glGetIntegerv(GL_SAMPLER_BINDING, &last_sampler);
 #endif
+    ImGui_ImplOpenGL3_UpdateFontsTexture();
     GLint last_array_buffer; glGetIntegerv(GL_ARRAY_BUFFER_BINDING, &last_array_buffer);
     GLint last_vertex_array; glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &last_vertex_array);
 #ifdef GL_POLYGON_MODE
@@ -201,26 +243,53 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
     GLuint vao_handle = 0;
     glGenVertexArrays(1, &vao_handle);
     glBindVertexArray(vao_handle);
-    glBindBuffer(GL_ARRAY_BUFFER, g_VboHandle);
     glEnableVertexAttribArray(g_AttribLocationPosition);
     glEnableVertexAttribArray(g_AttribLocationUV);
     glEnableVertexAttribArray(g_AttribLocationColor);
-    glVertexAttribPointer(g_AttribLocationPosition, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, pos));
-    glVertexAttribPointer(g_AttribLocationUV, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, uv));
-    glVertexAttribPointer(g_AttribLocationColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, col));
 
     // Draw
     ImVec2 pos = draw_data->DisplayPos;
+    const int frame_count = ImGui::GetFrameCount();
     for (int n = 0; n < draw_data->CmdListsCount; n++)
     {
         const ImDrawList* cmd_list = draw_data->CmdLists[n];
         const ImDrawIdx* idx_buffer_offset = 0;
 
-        glBindBuffer(GL_ARRAY_BUFFER, g_VboHandle);
-        glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)cmd_list->VtxBuffer.Size * sizeof(ImDrawVert), (const GLvoid*)cmd_list->VtxBuffer.Data, GL_STREAM_DRAW);
+        if (n == g_ListBuffers.Size)
+        {
+            ImGui_ImplOpenGL3_ListBuffers slot;
+            memset(&slot, 0, sizeof(slot));
+            glGenBuffers(1, &slot.VboHandle);
+            glGenBuffers(1, &slot.ElementsHandle);
+            slot.FrameCount = -1;
+            g_ListBuffers.push_back(slot);
+        }
+        ImGui_ImplOpenGL3_ListBuffers& buffers = g_ListBuffers[n];
+        bool upload = buffers.List != cmd_list || buffers.FrameCount != frame_count || buffers.VtxCount != cmd_list->VtxBuffer.Size || buffers.IdxCount != cmd_list->IdxBuffer.Size;
+
+        glBindBuffer(GL_ARRAY_BUFFER, buffers.VboHandle);
+        if (upload)
+            glBufferData(GL_ARRAY_BUFFER, (GLsizeiptr)cmd_list->VtxBuffer.Size * sizeof(ImDrawVert), (const GLvoid*)cmd_list->VtxBuffer.Data, GL_STREAM_DRAW);
+        glVertexAttribPointer(g_AttribLocationPosition, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, pos));
+        glVertexAttribPointer(g_AttribLocationUV, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, uv));
+        glVertexAttribPointer(g_AttribLocationColor, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (GLvoid*)IM_OFFSETOF(ImDrawVert, col));
+
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, buffers.ElementsHandle);
+        if (upload)
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx), (const GLvoid*)cmd_list->IdxBuffer.Data, GL_STREAM_DRAW);
 
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, g_ElementsHandle);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, (GLsizeiptr)cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx), (const GLvoid*)cmd_list->IdxBuffer.Data, GL_STREAM_DRAW);
+        if (upload)
+        {
+            buffers.List = cmd_list;
+            buffers.FrameCount = frame_count;
+            buffers.VtxCount = cmd_list->VtxBuffer.Size;
+            buffers.IdxCount = cmd_list->IdxBuffer.Size;
+            g_ListsUploaded++;
+        }
+        else
+        {
+            g_ListsReused++;
+        }
 
         for (int cmd_i = 0; cmd_i < cmd_list->CmdBuffer.Size; cmd_i++)
         {
@@ -232,7 +301,7 @@ void    ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data)
             }
             else
             {
-                ImVec4 clip_rect = ImVec4(pcmd->ClipRect.x - pos.x, pcmd->ClipRect.y - pos.y, pcmd->ClipRect.z - pos.x, pcmd->ClipRect.w - pos.y);
+                ImVec4 clip_rect = ImVec4((pcmd->ClipRect.x - pos.x) * clip_scale.x, (pcmd->ClipRect.y - pos.y) * clip_scale.y, (pcmd->ClipRect.z - pos.x) * clip_scale.x, (pcmd->ClipRect.w - pos.y) * clip_scale.y);
                 if (clip_rect.x < fb_width && clip_rect.y < fb_height && clip_rect.z >= 0.0f && clip_rect.w >= 0.0f)
                 {
                     // Apply scissor/clipping rectangle
@@ -505,9 +574,8 @@ bool    ImGui_ImplOpenGL3_CreateDeviceObjects()
     g_AttribLocationUV = glGetAttribLocation(g_ShaderHandle, "UV");
     g_AttribLocationColor = glGetAttribLocation(g_ShaderHandle, "Color");
 
-    // Create buffers
-    glGenBuffers(1, &g_VboHandle);
-    glGenBuffers(1, &g_ElementsHandle);
+    // Buffers are created on first use, one pair per draw list slot (see ImGui_ImplOpenGL3_RenderDrawData)
+    g_ListBuffers.clear();
 
     ImGui_ImplOpenGL3_CreateFontsTexture();
 
@@ -521,9 +589,12 @@ bool    ImGui_ImplOpenGL3_CreateDeviceObjects()
 
 void    ImGui_ImplOpenGL3_DestroyDeviceObjects()
 {
-    if (g_VboHandle) glDeleteBuffers(1, &g_VboHandle);
-    if (g_ElementsHandle) glDeleteBuffers(1, &g_ElementsHandle);
-    g_VboHandle = g_ElementsHandle = 0;
+    for (int n = 0; n < g_ListBuffers.Size; n++)
+    {
+        glDeleteBuffers(1, &g_ListBuffers[n].VboHandle);
+        glDeleteBuffers(1, &g_ListBuffers[n].ElementsHandle);
+    }
+    g_ListBuffers.clear();
 
     if (g_ShaderHandle && g_VertHandle) glDetachShader(g_ShaderHandle, g_VertHandle);
     if (g_VertHandle) glDeleteShader(g_VertHandle);
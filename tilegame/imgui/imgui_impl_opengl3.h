@@ -32,6 +32,9 @@ IMGUI_IMPL_API void     ImGui_ImplOpenGL3_Shutdown();
 IMGUI_IMPL_API void     ImGui_ImplOpenGL3_NewFrame();
 IMGUI_IMPL_API void     ImGui_ImplOpenGL3_RenderDrawData(ImDrawData* draw_data);
 
+// Running totals of draw lists whose vertex/index data was uploaded, and of draw lists drawn from the data already on the GPU
+IMGUI_IMPL_API void     ImGui_ImplOpenGL3_GetUploadStats(int* lists_uploaded, int* lists_reused);
+
 // Called by Init/NewFrame/Shutdown
 IMGUI_IMPL_API bool     ImGui_ImplOpenGL3_CreateFontsTexture();
 IMGUI_IMPL_API void     ImGui_ImplOpenGL3_DestroyFontsTexture();
@@ -0,0 +1,254 @@
+#include "stdafx.h"
+#include "lighting.h"
+#include "mem_stats.h"
+#include "platform.h"
+
+#include <string.h>
+
+static void
+free_buffer(LightBuffer* lb)
+{
+	if (lb->light_tex) {
+		mem_untrack_object(MEM_GL_TEXTURES, lb->light_tex);
+		glDeleteTextures(1, &lb->light_tex);
+	}
+	if (lb->fbo)
+		glDeleteFramebuffers(1, &lb->fbo);
+	free(lb->tiles);
+	lb->light_tex = lb->fbo = 0;
+	lb->tiles = NULL;
+}
+
+static bool
+alloc_buffer(LightBuffer* lb)
+{
+	lb->width = (lb->view_width + lb->downscale - 1) / lb->downscale;
+	lb->height = (lb->view_height + lb->downscale - 1) / lb->downscale;
+	lb->tiles_x = (lb->view_width + LIGHTING_TILE_SIZE - 1) / LIGHTING_TILE_SIZE;
+	lb->tiles_y = (lb->view_height + LIGHTING_TILE_SIZE - 1) / LIGHTING_TILE_SIZE;
+	lb->tiles = (uint32_t*)malloc((size_t)lb->tiles_x * lb->tiles_y * 2 * sizeof(uint32_t));
+	if (!lb->tiles)
+		return false;
+
+	// lights add up past 1 before the composite clamps them
+	glGenTextures(1, &lb->light_tex);
+	glBindTexture(GL_TEXTURE_2D, lb->light_tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, lb->width, lb->height, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	mem_track_object(MEM_GL_TEXTURES, lb->light_tex, mem_texture_bytes(lb->width, lb->height, 8, false));
+
+	glGenFramebuffers(1, &lb->fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, lb->fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, lb->light_tex, 0);
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (!complete) {
+		printf("Light buffer %dx%d is incomplete\n", lb->width, lb->height);
+		free_buffer(lb);
+		return false;
+	}
+	return true;
+}
+
+bool lighting_init(LightBuffer* lb, int view_width, int view_height, int downscale, uint32_t light_capacity, GLuint accumulate_program, GLuint composite_program)
+{
+	memset(lb, 0, sizeof(*lb));
+	lb->downscale = downscale > 1 ? downscale : 1;
+	lb->accumulate_program = accumulate_program;
+	lb->composite_program = composite_program;
+	lb->ambient[0] = lb->ambient[1] = lb->ambient[2] = LIGHTING_DEFAULT_AMBIENT;
+
+	lb->lights = (PointLight*)malloc(light_capacity * sizeof(PointLight));
+	lb->indices = (uint32_t*)malloc((size_t)light_capacity * LIGHTING_ENTRIES_PER_LIGHT * sizeof(uint32_t));
+	if (!lb->lights || !lb->indices) {
+		lighting_free(lb);
+		return false;
+	}
+	lb->light_capacity = light_capacity;
+	lb->index_capacity = light_capacity * LIGHTING_ENTRIES_PER_LIGHT;
+
+	glGenVertexArrays(1, &lb->vao);
+	glGenBuffers(1, &lb->light_ssbo);
+	glGenBuffers(1, &lb->tile_ssbo);
+	glGenBuffers(1, &lb->index_ssbo);
+	return lighting_resize(lb, view_width, view_height);
+}
+
+void lighting_free(LightBuffer* lb)
+{
+	free_buffer(lb);
+	GLuint buffers[3] = { lb->light_ssbo, lb->tile_ssbo, lb->index_ssbo };
+	for (int i = 0; i < 3; i++) {
+		if (buffers[i]) {
+			mem_untrack_object(MEM_GL_VERTEX_BUFFERS, buffers[i]);
+			glDeleteBuffers(1, &buffers[i]);
+		}
+	}
+	if (lb->vao)
+		glDeleteVertexArrays(1, &lb->vao);
+	free(lb->lights);
+	free(lb->indices);
+	memset(lb, 0, sizeof(*lb));
+}
+
+bool lighting_resize(LightBuffer* lb, int view_width, int view_height)
+{
+	if (lb->fbo && lb->view_width == view_width && lb->view_height == view_height)
+		return true;
+	free_buffer(lb);
+	lb->view_width = view_width;
+	lb->view_height = view_height;
+	return alloc_buffer(lb);
+}
+
+void lighting_clear(LightBuffer* lb)
+{
+	lb->light_count = 0;
+}
+
+bool lighting_add(LightBuffer* lb, const PointLight* light)
+{
+	if (lb->light_count == lb->light_capacity)
+		return false;
+	lb->lights[lb->light_count++] = *light;
+	return true;
+}
+
+// Tiles the square bounds of a light cover, clamped to the view. False
+// when it misses the view.
+static bool
+light_tiles(const LightBuffer* lb, const PointLight* light, int* tx0, int* ty0, int* tx1, int* ty1)
+{
+	float x0 = light->x - light->radius, y0 = light->y - light->radius;
+	float x1 = light->x + light->radius, y1 = light->y + light->radius;
+	if (light->radius <= 0.0f || x1 < 0.0f || y1 < 0.0f || x0 >= lb->view_width || y0 >= lb->view_height)
+		return false;
+
+	*tx0 = x0 <= 0.0f ? 0 : (int)x0 / LIGHTING_TILE_SIZE;
+	*ty0 = y0 <= 0.0f ? 0 : (int)y0 / LIGHTING_TILE_SIZE;
+	*tx1 = x1 >= lb->view_width ? lb->tiles_x - 1 : (int)x1 / LIGHTING_TILE_SIZE;
+	*ty1 = y1 >= lb->view_height ? lb->tiles_y - 1 : (int)y1 / LIGHTING_TILE_SIZE;
+	return true;
+}
+
+// Counts the lights of every tile, turns the counts into offsets, then
+// writes the lists. Lists that would run past the reserved storage are cut
+// short.
+static void
+bin_lights(LightBuffer* lb)
+{
+	LightingStats* stats = &lb->stats;
+	uint32_t tile_count = (uint32_t)(lb->tiles_x * lb->tiles_y);
+	uint32_t* tiles = lb->tiles;
+	memset(tiles, 0, tile_count * 2 * sizeof(uint32_t));
+
+	int tx0, ty0, tx1, ty1;
+	for (uint32_t i = 0; i < lb->light_count; i++) {
+		if (!light_tiles(lb, &lb->lights[i], &tx0, &ty0, &tx1, &ty1))
+			continue;
+		stats->visible_lights++;
+		for (int ty = ty0; ty <= ty1; ty++) {
+			for (int tx = tx0; tx <= tx1; tx++)
+				tiles[(ty * lb->tiles_x + tx) * 2 + 1]++;
+		}
+	}
+
+	uint32_t offset = 0;
+	for (uint32_t t = 0; t < tile_count; t++) {
+		uint32_t count = tiles[t * 2 + 1];
+		if (count > stats->max_tile_lights)
+			stats->max_tile_lights = count;
+		if (offset + count > lb->index_capacity) {
+			stats->dropped += offset + count - lb->index_capacity;
+			count = lb->index_capacity - offset;
+		}
+		tiles[t * 2] = offset;
+		tiles[t * 2 + 1] = 0;
+		offset += count;
+	}
+	stats->tile_entries = offset;
+
+	for (uint32_t i = 0; i < lb->light_count; i++) {
+		if (!light_tiles(lb, &lb->lights[i], &tx0, &ty0, &tx1, &ty1))
+			continue;
+		for (int ty = ty0; ty <= ty1; ty++) {
+			for (int tx = tx0; tx <= tx1; tx++) {
+				// a list ends where the next tile's starts
+				uint32_t t = (uint32_t)(ty * lb->tiles_x + tx);
+				uint32_t end = t + 1 < tile_count ? tiles[(t + 1) * 2] : stats->tile_entries;
+				uint32_t* tile = &tiles[t * 2];
+				if (tile[0] + tile[1] < end)
+					lb->indices[tile[0] + tile[1]++] = i;
+			}
+		}
+	}
+}
+
+static void
+upload(GLuint buffer, const void* data, size_t bytes)
+{
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, buffer);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, bytes, data, GL_STREAM_DRAW);
+	mem_track_object(MEM_GL_VERTEX_BUFFERS, buffer, bytes);
+}
+
+void lighting_render(LightBuffer* lb)
+{
+	double start = platform_time_us();
+	memset(&lb->stats, 0, sizeof(lb->stats));
+	lb->stats.lights = lb->light_count;
+	lb->stats.tiles = (uint32_t)(lb->tiles_x * lb->tiles_y);
+	bin_lights(lb);
+	lb->stats.bin_ms = (float)((platform_time_us() - start) / 1000.0);
+
+	// empty buffers cannot be bound, so each one holds at least one entry
+	PointLight none = {};
+	upload(lb->light_ssbo, lb->light_count ? (const void*)lb->lights : &none, (lb->light_count ? lb->light_count : 1) * sizeof(PointLight));
+	upload(lb->tile_ssbo, lb->tiles, lb->stats.tiles * 2 * sizeof(uint32_t));
+	upload(lb->index_ssbo, lb->stats.tile_entries ? lb->indices : lb->tiles, (lb->stats.tile_entries ? lb->stats.tile_entries : 1) * sizeof(uint32_t));
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, lb->light_ssbo);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, lb->tile_ssbo);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, lb->index_ssbo);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, lb->fbo);
+	glViewport(0, 0, lb->width, lb->height);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+
+	GLuint program = lb->accumulate_program;
+	glUseProgram(program);
+	glUniform2f(glGetUniformLocation(program, "view_size"), (float)lb->view_width, (float)lb->view_height);
+	glUniform2f(glGetUniformLocation(program, "buffer_size"), (float)lb->width, (float)lb->height);
+	glUniform2i(glGetUniformLocation(program, "tiles"), lb->tiles_x, lb->tiles_y);
+	glUniform1f(glGetUniformLocation(program, "tile_size"), (float)LIGHTING_TILE_SIZE);
+	glUniform3fv(glGetUniformLocation(program, "ambient"), 1, lb->ambient);
+	glBindVertexArray(lb->vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+
+	for (int i = 0; i < 3; i++)
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void lighting_composite(LightBuffer* lb)
+{
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_DST_COLOR, GL_ZERO);
+
+	glUseProgram(lb->composite_program);
+	glUniform1i(glGetUniformLocation(lb->composite_program, "light"), 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, lb->light_tex);
+	glBindVertexArray(lb->vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+
+	glDisable(GL_BLEND);
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "glad/include/glad.h"
+
+//----------------------------------------------------------------------------
+//
+//  Deferred 2D lighting. Point lights are added each frame in view pixels
+//    and lighting_render() accumulates them, over an ambient term, into a
+//    float light buffer 1/downscale the size of the view. Light falls off
+//    smoothly to zero at its radius, and the light field is smooth, so
+//    the buffer can be small and bilinear upsampling hides it.
+//    lighting_composite() then multiplies the world already drawn into
+//    the bound framebuffer by the upsampled buffer.
+//
+//  Lights are binned on the CPU into LIGHTING_TILE_SIZE view pixel tiles:
+//    each tile gets the list of lights whose square bounds reach it, and
+//    light_accumulate.frag only walks the list of its own tile. A light
+//    costs the pixels it can reach instead of every pixel of the view, so
+//    hundreds of small lights cost little more than a few large ones.
+//    Lights off the view are not binned at all.
+//
+//  Lights, tile ranges and the tile light lists are uploaded to shader
+//    storage buffers each frame. The tile list storage is reserved for
+//    LIGHTING_ENTRIES_PER_LIGHT tiles per light; entries past it are
+//    dropped and counted.
+//
+
+#define LIGHTING_TILE_SIZE 64
+#define LIGHTING_ENTRIES_PER_LIGHT 64
+#define LIGHTING_DEFAULT_AMBIENT 0.15f
+
+// Layout matches the Lights buffer of light_accumulate.frag.
+typedef struct PointLight {
+	float x, y;					// view pixels, y down
+	float radius;
+	float intensity;
+	float r, g, b;
+	float unused;
+} PointLight;
+
+typedef struct LightingStats {
+	uint32_t lights;
+	uint32_t visible_lights;	// binned into at least one tile
+	uint32_t tiles;
+	uint32_t tile_entries;
+	uint32_t max_tile_lights;
+	uint32_t dropped;			// tile entries past the reserved storage
+	float bin_ms;
+} LightingStats;
+
+typedef struct LightBuffer {
+	int view_width;
+	int view_height;
+	int downscale;
+	int width;					// of the light buffer
+	int height;
+	int tiles_x;
+	int tiles_y;
+
+	GLuint fbo;
+	GLuint light_tex;
+	GLuint accumulate_program;	// present.vert with light_accumulate.frag
+	GLuint composite_program;	// present.vert with light_composite.frag
+	GLuint vao;
+	GLuint light_ssbo;
+	GLuint tile_ssbo;
+	GLuint index_ssbo;
+
+	PointLight* lights;
+	uint32_t light_count;
+	uint32_t light_capacity;
+	uint32_t* tiles;			// offset and count per tile
+	uint32_t* indices;			// light lists of the tiles, back to back
+	uint32_t index_capacity;
+
+	float ambient[3];			// light of a pixel no light reaches
+	LightingStats stats;		// of the last lighting_render()
+} LightBuffer;
+
+bool
+lighting_init(LightBuffer* lb, int view_width, int view_height, int downscale, uint32_t light_capacity, GLuint accumulate_program, GLuint composite_program);
+
+// Frees the GL objects except the programs, which belong to the caller.
+void
+lighting_free(LightBuffer* lb);
+
+bool
+lighting_resize(LightBuffer* lb, int view_width, int view_height);
+
+void
+lighting_clear(LightBuffer* lb);
+
+// Returns false when the light storage is full.
+bool
+lighting_add(LightBuffer* lb, const PointLight* light);
+
+// Bins the lights added since the last lighting_clear() and draws them
+// into the light buffer. Leaves the default framebuffer bound.
+void
+lighting_render(LightBuffer* lb);
+
+// Multiplies the bound framebuffer's viewport by the light buffer. Blending
+// and the depth test are off afterwards.
+void
+lighting_composite(LightBuffer* lb);
@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "load_shaders.h"
+#include "vfs.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -7,80 +8,83 @@ extern "C" {
 
 	//----------------------------------------------------------------------------
 
-	static const GLchar*
-		read_shader(const char* filename)
+	static void
+		delete_shaders(ShaderInfo* shaders)
 	{
-#ifdef WIN32
-		FILE* infile;
-		fopen_s(&infile, filename, "rb");
-#else
-		FILE* infile = fopen(filename, "rb");
-#endif // WIN32
-
-		if (!infile) {
-			return NULL;
+		for (ShaderInfo* entry = shaders; entry->type != GL_NONE; ++entry) {
+			glDeleteShader(entry->shader);
+			entry->shader = 0;
 		}
+	}
 
-		fseek(infile, 0, SEEK_END);
-		int len = ftell(infile);
-		fseek(infile, 0, SEEK_SET);
-
-		GLchar* source = new GLchar[len + 1];
-
-		fread(source, 1, len, infile);
-		fclose(infile);
+	GLuint
+		load_shaders(ShaderInfo* shaders)
+	{
+		if (shaders == NULL) { return 0; }
 
-		source[len] = 0;
+		const GLchar* sources[LOAD_SHADERS_MAX_STAGES] = {};
+		GLint lengths[LOAD_SHADERS_MAX_STAGES] = {};
+		VfsFile files[LOAD_SHADERS_MAX_STAGES];
+		int count = 0;
+		bool read = true;
+
+		for (ShaderInfo* entry = shaders; entry->type != GL_NONE; ++entry, ++count) {
+			if (count == LOAD_SHADERS_MAX_STAGES) {
+				printf("%s: more than %d shader stages\n", entry->filename, LOAD_SHADERS_MAX_STAGES);
+				read = false;
+				break;
+			}
+			if (!vfs_read(entry->filename, &files[count])) {
+				read = false;
+				break;
+			}
+			sources[count] = (const GLchar*)files[count].data;
+			lengths[count] = (GLint)files[count].size;
+		}
 
-		return const_cast<const GLchar*>(source);
+		GLuint program = read ? load_shader_sources(shaders, sources, lengths, count) : 0;
+		for (int i = 0; i < count; i++)
+			vfs_close(&files[i]);
+		return program;
 	}
 
 	GLuint
-		load_shaders(ShaderInfo* shaders)
+		load_shader_sources(ShaderInfo* shaders, const GLchar* const* sources, const GLint* lengths, int count)
 	{
 		if (shaders == NULL) { return 0; }
 
+		int stages = 0;
+		while (shaders[stages].type != GL_NONE)
+			stages++;
+		if (stages != count) {
+			printf("%d shader stages listed, %d sources given\n", stages, count);
+			return 0;
+		}
+
 		GLuint program = glCreateProgram();
 
-		ShaderInfo* entry = shaders;
-		while (entry->type != GL_NONE) {
+		for (int stage = 0; stage < count; ++stage) {
+			ShaderInfo* entry = &shaders[stage];
 			GLuint shader = glCreateShader(entry->type);
 
 			entry->shader = shader;
 
-			const GLchar* source = read_shader(entry->filename);
-			if (source == NULL) {
-				for (entry = shaders; entry->type != GL_NONE; ++entry) {
-					glDeleteShader(entry->shader);
-					entry->shader = 0;
-				}
-
-				return 0;
-			}
-
-			glShaderSource(shader, 1, &source, NULL);
-			delete[] source;
-
+			glShaderSource(shader, 1, &sources[stage], &lengths[stage]);
 			glCompileShader(shader);
 
 			GLint compiled;
 			glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
-			//if (!compiled) {
-#ifdef _DEBUG
-				GLsizei len;
-				glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &len);
-
-				GLchar* log = new GLchar[len + 1];
-				glGetShaderInfoLog(shader, len, &len, log);
-				delete[] log;
-#endif /* DEBUG */
+			if (!compiled) {
+				GLchar log[1024];
+				glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+				printf("%s: %s\n", entry->filename, log);
 
-			//	return 0;
-			//}
+				delete_shaders(shaders);
+				glDeleteProgram(program);
+				return 0;
+			}
 
 			glAttachShader(program, shader);
-
-			++entry;
 		}
 
 		glLinkProgram(program);
@@ -88,20 +92,12 @@ extern "C" {
 		GLint linked;
 		glGetProgramiv(program, GL_LINK_STATUS, &linked);
 		if (!linked) {
-#ifdef _DEBUG
-			GLsizei len;
-			glGetProgramiv(program, GL_INFO_LOG_LENGTH, &len);
-
-			GLchar* log = new GLchar[len + 1];
-			glGetProgramInfoLog(program, len, &len, log);
-			delete[] log;
-#endif /* DEBUG */
-
-			for (entry = shaders; entry->type != GL_NONE; ++entry) {
-				glDeleteShader(entry->shader);
-				entry->shader = 0;
-			}
+			GLchar log[1024];
+			glGetProgramInfoLog(program, sizeof(log), NULL, log);
+			printf("%s: %s\n", shaders->filename, log);
 
+			delete_shaders(shaders);
+			glDeleteProgram(program);
 			return 0;
 		}
 
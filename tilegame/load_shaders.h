@@ -1,3 +1,5 @@
+#pragma once
+
 #include <glad/glad.h>
 
 #ifdef __cplusplus
@@ -17,6 +19,13 @@ extern "C" {
 	//  LoadShaders() returns the shader program value (as returned by
 	//    glCreateProgram()) on success, or zero on failure. 
 	//
+	//  load_shader_sources() does the same with the source of each stage
+	//    already in memory, in the order of the array; 'count' is the number
+	//    of sources and must match the array. Compile and link errors are
+	//    printed.
+	//
+
+#define LOAD_SHADERS_MAX_STAGES 4
 
 	typedef struct {
 		GLenum       type;
@@ -26,6 +35,8 @@ extern "C" {
 
 	GLuint load_shaders(ShaderInfo*);
 
+	GLuint load_shader_sources(ShaderInfo*, const GLchar* const* sources, const GLint* lengths, int count);
+
 	//----------------------------------------------------------------------------
 
 #ifdef __cplusplus
@@ -0,0 +1,155 @@
+#include "stdafx.h"
+#include "mem_stats.h"
+#include "alloc_tracker.h"
+
+#include <mutex>
+#include <unordered_map>
+
+typedef struct TrackedObject {
+	MemCategory category;
+	size_t bytes;
+} TrackedObject;
+
+typedef struct ImGuiAllocHeader {
+	size_t bytes;
+	size_t pad;
+} ImGuiAllocHeader;
+
+static std::mutex mem_lock;
+static MemCategoryStats mem_stats[MEM_CATEGORY_COUNT];
+static std::unordered_map<uint64_t, TrackedObject> mem_objects;
+
+static const char* mem_category_names[MEM_CATEGORY_COUNT] = {
+	"GL textures",
+	"GL vertex buffers",
+	"GL index buffers",
+	"SDL textures",
+	"Frame arena",
+	"Object pools",
+	"Simulation",
+	"ImGui heap",
+	"File cache",
+	"Draw queues",
+	"Particles",
+	"World chunks",
+	"Tile maps",
+};
+
+static uint64_t object_key(MemCategory category, uint64_t id)
+{
+	return ((uint64_t)category << 56) ^ id;
+}
+
+static void add_bytes(MemCategory category, int64_t bytes, int32_t objects)
+{
+	MemCategoryStats* s = &mem_stats[category];
+	s->current_bytes += bytes;
+	s->live_objects += objects;
+	if (s->current_bytes > s->peak_bytes)
+		s->peak_bytes = s->current_bytes;
+	if (s->live_objects > s->peak_objects)
+		s->peak_objects = s->live_objects;
+}
+
+void mem_track_alloc(MemCategory category, size_t bytes)
+{
+	std::lock_guard<std::mutex> guard(mem_lock);
+	add_bytes(category, (int64_t)bytes, 1);
+}
+
+void mem_track_free(MemCategory category, size_t bytes)
+{
+	std::lock_guard<std::mutex> guard(mem_lock);
+	add_bytes(category, -(int64_t)bytes, -1);
+}
+
+void mem_track_object(MemCategory category, uint64_t id, size_t bytes)
+{
+	std::lock_guard<std::mutex> guard(mem_lock);
+	auto inserted = mem_objects.insert({ object_key(category, id), { category, 0 } });
+	TrackedObject& obj = inserted.first->second;
+
+	// a re-specified object replaces its previous size
+	add_bytes(category, (int64_t)bytes - (int64_t)obj.bytes, inserted.second ? 1 : 0);
+	obj.bytes = bytes;
+}
+
+void mem_untrack_object(MemCategory category, uint64_t id)
+{
+	std::lock_guard<std::mutex> guard(mem_lock);
+	auto it = mem_objects.find(object_key(category, id));
+	if (it == mem_objects.end())
+		return;
+
+	add_bytes(category, -(int64_t)it->second.bytes, -1);
+	mem_objects.erase(it);
+}
+
+size_t mem_texture_bytes(int width, int height, int bytes_per_pixel, bool mipmapped)
+{
+	size_t bytes = (size_t)width * height * bytes_per_pixel;
+	// a full mip chain adds a third of the base level
+	return mipmapped ? bytes + bytes / 3 : bytes;
+}
+
+void mem_stats_get(MemCategory category, MemCategoryStats* stats)
+{
+	std::lock_guard<std::mutex> guard(mem_lock);
+	*stats = mem_stats[category];
+}
+
+const char* mem_category_name(MemCategory category)
+{
+	return mem_category_names[category];
+}
+
+static void* imgui_alloc(size_t size, void* user_data)
+{
+	(void)user_data;
+	ImGuiAllocHeader* header = (ImGuiAllocHeader*)malloc(sizeof(ImGuiAllocHeader) + size);
+	if (!header)
+		return NULL;
+	header->bytes = size;
+	mem_track_alloc(MEM_CPU_IMGUI, size);
+	alloc_tracker_count_alloc();
+	return header + 1;
+}
+
+static void imgui_free(void* ptr, void* user_data)
+{
+	(void)user_data;
+	if (!ptr)
+		return;
+	ImGuiAllocHeader* header = (ImGuiAllocHeader*)ptr - 1;
+	mem_track_free(MEM_CPU_IMGUI, header->bytes);
+	alloc_tracker_count_free();
+	free(header);
+}
+
+void mem_install_imgui_allocator()
+{
+	ImGui::SetAllocatorFunctions(imgui_alloc, imgui_free);
+}
+
+int mem_report_leaks()
+{
+	std::lock_guard<std::mutex> guard(mem_lock);
+	int leaks = 0;
+
+	for (int c = 0; c < MEM_CATEGORY_COUNT; c++) {
+		const MemCategoryStats* s = &mem_stats[c];
+		if (s->current_bytes == 0 && s->live_objects == 0)
+			continue;
+
+		printf("Leak: %s still holds %lld bytes in %d objects (peak %lld bytes)\n",
+			mem_category_names[c], (long long)s->current_bytes, s->live_objects, (long long)s->peak_bytes);
+		leaks += s->live_objects > 0 ? s->live_objects : 1;
+	}
+
+	for (auto& it : mem_objects) {
+		printf("  %s object %llu: %zu bytes\n", mem_category_names[it.second.category],
+			(unsigned long long)(it.first ^ ((uint64_t)it.second.category << 56)), it.second.bytes);
+	}
+
+	return leaks;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+//----------------------------------------------------------------------------
+//
+//  Resource accounting. Every GL object, SDL texture and large CPU
+//    allocation the game makes is tagged with a category, and each category
+//    keeps its current and peak byte counts and live object count.
+//
+//  GL and SDL objects are tracked by id so that re-specifying a texture or
+//    buffer replaces its old size instead of adding to it. Anything still
+//    tracked when mem_report_leaks() runs is printed as a leak.
+//
+
+typedef enum MemCategory {
+	MEM_GL_TEXTURES,
+	MEM_GL_VERTEX_BUFFERS,
+	MEM_GL_INDEX_BUFFERS,
+	MEM_SDL_TEXTURES,
+	MEM_CPU_FRAME_ARENA,
+	MEM_CPU_POOLS,
+	MEM_CPU_SIMULATION,
+	MEM_CPU_IMGUI,
+	MEM_CPU_FILE_CACHE,
+	MEM_CPU_DRAW_QUEUES,
+	MEM_CPU_PARTICLES,
+	MEM_CPU_WORLD_CHUNKS,
+	MEM_CPU_TILE_MAPS,
+	MEM_CATEGORY_COUNT
+} MemCategory;
+
+typedef struct MemCategoryStats {
+	int64_t current_bytes;
+	int64_t peak_bytes;
+	int32_t live_objects;
+	int32_t peak_objects;
+} MemCategoryStats;
+
+void
+mem_track_alloc(MemCategory category, size_t bytes);
+
+void
+mem_track_free(MemCategory category, size_t bytes);
+
+// Records (or re-records) the size of the object 'id' in 'category'.
+void
+mem_track_object(MemCategory category, uint64_t id, size_t bytes);
+
+void
+mem_untrack_object(MemCategory category, uint64_t id);
+
+size_t
+mem_texture_bytes(int width, int height, int bytes_per_pixel, bool mipmapped);
+
+void
+mem_stats_get(MemCategory category, MemCategoryStats* stats);
+
+const char*
+mem_category_name(MemCategory category);
+
+// Routes ImGui's allocations through MEM_CPU_IMGUI. Must run before
+// ImGui::CreateContext().
+void
+mem_install_imgui_allocator();
+
+// Prints every category that still holds memory. Returns the number of
+// leaked objects and allocations.
+int
+mem_report_leaks();
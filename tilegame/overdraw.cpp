@@ -0,0 +1,356 @@
+#include "stdafx.h"
+#include "overdraw.h"
+#include "mem_stats.h"
+#include "platform.h"
+
+#include <string.h>
+
+// Renderbuffers share MEM_GL_TEXTURES with textures, as in render_target.cpp.
+#define RENDERBUFFER_MEM_ID(id) ((uint64_t)(id) | (1ull << 32))
+
+// keep in step with the ramp in heatmap.frag
+static const float bucket_colors[OVERDRAW_BUCKETS][3] = {
+	{ 0.0f, 0.0f, 0.5f },
+	{ 0.0f, 0.3f, 1.0f },
+	{ 0.0f, 0.8f, 0.8f },
+	{ 0.0f, 0.8f, 0.0f },
+	{ 1.0f, 1.0f, 0.0f },
+	{ 1.0f, 0.5f, 0.0f },
+	{ 1.0f, 0.0f, 0.0f },
+	{ 1.0f, 1.0f, 1.0f },
+};
+
+static const char* bucket_names[OVERDRAW_BUCKETS] = {
+	"1", "2", "3", "4", "5-8", "9-16", "17-32", "33+",
+};
+
+const char* overdraw_bucket_name(int bucket)
+{
+	return bucket >= 0 && bucket < OVERDRAW_BUCKETS ? bucket_names[bucket] : "?";
+}
+
+const float* overdraw_bucket_color(int bucket)
+{
+	return bucket_colors[bucket >= 0 && bucket < OVERDRAW_BUCKETS ? bucket : OVERDRAW_BUCKETS - 1];
+}
+
+static void
+free_target(OverdrawView* view)
+{
+	if (view->count_tex) {
+		mem_untrack_object(MEM_GL_TEXTURES, view->count_tex);
+		glDeleteTextures(1, &view->count_tex);
+	}
+	if (view->depth_rb) {
+		mem_untrack_object(MEM_GL_TEXTURES, RENDERBUFFER_MEM_ID(view->depth_rb));
+		glDeleteRenderbuffers(1, &view->depth_rb);
+	}
+	if (view->fbo)
+		glDeleteFramebuffers(1, &view->fbo);
+	view->count_tex = view->depth_rb = view->fbo = 0;
+}
+
+static bool
+alloc_target(OverdrawView* view)
+{
+	// 32-bit float blends exactly up to 2^24 layers
+	glGenTextures(1, &view->count_tex);
+	glBindTexture(GL_TEXTURE_2D, view->count_tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, view->width, view->height, 0, GL_RED, GL_FLOAT, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	mem_track_object(MEM_GL_TEXTURES, view->count_tex, mem_texture_bytes(view->width, view->height, 4, false));
+
+	glGenRenderbuffers(1, &view->depth_rb);
+	glBindRenderbuffer(GL_RENDERBUFFER, view->depth_rb);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, view->width, view->height);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	mem_track_object(MEM_GL_TEXTURES, RENDERBUFFER_MEM_ID(view->depth_rb), mem_texture_bytes(view->width, view->height, 4, false));
+
+	glGenFramebuffers(1, &view->fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, view->fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, view->count_tex, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, view->depth_rb);
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (!complete) {
+		printf("Overdraw target %dx%d is incomplete\n", view->width, view->height);
+		free_target(view);
+		return false;
+	}
+	return true;
+}
+
+bool overdraw_init(OverdrawView* view, int width, int height, GLuint count_program, GLuint gui_program, GLuint heatmap_program)
+{
+	memset(view, 0, sizeof(*view));
+	view->count_program = count_program;
+	view->gui_program = gui_program;
+	view->heatmap_program = heatmap_program;
+
+	glGenVertexArrays(1, &view->vao);
+	glGenVertexArrays(1, &view->gui_vao);
+	glGenBuffers(1, &view->gui_vbo);
+	glGenBuffers(1, &view->gui_ebo);
+
+	glBindVertexArray(view->gui_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, view->gui_vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, view->gui_ebo);
+	glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (void*)IM_OFFSETOF(ImDrawVert, pos));
+	glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(ImDrawVert), (void*)IM_OFFSETOF(ImDrawVert, uv));
+	glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ImDrawVert), (void*)IM_OFFSETOF(ImDrawVert, col));
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glEnableVertexAttribArray(2);
+	glBindVertexArray(0);
+
+	glGenBuffers(OVERDRAW_COUNTER_BUFFERS, view->counters);
+	for (int i = 0; i < OVERDRAW_COUNTER_BUFFERS; i++) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, view->counters[i]);
+		glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(OverdrawCounters), NULL, GL_DYNAMIC_READ);
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	return overdraw_resize(view, width, height);
+}
+
+void overdraw_free(OverdrawView* view)
+{
+	free_target(view);
+	for (int i = 0; i < OVERDRAW_COUNTER_BUFFERS; i++) {
+		if (view->fences[i])
+			glDeleteSync(view->fences[i]);
+	}
+	if (view->counters[0])
+		glDeleteBuffers(OVERDRAW_COUNTER_BUFFERS, view->counters);
+	if (view->gui_vbo) {
+		mem_untrack_object(MEM_GL_VERTEX_BUFFERS, view->gui_vbo);
+		mem_untrack_object(MEM_GL_INDEX_BUFFERS, view->gui_ebo);
+		glDeleteBuffers(1, &view->gui_vbo);
+		glDeleteBuffers(1, &view->gui_ebo);
+	}
+	if (view->gui_vao)
+		glDeleteVertexArrays(1, &view->gui_vao);
+	if (view->vao)
+		glDeleteVertexArrays(1, &view->vao);
+	memset(view, 0, sizeof(*view));
+}
+
+bool overdraw_resize(OverdrawView* view, int width, int height)
+{
+	if (view->fbo && width == view->width && height == view->height)
+		return true;
+
+	free_target(view);
+	view->width = width > 0 ? width : 1;
+	view->height = height > 0 ? height : 1;
+	return alloc_target(view);
+}
+
+void overdraw_begin(OverdrawView* view)
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, view->fbo);
+	glViewport(0, 0, view->width, view->height);
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_SCISSOR_TEST);
+	glEnable(GL_BLEND);
+	glBlendEquation(GL_FUNC_ADD);
+	glBlendFunc(GL_ONE, GL_ONE);
+}
+
+void overdraw_count_gui(OverdrawView* view, const ImDrawData* draw_data)
+{
+	if (!draw_data || draw_data->CmdListsCount == 0)
+		return;
+
+	// the projection and clipping of ImGui_ImplOpenGL3_RenderDrawData()
+	float L = draw_data->DisplayPos.x;
+	float R = draw_data->DisplayPos.x + draw_data->DisplaySize.x;
+	float T = draw_data->DisplayPos.y;
+	float B = draw_data->DisplayPos.y + draw_data->DisplaySize.y;
+	const float ortho_projection[4][4] = {
+		{ 2.0f / (R - L), 0.0f, 0.0f, 0.0f },
+		{ 0.0f, 2.0f / (T - B), 0.0f, 0.0f },
+		{ 0.0f, 0.0f, -1.0f, 0.0f },
+		{ (R + L) / (L - R), (T + B) / (B - T), 0.0f, 1.0f },
+	};
+
+	glUseProgram(view->gui_program);
+	glUniformMatrix4fv(glGetUniformLocation(view->gui_program, "ProjMtx"), 1, GL_FALSE, &ortho_projection[0][0]);
+	glBindVertexArray(view->gui_vao);
+	glBindBuffer(GL_ARRAY_BUFFER, view->gui_vbo);
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_SCISSOR_TEST);
+
+	// one upload for the whole frame, the lists are drawn at their offsets
+	size_t vtx_bytes = (size_t)draw_data->TotalVtxCount * sizeof(ImDrawVert);
+	size_t idx_bytes = (size_t)draw_data->TotalIdxCount * sizeof(ImDrawIdx);
+	glBufferData(GL_ARRAY_BUFFER, vtx_bytes, NULL, GL_STREAM_DRAW);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, idx_bytes, NULL, GL_STREAM_DRAW);
+	mem_track_object(MEM_GL_VERTEX_BUFFERS, view->gui_vbo, vtx_bytes);
+	mem_track_object(MEM_GL_INDEX_BUFFERS, view->gui_ebo, idx_bytes);
+
+	size_t vtx_offset = 0, idx_offset = 0;
+	for (int n = 0; n < draw_data->CmdListsCount; n++) {
+		const ImDrawList* cmd_list = draw_data->CmdLists[n];
+		glBufferSubData(GL_ARRAY_BUFFER, vtx_offset * sizeof(ImDrawVert), cmd_list->VtxBuffer.Size * sizeof(ImDrawVert), cmd_list->VtxBuffer.Data);
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, idx_offset * sizeof(ImDrawIdx), cmd_list->IdxBuffer.Size * sizeof(ImDrawIdx), cmd_list->IdxBuffer.Data);
+
+		size_t first_index = idx_offset;
+		for (int i = 0; i < cmd_list->CmdBuffer.Size; i++) {
+			const ImDrawCmd* pcmd = &cmd_list->CmdBuffer[i];
+			if (pcmd->UserCallback) {
+				first_index += pcmd->ElemCount;
+				continue;
+			}
+			float x0 = pcmd->ClipRect.x - L, y0 = pcmd->ClipRect.y - T;
+			float x1 = pcmd->ClipRect.z - L, y1 = pcmd->ClipRect.w - T;
+			if (x0 < view->width && y0 < view->height && x1 >= 0.0f && y1 >= 0.0f) {
+				glScissor((int)x0, (int)(view->height - y1), (int)(x1 - x0), (int)(y1 - y0));
+				glDrawElementsBaseVertex(GL_TRIANGLES, (GLsizei)pcmd->ElemCount, sizeof(ImDrawIdx) == 2 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT,
+					(void*)(first_index * sizeof(ImDrawIdx)), (GLint)vtx_offset);
+			}
+			first_index += pcmd->ElemCount;
+		}
+		vtx_offset += cmd_list->VtxBuffer.Size;
+		idx_offset += cmd_list->IdxBuffer.Size;
+	}
+
+	glDisable(GL_SCISSOR_TEST);
+	glBindVertexArray(0);
+}
+
+void overdraw_end(OverdrawView* view)
+{
+	glDisable(GL_BLEND);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+static void
+read_counters(OverdrawView* view, int slot)
+{
+	OverdrawCounters counters;
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, view->counters[slot]);
+	glGetBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, sizeof(counters), &counters);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	OverdrawStats* stats = &view->stats;
+	stats->fragments = counters.fragments;
+	stats->pixels = (uint32_t)view->width * (uint32_t)view->height;
+	stats->covered_pixels = counters.covered_pixels;
+	stats->max_layers = counters.max_layers;
+	stats->overdraw = (float)((double)counters.fragments / stats->pixels);
+	stats->average_layers = counters.covered_pixels ? (float)((double)counters.fragments / counters.covered_pixels) : 0.0f;
+	memcpy(stats->histogram, counters.histogram, sizeof(stats->histogram));
+
+	glDeleteSync(view->fences[slot]);
+	view->fences[slot] = 0;
+}
+
+void overdraw_present(OverdrawView* view, GLuint dst_fbo)
+{
+	// the slot about to be reused was written OVERDRAW_COUNTER_BUFFERS frames
+	// ago; when the GPU has not got to it yet its counters are dropped
+	int slot = view->frame % OVERDRAW_COUNTER_BUFFERS;
+	if (view->fences[slot]) {
+		if (glClientWaitSync(view->fences[slot], 0, 0) != GL_TIMEOUT_EXPIRED)
+			read_counters(view, slot);
+		else {
+			glDeleteSync(view->fences[slot]);
+			view->fences[slot] = 0;
+		}
+	}
+
+	GLuint zero = 0;
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, view->counters[slot]);
+	glClearBufferData(GL_SHADER_STORAGE_BUFFER, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, &zero);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, dst_fbo);
+	glViewport(0, 0, view->width, view->height);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+
+	glUseProgram(view->heatmap_program);
+	glUniform1i(glGetUniformLocation(view->heatmap_program, "counts"), 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, view->count_tex);
+	glBindVertexArray(view->vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+
+	glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, 0);
+	view->fences[slot] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	view->frame++;
+}
+
+bool overdraw_wait_stats(OverdrawView* view)
+{
+	if (view->frame == 0)
+		return false;
+	int slot = (view->frame - 1) % OVERDRAW_COUNTER_BUFFERS;
+	if (!view->fences[slot])
+		return false;
+
+	GLenum result = glClientWaitSync(view->fences[slot], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ull);
+	if (result == GL_TIMEOUT_EXPIRED || result == GL_WAIT_FAILED)
+		return false;
+	read_counters(view, slot);
+	return true;
+}
+
+// 24-bit BMP rows are bottom-up BGR padded to four bytes, which is what
+// glReadPixels() returns for GL_BGR with the default pack alignment.
+static bool
+write_bmp(const char* path, int width, int height, const uint8_t* bgr)
+{
+	uint32_t row = ((uint32_t)width * 3 + 3) & ~3u;
+	uint32_t image_bytes = row * (uint32_t)height;
+	uint8_t header[54] = { 'B', 'M' };
+	uint32_t fields[] = {
+		54 + image_bytes, 0, 54,						// file size, reserved, pixel offset
+		40, (uint32_t)width, (uint32_t)height,			// BITMAPINFOHEADER
+		1 | (24 << 16), 0, image_bytes, 2835, 2835, 0, 0	// planes and bpp, BI_RGB, 72 dpi
+	};
+	memcpy(header + 2, fields, sizeof(fields));
+
+	FILE* f = platform_fopen(path, "wb");
+	if (!f)
+		return false;
+	bool ok = fwrite(header, sizeof(header), 1, f) == 1 && fwrite(bgr, 1, image_bytes, f) == image_bytes;
+	return fclose(f) == 0 && ok;
+}
+
+bool overdraw_export(OverdrawView* view, const char* path)
+{
+	GLuint tex, fbo;
+	glGenTextures(1, &tex);
+	glBindTexture(GL_TEXTURE_2D, tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, view->width, view->height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glGenFramebuffers(1, &fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, tex, 0);
+	bool ok = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+	uint8_t* bgr = NULL;
+	if (ok) {
+		overdraw_present(view, fbo);
+		bgr = (uint8_t*)malloc((size_t)((view->width * 3 + 3) & ~3) * view->height);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+		glPixelStorei(GL_PACK_ALIGNMENT, 4);
+		glReadPixels(0, 0, view->width, view->height, GL_BGR, GL_UNSIGNED_BYTE, bgr);
+		ok = overdraw_wait_stats(view) && write_bmp(path, view->width, view->height, bgr);
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &fbo);
+	glDeleteTextures(1, &tex);
+	free(bgr);
+	if (!ok)
+		printf("Unable to export the overdraw view to %s\n", path);
+	return ok;
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "glad/include/glad.h"
+
+struct ImDrawData;
+
+//----------------------------------------------------------------------------
+//
+//  Overdraw view. Instead of colours, the passes of a frame are drawn with
+//    counting shaders (overdraw.frag) into a single float channel with
+//    additive blending, so every pixel ends up holding the number of
+//    fragments shaded over it. The scene is drawn between overdraw_begin()
+//    and overdraw_end() with count_program in place of the world program;
+//    the ImGui draw lists are counted with their clip rects applied. The
+//    count target has a depth buffer, so passes drawn with the depth test
+//    count only the fragments that pass it.
+//
+//  overdraw_present() turns the counts into a heatmap and, in the same pass,
+//    sums them into a small counter buffer with atomics: fragments shaded,
+//    pixels covered, the deepest pixel and a histogram of layer buckets.
+//    The counters are kept in a ring and read back OVERDRAW_COUNTER_BUFFERS
+//    frames later behind a fence, so the view never stalls the pipeline.
+//    overdraw_export() waits for them instead and writes the heatmap to a
+//    BMP file.
+//
+
+#define OVERDRAW_BUCKETS 8
+#define OVERDRAW_COUNTER_BUFFERS 3
+
+// Layout of the counter buffer written by heatmap.frag.
+typedef struct OverdrawCounters {
+	uint32_t fragments;
+	uint32_t covered_pixels;
+	uint32_t max_layers;
+	uint32_t histogram[OVERDRAW_BUCKETS];
+} OverdrawCounters;
+
+typedef struct OverdrawStats {
+	uint64_t fragments;			// shaded by the counted passes
+	uint32_t pixels;			// in the view
+	uint32_t covered_pixels;	// with at least one fragment
+	uint32_t max_layers;
+	float overdraw;				// fragments per pixel of the view
+	float average_layers;		// fragments per covered pixel
+	uint32_t histogram[OVERDRAW_BUCKETS];	// covered pixels per layer bucket
+} OverdrawStats;
+
+typedef struct OverdrawView {
+	int width;
+	int height;
+	GLuint fbo;
+	GLuint count_tex;
+	GLuint depth_rb;
+
+	GLuint count_program;		// tilegame.vert with overdraw.frag
+	GLuint gui_program;			// overdraw_gui.vert with overdraw.frag
+	GLuint heatmap_program;		// present.vert with heatmap.frag
+	GLuint vao;
+	GLuint gui_vao;
+	GLuint gui_vbo;
+	GLuint gui_ebo;
+
+	GLuint counters[OVERDRAW_COUNTER_BUFFERS];
+	GLsync fences[OVERDRAW_COUNTER_BUFFERS];
+	uint32_t frame;
+	OverdrawStats stats;		// last counters read back
+} OverdrawView;
+
+bool
+overdraw_init(OverdrawView* view, int width, int height, GLuint count_program, GLuint gui_program, GLuint heatmap_program);
+
+// Frees the GL objects except the programs, which belong to the caller.
+void
+overdraw_free(OverdrawView* view);
+
+bool
+overdraw_resize(OverdrawView* view, int width, int height);
+
+// Binds and clears the count target and turns additive blending on. Draw
+// with view->count_program until overdraw_end(), keeping the blend state.
+void
+overdraw_begin(OverdrawView* view);
+
+// Counts the fragments ImGui_ImplOpenGL3_RenderDrawData() would shade.
+void
+overdraw_count_gui(OverdrawView* view, const ImDrawData* draw_data);
+
+void
+overdraw_end(OverdrawView* view);
+
+// Draws the heatmap to 'dst_fbo', which must be at least the view's size.
+void
+overdraw_present(OverdrawView* view, GLuint dst_fbo);
+
+// Waits for the counters of the last heatmap drawn and reads them into
+// view->stats.
+bool
+overdraw_wait_stats(OverdrawView* view);
+
+// Draws the heatmap offscreen and writes it to 'path' as a 24-bit BMP.
+// view->stats holds the counters of that frame afterwards.
+bool
+overdraw_export(OverdrawView* view, const char* path);
+
+// Name ("5-8") and heatmap colour of a layer bucket.
+const char*
+overdraw_bucket_name(int bucket);
+
+const float*
+overdraw_bucket_color(int bucket);
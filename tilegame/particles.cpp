@@ -0,0 +1,420 @@
+#include "stdafx.h"
+#include "particles.h"
+#include "mem_stats.h"
+#include "platform.h"
+
+#include <string.h>
+#include <math.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PARTICLES_SSE2 1
+#endif
+
+#define PARTICLE_CPU_ARRAYS 5
+#define PARTICLE_INSTANCE_FLOATS 4
+
+// Layout of the Particles buffer of particles.comp.
+typedef struct GpuParticle {
+	float pos_x, pos_y;
+	float vel_x, vel_y;
+	float age;
+	uint32_t emitter;
+	uint32_t unused[2];
+} GpuParticle;
+
+static const char* particle_path_names[PARTICLE_PATH_COUNT] = {
+	"GPU compute",
+	"CPU SIMD",
+	"CPU scalar",
+};
+
+const char* particle_path_name(ParticlePath path)
+{
+	return path < PARTICLE_PATH_COUNT ? particle_path_names[path] : "unknown";
+}
+
+// Same hash and launch as particles.comp.
+static inline uint32_t
+hash_u32(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+static inline float
+hash_unit(uint32_t h)
+{
+	return (h >> 8) * (1.0f / 16777216.0f);
+}
+
+static inline void
+launch(ParticleSystem* ps, const ParticleEmitter* e, uint32_t i, uint32_t tick)
+{
+	uint32_t h = hash_u32(i ^ hash_u32(tick));
+	float angle = e->direction + e->spread * (hash_unit(h) - 0.5f);
+	float speed = e->speed * (0.5f + 0.5f * hash_unit(hash_u32(h)));
+	ps->pos_x[i] = e->x;
+	ps->pos_y[i] = e->y;
+	ps->vel_x[i] = cosf(angle) * speed;
+	ps->vel_y[i] = sinf(angle) * speed;
+}
+
+static size_t
+cpu_bytes(uint32_t capacity)
+{
+	return (size_t)capacity * (PARTICLE_CPU_ARRAYS + PARTICLE_INSTANCE_FLOATS) * sizeof(float);
+}
+
+bool particles_init(ParticleSystem* ps, uint32_t capacity, GLuint simulate_program, GLuint render_program)
+{
+	memset(ps, 0, sizeof(*ps));
+	capacity = (capacity + 3) & ~3u;
+	float** arrays[PARTICLE_CPU_ARRAYS] = { &ps->pos_x, &ps->pos_y, &ps->vel_x, &ps->vel_y, &ps->age };
+	bool allocated = true;
+	for (int a = 0; a < PARTICLE_CPU_ARRAYS; a++) {
+		*arrays[a] = (float*)calloc(capacity, sizeof(float));
+		allocated = allocated && *arrays[a];
+	}
+	ps->instances = (float*)calloc((size_t)capacity * PARTICLE_INSTANCE_FLOATS, sizeof(float));
+	if (!allocated || !ps->instances) {
+		particles_free(ps);
+		return false;
+	}
+	ps->capacity = capacity;
+	ps->simulate_program = simulate_program;
+	ps->render_program = render_program;
+	ps->path = simulate_program ? PARTICLE_PATH_GPU : PARTICLE_PATH_CPU_SIMD;
+	mem_track_alloc(MEM_CPU_PARTICLES, cpu_bytes(capacity));
+
+	size_t state_bytes = (size_t)capacity * sizeof(GpuParticle);
+	size_t instance_bytes = (size_t)capacity * PARTICLE_INSTANCE_FLOATS * sizeof(float);
+	glGenBuffers(1, &ps->state_ssbo);
+	glGenBuffers(1, &ps->instance_ssbo);
+	glGenBuffers(1, &ps->emitter_ssbo);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, ps->state_ssbo);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, state_bytes, NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, ps->emitter_ssbo);
+	glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(ps->emitters), NULL, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+	mem_track_object(MEM_GL_VERTEX_BUFFERS, ps->state_ssbo, state_bytes);
+	mem_track_object(MEM_GL_VERTEX_BUFFERS, ps->instance_ssbo, instance_bytes);
+	mem_track_object(MEM_GL_VERTEX_BUFFERS, ps->emitter_ssbo, sizeof(ps->emitters));
+
+	// particle.vert: position and age per instance, then the packed colour
+	glGenVertexArrays(1, &ps->vao);
+	glBindVertexArray(ps->vao);
+	glBindBuffer(GL_ARRAY_BUFFER, ps->instance_ssbo);
+	glBufferData(GL_ARRAY_BUFFER, instance_bytes, NULL, GL_STREAM_DRAW);
+	GLsizei stride = PARTICLE_INSTANCE_FLOATS * sizeof(float);
+	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, stride, (void*)0);
+	glVertexAttribIPointer(1, 1, GL_UNSIGNED_INT, stride, (void*)(3 * sizeof(float)));
+	glVertexAttribDivisor(0, 1);
+	glVertexAttribDivisor(1, 1);
+	glEnableVertexAttribArray(0);
+	glEnableVertexAttribArray(1);
+	glBindVertexArray(0);
+
+	glGenQueries(PARTICLE_QUERY_FRAMES * 4, &ps->queries[0][0]);
+	return true;
+}
+
+void particles_free(ParticleSystem* ps)
+{
+	if (ps->capacity)
+		mem_track_free(MEM_CPU_PARTICLES, cpu_bytes(ps->capacity));
+	GLuint buffers[3] = { ps->state_ssbo, ps->instance_ssbo, ps->emitter_ssbo };
+	for (int i = 0; i < 3; i++) {
+		if (buffers[i]) {
+			mem_untrack_object(MEM_GL_VERTEX_BUFFERS, buffers[i]);
+			glDeleteBuffers(1, &buffers[i]);
+		}
+	}
+	if (ps->vao)
+		glDeleteVertexArrays(1, &ps->vao);
+	if (ps->queries[0][0])
+		glDeleteQueries(PARTICLE_QUERY_FRAMES * 4, &ps->queries[0][0]);
+	free(ps->pos_x);
+	free(ps->pos_y);
+	free(ps->vel_x);
+	free(ps->vel_y);
+	free(ps->age);
+	free(ps->instances);
+	memset(ps, 0, sizeof(*ps));
+}
+
+// Every particle of an emitter waits a random part of a lifetime before it
+// is first launched.
+static void
+reset_emitter(ParticleSystem* ps, const ParticleEmitter* e)
+{
+	for (uint32_t i = e->first; i < e->first + e->count; i++) {
+		launch(ps, e, i, 0);
+		ps->age[i] = -e->lifetime * hash_unit(hash_u32(i + 0x68bc21ebu));
+	}
+	ps->state_dirty = true;
+}
+
+int particles_add_emitter(ParticleSystem* ps, const ParticleEmitter* emitter, uint32_t count)
+{
+	count = (count + 3) & ~3u;
+	if (ps->emitter_count == PARTICLE_MAX_EMITTERS || count > ps->capacity - ps->count)
+		return -1;
+
+	int index = (int)ps->emitter_count++;
+	ParticleEmitter* e = &ps->emitters[index];
+	*e = *emitter;
+	e->size = e->size < 255 ? e->size : 255;
+	e->first = ps->count;
+	e->count = count;
+	ps->count += count;
+	ps->emitters_dirty = true;
+	reset_emitter(ps, e);
+	return index;
+}
+
+void particles_move_emitter(ParticleSystem* ps, int index, float x, float y)
+{
+	ps->emitters[index].x = x;
+	ps->emitters[index].y = y;
+	ps->emitters_dirty = true;
+}
+
+void particles_reset(ParticleSystem* ps)
+{
+	for (uint32_t e = 0; e < ps->emitter_count; e++)
+		reset_emitter(ps, &ps->emitters[e]);
+	ps->tick = 0;
+}
+
+void particles_set_path(ParticleSystem* ps, ParticlePath path)
+{
+	if (path == PARTICLE_PATH_GPU && !ps->simulate_program)
+		path = PARTICLE_PATH_CPU_SIMD;
+	ps->path = path;
+	particles_reset(ps);
+}
+
+uint32_t particles_idle_frame_ms(const ParticleSystem* ps, int view_width, int view_height, double since_ms)
+{
+	bool visible = false;
+	for (uint32_t i = 0; i < ps->emitter_count && !visible; i++) {
+		const ParticleEmitter* e = &ps->emitters[i];
+		if (!e->count)
+			continue;
+		// farthest a particle gets from its emitter over one lifetime
+		float reach = e->speed * e->lifetime + 0.5f * fabsf(e->gravity) * e->lifetime * e->lifetime + e->size;
+		visible = e->x + reach > 0.0f && e->y + reach > 0.0f && e->x - reach < view_width && e->y - reach < view_height;
+	}
+	if (!visible)
+		return PARTICLE_NO_FRAME;
+
+	double interval_ms = 1000.0 / PARTICLE_IDLE_FPS;
+	return since_ms >= interval_ms ? 0 : (uint32_t)ceil(interval_ms - since_ms);
+}
+
+static inline void
+pack_instance(float* out, float x, float y, float t, uint32_t packed)
+{
+	out[0] = x;
+	out[1] = y;
+	out[2] = t;
+	memcpy(&out[3], &packed, sizeof(packed));
+}
+
+// Particles wait without moving until their age reaches zero.
+static void
+simulate_scalar(ParticleSystem* ps, const ParticleEmitter* e, uint32_t first, uint32_t last, float dt)
+{
+	float g_dt = e->gravity * dt, inv_lifetime = 1.0f / e->lifetime;
+	uint32_t packed = e->color | e->size << 24;
+	for (uint32_t i = first; i < last; i++) {
+		if (ps->age[i] >= 0.0f) {
+			ps->vel_y[i] += g_dt;
+			ps->pos_x[i] += ps->vel_x[i] * dt;
+			ps->pos_y[i] += ps->vel_y[i] * dt;
+		}
+		ps->age[i] += dt;
+		if (ps->age[i] >= e->lifetime) {
+			ps->age[i] -= e->lifetime;
+			launch(ps, e, i, ps->tick);
+		}
+		pack_instance(&ps->instances[(size_t)i * PARTICLE_INSTANCE_FLOATS], ps->pos_x[i], ps->pos_y[i], ps->age[i] * inv_lifetime, packed);
+	}
+}
+
+#ifdef PARTICLES_SSE2
+// simulate_scalar() four particles at a time. The few particles that are
+// launched again this step are handled one by one, then the four are
+// transposed into their instances.
+static void
+simulate_sse2(ParticleSystem* ps, const ParticleEmitter* e, uint32_t first, uint32_t last, float dt)
+{
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 dt4 = _mm_set1_ps(dt);
+	const __m128 g_dt = _mm_set1_ps(e->gravity * dt);
+	const __m128 lifetime = _mm_set1_ps(e->lifetime);
+	const __m128 inv_lifetime = _mm_set1_ps(1.0f / e->lifetime);
+	const __m128 packed = _mm_castsi128_ps(_mm_set1_epi32((int)(e->color | e->size << 24)));
+
+	for (uint32_t i = first; i < last; i += 4) {
+		__m128 px = _mm_loadu_ps(ps->pos_x + i), py = _mm_loadu_ps(ps->pos_y + i);
+		__m128 vx = _mm_loadu_ps(ps->vel_x + i), vy = _mm_loadu_ps(ps->vel_y + i);
+		__m128 age = _mm_loadu_ps(ps->age + i);
+
+		__m128 live = _mm_cmpge_ps(age, zero);
+		__m128 step = _mm_and_ps(live, dt4);
+		vy = _mm_add_ps(vy, _mm_and_ps(live, g_dt));
+		px = _mm_add_ps(px, _mm_mul_ps(vx, step));
+		py = _mm_add_ps(py, _mm_mul_ps(vy, step));
+		age = _mm_add_ps(age, dt4);
+		_mm_storeu_ps(ps->pos_x + i, px);
+		_mm_storeu_ps(ps->pos_y + i, py);
+		_mm_storeu_ps(ps->vel_y + i, vy);
+
+		int expired = _mm_movemask_ps(_mm_cmpge_ps(age, lifetime));
+		if (expired) {
+			age = _mm_sub_ps(age, _mm_and_ps(_mm_cmpge_ps(age, lifetime), lifetime));
+			_mm_storeu_ps(ps->age + i, age);
+			for (int lane = 0; lane < 4; lane++) {
+				if (expired & (1 << lane))
+					launch(ps, e, i + lane, ps->tick);
+			}
+			px = _mm_loadu_ps(ps->pos_x + i);
+			py = _mm_loadu_ps(ps->pos_y + i);
+		} else {
+			_mm_storeu_ps(ps->age + i, age);
+		}
+
+		__m128 r0 = px, r1 = py, r2 = _mm_mul_ps(age, inv_lifetime), r3 = packed;
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		float* out = &ps->instances[(size_t)i * PARTICLE_INSTANCE_FLOATS];
+		_mm_storeu_ps(out, r0);
+		_mm_storeu_ps(out + 4, r1);
+		_mm_storeu_ps(out + 8, r2);
+		_mm_storeu_ps(out + 12, r3);
+	}
+}
+#endif // PARTICLES_SSE2
+
+static void
+upload_state(ParticleSystem* ps)
+{
+	GpuParticle* state = (GpuParticle*)malloc((size_t)ps->count * sizeof(GpuParticle));
+	if (!state)
+		return;
+	for (uint32_t e = 0; e < ps->emitter_count; e++) {
+		const ParticleEmitter* emitter = &ps->emitters[e];
+		for (uint32_t i = emitter->first; i < emitter->first + emitter->count; i++) {
+			GpuParticle p = { ps->pos_x[i], ps->pos_y[i], ps->vel_x[i], ps->vel_y[i], ps->age[i], e, { 0, 0 } };
+			state[i] = p;
+		}
+	}
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, ps->state_ssbo);
+	glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, (size_t)ps->count * sizeof(GpuParticle), state);
+	free(state);
+	ps->state_dirty = false;
+}
+
+static void
+simulate_gpu(ParticleSystem* ps, float dt)
+{
+	if (ps->emitters_dirty) {
+		glBindBuffer(GL_SHADER_STORAGE_BUFFER, ps->emitter_ssbo);
+		glBufferSubData(GL_SHADER_STORAGE_BUFFER, 0, ps->emitter_count * sizeof(ParticleEmitter), ps->emitters);
+		ps->emitters_dirty = false;
+	}
+	if (ps->state_dirty)
+		upload_state(ps);
+	glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+
+	GLuint program = ps->simulate_program;
+	glUseProgram(program);
+	glUniform1ui(glGetUniformLocation(program, "count"), ps->count);
+	glUniform1ui(glGetUniformLocation(program, "tick"), ps->tick);
+	glUniform1f(glGetUniformLocation(program, "dt"), dt);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, ps->state_ssbo);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, ps->instance_ssbo);
+	glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, ps->emitter_ssbo);
+	glDispatchCompute((ps->count + PARTICLE_GROUP_SIZE - 1) / PARTICLE_GROUP_SIZE, 1, 1);
+	glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_SHADER_STORAGE_BARRIER_BIT);
+	for (int i = 0; i < 3; i++)
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, i, 0);
+}
+
+// Timestamps of the frame about to reuse the slot, when they have landed.
+static void
+read_queries(ParticleSystem* ps)
+{
+	if (ps->query_frame < PARTICLE_QUERY_FRAMES)
+		return;
+	GLuint* q = ps->queries[ps->query_frame % PARTICLE_QUERY_FRAMES];
+	GLint available = 0;
+	glGetQueryObjectiv(q[3], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+		return;
+
+	GLuint64 ns[4];
+	for (int i = 0; i < 4; i++)
+		glGetQueryObjectui64v(q[i], GL_QUERY_RESULT, &ns[i]);
+	ps->stats.simulate_ms = (float)((ns[1] - ns[0]) / 1000000.0);
+	ps->stats.render_ms = (float)((ns[3] - ns[2]) / 1000000.0);
+}
+
+void particles_simulate(ParticleSystem* ps, float dt)
+{
+	read_queries(ps);
+	GLuint* q = ps->queries[ps->query_frame % PARTICLE_QUERY_FRAMES];
+	ps->stats.particles = ps->count;
+	ps->stats.emitters = ps->emitter_count;
+	ps->tick++;
+
+	glQueryCounter(q[0], GL_TIMESTAMP);
+	if (ps->path == PARTICLE_PATH_GPU) {
+		simulate_gpu(ps, dt);
+		ps->stats.cpu_simulate_ms = 0.0f;
+	} else {
+		double start = platform_time_us();
+		for (uint32_t e = 0; e < ps->emitter_count; e++) {
+			const ParticleEmitter* emitter = &ps->emitters[e];
+#ifdef PARTICLES_SSE2
+			if (ps->path == PARTICLE_PATH_CPU_SIMD) {
+				simulate_sse2(ps, emitter, emitter->first, emitter->first + emitter->count, dt);
+				continue;
+			}
+#endif
+			simulate_scalar(ps, emitter, emitter->first, emitter->first + emitter->count, dt);
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, ps->instance_ssbo);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, (size_t)ps->count * PARTICLE_INSTANCE_FLOATS * sizeof(float), ps->instances);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		// the GPU state no longer matches
+		ps->state_dirty = true;
+		ps->stats.cpu_simulate_ms = (float)((platform_time_us() - start) / 1000.0);
+	}
+	glQueryCounter(q[1], GL_TIMESTAMP);
+}
+
+void particles_render(ParticleSystem* ps, int view_width, int view_height)
+{
+	GLuint* q = ps->queries[ps->query_frame % PARTICLE_QUERY_FRAMES];
+	glQueryCounter(q[2], GL_TIMESTAMP);
+
+	if (ps->count) {
+		glEnable(GL_BLEND);
+		glBlendFunc(GL_SRC_ALPHA, GL_ONE);
+		glUseProgram(ps->render_program);
+		glUniform2f(glGetUniformLocation(ps->render_program, "view_size"), (float)view_width, (float)view_height);
+		glBindVertexArray(ps->vao);
+		glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, (GLsizei)ps->count);
+		glBindVertexArray(0);
+		glDisable(GL_BLEND);
+	}
+
+	glQueryCounter(q[3], GL_TIMESTAMP);
+	ps->query_frame++;
+}
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "glad/include/glad.h"
+
+//----------------------------------------------------------------------------
+//
+//  Particle effects. Every emitter owns a fixed range of the particle pool
+//    and keeps it full: a particle that outlives its emitter's lifetime is
+//    launched again from the emitter with a new hashed direction and
+//    speed, so nothing is allocated or compacted while the effect runs and
+//    each particle can be updated on its own. Particles start with a
+//    negative age spread over one lifetime, so an emitter ramps up evenly.
+//
+//  PARTICLE_PATH_GPU simulates in particles.comp on shader storage buffers.
+//    The CPU paths keep the particles as separate arrays of floats and
+//    update them four at a time with SSE2 (PARTICLE_PATH_CPU_SIMD) or one
+//    at a time (PARTICLE_PATH_CPU_SCALAR), for headless runs and software
+//    GL. Every path ends with the same instance buffer, one vec4 per
+//    particle (position, age over lifetime, then the colour and size
+//    packed in the bits of w), which particle.vert expands into instanced
+//    quads blended additively.
+//
+//  Simulate and render times are read back from GL timestamps
+//    PARTICLE_QUERY_FRAMES frames later; the CPU paths also time their
+//    update and upload on the CPU.
+//
+
+#define PARTICLE_MAX_EMITTERS 1024
+#define PARTICLE_GROUP_SIZE 256
+#define PARTICLE_QUERY_FRAMES 4
+#define PARTICLE_IDLE_FPS 10
+#define PARTICLE_NO_FRAME UINT32_MAX
+
+typedef enum ParticlePath {
+	PARTICLE_PATH_GPU,
+	PARTICLE_PATH_CPU_SIMD,
+	PARTICLE_PATH_CPU_SCALAR,
+	PARTICLE_PATH_COUNT
+} ParticlePath;
+
+// Layout matches the Emitters buffer of particles.comp.
+typedef struct ParticleEmitter {
+	float x, y;					// view pixels, y down
+	float direction;			// radians, 0 along +x
+	float spread;				// radians around the direction
+	float speed;				// pixels per second, the fastest launch
+	float lifetime;				// seconds
+	float gravity;				// pixels per second squared, down
+	uint32_t color;				// 0xBBGGRR
+	uint32_t size;				// pixels, at most 255
+	uint32_t first;				// range of the pool, set by particles_add_emitter()
+	uint32_t count;
+	uint32_t unused;
+} ParticleEmitter;
+
+typedef struct ParticleStats {
+	uint32_t particles;
+	uint32_t emitters;
+	float simulate_ms;			// GPU time of the simulate step
+	float render_ms;			// GPU time of the draw
+	float cpu_simulate_ms;		// CPU time of the update and upload
+} ParticleStats;
+
+typedef struct ParticleSystem {
+	ParticlePath path;
+	uint32_t capacity;
+	uint32_t count;				// particles owned by emitters
+	ParticleEmitter emitters[PARTICLE_MAX_EMITTERS];
+	uint32_t emitter_count;
+	bool emitters_dirty;
+	bool state_dirty;			// the GPU state needs the initial particles
+	uint32_t tick;
+
+	// CPU paths, one entry per particle
+	float* pos_x;
+	float* pos_y;
+	float* vel_x;
+	float* vel_y;
+	float* age;
+	float* instances;			// 4 floats per particle
+
+	GLuint state_ssbo;
+	GLuint instance_ssbo;
+	GLuint emitter_ssbo;
+	GLuint vao;
+	GLuint simulate_program;	// particles.comp, 0 without compute shaders
+	GLuint render_program;		// particle.vert with particle.frag
+
+	GLuint queries[PARTICLE_QUERY_FRAMES][4];
+	uint32_t query_frame;
+	ParticleStats stats;
+} ParticleSystem;
+
+// 'simulate_program' may be 0, which leaves only the CPU paths.
+bool
+particles_init(ParticleSystem* ps, uint32_t capacity, GLuint simulate_program, GLuint render_program);
+
+// Frees the GL objects except the programs, which belong to the caller.
+void
+particles_free(ParticleSystem* ps);
+
+// Gives the emitter 'count' particles of the pool, rounded up to a multiple
+// of four. Returns its index, or -1 when the pool or the emitter table is
+// full.
+int
+particles_add_emitter(ParticleSystem* ps, const ParticleEmitter* emitter, uint32_t count);
+
+void
+particles_move_emitter(ParticleSystem* ps, int index, float x, float y);
+
+// Restarts every particle, as when the system was created.
+void
+particles_reset(ParticleSystem* ps);
+
+// Falls back to a CPU path when there is no compute program.
+void
+particles_set_path(ParticleSystem* ps, ParticlePath path);
+
+// Milliseconds until the particles want another frame of an otherwise idle
+// view_width x view_height view, 'since_ms' after the last frame drawn: 0
+// when one is due, PARTICLE_NO_FRAME when no emitter's particles can reach
+// the view. Particles alone redraw an idle view PARTICLE_IDLE_FPS times a
+// second, so the frame loop still blocks between those frames.
+uint32_t
+particles_idle_frame_ms(const ParticleSystem* ps, int view_width, int view_height, double since_ms);
+
+// Advances every particle by 'dt' seconds and fills the instance buffer.
+void
+particles_simulate(ParticleSystem* ps, float dt);
+
+// Draws the particles into the bound framebuffer, whose viewport covers a
+// view_width x view_height view. Blending is off afterwards.
+void
+particles_render(ParticleSystem* ps, int view_width, int view_height);
+
+const char*
+particle_path_name(ParticlePath path);
@@ -0,0 +1,227 @@
+#include "stdafx.h"
+#include "platform.h"
+
+#include <string.h>
+
+#ifdef _WIN32
+#include <Windows.h>
+#include <direct.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+double platform_time_us()
+{
+#ifdef _WIN32
+	static LARGE_INTEGER frequency;
+	if (!frequency.QuadPart)
+		QueryPerformanceFrequency(&frequency);
+	LARGE_INTEGER now;
+	QueryPerformanceCounter(&now);
+	return (double)now.QuadPart * 1000000.0 / (double)frequency.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec * 1000000.0 + (double)ts.tv_nsec / 1000.0;
+#endif
+}
+
+uint64_t platform_process_cpu_us()
+{
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		return 0;
+	ULARGE_INTEGER k, u;
+	k.LowPart = kernel.dwLowDateTime;
+	k.HighPart = kernel.dwHighDateTime;
+	u.LowPart = user.dwLowDateTime;
+	u.HighPart = user.dwHighDateTime;
+	// FILETIME counts 100ns intervals
+	return (k.QuadPart + u.QuadPart) / 10;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+#endif
+}
+
+FILE* platform_fopen(const char* path, const char* mode)
+{
+#ifdef _WIN32
+	FILE* file = NULL;
+	if (fopen_s(&file, path, mode) != 0)
+		return NULL;
+	return file;
+#else
+	return fopen(path, mode);
+#endif
+}
+
+uint8_t* platform_read_file(const char* path, size_t* size)
+{
+	FILE* file = platform_fopen(path, "rb");
+	if (!file)
+		return NULL;
+
+	fseek(file, 0, SEEK_END);
+	long len = ftell(file);
+	fseek(file, 0, SEEK_SET);
+
+	uint8_t* data = len >= 0 ? (uint8_t*)malloc((size_t)len + 1) : NULL;
+	bool read = data && fread(data, 1, (size_t)len, file) == (size_t)len;
+	fclose(file);
+
+	if (!read) {
+		free(data);
+		return NULL;
+	}
+	data[len] = 0;
+	*size = (size_t)len;
+	return data;
+}
+
+bool platform_file_size(const char* path, uint64_t* size)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data) || (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+		return false;
+	*size = ((uint64_t)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+#else
+	struct stat st;
+	if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+		return false;
+	*size = (uint64_t)st.st_size;
+#endif
+	return true;
+}
+
+bool platform_file_mtime(const char* path, uint64_t* mtime)
+{
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExA(path, GetFileExInfoStandard, &data) || (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY))
+		return false;
+	*mtime = ((uint64_t)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+#else
+	struct stat st;
+	if (stat(path, &st) != 0 || !S_ISREG(st.st_mode))
+		return false;
+	*mtime = (uint64_t)st.st_mtim.tv_sec * 1000000000 + (uint64_t)st.st_mtim.tv_nsec;
+#endif
+	return true;
+}
+
+bool platform_replace_file(const char* from, const char* to)
+{
+#ifdef _WIN32
+	return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	return rename(from, to) == 0;
+#endif
+}
+
+bool platform_map_file(const char* path, PlatformMapping* mapping)
+{
+	memset(mapping, 0, sizeof(*mapping));
+#ifdef _WIN32
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+	LARGE_INTEGER size;
+	HANDLE map = NULL;
+	if (GetFileSizeEx(file, &size) && size.QuadPart > 0)
+		map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!map)
+		return false;
+	void* data = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+	if (!data) {
+		CloseHandle(map);
+		return false;
+	}
+	mapping->handle = map;
+	mapping->size = (size_t)size.QuadPart;
+#else
+	int fd = open(path, O_RDONLY);
+	if (fd < 0)
+		return false;
+	struct stat st;
+	void* data = MAP_FAILED;
+	if (fstat(fd, &st) == 0 && st.st_size > 0)
+		data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED)
+		return false;
+	mapping->size = (size_t)st.st_size;
+#endif
+	mapping->data = (const uint8_t*)data;
+	return true;
+}
+
+void platform_unmap_file(PlatformMapping* mapping)
+{
+	if (!mapping->data)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(mapping->data);
+	CloseHandle((HANDLE)mapping->handle);
+#else
+	munmap((void*)mapping->data, mapping->size);
+#endif
+	memset(mapping, 0, sizeof(*mapping));
+}
+
+static bool
+is_directory(const char* path)
+{
+#ifdef _WIN32
+	DWORD attributes = GetFileAttributesA(path);
+	return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+#else
+	struct stat st;
+	return stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+#endif
+}
+
+bool platform_find_resources(const char* dir)
+{
+	if (is_directory(dir))
+		return true;
+
+	char exe_dir[1024];
+#ifdef _WIN32
+	DWORD len = GetModuleFileNameA(NULL, exe_dir, sizeof(exe_dir));
+	if (len == 0 || len >= sizeof(exe_dir))
+		return false;
+#else
+	ssize_t len = readlink("/proc/self/exe", exe_dir, sizeof(exe_dir) - 1);
+	if (len <= 0)
+		return false;
+	exe_dir[len] = 0;
+#endif
+
+	char* slash = strrchr(exe_dir, '/');
+	char* backslash = strrchr(exe_dir, '\\');
+	if (backslash > slash)
+		slash = backslash;
+	if (!slash)
+		return false;
+	*slash = 0;
+
+	char candidate[1280];
+	snprintf(candidate, sizeof(candidate), "%s/%s", exe_dir, dir);
+	if (!is_directory(candidate))
+		return false;
+
+#ifdef _WIN32
+	return _chdir(exe_dir) == 0;
+#else
+	return chdir(exe_dir) == 0;
+#endif
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+//----------------------------------------------------------------------------
+//
+//  Platform layer. The rest of the game is written against these functions
+//    instead of Win32 or POSIX directly: the entry point, file access and
+//    clocks. platform_main.cpp holds the per-platform entry point (WinMain
+//    or main) and hands over to game_main().
+//
+//  Paths are always written with forward slashes, which Windows accepts
+//    as well.
+//
+
+// Read-only view of a whole file mapped into memory.
+typedef struct PlatformMapping {
+	const uint8_t* data;
+	size_t size;
+	void* handle;				// file mapping object on Windows
+} PlatformMapping;
+
+// Implemented by the game, called from the platform entry point.
+int
+game_main(int argc, char** argv);
+
+// Monotonic wall clock in microseconds.
+double
+platform_time_us();
+
+// CPU time (user + kernel) used by the whole process, in microseconds.
+uint64_t
+platform_process_cpu_us();
+
+FILE*
+platform_fopen(const char* path, const char* mode);
+
+// Reads a whole file into a malloc'd buffer followed by a 0 byte that is not
+// counted in 'size'. Returns NULL when the file cannot be read.
+uint8_t*
+platform_read_file(const char* path, size_t* size);
+
+bool
+platform_file_size(const char* path, uint64_t* size);
+
+// Last write time in platform units, only good for comparing with itself.
+bool
+platform_file_mtime(const char* path, uint64_t* mtime);
+
+// Moves 'from' over 'to', replacing it in one step, so that readers of 'to'
+// see either the old file or the new one.
+bool
+platform_replace_file(const char* from, const char* to);
+
+// Empty files cannot be mapped and fail like missing ones.
+bool
+platform_map_file(const char* path, PlatformMapping* mapping);
+
+void
+platform_unmap_file(PlatformMapping* mapping);
+
+// Makes relative paths under 'dir' resolve when the game is started from
+// somewhere else: when 'dir' is not in the working directory but next to
+// the executable, changes to the executable's directory.
+bool
+platform_find_resources(const char* dir);
@@ -0,0 +1,22 @@
+#include "stdafx.h"
+#include "platform.h"
+
+// stdafx.h undefines SDL's main, so each platform has its own entry point.
+// Resources are looked up relative to the working directory; starting the
+// game from elsewhere falls back to the directory of the executable.
+
+#ifdef _WIN32
+#include <Windows.h>
+
+int WINAPI WinMain(_In_ HINSTANCE hInstance, _In_opt_ HINSTANCE hPrevInstance, _In_ LPSTR lpCmdLine, _In_ int nShowCmd)
+{
+	platform_find_resources("Resources");
+	return game_main(__argc, __argv);
+}
+#else
+int main(int argc, char** argv)
+{
+	platform_find_resources("Resources");
+	return game_main(argc, argv);
+}
+#endif
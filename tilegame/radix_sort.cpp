@@ -0,0 +1,55 @@
+#include "stdafx.h"
+#include "radix_sort.h"
+
+#include <string.h>
+
+int radix_sort_u64(uint64_t* keys, uint32_t* values, uint32_t count, uint64_t* scratch_keys, uint32_t* scratch_values)
+{
+	uint32_t histograms[RADIX_SORT_PASSES][RADIX_SORT_BUCKETS];
+	memset(histograms, 0, sizeof(histograms));
+	for (uint32_t i = 0; i < count; i++) {
+		uint64_t key = keys[i];
+		for (int p = 0; p < RADIX_SORT_PASSES; p++)
+			histograms[p][(key >> (p * RADIX_SORT_BITS)) & (RADIX_SORT_BUCKETS - 1)]++;
+	}
+
+	uint64_t* src_keys = keys;
+	uint32_t* src_values = values;
+	uint64_t* dst_keys = scratch_keys;
+	uint32_t* dst_values = scratch_values;
+	int passes = 0;
+
+	for (int p = 0; p < RADIX_SORT_PASSES; p++) {
+		uint32_t* histogram = histograms[p];
+		int shift = p * RADIX_SORT_BITS;
+		if (count == 0 || histogram[(src_keys[0] >> shift) & (RADIX_SORT_BUCKETS - 1)] == count)
+			continue;
+
+		// bucket counts become the first output slot of each bucket
+		uint32_t offset = 0;
+		for (int b = 0; b < RADIX_SORT_BUCKETS; b++) {
+			uint32_t n = histogram[b];
+			histogram[b] = offset;
+			offset += n;
+		}
+		for (uint32_t i = 0; i < count; i++) {
+			uint32_t slot = histogram[(src_keys[i] >> shift) & (RADIX_SORT_BUCKETS - 1)]++;
+			dst_keys[slot] = src_keys[i];
+			dst_values[slot] = src_values[i];
+		}
+
+		uint64_t* tmp_keys = src_keys;
+		uint32_t* tmp_values = src_values;
+		src_keys = dst_keys;
+		src_values = dst_values;
+		dst_keys = tmp_keys;
+		dst_values = tmp_values;
+		passes++;
+	}
+
+	if (src_keys != keys) {
+		memcpy(keys, src_keys, (size_t)count * sizeof(uint64_t));
+		memcpy(values, src_values, (size_t)count * sizeof(uint32_t));
+	}
+	return passes;
+}
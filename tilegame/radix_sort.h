@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+//----------------------------------------------------------------------------
+//
+//  LSD radix sort of 64-bit keys carrying a 32-bit value each, used to
+//    order draw items every frame in O(n). All eight byte histograms are
+//    counted in one read of the keys; a pass whose byte is the same for
+//    every key would not move anything and is skipped, so keys that only
+//    use a few of their bits (a small texture id, a handful of layers)
+//    cost only the passes they need. Each pass is stable, and so is the
+//    whole sort: equal keys keep their input order.
+//
+//  The caller provides scratch arrays of 'count' entries; nothing is
+//    allocated.
+//
+
+#define RADIX_SORT_BITS 8
+#define RADIX_SORT_BUCKETS (1 << RADIX_SORT_BITS)
+#define RADIX_SORT_PASSES (64 / RADIX_SORT_BITS)
+
+// Sorts 'keys' ascending and moves 'values' with them. Returns the number
+// of passes that moved data.
+int
+radix_sort_u64(uint64_t* keys, uint32_t* values, uint32_t count, uint64_t* scratch_keys, uint32_t* scratch_values);
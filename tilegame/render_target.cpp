@@ -0,0 +1,288 @@
+#include "stdafx.h"
+#include "render_target.h"
+#include "mem_stats.h"
+
+#include <math.h>
+#include <string.h>
+
+// Renderbuffers share MEM_GL_TEXTURES with textures, so their ids are
+// moved out of the texture id range.
+#define RENDERBUFFER_MEM_ID(id) ((uint64_t)(id) | (1ull << 32))
+
+// Fraction of the way to the ideal scale taken per update, and the smallest
+// change worth making; together they keep the scale from oscillating.
+#define RESOLUTION_SCALER_DAMPING 0.5f
+#define RESOLUTION_SCALER_MIN_STEP 0.02f
+#define RESOLUTION_SCALER_SMOOTHING 0.2f
+
+static const char* aa_names[AA_MODE_COUNT] = {
+	"none",
+	"MSAA 2x",
+	"MSAA 4x",
+	"MSAA 8x",
+	"FXAA",
+};
+
+static int
+aa_samples(AntiAliasing aa)
+{
+	switch (aa) {
+	case AA_MSAA_2X: return 2;
+	case AA_MSAA_4X: return 4;
+	case AA_MSAA_8X: return 8;
+	default: return 0;
+	}
+}
+
+const char* render_target_aa_name(AntiAliasing aa)
+{
+	return aa < AA_MODE_COUNT ? aa_names[aa] : "unknown";
+}
+
+static GLuint
+create_renderbuffer(GLenum format, int samples, int width, int height, int bytes_per_pixel)
+{
+	GLuint rb;
+	glGenRenderbuffers(1, &rb);
+	glBindRenderbuffer(GL_RENDERBUFFER, rb);
+	if (samples > 0)
+		glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, format, width, height);
+	else
+		glRenderbufferStorage(GL_RENDERBUFFER, format, width, height);
+
+	size_t bytes = mem_texture_bytes(width, height, bytes_per_pixel, false) * (samples > 0 ? samples : 1);
+	mem_track_object(MEM_GL_TEXTURES, RENDERBUFFER_MEM_ID(rb), bytes);
+	return rb;
+}
+
+static void
+delete_renderbuffer(GLuint* rb)
+{
+	if (!*rb)
+		return;
+	mem_untrack_object(MEM_GL_TEXTURES, RENDERBUFFER_MEM_ID(*rb));
+	glDeleteRenderbuffers(1, rb);
+	*rb = 0;
+}
+
+static void
+free_attachments(RenderTarget* target)
+{
+	if (target->color_tex) {
+		mem_untrack_object(MEM_GL_TEXTURES, target->color_tex);
+		glDeleteTextures(1, &target->color_tex);
+		target->color_tex = 0;
+	}
+	delete_renderbuffer(&target->depth_rb);
+	delete_renderbuffer(&target->msaa_color_rb);
+	delete_renderbuffer(&target->msaa_depth_rb);
+
+	if (target->fbo)
+		glDeleteFramebuffers(1, &target->fbo);
+	if (target->msaa_fbo)
+		glDeleteFramebuffers(1, &target->msaa_fbo);
+	target->fbo = target->msaa_fbo = 0;
+}
+
+static bool
+alloc_attachments(RenderTarget* target)
+{
+	int w = target->max_width, h = target->max_height;
+
+	GLint max_samples = 0;
+	glGetIntegerv(GL_MAX_SAMPLES, &max_samples);
+	target->samples = aa_samples(target->aa);
+	if (target->samples > max_samples)
+		target->samples = max_samples;
+
+	glGenTextures(1, &target->color_tex);
+	glBindTexture(GL_TEXTURE_2D, target->color_tex);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	mem_track_object(MEM_GL_TEXTURES, target->color_tex, mem_texture_bytes(w, h, 4, false));
+
+	target->depth_rb = create_renderbuffer(GL_DEPTH24_STENCIL8, 0, w, h, 4);
+
+	glGenFramebuffers(1, &target->fbo);
+	glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, target->color_tex, 0);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, target->depth_rb);
+	bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+
+	if (complete && target->samples > 0) {
+		target->msaa_color_rb = create_renderbuffer(GL_RGBA8, target->samples, w, h, 4);
+		target->msaa_depth_rb = create_renderbuffer(GL_DEPTH24_STENCIL8, target->samples, w, h, 4);
+
+		glGenFramebuffers(1, &target->msaa_fbo);
+		glBindFramebuffer(GL_FRAMEBUFFER, target->msaa_fbo);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target->msaa_color_rb);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, target->msaa_depth_rb);
+		complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+
+	if (!complete) {
+		printf("Render target %dx%d (%s) is incomplete\n", w, h, render_target_aa_name(target->aa));
+		free_attachments(target);
+		return false;
+	}
+	return true;
+}
+
+bool render_target_init(RenderTarget* target, int width, int height, AntiAliasing aa, GLuint present_program, GLuint fxaa_program)
+{
+	memset(target, 0, sizeof(*target));
+	target->present_program = present_program;
+	target->fxaa_program = fxaa_program;
+
+	// the present pass generates its full-screen triangle from gl_VertexID,
+	// but core profile still needs a vertex array bound to draw
+	glGenVertexArrays(1, &target->vao);
+	glGenQueries(RENDER_TARGET_QUERIES, target->queries);
+	glGenQueries(RENDER_TARGET_QUERIES, target->sample_queries);
+
+	return render_target_resize(target, width, height, aa);
+}
+
+void render_target_free(RenderTarget* target)
+{
+	free_attachments(target);
+	if (target->vao)
+		glDeleteVertexArrays(1, &target->vao);
+	if (target->queries[0])
+		glDeleteQueries(RENDER_TARGET_QUERIES, target->queries);
+	if (target->sample_queries[0])
+		glDeleteQueries(RENDER_TARGET_QUERIES, target->sample_queries);
+	memset(target, 0, sizeof(*target));
+}
+
+bool render_target_resize(RenderTarget* target, int width, int height, AntiAliasing aa)
+{
+	if (target->fbo && width == target->max_width && height == target->max_height && aa == target->aa)
+		return true;
+
+	free_attachments(target);
+	target->max_width = width > 0 ? width : 1;
+	target->max_height = height > 0 ? height : 1;
+	target->width = target->max_width;
+	target->height = target->max_height;
+	target->aa = aa;
+	return alloc_attachments(target);
+}
+
+bool render_target_read_timer(RenderTarget* target, float* gpu_ms, float* frame_scale)
+{
+	if (target->query_frame < RENDER_TARGET_QUERIES)
+		return false;
+
+	uint32_t slot = target->query_frame % RENDER_TARGET_QUERIES;
+	GLint available = 0;
+	glGetQueryObjectiv(target->queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+	if (!available)
+		return false;
+
+	GLuint64 ns = 0, samples = 0;
+	glGetQueryObjectui64v(target->queries[slot], GL_QUERY_RESULT, &ns);
+	glGetQueryObjectui64v(target->sample_queries[slot], GL_QUERY_RESULT, &samples);
+	target->samples_passed = samples;
+	target->gpu_ms = (float)(ns / 1000000.0);
+	target->gpu_scale = target->query_scales[slot];
+	*gpu_ms = target->gpu_ms;
+	*frame_scale = target->gpu_scale;
+	return true;
+}
+
+void render_target_begin(RenderTarget* target, float scale, float r, float g, float b, float a)
+{
+	target->width = (int)(target->max_width * scale + 0.5f);
+	target->height = (int)(target->max_height * scale + 0.5f);
+	if (target->width < 1)
+		target->width = 1;
+	if (target->height < 1)
+		target->height = 1;
+
+	uint32_t slot = target->query_frame % RENDER_TARGET_QUERIES;
+	target->query_scales[slot] = scale;
+	glBeginQuery(GL_TIME_ELAPSED, target->queries[slot]);
+	glBeginQuery(GL_SAMPLES_PASSED, target->sample_queries[slot]);
+
+	glBindFramebuffer(GL_FRAMEBUFFER, target->samples > 0 ? target->msaa_fbo : target->fbo);
+	glViewport(0, 0, target->width, target->height);
+	glClearColor(r, g, b, a);
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
+}
+
+void render_target_end(RenderTarget* target)
+{
+	if (target->samples > 0) {
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, target->msaa_fbo);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, target->fbo);
+		glBlitFramebuffer(0, 0, target->width, target->height, 0, 0, target->width, target->height, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+	}
+
+	glEndQuery(GL_SAMPLES_PASSED);
+	glEndQuery(GL_TIME_ELAPSED);
+	target->query_frame++;
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+void render_target_present(RenderTarget* target, GLuint dst_fbo, int dst_width, int dst_height)
+{
+	GLuint program = target->aa == AA_FXAA ? target->fxaa_program : target->present_program;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, dst_fbo);
+	glViewport(0, 0, dst_width, dst_height);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_BLEND);
+
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "source"), 0);
+	glUniform2f(glGetUniformLocation(program, "uv_scale"), (float)target->width / target->max_width, (float)target->height / target->max_height);
+	glUniform2f(glGetUniformLocation(program, "texel"), 1.0f / target->max_width, 1.0f / target->max_height);
+
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_2D, target->color_tex);
+	glBindVertexArray(target->vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+}
+
+void resolution_scaler_init(ResolutionScaler* scaler, float target_ms, float min_scale, float max_scale)
+{
+	memset(scaler, 0, sizeof(*scaler));
+	scaler->scale = max_scale;
+	scaler->min_scale = min_scale;
+	scaler->max_scale = max_scale;
+	scaler->target_ms = target_ms;
+}
+
+float resolution_scaler_update(ResolutionScaler* scaler, float gpu_ms, float frame_scale)
+{
+	if (gpu_ms <= 0.0f || frame_scale <= 0.0f)
+		return scaler->scale;
+
+	// Fill cost follows the pixel count, so a pass at scale s costs about
+	// s^2 of the full resolution pass. Normalizing first keeps timings that
+	// arrive a few frames late, at an older scale, comparable.
+	float full_ms = gpu_ms / (frame_scale * frame_scale);
+	if (scaler->full_ms > 0.0f)
+		scaler->full_ms += (full_ms - scaler->full_ms) * RESOLUTION_SCALER_SMOOTHING;
+	else
+		scaler->full_ms = full_ms;
+
+	float ideal = sqrtf(scaler->target_ms / scaler->full_ms);
+	float next = scaler->scale + (ideal - scaler->scale) * RESOLUTION_SCALER_DAMPING;
+	if (next < scaler->min_scale)
+		next = scaler->min_scale;
+	if (next > scaler->max_scale)
+		next = scaler->max_scale;
+
+	if (fabsf(next - scaler->scale) >= RESOLUTION_SCALER_MIN_STEP || next == scaler->min_scale || next == scaler->max_scale)
+		scaler->scale = next;
+	return scaler->scale;
+}
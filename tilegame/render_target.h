@@ -0,0 +1,112 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "glad/include/glad.h"
+
+//----------------------------------------------------------------------------
+//
+//  Offscreen world rendering with dynamic resolution. The world is drawn
+//    into an FBO whose attachments are allocated once at the window size;
+//    each frame only the top-left width x height region is used, so changing
+//    the resolution scale never reallocates. render_target_present() then
+//    upscales that region to the destination framebuffer with bilinear
+//    filtering, or with FXAA applied on the way.
+//
+//  Anti-aliasing is either MSAA on the offscreen target (resolved with
+//    glBlitFramebuffer before presenting) or FXAA in the present pass, which
+//    costs one full-screen pass instead of multiplying every fragment.
+//
+//  The world pass is timed with GL_TIME_ELAPSED queries read back a few
+//    frames later, so timing never stalls the pipeline. A GL_SAMPLES_PASSED
+//    query alongside counts the samples it wrote. ResolutionScaler
+//    turns those times into a scale that holds a target GPU time.
+//
+
+#define RENDER_TARGET_QUERIES 4
+
+typedef enum AntiAliasing {
+	AA_NONE,
+	AA_MSAA_2X,
+	AA_MSAA_4X,
+	AA_MSAA_8X,
+	AA_FXAA,
+	AA_MODE_COUNT
+} AntiAliasing;
+
+typedef struct ResolutionScaler {
+	float scale;
+	float min_scale;
+	float max_scale;
+	float target_ms;
+	float full_ms;				// smoothed world pass time normalized to scale 1
+} ResolutionScaler;
+
+typedef struct RenderTarget {
+	int max_width;
+	int max_height;
+	int width;
+	int height;
+	AntiAliasing aa;
+	int samples;
+
+	GLuint fbo;
+	GLuint color_tex;
+	GLuint depth_rb;
+	GLuint msaa_fbo;
+	GLuint msaa_color_rb;
+	GLuint msaa_depth_rb;
+
+	GLuint present_program;
+	GLuint fxaa_program;
+	GLuint vao;
+
+	GLuint queries[RENDER_TARGET_QUERIES];
+	GLuint sample_queries[RENDER_TARGET_QUERIES];
+	float query_scales[RENDER_TARGET_QUERIES];
+	uint32_t query_frame;
+	float gpu_ms;				// last world pass time read back
+	float gpu_scale;			// resolution scale of that pass
+	uint64_t samples_passed;	// written by that pass
+} RenderTarget;
+
+// 'present_program' and 'fxaa_program' are the two upscaling shader
+// programs (present.vert with present.frag / fxaa.frag).
+bool
+render_target_init(RenderTarget* target, int width, int height, AntiAliasing aa, GLuint present_program, GLuint fxaa_program);
+
+void
+render_target_free(RenderTarget* target);
+
+// Reallocates the attachments when the window size or the MSAA level changed.
+bool
+render_target_resize(RenderTarget* target, int width, int height, AntiAliasing aa);
+
+// Reads back the oldest pending world pass timer and sample count. Returns
+// false when no new result is available yet.
+bool
+render_target_read_timer(RenderTarget* target, float* gpu_ms, float* frame_scale);
+
+// Binds the target at 'scale' of its full size, sets the viewport and
+// clears it. Starts the GPU timer for the world pass.
+void
+render_target_begin(RenderTarget* target, float scale, float r, float g, float b, float a);
+
+// Ends the world pass: stops the timer and resolves MSAA.
+void
+render_target_end(RenderTarget* target);
+
+// Upscales the last rendered region into 'dst_fbo' (0 for the window).
+void
+render_target_present(RenderTarget* target, GLuint dst_fbo, int dst_width, int dst_height);
+
+const char*
+render_target_aa_name(AntiAliasing aa);
+
+void
+resolution_scaler_init(ResolutionScaler* scaler, float target_ms, float min_scale, float max_scale);
+
+// Feeds the GPU time of a pass rendered at 'frame_scale' and returns the
+// scale for the next frame.
+float
+resolution_scaler_update(ResolutionScaler* scaler, float gpu_ms, float frame_scale);
@@ -0,0 +1,355 @@
+#include "stdafx.h"
+#include "save_game.h"
+#include "mem_stats.h"
+
+#include <string.h>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#define SAVE_SECTION_COUNT 2
+
+static const uint32_t sim_strides[SAVE_SIM_ARRAYS] = {
+	sizeof(int32_t), sizeof(int32_t), sizeof(uint32_t), sizeof(uint32_t), sizeof(uint8_t), sizeof(uint8_t),
+};
+
+// Where each part of a save of 'count' entities starts.
+typedef struct SaveLayout {
+	size_t world;
+	size_t sim;
+	size_t arrays[SAVE_SIM_ARRAYS];
+	size_t bytes;
+} SaveLayout;
+
+// The image the writer thread works on, handed over with 'pending' set and
+// given back by clearing it.
+struct SaveThread {
+	std::thread thread;
+	std::mutex lock;
+	std::condition_variable wake;
+	std::condition_variable done;
+	char path[SAVE_MAX_PATH];
+	size_t bytes;
+	bool pending;
+	bool stop;
+	// results of the saves written so far
+	uint32_t saves;
+	uint32_t failed;
+	float write_ms;
+};
+
+static size_t
+align(size_t x)
+{
+	return (x + SAVE_ALIGN - 1) & ~(size_t)(SAVE_ALIGN - 1);
+}
+
+static void
+plan_layout(uint32_t count, SaveLayout* layout)
+{
+	size_t pos = align(sizeof(SaveFileHeader) + SAVE_SECTION_COUNT * sizeof(SaveSection));
+	layout->world = pos;
+	pos = align(pos + sizeof(SaveWorld));
+	layout->sim = pos;
+	pos = align(pos + sizeof(SaveSim));
+	for (int a = 0; a < SAVE_SIM_ARRAYS; a++) {
+		layout->arrays[a] = pos;
+		pos = align(pos + (size_t)count * sim_strides[a]);
+	}
+	layout->bytes = pos;
+}
+
+static const void*
+sim_array(const SimState* sim, int a)
+{
+	switch (a) {
+	case SAVE_SIM_POS_X: return sim->pos_x;
+	case SAVE_SIM_POS_Y: return sim->pos_y;
+	case SAVE_SIM_ANIM_FRAME: return sim->anim_frame;
+	case SAVE_SIM_ANIM_INDEX: return sim->anim_index;
+	case SAVE_SIM_INPUT: return sim->input;
+	default: return sim->stance;
+	}
+}
+
+// Everything but the hash, padding zeroed so that equal states give equal
+// files.
+static void
+build_image(uint8_t* image, const SaveLayout* layout, const SimState* sim, const SaveWorld* world)
+{
+	uint32_t count = sim->header->count;
+	memset(image, 0, layout->arrays[0]);
+
+	SaveFileHeader* header = (SaveFileHeader*)image;
+	header->magic = SAVE_FILE_MAGIC;
+	header->version = SAVE_SCHEMA_VERSION;
+	header->section_count = SAVE_SECTION_COUNT;
+	header->bytes = layout->bytes;
+
+	SaveSection* sections = (SaveSection*)(image + sizeof(SaveFileHeader));
+	sections[0].id = SAVE_SECTION_WORLD;
+	sections[0].offset = layout->world;
+	sections[0].bytes = sizeof(SaveWorld);
+	sections[1].id = SAVE_SECTION_SIM;
+	sections[1].offset = layout->sim;
+	sections[1].bytes = layout->bytes - layout->sim;
+	memcpy(image + layout->world, world, sizeof(SaveWorld));
+
+	SaveSim* saved = (SaveSim*)(image + layout->sim);
+	saved->header = *sim->header;
+	for (int a = 0; a < SAVE_SIM_ARRAYS; a++) {
+		size_t bytes = (size_t)count * sim_strides[a];
+		size_t end = a + 1 < SAVE_SIM_ARRAYS ? layout->arrays[a + 1] : layout->bytes;
+		saved->arrays[a].offset = layout->arrays[a];
+		saved->arrays[a].count = count;
+		saved->arrays[a].stride = sim_strides[a];
+		memcpy(image + layout->arrays[a], sim_array(sim, a), bytes);
+		memset(image + layout->arrays[a] + bytes, 0, end - layout->arrays[a] - bytes);
+	}
+}
+
+static uint64_t
+image_hash(const uint8_t* image, size_t bytes)
+{
+	return sim_hash_bytes(image + sizeof(SaveFileHeader), bytes - sizeof(SaveFileHeader), SAVE_FILE_MAGIC);
+}
+
+// Hashes the image and writes it next to 'path', then moves it over.
+static bool
+write_image(uint8_t* image, size_t bytes, const char* path)
+{
+	((SaveFileHeader*)image)->hash = image_hash(image, bytes);
+
+	char temp[SAVE_MAX_PATH + 8];
+	snprintf(temp, sizeof(temp), "%s.tmp", path);
+	FILE* file = platform_fopen(temp, "wb");
+	if (!file) {
+		printf("Unable to write %s\n", temp);
+		return false;
+	}
+	bool ok = fwrite(image, 1, bytes, file) == bytes;
+	ok = fclose(file) == 0 && ok;
+	if (ok && !platform_replace_file(temp, path)) {
+		printf("Unable to replace %s\n", path);
+		ok = false;
+	}
+	if (!ok)
+		remove(temp);
+	return ok;
+}
+
+static void
+writer_main(SaveWriter* writer)
+{
+	SaveThread* thread = writer->thread;
+	std::unique_lock<std::mutex> lock(thread->lock);
+	for (;;) {
+		thread->wake.wait(lock, [thread] { return thread->stop || thread->pending; });
+		// a save still pending is written before stopping
+		if (!thread->pending)
+			break;
+		lock.unlock();
+
+		double start = platform_time_us();
+		bool ok = write_image(writer->image, thread->bytes, thread->path);
+		float ms = (float)((platform_time_us() - start) / 1000.0);
+
+		lock.lock();
+		thread->pending = false;
+		thread->saves += ok;
+		thread->failed += !ok;
+		thread->write_ms = ms;
+		thread->done.notify_all();
+	}
+}
+
+bool save_file_open(SaveFile* file, const char* path, bool verify)
+{
+	memset(file, 0, sizeof(*file));
+	if (!platform_map_file(path, &file->mapping))
+		return false;
+
+	const uint8_t* data = file->mapping.data;
+	size_t size = file->mapping.size;
+	const SaveFileHeader* header = (const SaveFileHeader*)data;
+	const char* problem = NULL;
+	if (size < sizeof(SaveFileHeader) || header->magic != SAVE_FILE_MAGIC)
+		problem = "not a save";
+	else if (header->version != SAVE_SCHEMA_VERSION)
+		problem = "saved by another version";
+	else if (header->bytes != size || header->section_count > (size - sizeof(SaveFileHeader)) / sizeof(SaveSection))
+		problem = "truncated";
+	else if (verify && image_hash(data, size) != header->hash)
+		problem = "damaged";
+
+	const SaveSection* sections = (const SaveSection*)(data + sizeof(SaveFileHeader));
+	for (uint32_t i = 0; !problem && i < header->section_count; i++) {
+		const SaveSection* section = &sections[i];
+		if (section->offset % SAVE_ALIGN || section->offset > size || section->bytes > size - section->offset) {
+			problem = "section out of bounds";
+		} else if (section->id == SAVE_SECTION_WORLD && section->bytes >= sizeof(SaveWorld)) {
+			file->world = (const SaveWorld*)(data + section->offset);
+		} else if (section->id == SAVE_SECTION_SIM && section->bytes >= sizeof(SaveSim)) {
+			file->sim = (const SaveSim*)(data + section->offset);
+		}
+	}
+	if (!problem && (!file->world || !file->sim))
+		problem = "section missing";
+
+	// every array must lie in the file and hold the saved entities
+	for (int a = 0; !problem && a < SAVE_SIM_ARRAYS; a++) {
+		const SaveArray* array = &file->sim->arrays[a];
+		size_t bytes = (size_t)array->count * array->stride;
+		if (array->stride != sim_strides[a] || array->count != file->sim->header.count ||
+			array->offset % SAVE_ALIGN || array->offset > size || bytes > size - array->offset)
+			problem = "entities out of bounds";
+	}
+
+	if (problem) {
+		printf("Unable to load %s: %s\n", path, problem);
+		save_file_close(file);
+		return false;
+	}
+	file->header = header;
+	return true;
+}
+
+void save_file_close(SaveFile* file)
+{
+	platform_unmap_file(&file->mapping);
+	memset(file, 0, sizeof(*file));
+}
+
+void save_file_sim_view(const SaveFile* file, SaveSimView* view)
+{
+	const uint8_t* data = file->mapping.data;
+	const SaveArray* arrays = file->sim->arrays;
+	view->header = &file->sim->header;
+	view->pos_x = (const int32_t*)(data + arrays[SAVE_SIM_POS_X].offset);
+	view->pos_y = (const int32_t*)(data + arrays[SAVE_SIM_POS_Y].offset);
+	view->anim_frame = (const uint32_t*)(data + arrays[SAVE_SIM_ANIM_FRAME].offset);
+	view->anim_index = (const uint32_t*)(data + arrays[SAVE_SIM_ANIM_INDEX].offset);
+	view->input = data + arrays[SAVE_SIM_INPUT].offset;
+	view->stance = data + arrays[SAVE_SIM_STANCE].offset;
+}
+
+bool save_file_restore_sim(const SaveFile* file, SimState* state)
+{
+	const SimHeader* saved = &file->sim->header;
+	uint32_t capacity = state->header->capacity;
+	if (saved->count > capacity) {
+		printf("Save holds %u entities, the simulation %u\n", saved->count, capacity);
+		return false;
+	}
+
+	// the arrays past the saved entities are cleared like a new state's
+	memset(state->block, 0, state->bytes);
+	*state->header = *saved;
+	state->header->capacity = capacity;
+	for (int a = 0; a < SAVE_SIM_ARRAYS; a++) {
+		const SaveArray* array = &file->sim->arrays[a];
+		memcpy((void*)sim_array(state, a), file->mapping.data + array->offset, (size_t)array->count * array->stride);
+	}
+	return true;
+}
+
+bool save_game_write(const char* path, const SimState* sim, const SaveWorld* world)
+{
+	SaveLayout layout;
+	plan_layout(sim->header->count, &layout);
+	uint8_t* image = (uint8_t*)malloc(layout.bytes);
+	if (!image)
+		return false;
+	build_image(image, &layout, sim, world);
+	bool ok = write_image(image, layout.bytes, path);
+	free(image);
+	return ok;
+}
+
+bool save_writer_init(SaveWriter* writer)
+{
+	memset(writer, 0, sizeof(*writer));
+	writer->thread = new SaveThread();
+	writer->thread->thread = std::thread(writer_main, writer);
+	return true;
+}
+
+void save_writer_free(SaveWriter* writer)
+{
+	if (!writer->thread)
+		return;
+	{
+		std::lock_guard<std::mutex> guard(writer->thread->lock);
+		writer->thread->stop = true;
+	}
+	writer->thread->wake.notify_one();
+	writer->thread->thread.join();
+	delete writer->thread;
+
+	if (writer->image)
+		mem_track_free(MEM_CPU_SIMULATION, writer->capacity);
+	free(writer->image);
+	memset(writer, 0, sizeof(*writer));
+}
+
+bool save_writer_submit(SaveWriter* writer, const char* path, const SimState* sim, const SaveWorld* world)
+{
+	SaveThread* thread = writer->thread;
+	if (save_writer_busy(writer)) {
+		writer->stats.skipped++;
+		return false;
+	}
+
+	double start = platform_time_us();
+	SaveLayout layout;
+	plan_layout(sim->header->count, &layout);
+	// the image only grows, so saving the same world again never allocates
+	if (layout.bytes > writer->capacity) {
+		uint8_t* image = (uint8_t*)malloc(layout.bytes);
+		if (!image) {
+			writer->stats.failed++;
+			return false;
+		}
+		if (writer->image)
+			mem_track_free(MEM_CPU_SIMULATION, writer->capacity);
+		free(writer->image);
+		writer->image = image;
+		writer->capacity = layout.bytes;
+		mem_track_alloc(MEM_CPU_SIMULATION, writer->capacity);
+	}
+	build_image(writer->image, &layout, sim, world);
+	writer->stats.bytes = layout.bytes;
+	writer->stats.snapshot_ms = (float)((platform_time_us() - start) / 1000.0);
+
+	{
+		std::lock_guard<std::mutex> guard(thread->lock);
+		snprintf(thread->path, sizeof(thread->path), "%s", path);
+		thread->bytes = layout.bytes;
+		thread->pending = true;
+	}
+	thread->wake.notify_one();
+	return true;
+}
+
+bool save_writer_busy(SaveWriter* writer)
+{
+	std::lock_guard<std::mutex> guard(writer->thread->lock);
+	return writer->thread->pending;
+}
+
+void save_writer_wait(SaveWriter* writer)
+{
+	SaveThread* thread = writer->thread;
+	std::unique_lock<std::mutex> lock(thread->lock);
+	thread->done.wait(lock, [thread] { return !thread->pending; });
+}
+
+void save_writer_get_stats(SaveWriter* writer, SaveStats* stats)
+{
+	SaveThread* thread = writer->thread;
+	*stats = writer->stats;
+	std::lock_guard<std::mutex> guard(thread->lock);
+	stats->saves = thread->saves;
+	stats->failed += thread->failed;
+	stats->write_ms = thread->write_ms;
+}
@@ -0,0 +1,162 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "platform.h"
+#include "sim_state.h"
+
+//----------------------------------------------------------------------------
+//
+//  Save games. A save is one file of plain data with no pointers: a
+//    SaveFileHeader with the schema version, a table of sections, then the
+//    sections, each starting on a SAVE_ALIGN boundary. Everything inside
+//    refers to other parts of the file by offset from its start, so a file
+//    mapped anywhere in memory is read where it lies: save_file_open()
+//    maps it, checks the header and the bounds of every offset, and
+//    save_file_sim_view() points straight into the mapping.
+//
+//  The simulation section holds the SimHeader and one array per entity
+//    field, each of 'count' elements of 'stride' bytes, as in SimState but
+//    without the unused capacity.
+//
+//  save_writer_submit() costs the calling thread a copy of the state into
+//    the writer's file image. The writer thread hashes the image, writes it
+//    to "<path>.tmp" and moves it over the save, so a crash never leaves a
+//    half written save behind. One save is in flight at a time; a save
+//    submitted while the last one is still being written is skipped.
+//
+//  File layout (little endian): SaveFileHeader, SaveSection[section_count],
+//    then the sections.
+//
+
+#define SAVE_FILE_MAGIC 0x56534754	// "TGSV"
+#define SAVE_SCHEMA_VERSION 1
+#define SAVE_ALIGN 64
+#define SAVE_MAX_PATH 256
+
+typedef enum SaveSectionId {
+	SAVE_SECTION_WORLD = 1,
+	SAVE_SECTION_SIM = 2,
+} SaveSectionId;
+
+typedef struct SaveFileHeader {
+	uint32_t magic;
+	uint32_t version;			// SAVE_SCHEMA_VERSION
+	uint32_t section_count;
+	uint32_t unused;
+	uint64_t bytes;				// of the whole file
+	uint64_t hash;				// sim_hash_bytes() of everything after the header
+} SaveFileHeader;
+
+typedef struct SaveSection {
+	uint32_t id;				// SaveSectionId
+	uint32_t unused;
+	uint64_t offset;
+	uint64_t bytes;
+} SaveSection;
+
+typedef struct SaveArray {
+	uint64_t offset;
+	uint32_t count;
+	uint32_t stride;			// bytes per element
+} SaveArray;
+
+typedef enum SaveSimArray {
+	SAVE_SIM_POS_X,
+	SAVE_SIM_POS_Y,
+	SAVE_SIM_ANIM_FRAME,
+	SAVE_SIM_ANIM_INDEX,
+	SAVE_SIM_INPUT,
+	SAVE_SIM_STANCE,
+	SAVE_SIM_ARRAYS
+} SaveSimArray;
+
+typedef struct SaveSim {
+	SimHeader header;
+	SaveArray arrays[SAVE_SIM_ARRAYS];
+} SaveSim;
+
+typedef struct SaveWorld {
+	uint32_t seed;				// of the generated chunks
+	uint32_t unused;
+} SaveWorld;
+
+// A mapped save, valid until save_file_close().
+typedef struct SaveFile {
+	PlatformMapping mapping;
+	const SaveFileHeader* header;
+	const SaveWorld* world;
+	const SaveSim* sim;
+} SaveFile;
+
+// Entities of a mapped save, read in place.
+typedef struct SaveSimView {
+	const SimHeader* header;
+	const int32_t* pos_x;
+	const int32_t* pos_y;
+	const uint32_t* anim_frame;
+	const uint32_t* anim_index;
+	const uint8_t* input;
+	const uint8_t* stance;
+} SaveSimView;
+
+typedef struct SaveStats {
+	uint32_t saves;
+	uint32_t failed;
+	uint32_t skipped;			// submitted while a save was in flight
+	uint64_t bytes;				// of the last save
+	float snapshot_ms;			// calling thread, last save
+	float write_ms;				// writer thread, last save
+} SaveStats;
+
+struct SaveThread;
+
+typedef struct SaveWriter {
+	uint8_t* image;				// the file being written
+	size_t capacity;
+	SaveStats stats;
+	SaveThread* thread;
+} SaveWriter;
+
+// Maps 'path' and checks its header, schema version and section bounds.
+// With 'verify' the hash of the contents is checked too, which reads the
+// whole file.
+bool
+save_file_open(SaveFile* file, const char* path, bool verify);
+
+void
+save_file_close(SaveFile* file);
+
+void
+save_file_sim_view(const SaveFile* file, SaveSimView* view);
+
+// Copies the saved entities into 'state', whose capacity must hold them.
+bool
+save_file_restore_sim(const SaveFile* file, SimState* state);
+
+// Writes a save on the calling thread.
+bool
+save_game_write(const char* path, const SimState* sim, const SaveWorld* world);
+
+bool
+save_writer_init(SaveWriter* writer);
+
+// Waits for the save in flight.
+void
+save_writer_free(SaveWriter* writer);
+
+// Snapshots the state and queues it to be written to 'path'. Returns false
+// when a save is still in flight or memory runs out.
+bool
+save_writer_submit(SaveWriter* writer, const char* path, const SimState* sim, const SaveWorld* world);
+
+bool
+save_writer_busy(SaveWriter* writer);
+
+void
+save_writer_wait(SaveWriter* writer);
+
+// Stats with the results of the writer thread so far.
+void
+save_writer_get_stats(SaveWriter* writer, SaveStats* stats);
@@ -0,0 +1,320 @@
+#include "stdafx.h"
+#include "sim_state.h"
+#include "mem_stats.h"
+
+#include <mutex>
+#include <string.h>
+
+#define SIM_ALIGN(x) (((x) + 63) & ~(size_t)63)
+#define SIM_WANDER_TICKS 64
+
+static const int32_t stance_dx[8] = { 0, 1, 1, 1, 0, -1, -1, -1 };
+static const int32_t stance_dy[8] = { 1, 1, 0, -1, -1, -1, 0, 1 };
+
+// per input mask: summed movement and the facing it selects
+static int32_t input_dx[256];
+static int32_t input_dy[256];
+static uint8_t input_stance[256];
+static std::once_flag input_tables_once;
+
+static void build_input_tables()
+{
+	for (int mask = 0; mask < 256; mask++) {
+		int32_t dx = 0, dy = 0;
+		uint8_t stance = 0;
+		for (int s = 7; s >= 0; s--) {
+			if ((mask >> s) & 1) {
+				dx += stance_dx[s];
+				dy += stance_dy[s];
+				// lowest set bit picks the facing, same priority as render_player
+				stance = (uint8_t)s;
+			}
+		}
+		input_dx[mask] = dx;
+		input_dy[mask] = dy;
+		input_stance[mask] = stance;
+	}
+}
+
+static uint32_t xorshift32(uint32_t* s)
+{
+	uint32_t x = *s;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*s = x;
+	return x;
+}
+
+SimState* sim_state_create(uint32_t capacity, uint32_t seed)
+{
+	size_t off_header = 0;
+	size_t off_pos_x = SIM_ALIGN(off_header + sizeof(SimHeader));
+	size_t off_pos_y = SIM_ALIGN(off_pos_x + capacity * sizeof(int32_t));
+	size_t off_anim_frame = SIM_ALIGN(off_pos_y + capacity * sizeof(int32_t));
+	size_t off_anim_index = SIM_ALIGN(off_anim_frame + capacity * sizeof(uint32_t));
+	size_t off_input = SIM_ALIGN(off_anim_index + capacity * sizeof(uint32_t));
+	size_t off_stance = SIM_ALIGN(off_input + capacity * sizeof(uint8_t));
+	size_t bytes = SIM_ALIGN(off_stance + capacity * sizeof(uint8_t));
+
+	// states may be created from several threads at once
+	std::call_once(input_tables_once, build_input_tables);
+
+	SimState* state = (SimState*)malloc(sizeof(SimState));
+	if (!state)
+		return NULL;
+
+	// zeroed so that padding between arrays hashes the same on every machine
+	state->block = (uint8_t*)calloc(1, bytes);
+	if (!state->block) {
+		free(state);
+		return NULL;
+	}
+
+	state->bytes = bytes;
+	mem_track_alloc(MEM_CPU_SIMULATION, bytes);
+	state->header = (SimHeader*)(state->block + off_header);
+	state->pos_x = (int32_t*)(state->block + off_pos_x);
+	state->pos_y = (int32_t*)(state->block + off_pos_y);
+	state->anim_frame = (uint32_t*)(state->block + off_anim_frame);
+	state->anim_index = (uint32_t*)(state->block + off_anim_index);
+	state->input = state->block + off_input;
+	state->stance = state->block + off_stance;
+
+	state->header->capacity = capacity;
+	state->header->rng = seed ? seed : 1;
+
+	return state;
+}
+
+void sim_state_destroy(SimState* state)
+{
+	if (!state)
+		return;
+	mem_track_free(MEM_CPU_SIMULATION, state->bytes);
+	free(state->block);
+	free(state);
+}
+
+int sim_spawn(SimState* state, int32_t x, int32_t y, uint8_t stance)
+{
+	SimHeader* h = state->header;
+	if (h->count >= h->capacity)
+		return -1;
+
+	uint32_t i = h->count++;
+	state->pos_x[i] = x;
+	state->pos_y[i] = y;
+	state->anim_frame[i] = 0;
+	state->anim_index[i] = 0;
+	state->input[i] = 0;
+	state->stance[i] = stance & 7;
+	return (int)i;
+}
+
+void sim_set_input(SimState* state, uint32_t entity, uint8_t input)
+{
+	if (entity < state->header->count)
+		state->input[entity] = input;
+}
+
+uint8_t sim_input_from_directions(const bool directions[8])
+{
+	uint8_t input = 0;
+	for (int i = 0; i < 8; i++) {
+		if (directions[i])
+			input |= (uint8_t)(1 << i);
+	}
+	return input;
+}
+
+void sim_step(SimState* state)
+{
+	SimHeader* h = state->header;
+	uint32_t count = h->count;
+
+	// non-player entities pick a new heading at fixed intervals
+	if (h->tick % SIM_WANDER_TICKS == 0) {
+		for (uint32_t i = SIM_PLAYER_ENTITY + 1; i < count; i++)
+			state->input[i] = (uint8_t)(1 << (xorshift32(&h->rng) & 7));
+	}
+
+	for (uint32_t i = 0; i < count; i++) {
+		uint8_t input = state->input[i];
+
+		state->pos_x[i] += input_dx[input] * SIM_MOVE_STEP;
+		state->pos_y[i] += input_dy[input] * SIM_MOVE_STEP;
+
+		if (input == 0) {
+			state->anim_frame[i] = 0;
+			state->anim_index[i] = 0;
+			continue;
+		}
+
+		uint8_t stance = input_stance[input];
+
+		// when changing directions, start from first animation frame
+		if (state->stance[i] != stance) {
+			state->stance[i] = stance;
+			state->anim_frame[i] = 0;
+			state->anim_index[i] = 0;
+		}
+
+		if (++state->anim_frame[i] == SIM_ANIM_TICKS_PER_FRAME) {
+			state->anim_frame[i] = 0;
+			state->anim_index[i]++;
+		}
+	}
+
+	h->tick++;
+}
+
+bool sim_is_at_rest(const SimState* state)
+{
+	uint32_t count = state->header->count;
+	if (count > SIM_PLAYER_ENTITY + 1)
+		return false;
+
+	for (uint32_t i = 0; i < count; i++) {
+		if (state->input[i] != 0 || state->anim_frame[i] != 0 || state->anim_index[i] != 0)
+			return false;
+	}
+	return true;
+}
+
+uint64_t sim_hash_bytes(const void* data, size_t bytes, uint64_t seed)
+{
+	const uint64_t prime = 0x100000001b3ULL;
+	const uint8_t* p = (const uint8_t*)data;
+	uint64_t h0 = seed ^ 0xcbf29ce484222325ULL;
+	uint64_t h1 = h0 ^ 0x9e3779b97f4a7c15ULL;
+	uint64_t h2 = h0 ^ 0xc2b2ae3d27d4eb4fULL;
+	uint64_t h3 = h0 ^ 0x165667b19e3779f9ULL;
+
+	// four independent lanes so the multiplies can overlap
+	size_t i = 0;
+	for (; i + 32 <= bytes; i += 32) {
+		uint64_t w[4];
+		memcpy(w, p + i, sizeof(w));
+		h0 = (h0 ^ w[0]) * prime;
+		h1 = (h1 ^ w[1]) * prime;
+		h2 = (h2 ^ w[2]) * prime;
+		h3 = (h3 ^ w[3]) * prime;
+	}
+	for (; i < bytes; i++)
+		h0 = (h0 ^ p[i]) * prime;
+
+	uint64_t h = h0 ^ (h1 * 31) ^ (h2 * 131) ^ (h3 * 1031) ^ (uint64_t)bytes;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ULL;
+	h ^= h >> 33;
+	return h;
+}
+
+uint64_t sim_state_hash(const SimState* state)
+{
+	return sim_hash_bytes(state->block, state->bytes, 0);
+}
+
+bool sim_snapshot_init(SimSnapshot* snapshot, const SimState* state)
+{
+	snapshot->block = (uint8_t*)malloc(state->bytes);
+	snapshot->bytes = snapshot->block ? state->bytes : 0;
+	if (snapshot->block)
+		mem_track_alloc(MEM_CPU_SIMULATION, snapshot->bytes);
+	return snapshot->block != NULL;
+}
+
+void sim_snapshot_free(SimSnapshot* snapshot)
+{
+	if (snapshot->block)
+		mem_track_free(MEM_CPU_SIMULATION, snapshot->bytes);
+	free(snapshot->block);
+	snapshot->block = NULL;
+	snapshot->bytes = 0;
+}
+
+void sim_snapshot_save(SimSnapshot* snapshot, const SimState* state)
+{
+	memcpy(snapshot->block, state->block, state->bytes);
+}
+
+bool sim_snapshot_restore(SimState* state, const SimSnapshot* snapshot)
+{
+	if (snapshot->bytes != state->bytes)
+		return false;
+	memcpy(state->block, snapshot->block, state->bytes);
+	return true;
+}
+
+bool sim_history_init(SimHistory* history, const SimState* state, uint32_t size)
+{
+	memset(history, 0, sizeof(SimHistory));
+	history->slots = (SimSnapshot*)calloc(size, sizeof(SimSnapshot));
+	history->hashes = (uint64_t*)calloc(size, sizeof(uint64_t));
+	history->ticks = (uint32_t*)calloc(size, sizeof(uint32_t));
+	history->size = size;
+
+	bool ok = history->slots && history->hashes && history->ticks;
+	for (uint32_t i = 0; ok && i < size; i++)
+		ok = sim_snapshot_init(&history->slots[i], state);
+
+	if (!ok)
+		sim_history_free(history);
+	return ok;
+}
+
+void sim_history_free(SimHistory* history)
+{
+	if (history->slots) {
+		for (uint32_t i = 0; i < history->size; i++)
+			sim_snapshot_free(&history->slots[i]);
+	}
+	free(history->slots);
+	free(history->hashes);
+	free(history->ticks);
+	memset(history, 0, sizeof(SimHistory));
+}
+
+uint64_t sim_history_push(SimHistory* history, const SimState* state)
+{
+	uint32_t slot = history->head;
+	uint64_t hash = sim_state_hash(state);
+
+	sim_snapshot_save(&history->slots[slot], state);
+	history->hashes[slot] = hash;
+	history->ticks[slot] = state->header->tick;
+
+	history->head = (slot + 1) % history->size;
+	if (history->count < history->size)
+		history->count++;
+
+	return hash;
+}
+
+bool sim_history_rewind(SimHistory* history, SimState* state, uint32_t ticks_back)
+{
+	if (ticks_back >= history->count)
+		return false;
+
+	uint32_t slot = (history->head + history->size - 1 - ticks_back) % history->size;
+	if (!sim_snapshot_restore(state, &history->slots[slot]))
+		return false;
+
+	history->head = (slot + 1) % history->size;
+	history->count -= ticks_back;
+	return true;
+}
+
+int sim_replay(SimState* state, const uint8_t* player_inputs, const uint64_t* expected_hashes, uint32_t tick_count)
+{
+	for (uint32_t t = 0; t < tick_count; t++) {
+		sim_set_input(state, SIM_PLAYER_ENTITY, player_inputs[t]);
+		sim_step(state);
+		if (expected_hashes && sim_state_hash(state) != expected_hashes[t])
+			return (int)t;
+	}
+	return -1;
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define PLAYER_STANCE_DOWN			0
+#define PLAYER_STANCE_DOWN_RIGHT	1
+#define PLAYER_STANCE_RIGHT			2
+#define PLAYER_STANCE_UP_RIGHT		3
+#define PLAYER_STANCE_UP			4
+#define PLAYER_STANCE_UP_LEFT		5
+#define PLAYER_STANCE_LEFT			6
+#define PLAYER_STANCE_DOWN_LEFT		7
+
+#define SIM_PLAYER_ENTITY 0
+#define SIM_MOVE_STEP 10
+#define SIM_ANIM_TICKS_PER_FRAME 5
+
+//----------------------------------------------------------------------------
+//
+//  The simulation state lives in one contiguous, pointer-free block so that
+//    it can be hashed every tick and snapshotted or restored with a single
+//    memcpy. Entities are stored as parallel arrays (one array per field);
+//    the arrays below point into that block at fixed offsets, so a restored
+//    block is valid without any fix-ups.
+//
+//  sim_step() only uses integer math and never reads anything outside the
+//    block, which keeps it deterministic across runs and machines.
+//
+
+typedef struct SimHeader {
+	uint32_t tick;
+	uint32_t count;
+	uint32_t capacity;
+	uint32_t rng;
+} SimHeader;
+
+typedef struct SimState {
+	size_t bytes;
+	uint8_t* block;
+
+	SimHeader* header;
+	int32_t* pos_x;
+	int32_t* pos_y;
+	uint32_t* anim_frame;
+	uint32_t* anim_index;
+	uint8_t* input;		// bit N set = moving in PLAYER_STANCE_N
+	uint8_t* stance;
+} SimState;
+
+typedef struct SimSnapshot {
+	size_t bytes;
+	uint8_t* block;
+} SimSnapshot;
+
+// Fixed-size ring of per-tick snapshots and hashes used for rewind and
+// desync detection.
+typedef struct SimHistory {
+	SimSnapshot* slots;
+	uint64_t* hashes;
+	uint32_t* ticks;
+	uint32_t size;
+	uint32_t head;
+	uint32_t count;
+} SimHistory;
+
+SimState*
+sim_state_create(uint32_t capacity, uint32_t seed);
+
+void
+sim_state_destroy(SimState* state);
+
+// Returns the new entity index, or -1 when the state is full.
+int
+sim_spawn(SimState* state, int32_t x, int32_t y, uint8_t stance);
+
+void
+sim_set_input(SimState* state, uint32_t entity, uint8_t input);
+
+uint8_t
+sim_input_from_directions(const bool directions[8]);
+
+void
+sim_step(SimState* state);
+
+// True when a sim_step() with the current inputs would only advance the
+// tick: nothing moves, every animation is on its first frame and there are
+// no wandering entities left to pick a new heading.
+bool
+sim_is_at_rest(const SimState* state);
+
+uint64_t
+sim_state_hash(const SimState* state);
+
+uint64_t
+sim_hash_bytes(const void* data, size_t bytes, uint64_t seed);
+
+bool
+sim_snapshot_init(SimSnapshot* snapshot, const SimState* state);
+
+void
+sim_snapshot_free(SimSnapshot* snapshot);
+
+void
+sim_snapshot_save(SimSnapshot* snapshot, const SimState* state);
+
+bool
+sim_snapshot_restore(SimState* state, const SimSnapshot* snapshot);
+
+bool
+sim_history_init(SimHistory* history, const SimState* state, uint32_t size);
+
+void
+sim_history_free(SimHistory* history);
+
+// Snapshots the state and returns its hash.
+uint64_t
+sim_history_push(SimHistory* history, const SimState* state);
+
+// Restores the state recorded 'ticks_back' pushes ago and drops the newer
+// entries. Returns false when the history is not that deep.
+bool
+sim_history_rewind(SimHistory* history, SimState* state, uint32_t ticks_back);
+
+// Re-runs 'tick_count' ticks from the current state, feeding the player
+// input for each tick, and compares the hash after every tick against
+// 'expected_hashes'. Returns the index of the first tick that diverges,
+// or -1 when the whole replay matches. Only touches 'state', so separate
+// sessions can be replayed in parallel.
+int
+sim_replay(SimState* state, const uint8_t* player_inputs, const uint64_t* expected_hashes, uint32_t tick_count);
@@ -0,0 +1,339 @@
+#include "stdafx.h"
+#include "sprite_atlas.h"
+#include "platform.h"
+#include "vfs.h"
+
+#include <string.h>
+#include <algorithm>
+
+typedef struct TrimmedFrame {
+	int index;
+	int cell_x;					// of the cell in the sheet
+	int cell_y;
+	uint64_t hash;
+	int duplicate_of;			// -1 when the frame has its own pixels
+} TrimmedFrame;
+
+static bool is_opaque(const uint8_t* rgba, int width, int x, int y, uint8_t alpha_threshold)
+{
+	return rgba[((size_t)y * width + x) * 4 + 3] > alpha_threshold;
+}
+
+// Shrinks the cell to the rectangle holding its opaque pixels.
+static void trim_cell(const uint8_t* rgba, int width, int cell_x, int cell_y, int cell_w, int cell_h, uint8_t alpha_threshold, SpriteFrame* frame)
+{
+	int min_x = cell_w, min_y = cell_h, max_x = -1, max_y = -1;
+	for (int y = 0; y < cell_h; y++) {
+		for (int x = 0; x < cell_w; x++) {
+			if (!is_opaque(rgba, width, cell_x + x, cell_y + y, alpha_threshold))
+				continue;
+			min_x = std::min(min_x, x);
+			max_x = std::max(max_x, x);
+			min_y = std::min(min_y, y);
+			max_y = std::max(max_y, y);
+		}
+	}
+
+	memset(frame, 0, sizeof(*frame));
+	if (max_x < 0)
+		return;
+	frame->offset_x = (uint16_t)min_x;
+	frame->offset_y = (uint16_t)min_y;
+	frame->width = (uint16_t)(max_x - min_x + 1);
+	frame->height = (uint16_t)(max_y - min_y + 1);
+}
+
+static uint64_t hash_frame(const uint8_t* rgba, int width, const TrimmedFrame* t, const SpriteFrame* f)
+{
+	uint64_t hash = 14695981039346656037ull;
+	for (int y = 0; y < f->height; y++) {
+		const uint8_t* row = rgba + ((size_t)(t->cell_y + f->offset_y + y) * width + t->cell_x + f->offset_x) * 4;
+		for (size_t i = 0; i < (size_t)f->width * 4; i++)
+			hash = (hash ^ row[i]) * 1099511628211ull;
+	}
+	return hash ^ ((uint64_t)f->width << 48) ^ ((uint64_t)f->height << 32);
+}
+
+static bool same_pixels(const uint8_t* rgba, int width, const TrimmedFrame* a, const SpriteFrame* fa, const TrimmedFrame* b, const SpriteFrame* fb)
+{
+	if (fa->width != fb->width || fa->height != fb->height)
+		return false;
+	for (int y = 0; y < fa->height; y++) {
+		const uint8_t* row_a = rgba + ((size_t)(a->cell_y + fa->offset_y + y) * width + a->cell_x + fa->offset_x) * 4;
+		const uint8_t* row_b = rgba + ((size_t)(b->cell_y + fb->offset_y + y) * width + b->cell_x + fb->offset_x) * 4;
+		if (memcmp(row_a, row_b, (size_t)fa->width * 4) != 0)
+			return false;
+	}
+	return true;
+}
+
+// Places the frames in 'order' on shelves 'atlas_width' wide. Returns the
+// height used, or -1 when a frame does not fit the width.
+static int shelf_pack(const int* order, int count, SpriteFrame* frames, int atlas_width)
+{
+	int x = 0, y = 0, shelf_height = 0;
+	for (int i = 0; i < count; i++) {
+		SpriteFrame* f = &frames[order[i]];
+		int w = f->width + SPRITE_ATLAS_PADDING;
+		int h = f->height + SPRITE_ATLAS_PADDING;
+		if (w > atlas_width)
+			return -1;
+		if (x + w > atlas_width) {
+			y += shelf_height;
+			x = 0;
+			shelf_height = 0;
+		}
+		f->x = (uint16_t)x;
+		f->y = (uint16_t)y;
+		x += w;
+		shelf_height = std::max(shelf_height, h);
+	}
+	return y + shelf_height;
+}
+
+bool sprite_atlas_build(const uint8_t* rgba, int width, int height, int cell_width, int cell_height, uint8_t alpha_threshold, SpriteAtlas* atlas, SpriteAtlasStats* stats)
+{
+	memset(atlas, 0, sizeof(*atlas));
+	memset(stats, 0, sizeof(*stats));
+	if (cell_width <= 0 || cell_height <= 0 || cell_width > 0xffff || cell_height > 0xffff)
+		return false;
+
+	int columns = width / cell_width;
+	int rows = height / cell_height;
+	int count = columns * rows;
+	if (count == 0)
+		return false;
+
+	SpriteFrame* frames = (SpriteFrame*)calloc(count, sizeof(SpriteFrame));
+	TrimmedFrame* trimmed = (TrimmedFrame*)calloc(count, sizeof(TrimmedFrame));
+	int* order = (int*)malloc(count * sizeof(int));
+	if (!frames || !trimmed || !order) {
+		free(frames);
+		free(trimmed);
+		free(order);
+		return false;
+	}
+
+	// trim, and point duplicates at the first frame with the same pixels
+	int packed = 0;
+	for (int i = 0; i < count; i++) {
+		TrimmedFrame* t = &trimmed[i];
+		SpriteFrame* f = &frames[i];
+		t->index = i;
+		t->cell_x = (i % columns) * cell_width;
+		t->cell_y = (i / columns) * cell_height;
+		t->duplicate_of = -1;
+		trim_cell(rgba, width, t->cell_x, t->cell_y, cell_width, cell_height, alpha_threshold, f);
+
+		stats->cell_pixels += (uint64_t)cell_width * cell_height;
+		stats->trimmed_pixels += (uint64_t)f->width * f->height;
+		if (!f->width) {
+			stats->empty_frames++;
+			continue;
+		}
+
+		t->hash = hash_frame(rgba, width, t, f);
+		for (int j = 0; j < i && t->duplicate_of < 0; j++) {
+			if (trimmed[j].duplicate_of < 0 && frames[j].width && trimmed[j].hash == t->hash &&
+				same_pixels(rgba, width, t, f, &trimmed[j], &frames[j]))
+				t->duplicate_of = j;
+		}
+		if (t->duplicate_of >= 0)
+			stats->duplicate_frames++;
+		else
+			order[packed++] = i;
+	}
+
+	std::sort(order, order + packed, [frames](int a, int b) {
+		if (frames[a].height != frames[b].height)
+			return frames[a].height > frames[b].height;
+		return frames[a].width > frames[b].width;
+	});
+
+	// Widths go up in steps of SPRITE_ATLAS_WIDTH_STEP from the widest frame;
+	// the smallest atlas no more than twice as tall as wide wins, any atlas
+	// when no width gives that shape.
+	int min_width = SPRITE_ATLAS_WIDTH_STEP;
+	for (int i = 0; i < packed; i++)
+		min_width = std::max(min_width, frames[order[i]].width + SPRITE_ATLAS_PADDING);
+	int best_width = 0, best_height = 0;
+	bool best_shaped = false;
+	for (int w = min_width; w <= SPRITE_ATLAS_MAX_WIDTH; w += SPRITE_ATLAS_WIDTH_STEP) {
+		int h = shelf_pack(order, packed, frames, w);
+		if (h < 0 || h > 0xffff)
+			continue;
+		bool shaped = h <= 2 * w;
+		if (!best_width || (shaped && !best_shaped) ||
+			(shaped == best_shaped && (uint64_t)w * h < (uint64_t)best_width * best_height)) {
+			best_width = w;
+			best_height = h;
+			best_shaped = shaped;
+		}
+	}
+	if (!best_width && packed) {
+		free(frames);
+		free(trimmed);
+		free(order);
+		return false;
+	}
+	best_height = std::max(best_height, 1);
+	best_width = std::max(best_width, 1);
+
+	// when repacking does not shrink the texture the sheet is kept as it
+	// is, with each frame trimmed where it lies in its cell
+	stats->kept_sheet = (uint64_t)best_width * best_height >= (uint64_t)width * height &&
+		width <= 0xffff && height <= 0xffff;
+	if (stats->kept_sheet) {
+		best_width = width;
+		best_height = height;
+	} else {
+		shelf_pack(order, packed, frames, best_width);
+	}
+
+	uint8_t* pixels = (uint8_t*)calloc((size_t)best_width * best_height, 4);
+	if (!pixels) {
+		free(frames);
+		free(trimmed);
+		free(order);
+		return false;
+	}
+	if (stats->kept_sheet)
+		memcpy(pixels, rgba, (size_t)width * height * 4);
+	for (int i = 0; i < count; i++) {
+		SpriteFrame* f = &frames[i];
+		const TrimmedFrame* t = &trimmed[i];
+		if (!f->width)
+			continue;
+		if (stats->kept_sheet) {
+			f->x = (uint16_t)(t->cell_x + f->offset_x);
+			f->y = (uint16_t)(t->cell_y + f->offset_y);
+			continue;
+		}
+		if (t->duplicate_of >= 0) {
+			f->x = frames[t->duplicate_of].x;
+			f->y = frames[t->duplicate_of].y;
+			continue;
+		}
+		for (int y = 0; y < f->height; y++) {
+			const uint8_t* src = rgba + ((size_t)(t->cell_y + f->offset_y + y) * width + t->cell_x + f->offset_x) * 4;
+			memcpy(pixels + ((size_t)(f->y + y) * best_width + f->x) * 4, src, (size_t)f->width * 4);
+		}
+	}
+	free(trimmed);
+	free(order);
+
+	atlas->header.magic = SPRITE_ATLAS_MAGIC;
+	atlas->header.version = SPRITE_ATLAS_VERSION;
+	atlas->header.width = best_width;
+	atlas->header.height = best_height;
+	atlas->header.frame_count = count;
+	atlas->header.cell_width = cell_width;
+	atlas->header.cell_height = cell_height;
+	atlas->header.columns = columns;
+	atlas->frames = frames;
+	atlas->rgba = pixels;
+
+	stats->sheet_pixels = (uint64_t)width * height;
+	stats->atlas_pixels = (uint64_t)best_width * best_height;
+	return true;
+}
+
+bool sprite_atlas_write(const char* path, const SpriteAtlas* atlas)
+{
+	FILE* outfile = platform_fopen(path, "wb");
+
+	if (!outfile)
+		return false;
+
+	const SpriteAtlasHeader* header = &atlas->header;
+	size_t pixels = (size_t)header->width * header->height * 4;
+	bool ok = fwrite(header, sizeof(*header), 1, outfile) == 1 &&
+		fwrite(atlas->frames, sizeof(SpriteFrame), header->frame_count, outfile) == header->frame_count &&
+		fwrite(atlas->rgba, 1, pixels, outfile) == pixels;
+
+	fclose(outfile);
+	return ok;
+}
+
+bool sprite_atlas_read(const char* path, SpriteAtlas* atlas)
+{
+	memset(atlas, 0, sizeof(*atlas));
+
+	VfsFile file;
+	if (!vfs_read(path, &file))
+		return false;
+
+	SpriteAtlasHeader* header = &atlas->header;
+	bool ok = file.size >= sizeof(*header);
+	if (ok) {
+		memcpy(header, file.data, sizeof(*header));
+		ok = header->magic == SPRITE_ATLAS_MAGIC && header->version == SPRITE_ATLAS_VERSION;
+	}
+
+	size_t frames_bytes = 0, pixel_bytes = 0;
+	if (ok) {
+		frames_bytes = (size_t)header->frame_count * sizeof(SpriteFrame);
+		pixel_bytes = (size_t)header->width * header->height * 4;
+		ok = file.size - sizeof(*header) >= frames_bytes &&
+			file.size - sizeof(*header) - frames_bytes >= pixel_bytes;
+	}
+	if (ok) {
+		atlas->frames = (SpriteFrame*)malloc(frames_bytes);
+		atlas->rgba = (uint8_t*)malloc(pixel_bytes);
+		ok = atlas->frames && atlas->rgba;
+	}
+	if (ok) {
+		memcpy(atlas->frames, file.data + sizeof(*header), frames_bytes);
+		memcpy(atlas->rgba, file.data + sizeof(*header) + frames_bytes, pixel_bytes);
+		for (uint32_t i = 0; ok && i < header->frame_count; i++) {
+			const SpriteFrame* f = &atlas->frames[i];
+			ok = (uint32_t)f->x + f->width <= header->width && (uint32_t)f->y + f->height <= header->height;
+		}
+	}
+
+	vfs_close(&file);
+	if (!ok)
+		sprite_atlas_free(atlas);
+	return ok;
+}
+
+void sprite_atlas_free(SpriteAtlas* atlas)
+{
+	free(atlas->frames);
+	free(atlas->rgba);
+	memset(atlas, 0, sizeof(*atlas));
+}
+
+void sprite_atlas_path(const char* sheet_path, char* out, size_t out_size)
+{
+	const char* dot = strrchr(sheet_path, '.');
+	const char* slash = strrchr(sheet_path, '/');
+	const char* backslash = strrchr(sheet_path, '\\');
+	if (backslash > slash)
+		slash = backslash;
+
+	size_t stem = (dot && (!slash || dot > slash)) ? (size_t)(dot - sheet_path) : strlen(sheet_path);
+	snprintf(out, out_size, "%.*s%s", (int)stem, sheet_path, SPRITE_ATLAS_EXTENSION);
+}
+
+bool sprite_frame_quad(const SpriteAtlas* atlas, int frame, float x, float y, float scale, SpriteQuad* quad)
+{
+	if (frame < 0 || (uint32_t)frame >= atlas->header.frame_count)
+		return false;
+	const SpriteFrame* f = &atlas->frames[frame];
+	if (!f->width)
+		return false;
+
+	quad->x0 = x + f->offset_x * scale;
+	quad->y0 = y + f->offset_y * scale;
+	quad->x1 = quad->x0 + f->width * scale;
+	quad->y1 = quad->y0 + f->height * scale;
+
+	float inv_w = 1.0f / atlas->header.width;
+	float inv_h = 1.0f / atlas->header.height;
+	quad->u0 = f->x * inv_w;
+	quad->v0 = f->y * inv_h;
+	quad->u1 = (f->x + f->width) * inv_w;
+	quad->v1 = (f->y + f->height) * inv_h;
+	return true;
+}
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+//----------------------------------------------------------------------------
+//
+//  Trimmed sprite atlases. Sprite sheets are drawn on a fixed grid of
+//    cells, most of which is transparent padding around the character.
+//    The pack step (tools/sprite_pack.cpp) finds the tight alpha bounds of
+//    each cell, copies only that rectangle into a new atlas and records
+//    where it sat in the cell, so a quad built with sprite_frame_quad()
+//    covers just the opaque pixels and lands exactly where the full cell
+//    would have drawn them.
+//
+//  Frames are packed on shelves, tallest first, with SPRITE_ATLAS_PADDING
+//    transparent pixels between them so bilinear filtering does not bleed
+//    neighbours in. Atlas widths up to SPRITE_ATLAS_MAX_WIDTH are tried and
+//    the smallest atlas at most twice as tall as it is wide is kept.
+//    Identical frames are stored once. Cells without an opaque pixel become
+//    empty frames. When no packing is smaller than the source sheet, the
+//    atlas is the sheet itself and the frames are trimmed in place, which
+//    still saves the fill rate without growing the texture.
+//
+//  .sprites layout: SpriteAtlasHeader, frame_count SpriteFrame, then the
+//    atlas as RGBA8 rows. It is written next to the source sheet.
+//
+
+#define SPRITE_ATLAS_MAGIC 0x50534754	// "TGSP"
+#define SPRITE_ATLAS_VERSION 1
+#define SPRITE_ATLAS_EXTENSION ".sprites"
+#define SPRITE_ATLAS_PADDING 1
+#define SPRITE_ATLAS_WIDTH_STEP 4
+#define SPRITE_ATLAS_MAX_WIDTH 4096
+
+typedef struct SpriteAtlasHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t frame_count;
+	uint32_t cell_width;
+	uint32_t cell_height;
+	uint32_t columns;			// of cells in the source sheet
+} SpriteAtlasHeader;
+
+typedef struct SpriteFrame {
+	uint16_t x;					// trimmed rectangle in the atlas
+	uint16_t y;
+	uint16_t width;				// 0 for an empty cell
+	uint16_t height;
+	uint16_t offset_x;			// of the trimmed rectangle within the cell
+	uint16_t offset_y;
+} SpriteFrame;
+
+typedef struct SpriteAtlasStats {
+	uint64_t cell_pixels;		// drawn per frame set on the fixed grid
+	uint64_t trimmed_pixels;	// drawn per frame set with trimmed quads
+	uint64_t sheet_pixels;
+	uint64_t atlas_pixels;
+	uint32_t empty_frames;
+	uint32_t duplicate_frames;
+	bool kept_sheet;			// packing did not shrink the sheet
+} SpriteAtlasStats;
+
+typedef struct SpriteAtlas {
+	SpriteAtlasHeader header;
+	SpriteFrame* frames;
+	uint8_t* rgba;
+} SpriteAtlas;
+
+// A frame's quad in world units and its texture coordinates.
+typedef struct SpriteQuad {
+	float x0, y0, x1, y1;
+	float u0, v0, u1, v1;
+} SpriteQuad;
+
+// Trims every cell_width x cell_height cell of an RGBA8 sheet, in row-major
+// order, and packs the trimmed frames. Pixels with alpha at or below
+// 'alpha_threshold' count as transparent.
+bool
+sprite_atlas_build(const uint8_t* rgba, int width, int height, int cell_width, int cell_height, uint8_t alpha_threshold, SpriteAtlas* atlas, SpriteAtlasStats* stats);
+
+bool
+sprite_atlas_write(const char* path, const SpriteAtlas* atlas);
+
+// Reads an atlas through the VFS.
+bool
+sprite_atlas_read(const char* path, SpriteAtlas* atlas);
+
+void
+sprite_atlas_free(SpriteAtlas* atlas);
+
+// Writes the .sprites path that belongs to a source sheet into 'out'.
+void
+sprite_atlas_path(const char* sheet_path, char* out, size_t out_size);
+
+// Quad of 'frame' for a cell whose top-left corner is drawn at (x, y),
+// 'scale' world units per sheet pixel. Returns false for an empty frame.
+bool
+sprite_frame_quad(const SpriteAtlas* atlas, int frame, float x, float y, float scale, SpriteQuad* quad);
@@ -0,0 +1,188 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <vector>
+
+#include "../alloc_tracker.h"
+#include "../chunk_stream.h"
+#include "../draw_queue.h"
+#include "../frame_arena.h"
+#include "../mem_stats.h"
+#include "../sim_state.h"
+#include "../imgui/imgui.h"
+
+// Runs the CPU side of the frame loop headless, with the allocation tracker
+// built in, and fails when a frame past the warmup allocates on the frame
+// thread. Each frame steps the simulation, streams chunks around a moving
+// camera, orders a world queue through the frame arena and builds an
+// overlay like show_overlay_window(). The chunk source allocates on the
+// loader thread, which must not be charged to the frame.
+#define TEST_FRAMES (ALLOC_TRACKER_WARMUP_FRAMES + 600)
+#define TEST_QUEUE_CAPACITY 4096
+#define TEST_CHUNK_RADIUS 1
+#define TEST_CHUNK_BUDGET (16 * CHUNK_TILES)
+#define TEST_CAMERA_SPEED 0.5f	// tiles per frame
+#define TEST_HISTORY_TICKS 600
+
+static std::atomic<uint64_t> loader_allocs(0);
+
+static bool load_chunk(void* user, int32_t cx, int32_t cy, uint8_t* tiles)
+{
+	std::vector<uint8_t> row(CHUNK_SIZE);
+	for (int y = 0; y < CHUNK_SIZE; y++) {
+		for (int x = 0; x < CHUNK_SIZE; x++)
+			row[x] = (uint8_t)((cx * 7 + cy * 13 + x + y) % 5);
+		memcpy(tiles + y * CHUNK_SIZE, row.data(), CHUNK_SIZE);
+	}
+	loader_allocs.store(alloc_tracker_total_allocs(), std::memory_order_relaxed);
+	return true;
+}
+
+static void push_world(DrawQueue* queue, uint32_t frame)
+{
+	for (uint32_t i = 0; i < TEST_QUEUE_CAPACITY / 2 + frame % (TEST_QUEUE_CAPACITY / 2); i++) {
+		float x = (float)(i * 37 % 1280), y = (float)(i * 91 % 720);
+		DrawItem item = { x, y, x + 64.0f, y + 64.0f, 0.0f, 0.0f, 1.0f, 1.0f,
+			draw_layer_depth(i % DRAW_LAYERS, y + 64.0f, 720.0f), 1 + i % 3, i % 4 != 0 };
+		draw_queue_push(queue, &item);
+	}
+}
+
+static void show_overlay(const ChunkStream* cs, const DrawQueue* queue, const FrameArena* arena, uint32_t frame)
+{
+	ImGui::NewFrame();
+	ImGui::SetNextWindowPos(ImVec2(0.0f, 0.0f));
+	ImGui::Begin("Game stats", NULL, ImGuiWindowFlags_NoTitleBar);
+	ImGui::Columns(4, "memory");
+	for (int c = 0; c < MEM_CATEGORY_COUNT; c++) {
+		MemCategoryStats stats;
+		mem_stats_get((MemCategory)c, &stats);
+		ImGui::Text("%s", mem_category_name((MemCategory)c)); ImGui::NextColumn();
+		ImGui::Text("%.1f", stats.current_bytes / 1024.0); ImGui::NextColumn();
+		ImGui::Text("%.1f", stats.peak_bytes / 1024.0); ImGui::NextColumn();
+		ImGui::Text("%d", stats.live_objects); ImGui::NextColumn();
+	}
+	ImGui::Columns(1);
+	ImGui::Separator();
+	ImGui::Text("Frame %u", frame);
+	ImGui::Text("Chunks resident %u loading %u, %llu loaded", cs->stats.resident, cs->stats.loading, (unsigned long long)cs->stats.total_loaded);
+	ImGui::Text("Queue %u opaque %u blended, %u sort passes", queue->stats.opaque_items, queue->stats.blended_items, queue->stats.sort_passes);
+	ImGui::Text("Frame arena %.1f KB, peak %.1f KB", arena->offset / 1024.0, arena->peak / 1024.0);
+	ImGui::End();
+	ImGui::Render();
+}
+
+// A frame past the warmup that calls the C allocator directly must be
+// reported. 'block' is volatile so that the calls are not folded away.
+static bool check_raw_malloc_reported()
+{
+	alloc_tracker_begin_frame();
+	void* volatile block = malloc(32);
+	block = realloc(block, 64);
+	free(block);
+	block = calloc(4, 16);
+	free(block);
+	AllocFrameStats stats;
+	bool reported = !alloc_tracker_end_frame(&stats);
+	return reported && stats.allocs == 3 && stats.frees == 2;
+}
+
+static bool check_pool_constructs()
+{
+	struct Counted {
+		int value;
+		Counted() : value(42) {}
+		~Counted() { value = -1; }
+	};
+	ObjectPool pool;
+	if (!pool_init(&pool, sizeof(Counted), 2))
+		return false;
+	Counted* a = POOL_NEW(&pool, Counted);
+	bool ok = a && a->value == 42 && pool.used == 1;
+	POOL_DELETE(&pool, a);
+	ok = ok && pool.used == 0;
+	pool_free_all(&pool);
+	return ok;
+}
+
+int main()
+{
+	if (!check_pool_constructs()) {
+		printf("POOL_NEW did not construct the object\n");
+		return 1;
+	}
+
+	mem_install_imgui_allocator();
+	ImGui::CreateContext();
+	ImGuiIO& io = ImGui::GetIO();
+	io.DisplaySize = ImVec2(1280.0f, 720.0f);
+	io.DeltaTime = 1.0f / 60.0f;
+	io.IniFilename = NULL;
+	unsigned char* pixels;
+	int w, h;
+	io.Fonts->GetTexDataAsRGBA32(&pixels, &w, &h);
+	io.Fonts->TexID = (ImTextureID)(intptr_t)1;
+
+	SimState* sim = sim_state_create(1, 1);
+	SimHistory history;
+	ChunkSource source = { load_chunk, NULL, NULL };
+	ChunkStream chunks;
+	DrawQueue queue;
+	FrameArena arena;
+	if (!sim || !sim_history_init(&history, sim, TEST_HISTORY_TICKS) ||
+		!chunk_stream_init(&chunks, &source, TEST_CHUNK_RADIUS, TEST_CHUNK_BUDGET) ||
+		!draw_queue_init(&queue, TEST_QUEUE_CAPACITY) ||
+		!frame_arena_init(&arena, DRAW_QUEUE_FRAME_BYTES(TEST_QUEUE_CAPACITY))) {
+		printf("Could not set up the frame\n");
+		return 1;
+	}
+	sim_spawn(sim, 0, 0, 0);
+	const bool directions[8] = { true };
+
+	AllocFrameStats stats = {};
+	uint64_t loaded_in_warmup = 0;
+	for (uint32_t frame = 0; frame < TEST_FRAMES; frame++) {
+		alloc_tracker_begin_frame();
+
+		sim_set_input(sim, SIM_PLAYER_ENTITY, sim_input_from_directions(directions));
+		sim_step(sim);
+		sim_history_push(&history, sim);
+		chunk_stream_update(&chunks, frame * TEST_CAMERA_SPEED, frame * TEST_CAMERA_SPEED * 0.5f);
+
+		push_world(&queue, frame);
+		bool built = draw_queue_build(&queue, (DrawOrder)(frame / 64 % DRAW_ORDER_COUNT), 1280, 720, &arena);
+		draw_queue_clear(&queue);
+		show_overlay(&chunks, &queue, &arena, frame);
+		frame_arena_reset(&arena);
+
+		alloc_tracker_end_frame(&stats);
+		if (!built) {
+			printf("Frame %u did not fit the frame arena\n", frame);
+			return 1;
+		}
+		if (frame + 1 == ALLOC_TRACKER_WARMUP_FRAMES)
+			loaded_in_warmup = chunks.stats.total_loaded;
+	}
+
+	bool streamed = chunks.stats.total_loaded > loaded_in_warmup && loader_allocs.load() > 0;
+	uint32_t violations = stats.steady_state_violations;
+	printf("%u frames, %u allocated after the warmup\n", TEST_FRAMES, violations);
+	if (!check_raw_malloc_reported()) {
+		printf("A frame calling malloc, realloc and calloc was not reported\n");
+		return 1;
+	}
+
+	chunk_stream_free(&chunks);
+	draw_queue_free(&queue);
+	frame_arena_free(&arena);
+	sim_history_free(&history);
+	sim_state_destroy(sim);
+	ImGui::DestroyContext();
+
+	if (!streamed) {
+		printf("No chunks were loaded after the warmup\n");
+		return 1;
+	}
+	return violations == 0 ? 0 : 1;
+}
@@ -0,0 +1,474 @@
+#include "stdafx.h"
+#include "texture_codec.h"
+#include "platform.h"
+#include "vfs.h"
+
+#include <string.h>
+#include <math.h>
+
+static const int bc7_weights4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+typedef struct BitWriter {
+	uint8_t* out;
+	uint32_t pos;
+} BitWriter;
+
+static void write_bits(BitWriter* w, uint32_t value, uint32_t count)
+{
+	for (uint32_t i = 0; i < count; i++) {
+		if ((value >> i) & 1)
+			w->out[w->pos >> 3] |= (uint8_t)(1 << (w->pos & 7));
+		w->pos++;
+	}
+}
+
+static uint32_t read_bits(const uint8_t* in, uint32_t* pos, uint32_t count)
+{
+	uint32_t value = 0;
+	for (uint32_t i = 0; i < count; i++) {
+		value |= (uint32_t)((in[*pos >> 3] >> (*pos & 7)) & 1) << i;
+		(*pos)++;
+	}
+	return value;
+}
+
+static int clamp_int(int v, int lo, int hi)
+{
+	return v < lo ? lo : (v > hi ? hi : v);
+}
+
+static float clamp_float(float v, float lo, float hi)
+{
+	return v < lo ? lo : (v > hi ? hi : v);
+}
+
+// Quantizes an RGBA endpoint to 7 bits per channel plus a shared p-bit,
+// picking the p-bit with the lower error.
+static void quantize_endpoint(const float e[4], uint8_t q[4], uint8_t* pbit)
+{
+	float best_err = 1e30f;
+
+	for (int p = 0; p < 2; p++) {
+		uint8_t cand[4];
+		float err = 0.0f;
+		for (int c = 0; c < 4; c++) {
+			int v = clamp_int((int)((e[c] - p) * 0.5f + 0.5f), 0, 127);
+			float d = (float)(v * 2 + p) - e[c];
+			cand[c] = (uint8_t)v;
+			err += d * d;
+		}
+		if (err < best_err) {
+			best_err = err;
+			memcpy(q, cand, 4);
+			*pbit = (uint8_t)p;
+		}
+	}
+}
+
+static void build_palette(const uint8_t q0[4], uint8_t p0, const uint8_t q1[4], uint8_t p1, int palette[16][4])
+{
+	for (int c = 0; c < 4; c++) {
+		int e0 = q0[c] * 2 + p0;
+		int e1 = q1[c] * 2 + p1;
+		for (int i = 0; i < 16; i++)
+			palette[i][c] = ((64 - bc7_weights4[i]) * e0 + bc7_weights4[i] * e1 + 32) >> 6;
+	}
+}
+
+static int pick_indices(const uint8_t px[16][4], const int palette[16][4], uint8_t indices[16])
+{
+	int total = 0;
+	for (int p = 0; p < 16; p++) {
+		int best = 0, best_err = 0x7fffffff;
+		for (int i = 0; i < 16; i++) {
+			int err = 0;
+			for (int c = 0; c < 4; c++) {
+				int d = palette[i][c] - px[p][c];
+				err += d * d;
+			}
+			if (err < best_err) {
+				best_err = err;
+				best = i;
+			}
+		}
+		indices[p] = (uint8_t)best;
+		total += best_err;
+	}
+	return total;
+}
+
+// Least-squares endpoints for a fixed set of indices.
+static bool refit_endpoints(const uint8_t px[16][4], const uint8_t indices[16], float e0[4], float e1[4])
+{
+	float aa = 0, ab = 0, bb = 0;
+	float ax[4] = { 0 }, bx[4] = { 0 };
+
+	for (int p = 0; p < 16; p++) {
+		float w = bc7_weights4[indices[p]] / 64.0f;
+		float a = 1.0f - w;
+		aa += a * a;
+		ab += a * w;
+		bb += w * w;
+		for (int c = 0; c < 4; c++) {
+			ax[c] += a * px[p][c];
+			bx[c] += w * px[p][c];
+		}
+	}
+
+	float det = aa * bb - ab * ab;
+	if (det < 1e-6f)
+		return false;
+
+	for (int c = 0; c < 4; c++) {
+		e0[c] = clamp_float((ax[c] * bb - bx[c] * ab) / det, 0.0f, 255.0f);
+		e1[c] = clamp_float((bx[c] * aa - ax[c] * ab) / det, 0.0f, 255.0f);
+	}
+	return true;
+}
+
+static void encode_block_mode6(const uint8_t px[16][4], uint8_t out[TEX_BC7_BLOCK_BYTES])
+{
+	float mean[4] = { 0 };
+	for (int p = 0; p < 16; p++)
+		for (int c = 0; c < 4; c++)
+			mean[c] += px[p][c] / 16.0f;
+
+	float cov[4][4] = { { 0 } };
+	for (int p = 0; p < 16; p++) {
+		float d[4];
+		for (int c = 0; c < 4; c++)
+			d[c] = px[p][c] - mean[c];
+		for (int i = 0; i < 4; i++)
+			for (int j = 0; j < 4; j++)
+				cov[i][j] += d[i] * d[j];
+	}
+
+	// principal axis by power iteration
+	float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+	for (int iter = 0; iter < 8; iter++) {
+		float next[4] = { 0 };
+		float len = 0.0f;
+		for (int i = 0; i < 4; i++) {
+			for (int j = 0; j < 4; j++)
+				next[i] += cov[i][j] * axis[j];
+			len += next[i] * next[i];
+		}
+		if (len < 1e-12f)
+			break;
+		len = 1.0f / sqrtf(len);
+		for (int i = 0; i < 4; i++)
+			axis[i] = next[i] * len;
+	}
+
+	float tmin = 1e30f, tmax = -1e30f;
+	for (int p = 0; p < 16; p++) {
+		float t = 0.0f;
+		for (int c = 0; c < 4; c++)
+			t += (px[p][c] - mean[c]) * axis[c];
+		if (t < tmin) tmin = t;
+		if (t > tmax) tmax = t;
+	}
+
+	float e0[4], e1[4];
+	for (int c = 0; c < 4; c++) {
+		e0[c] = clamp_float(mean[c] + tmin * axis[c], 0.0f, 255.0f);
+		e1[c] = clamp_float(mean[c] + tmax * axis[c], 0.0f, 255.0f);
+	}
+
+	uint8_t q0[4], q1[4], p0, p1;
+	uint8_t indices[16];
+	int palette[16][4];
+
+	quantize_endpoint(e0, q0, &p0);
+	quantize_endpoint(e1, q1, &p1);
+	build_palette(q0, p0, q1, p1, palette);
+	int err = pick_indices(px, palette, indices);
+
+	if (err > 0 && refit_endpoints(px, indices, e0, e1)) {
+		uint8_t r0[4], r1[4], rp0, rp1;
+		uint8_t r_indices[16];
+
+		quantize_endpoint(e0, r0, &rp0);
+		quantize_endpoint(e1, r1, &rp1);
+		build_palette(r0, rp0, r1, rp1, palette);
+		int r_err = pick_indices(px, palette, r_indices);
+
+		if (r_err < err) {
+			memcpy(q0, r0, 4);
+			memcpy(q1, r1, 4);
+			p0 = rp0;
+			p1 = rp1;
+			memcpy(indices, r_indices, 16);
+		}
+	}
+
+	// the anchor index is stored with an implicit zero top bit
+	if (indices[0] & 8) {
+		uint8_t tq[4];
+		memcpy(tq, q0, 4);
+		memcpy(q0, q1, 4);
+		memcpy(q1, tq, 4);
+		uint8_t tp = p0;
+		p0 = p1;
+		p1 = tp;
+		for (int p = 0; p < 16; p++)
+			indices[p] = (uint8_t)(15 - indices[p]);
+	}
+
+	memset(out, 0, TEX_BC7_BLOCK_BYTES);
+	BitWriter w = { out, 0 };
+	write_bits(&w, 1 << 6, 7);
+	for (int c = 0; c < 4; c++) {
+		write_bits(&w, q0[c], 7);
+		write_bits(&w, q1[c], 7);
+	}
+	write_bits(&w, p0, 1);
+	write_bits(&w, p1, 1);
+	write_bits(&w, indices[0], 3);
+	for (int p = 1; p < 16; p++)
+		write_bits(&w, indices[p], 4);
+}
+
+static void decode_block(const uint8_t in[TEX_BC7_BLOCK_BYTES], uint8_t px[16][4])
+{
+	if ((in[0] & 0x7f) != (1 << 6)) {
+		for (int p = 0; p < 16; p++) {
+			px[p][0] = 0xff;
+			px[p][1] = 0x00;
+			px[p][2] = 0xff;
+			px[p][3] = 0xff;
+		}
+		return;
+	}
+
+	uint32_t pos = 7;
+	uint8_t q0[4], q1[4];
+	for (int c = 0; c < 4; c++) {
+		q0[c] = (uint8_t)read_bits(in, &pos, 7);
+		q1[c] = (uint8_t)read_bits(in, &pos, 7);
+	}
+	uint8_t p0 = (uint8_t)read_bits(in, &pos, 1);
+	uint8_t p1 = (uint8_t)read_bits(in, &pos, 1);
+
+	int palette[16][4];
+	build_palette(q0, p0, q1, p1, palette);
+
+	for (int p = 0; p < 16; p++) {
+		uint32_t index = read_bits(in, &pos, p == 0 ? 3 : 4);
+		for (int c = 0; c < 4; c++)
+			px[p][c] = (uint8_t)palette[index][c];
+	}
+}
+
+size_t tex_bc7_size(uint32_t width, uint32_t height)
+{
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * TEX_BC7_BLOCK_BYTES;
+}
+
+void tex_encode_bc7(const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* out)
+{
+	uint32_t blocks_x = (width + 3) / 4;
+	uint32_t blocks_y = (height + 3) / 4;
+
+	for (uint32_t by = 0; by < blocks_y; by++) {
+		for (uint32_t bx = 0; bx < blocks_x; bx++) {
+			uint8_t px[16][4];
+
+			// edge blocks repeat the last row/column
+			for (uint32_t y = 0; y < 4; y++) {
+				uint32_t sy = by * 4 + y < height ? by * 4 + y : height - 1;
+				for (uint32_t x = 0; x < 4; x++) {
+					uint32_t sx = bx * 4 + x < width ? bx * 4 + x : width - 1;
+					memcpy(px[y * 4 + x], rgba + ((size_t)sy * width + sx) * 4, 4);
+				}
+			}
+
+			encode_block_mode6(px, out + ((size_t)by * blocks_x + bx) * TEX_BC7_BLOCK_BYTES);
+		}
+	}
+}
+
+void tex_decode_bc7(const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba)
+{
+	uint32_t blocks_x = (width + 3) / 4;
+	uint32_t blocks_y = (height + 3) / 4;
+
+	for (uint32_t by = 0; by < blocks_y; by++) {
+		for (uint32_t bx = 0; bx < blocks_x; bx++) {
+			uint8_t px[16][4];
+			decode_block(blocks + ((size_t)by * blocks_x + bx) * TEX_BC7_BLOCK_BYTES, px);
+
+			for (uint32_t y = 0; y < 4 && by * 4 + y < height; y++) {
+				for (uint32_t x = 0; x < 4 && bx * 4 + x < width; x++)
+					memcpy(rgba + ((size_t)(by * 4 + y) * width + bx * 4 + x) * 4, px[y * 4 + x], 4);
+			}
+		}
+	}
+}
+
+static uint8_t* downsample(const uint8_t* src, uint32_t w, uint32_t h, uint32_t* out_w, uint32_t* out_h)
+{
+	uint32_t dw = w > 1 ? w / 2 : 1;
+	uint32_t dh = h > 1 ? h / 2 : 1;
+	uint8_t* dst = (uint8_t*)malloc((size_t)dw * dh * 4);
+	if (!dst)
+		return NULL;
+
+	for (uint32_t y = 0; y < dh; y++) {
+		uint32_t y0 = y * 2 < h ? y * 2 : h - 1;
+		uint32_t y1 = y * 2 + 1 < h ? y * 2 + 1 : h - 1;
+		for (uint32_t x = 0; x < dw; x++) {
+			uint32_t x0 = x * 2 < w ? x * 2 : w - 1;
+			uint32_t x1 = x * 2 + 1 < w ? x * 2 + 1 : w - 1;
+			for (int c = 0; c < 4; c++) {
+				int sum = src[((size_t)y0 * w + x0) * 4 + c] + src[((size_t)y0 * w + x1) * 4 + c] +
+					src[((size_t)y1 * w + x0) * 4 + c] + src[((size_t)y1 * w + x1) * 4 + c];
+				dst[((size_t)y * dw + x) * 4 + c] = (uint8_t)((sum + 2) / 4);
+			}
+		}
+	}
+
+	*out_w = dw;
+	*out_h = dh;
+	return dst;
+}
+
+bool tex_cook_bc7(const uint8_t* rgba, uint32_t width, uint32_t height, CookedTexture* out)
+{
+	memset(out, 0, sizeof(CookedTexture));
+	out->format = TEX_FORMAT_BC7;
+
+	const uint8_t* level = rgba;
+	uint8_t* owned = NULL;
+	uint32_t w = width, h = height;
+
+	while (out->level_count < TEX_MAX_LEVELS) {
+		TextureLevel* l = &out->levels[out->level_count];
+		l->width = w;
+		l->height = h;
+		l->bytes = (uint32_t)tex_bc7_size(w, h);
+		l->data = (uint8_t*)malloc(l->bytes);
+		if (!l->data) {
+			free(owned);
+			tex_free_cooked(out);
+			return false;
+		}
+		tex_encode_bc7(level, w, h, l->data);
+		out->level_count++;
+
+		if (w == 1 && h == 1)
+			break;
+
+		uint8_t* next = downsample(level, w, h, &w, &h);
+		free(owned);
+		if (!next) {
+			tex_free_cooked(out);
+			return false;
+		}
+		owned = next;
+		level = next;
+	}
+
+	free(owned);
+	return true;
+}
+
+bool tex_write_cooked(const char* path, const CookedTexture* texture)
+{
+	FILE* outfile = platform_fopen(path, "wb");
+
+	if (!outfile)
+		return false;
+
+	CookedTextureHeader header;
+	header.magic = TEX_COOKED_MAGIC;
+	header.version = TEX_COOKED_VERSION;
+	header.format = texture->format;
+	header.width = texture->levels[0].width;
+	header.height = texture->levels[0].height;
+	header.levels = texture->level_count;
+
+	bool ok = fwrite(&header, sizeof(header), 1, outfile) == 1;
+	for (uint32_t i = 0; ok && i < texture->level_count; i++) {
+		const TextureLevel* l = &texture->levels[i];
+		ok = fwrite(&l->bytes, sizeof(l->bytes), 1, outfile) == 1 &&
+			fwrite(l->data, 1, l->bytes, outfile) == l->bytes;
+	}
+
+	fclose(outfile);
+	return ok;
+}
+
+bool tex_read_cooked(const char* path, CookedTexture* texture)
+{
+	memset(texture, 0, sizeof(CookedTexture));
+
+	VfsFile file;
+	if (!vfs_read(path, &file))
+		return false;
+
+	const uint8_t* p = file.data;
+	const uint8_t* end = file.data + file.size;
+
+	CookedTextureHeader header;
+	bool ok = (size_t)(end - p) >= sizeof(header);
+	if (ok) {
+		memcpy(&header, p, sizeof(header));
+		p += sizeof(header);
+		ok = header.magic == TEX_COOKED_MAGIC &&
+			header.version == TEX_COOKED_VERSION &&
+			header.levels > 0 && header.levels <= TEX_MAX_LEVELS;
+	}
+
+	if (ok) {
+		texture->format = header.format;
+		uint32_t w = header.width, h = header.height;
+
+		for (uint32_t i = 0; ok && i < header.levels; i++) {
+			TextureLevel* l = &texture->levels[i];
+			l->width = w;
+			l->height = h;
+			ok = (size_t)(end - p) >= sizeof(l->bytes);
+			if (ok) {
+				memcpy(&l->bytes, p, sizeof(l->bytes));
+				p += sizeof(l->bytes);
+				ok = (size_t)(end - p) >= l->bytes &&
+					(header.format != TEX_FORMAT_BC7 || l->bytes == tex_bc7_size(w, h));
+			}
+			if (ok) {
+				l->data = (uint8_t*)malloc(l->bytes);
+				ok = l->data != NULL;
+				if (ok)
+					memcpy(l->data, p, l->bytes);
+				p += l->bytes;
+			}
+			texture->level_count = i + 1;
+			w = w > 1 ? w / 2 : 1;
+			h = h > 1 ? h / 2 : 1;
+		}
+	}
+
+	vfs_close(&file);
+	if (!ok)
+		tex_free_cooked(texture);
+	return ok;
+}
+
+void tex_free_cooked(CookedTexture* texture)
+{
+	for (uint32_t i = 0; i < texture->level_count; i++)
+		free(texture->levels[i].data);
+	memset(texture, 0, sizeof(CookedTexture));
+}
+
+void tex_cooked_path(const char* source_path, char* out, size_t out_size)
+{
+	const char* dot = strrchr(source_path, '.');
+	const char* slash = strrchr(source_path, '/');
+	const char* backslash = strrchr(source_path, '\\');
+	if (backslash > slash)
+		slash = backslash;
+
+	size_t stem = (dot && (!slash || dot > slash)) ? (size_t)(dot - source_path) : strlen(source_path);
+	snprintf(out, out_size, "%.*s%s", (int)stem, source_path, TEX_COOKED_EXTENSION);
+}
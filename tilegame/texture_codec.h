@@ -0,0 +1,85 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+//----------------------------------------------------------------------------
+//
+//  Cooked textures. The cook step (tools/texture_cook.cpp) encodes source
+//    images to BC7 with a full mip chain and writes them as .ctex files next
+//    to the source image. BC7 is core since GL 4.2, so the GL 4.3 context
+//    can upload the blocks directly with glCompressedTexImage2D; when the
+//    driver does not list the format, tex_decode_bc7() expands the blocks
+//    back to RGBA8 on the CPU.
+//
+//  The encoder only emits BC7 mode 6 (one subset, RGBA endpoints with
+//    per-endpoint p-bits, 4-bit indices). That keeps both the encoder and
+//    the fallback decoder small, at some quality cost on blocks with two
+//    distinct colour clusters.
+//
+//  .ctex layout: CookedTextureHeader, then for each level a uint32 byte
+//    count followed by the level's blocks in row-major order.
+//
+
+#define TEX_COOKED_MAGIC 0x31435854	// "TXC1"
+#define TEX_COOKED_VERSION 1
+#define TEX_COOKED_EXTENSION ".ctex"
+#define TEX_MAX_LEVELS 16
+
+#define TEX_BC7_BLOCK_BYTES 16
+
+typedef enum TexFormat {
+	TEX_FORMAT_RGBA8 = 0,
+	TEX_FORMAT_BC7 = 1,
+} TexFormat;
+
+typedef struct CookedTextureHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t format;
+	uint32_t width;
+	uint32_t height;
+	uint32_t levels;
+} CookedTextureHeader;
+
+typedef struct TextureLevel {
+	uint32_t width;
+	uint32_t height;
+	uint32_t bytes;
+	uint8_t* data;
+} TextureLevel;
+
+typedef struct CookedTexture {
+	uint32_t format;
+	uint32_t level_count;
+	TextureLevel levels[TEX_MAX_LEVELS];
+} CookedTexture;
+
+size_t
+tex_bc7_size(uint32_t width, uint32_t height);
+
+// Encodes one RGBA8 image to BC7 blocks. 'out' must hold tex_bc7_size() bytes.
+void
+tex_encode_bc7(const uint8_t* rgba, uint32_t width, uint32_t height, uint8_t* out);
+
+// Decodes BC7 blocks written by tex_encode_bc7() into RGBA8. Blocks in modes
+// other than 6 decode to opaque magenta.
+void
+tex_decode_bc7(const uint8_t* blocks, uint32_t width, uint32_t height, uint8_t* rgba);
+
+// Builds the mip chain of an RGBA8 image and encodes every level.
+bool
+tex_cook_bc7(const uint8_t* rgba, uint32_t width, uint32_t height, CookedTexture* out);
+
+bool
+tex_write_cooked(const char* path, const CookedTexture* texture);
+
+bool
+tex_read_cooked(const char* path, CookedTexture* texture);
+
+void
+tex_free_cooked(CookedTexture* texture);
+
+// Writes the .ctex path that belongs to a source image into 'out'.
+void
+tex_cooked_path(const char* source_path, char* out, size_t out_size);
@@ -0,0 +1,328 @@
+#include "stdafx.h"
+#include "tile_map.h"
+#include "image_decode.h"
+#include "mem_stats.h"
+#include "platform.h"
+
+#include <string.h>
+
+static const uint32_t floor_rgba = 0xff000000u;		// black, bytes r g b a
+static const uint32_t wall_rgba = 0xff0000ffu;		// red
+
+static size_t
+cpu_bytes(const TileMap* map)
+{
+	size_t blocks = (size_t)map->blocks_x * map->blocks_y;
+	return blocks * (TILE_MAP_BLOCK_TILES + 2 + sizeof(uint32_t));
+}
+
+bool tile_map_init(TileMap* map, int width, int height, GLuint program)
+{
+	memset(map, 0, sizeof(*map));
+	map->width = width;
+	map->height = height;
+	map->blocks_x = (width + TILE_MAP_BLOCK - 1) / TILE_MAP_BLOCK;
+	map->blocks_y = (height + TILE_MAP_BLOCK - 1) / TILE_MAP_BLOCK;
+	size_t blocks = (size_t)map->blocks_x * map->blocks_y;
+	size_t tile_bytes = blocks * TILE_MAP_BLOCK_TILES;
+
+	GLint max_texels = 0;
+	glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &max_texels);
+	if (width <= 0 || height <= 0 || tile_bytes > (size_t)max_texels) {
+		printf("Tile map of %dx%d does not fit a buffer texture of %d texels\n", width, height, max_texels);
+		return false;
+	}
+
+	map->tiles = (uint8_t*)calloc(tile_bytes, 1);
+	map->dirty_top = (uint8_t*)malloc(blocks);
+	map->dirty_bottom = (uint8_t*)malloc(blocks);
+	map->dirty_blocks = (uint32_t*)malloc(blocks * sizeof(uint32_t));
+	if (!map->tiles || !map->dirty_top || !map->dirty_bottom || !map->dirty_blocks) {
+		free(map->tiles);
+		free(map->dirty_top);
+		free(map->dirty_bottom);
+		free(map->dirty_blocks);
+		memset(map, 0, sizeof(*map));
+		return false;
+	}
+	memset(map->dirty_top, TILE_MAP_BLOCK - 1, blocks);
+	memset(map->dirty_bottom, 0, blocks);
+	mem_track_alloc(MEM_CPU_TILE_MAPS, cpu_bytes(map));
+
+	map->palette[TILE_MAP_FLOOR] = floor_rgba;
+	map->palette[TILE_MAP_WALL] = wall_rgba;
+	map->palette_count = 2;
+	map->program = program;
+
+	glGenBuffers(1, &map->buffer);
+	glBindBuffer(GL_TEXTURE_BUFFER, map->buffer);
+	glBufferData(GL_TEXTURE_BUFFER, tile_bytes, map->tiles, GL_DYNAMIC_DRAW);
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	mem_track_object(MEM_GL_VERTEX_BUFFERS, map->buffer, tile_bytes);
+	glGenTextures(1, &map->buffer_tex);
+	glBindTexture(GL_TEXTURE_BUFFER, map->buffer_tex);
+	glTexBuffer(GL_TEXTURE_BUFFER, GL_R8UI, map->buffer);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+	glGenTextures(1, &map->palette_tex);
+	glBindTexture(GL_TEXTURE_2D, map->palette_tex);
+	glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA8, TILE_MAP_PALETTE, 1);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	mem_track_object(MEM_GL_TEXTURES, map->palette_tex, TILE_MAP_PALETTE * 4);
+	map->palette_dirty = true;
+
+	// tile_map.frag draws from gl_VertexID, the array has no attributes
+	glGenVertexArrays(1, &map->vao);
+	return true;
+}
+
+bool tile_map_load(TileMap* map, const char* path, GLuint program)
+{
+	int width, height, channels;
+	uint8_t* rgba = image_load(path, &width, &height, &channels, 4);
+	if (!rgba) {
+		printf("Unable to load level %s\n", path);
+		return false;
+	}
+	if (!tile_map_init(map, width, height, program)) {
+		image_free(rgba);
+		return false;
+	}
+	for (int y = 0; y < height; y++) {
+		for (int x = 0; x < width; x++) {
+			uint32_t color;
+			memcpy(&color, rgba + ((size_t)y * width + x) * 4, 4);
+			int index = tile_map_palette_index(map, color);
+			if (index < 0) {
+				printf("Level %s has more than %d colours\n", path, TILE_MAP_PALETTE);
+				image_free(rgba);
+				tile_map_free(map);
+				return false;
+			}
+			map->tiles[tile_map_offset(map, x, y)] = (uint8_t)index;
+		}
+	}
+	image_free(rgba);
+	tile_map_invalidate(map);
+	return true;
+}
+
+bool tile_map_save(const TileMap* map, const char* path)
+{
+	uint8_t* rgba = (uint8_t*)malloc((size_t)map->width * map->height * 4);
+	if (!rgba)
+		return false;
+	for (int y = 0; y < map->height; y++) {
+		for (int x = 0; x < map->width; x++)
+			memcpy(rgba + ((size_t)y * map->width + x) * 4, &map->palette[map->tiles[tile_map_offset(map, x, y)]], 4);
+	}
+	bool ok = image_write_png(path, rgba, map->width, map->height);
+	free(rgba);
+	return ok;
+}
+
+void tile_map_free(TileMap* map)
+{
+	if (map->tiles)
+		mem_track_free(MEM_CPU_TILE_MAPS, cpu_bytes(map));
+	free(map->tiles);
+	free(map->dirty_top);
+	free(map->dirty_bottom);
+	free(map->dirty_blocks);
+	if (map->buffer) {
+		mem_untrack_object(MEM_GL_VERTEX_BUFFERS, map->buffer);
+		glDeleteBuffers(1, &map->buffer);
+	}
+	if (map->palette_tex) {
+		mem_untrack_object(MEM_GL_TEXTURES, map->palette_tex);
+		glDeleteTextures(1, &map->palette_tex);
+	}
+	if (map->buffer_tex)
+		glDeleteTextures(1, &map->buffer_tex);
+	if (map->vao)
+		glDeleteVertexArrays(1, &map->vao);
+	memset(map, 0, sizeof(*map));
+}
+
+int tile_map_palette_index(TileMap* map, uint32_t rgba)
+{
+	for (uint32_t i = 0; i < map->palette_count; i++) {
+		if (map->palette[i] == rgba)
+			return (int)i;
+	}
+	if (map->palette_count == TILE_MAP_PALETTE)
+		return -1;
+	map->palette[map->palette_count] = rgba;
+	map->palette_dirty = true;
+	return (int)map->palette_count++;
+}
+
+uint8_t tile_map_get(const TileMap* map, int x, int y, uint8_t outside)
+{
+	if (x < 0 || y < 0 || x >= map->width || y >= map->height)
+		return outside;
+	return map->tiles[tile_map_offset(map, x, y)];
+}
+
+// Queues the block the first time one of its rows changes.
+static void
+mark_rows(TileMap* map, uint32_t block, int top, int bottom)
+{
+	if (map->dirty_top[block] > map->dirty_bottom[block])
+		map->dirty_blocks[map->dirty_count++] = block;
+	if (top < map->dirty_top[block])
+		map->dirty_top[block] = (uint8_t)top;
+	if (bottom > map->dirty_bottom[block])
+		map->dirty_bottom[block] = (uint8_t)bottom;
+}
+
+void tile_map_set(TileMap* map, int x, int y, uint8_t tile)
+{
+	if (x < 0 || y < 0 || x >= map->width || y >= map->height)
+		return;
+	uint8_t* t = &map->tiles[tile_map_offset(map, x, y)];
+	if (*t == tile)
+		return;
+	*t = tile;
+	map->stats.tiles_changed++;
+	uint32_t block = (uint32_t)(y / TILE_MAP_BLOCK) * map->blocks_x + x / TILE_MAP_BLOCK;
+	mark_rows(map, block, y % TILE_MAP_BLOCK, y % TILE_MAP_BLOCK);
+}
+
+uint32_t tile_map_paint(TileMap* map, int x, int y, int radius, uint8_t tile)
+{
+	uint32_t changed = 0;
+	int r2 = radius * radius + radius;
+	int y0 = y - radius > 0 ? y - radius : 0;
+	int y1 = y + radius < map->height - 1 ? y + radius : map->height - 1;
+	for (int ty = y0; ty <= y1; ty++) {
+		// the span of the row within the circle, split at block edges
+		int dy = ty - y, half = 0;
+		while ((half + 1) * (half + 1) + dy * dy <= r2)
+			half++;
+		int left = x - half > 0 ? x - half : 0;
+		int right = x + half < map->width - 1 ? x + half : map->width - 1;
+		int row = ty % TILE_MAP_BLOCK;
+		for (int tx = left; tx <= right;) {
+			int end = (tx / TILE_MAP_BLOCK + 1) * TILE_MAP_BLOCK - 1;
+			end = end < right ? end : right;
+			uint8_t* t = &map->tiles[tile_map_offset(map, tx, ty)];
+			uint32_t run = 0;
+			for (int i = 0; i <= end - tx; i++) {
+				run += t[i] != tile;
+				t[i] = tile;
+			}
+			if (run) {
+				mark_rows(map, (uint32_t)(ty / TILE_MAP_BLOCK) * map->blocks_x + tx / TILE_MAP_BLOCK, row, row);
+				changed += run;
+			}
+			tx = end + 1;
+		}
+	}
+	map->stats.tiles_changed += changed;
+	return changed;
+}
+
+uint32_t tile_map_stroke(TileMap* map, int x0, int y0, int x1, int y1, int radius, uint8_t tile)
+{
+	int dx = x1 - x0, dy = y1 - y0;
+	int length = abs(dx) > abs(dy) ? abs(dx) : abs(dy);
+	int spacing = radius > 1 ? radius : 1;
+	int stamps = (length + spacing - 1) / spacing;
+	uint32_t changed = 0;
+	for (int i = 1; i <= stamps; i++)
+		changed += tile_map_paint(map, x0 + dx * i / stamps, y0 + dy * i / stamps, radius, tile);
+	if (!stamps)
+		changed = tile_map_paint(map, x1, y1, radius, tile);
+	return changed;
+}
+
+void tile_map_invalidate(TileMap* map)
+{
+	uint32_t blocks = (uint32_t)(map->blocks_x * map->blocks_y);
+	for (uint32_t b = 0; b < blocks; b++) {
+		map->dirty_blocks[b] = b;
+		map->dirty_top[b] = 0;
+		map->dirty_bottom[b] = TILE_MAP_BLOCK - 1;
+	}
+	map->dirty_count = blocks;
+}
+
+void tile_map_upload(TileMap* map)
+{
+	TileMapStats* stats = &map->stats;
+	stats->blocks = map->dirty_count;
+	stats->calls = 0;
+	stats->bytes = 0;
+	if (!map->dirty_count && !map->palette_dirty) {
+		stats->upload_ms = 0.0f;
+		return;
+	}
+	double start = platform_time_us();
+
+	uint32_t blocks = (uint32_t)(map->blocks_x * map->blocks_y);
+	glBindBuffer(GL_TEXTURE_BUFFER, map->buffer);
+	if (map->dirty_count == blocks) {
+		stats->bytes = blocks * TILE_MAP_BLOCK_TILES;
+		glBufferSubData(GL_TEXTURE_BUFFER, 0, stats->bytes, map->tiles);
+		stats->calls = 1;
+	} else {
+		for (uint32_t i = 0; i < map->dirty_count; i++) {
+			uint32_t block = map->dirty_blocks[i];
+			size_t offset = (size_t)block * TILE_MAP_BLOCK_TILES + map->dirty_top[block] * TILE_MAP_BLOCK;
+			uint32_t bytes = (map->dirty_bottom[block] - map->dirty_top[block] + 1) * TILE_MAP_BLOCK;
+			glBufferSubData(GL_TEXTURE_BUFFER, offset, bytes, map->tiles + offset);
+			stats->bytes += bytes;
+			stats->calls++;
+		}
+	}
+	glBindBuffer(GL_TEXTURE_BUFFER, 0);
+	for (uint32_t i = 0; i < map->dirty_count; i++) {
+		uint32_t block = map->dirty_blocks[i];
+		map->dirty_top[block] = TILE_MAP_BLOCK - 1;
+		map->dirty_bottom[block] = 0;
+	}
+	map->dirty_count = 0;
+
+	if (map->palette_dirty) {
+		glBindTexture(GL_TEXTURE_2D, map->palette_tex);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, TILE_MAP_PALETTE, 1, GL_RGBA, GL_UNSIGNED_BYTE, map->palette);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		map->palette_dirty = false;
+		stats->calls++;
+	}
+	stats->total_bytes += stats->bytes;
+	stats->upload_ms = (float)((platform_time_us() - start) / 1000.0);
+}
+
+void tile_map_render(TileMap* map, float origin_x, float origin_y, float tile_size, int view_width, int view_height, float opacity)
+{
+	glDisable(GL_DEPTH_TEST);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	GLuint program = map->program;
+	glUseProgram(program);
+	glUniform1i(glGetUniformLocation(program, "tiles"), 0);
+	glUniform1i(glGetUniformLocation(program, "palette"), 1);
+	glUniform2f(glGetUniformLocation(program, "view_size"), (float)view_width, (float)view_height);
+	glUniform2f(glGetUniformLocation(program, "origin"), origin_x, origin_y);
+	glUniform1f(glGetUniformLocation(program, "tile_size"), tile_size);
+	glUniform2i(glGetUniformLocation(program, "map_size"), map->width, map->height);
+	glUniform1i(glGetUniformLocation(program, "blocks_x"), map->blocks_x);
+	glUniform1f(glGetUniformLocation(program, "opacity"), opacity);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_BUFFER, map->buffer_tex);
+	glActiveTexture(GL_TEXTURE1);
+	glBindTexture(GL_TEXTURE_2D, map->palette_tex);
+	glBindVertexArray(map->vao);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glActiveTexture(GL_TEXTURE0);
+	glBindTexture(GL_TEXTURE_BUFFER, 0);
+
+	glDisable(GL_BLEND);
+}
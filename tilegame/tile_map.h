@@ -0,0 +1,127 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "glad/include/glad.h"
+
+//----------------------------------------------------------------------------
+//
+//  Editable tile layer drawn from a GL buffer. Each tile is a one byte
+//    index into a palette of up to TILE_MAP_PALETTE colours; level images
+//    map to it colour for colour, so a map saved after editing has the
+//    colours it was loaded with. Index 0 is floor (black) and 1 wall (red),
+//    the colours the levels use and the ids of chunk_stream.h.
+//
+//  The tiles are laid out in blocks of TILE_MAP_BLOCK x TILE_MAP_BLOCK,
+//    each block's rows one after another, in a buffer texture read by
+//    tile_map.frag. Changing a tile records the range of rows changed in
+//    its block and queues the block once; tile_map_upload() then sends
+//    each queued block's rows with one glBufferSubData(), so a brush
+//    stroke costs the blocks it touched rather than the whole map. When
+//    every block is queued the buffer is sent in a single call.
+//
+//  Storage is allocated by tile_map_init(); painting and uploading never
+//    allocate.
+//
+
+#define TILE_MAP_BLOCK 64			// tiles per side of a block, as in tile_map.frag
+#define TILE_MAP_BLOCK_TILES (TILE_MAP_BLOCK * TILE_MAP_BLOCK)
+#define TILE_MAP_PALETTE 256
+
+#define TILE_MAP_FLOOR 0
+#define TILE_MAP_WALL 1
+
+typedef struct TileMapStats {
+	// last upload
+	uint32_t blocks;
+	uint32_t calls;
+	uint32_t bytes;
+	float upload_ms;				// CPU time of the calls
+	// since tile_map_init()
+	uint64_t total_bytes;
+	uint64_t tiles_changed;
+} TileMapStats;
+
+typedef struct TileMap {
+	int width;						// tiles
+	int height;
+	int blocks_x;
+	int blocks_y;
+	uint8_t* tiles;					// blocks_x * blocks_y blocks
+	uint32_t palette[TILE_MAP_PALETTE];	// RGBA bytes in memory order
+	uint32_t palette_count;
+	bool palette_dirty;
+
+	uint8_t* dirty_top;				// per block, rows to upload, top > bottom when clean
+	uint8_t* dirty_bottom;
+	uint32_t* dirty_blocks;			// queued blocks
+	uint32_t dirty_count;
+
+	GLuint buffer;
+	GLuint buffer_tex;
+	GLuint palette_tex;
+	GLuint vao;
+	GLuint program;					// present.vert with tile_map.frag, owned by the caller
+	TileMapStats stats;
+} TileMap;
+
+// A width x height map of floor with the floor and wall palette. Fails
+// when the GL has no room for a buffer texture that size.
+bool
+tile_map_init(TileMap* map, int width, int height, GLuint program);
+
+// Loads a level image through the VFS. Fails when it has more colours
+// than the palette holds.
+bool
+tile_map_load(TileMap* map, const char* path, GLuint program);
+
+// Writes the map as an RGBA PNG to 'path' on disk.
+bool
+tile_map_save(const TileMap* map, const char* path);
+
+void
+tile_map_free(TileMap* map);
+
+// Palette index of 'rgba', added to the palette when new, or -1 when the
+// palette is full.
+int
+tile_map_palette_index(TileMap* map, uint32_t rgba);
+
+static inline uint32_t
+tile_map_offset(const TileMap* map, int x, int y)
+{
+	uint32_t block = (uint32_t)(y / TILE_MAP_BLOCK) * map->blocks_x + x / TILE_MAP_BLOCK;
+	return block * TILE_MAP_BLOCK_TILES + (y % TILE_MAP_BLOCK) * TILE_MAP_BLOCK + x % TILE_MAP_BLOCK;
+}
+
+// Tile at (x, y), or 'outside' off the map.
+uint8_t
+tile_map_get(const TileMap* map, int x, int y, uint8_t outside);
+
+void
+tile_map_set(TileMap* map, int x, int y, uint8_t tile);
+
+// Sets every tile within 'radius' tiles of (x, y), a single tile at 0.
+// Returns the number of tiles that changed.
+uint32_t
+tile_map_paint(TileMap* map, int x, int y, int radius, uint8_t tile);
+
+// Paints along the segment from (x0, y0) to (x1, y1), stamps close enough
+// that the strokes join, the last one at (x1, y1).
+uint32_t
+tile_map_stroke(TileMap* map, int x0, int y0, int x1, int y1, int radius, uint8_t tile);
+
+// Queues every block, as after loading.
+void
+tile_map_invalidate(TileMap* map);
+
+// Sends the queued blocks and the palette, when changed, to the GL.
+void
+tile_map_upload(TileMap* map);
+
+// Draws the map into the bound framebuffer, whose viewport covers a
+// view_width x view_height view, with tile (0, 0) at view pixel
+// (origin_x, origin_y) and 'tile_size' pixels per tile, blended at
+// 'opacity'. Blending is off afterwards.
+void
+tile_map_render(TileMap* map, float origin_x, float origin_y, float tile_size, int view_width, int view_height, float opacity);
@@ -0,0 +1,38 @@
+// pack_archive.cpp : Packs files into an archive the VFS can mount.
+//
+// usage: pack_archive <archive> <root> <file> [<file> ...]
+//
+// Each file is stored under its path relative to <root>. The data is laid
+// out in the order the files are given, which is the order the VFS reads
+// ahead in, so list them in the order the game loads them. For example:
+//
+//   pack_archive Resources.pak Resources Resources/shaders/* Resources/textures/*.png
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "../vfs.h"
+
+int main(int argc, char** argv)
+{
+	if (argc < 4) {
+		printf("usage: %s <archive> <root> <file> [<file> ...]\n", argv[0]);
+		return 1;
+	}
+
+	const char** files = (const char**)(argv + 3);
+	int count = argc - 3;
+	if (!vfs_pack_archive(argv[1], argv[2], files, count)) {
+		printf("%s: unable to write the archive\n", argv[1]);
+		return 1;
+	}
+
+	uint64_t total = 0, size;
+	for (int i = 0; i < count; i++) {
+		if (platform_file_size(files[i], &size))
+			total += size;
+	}
+	platform_file_size(argv[1], &size);
+	printf("%s: %d files, %llu bytes of data, %llu bytes packed\n", argv[1], count, (unsigned long long)total, (unsigned long long)size);
+	return 0;
+}
@@ -0,0 +1,241 @@
+// sim_runner.cpp : Runs the game simulation without a window or GL context.
+//
+// usage: sim_runner [ticks] [entities] [seed] [overdraw.bmp]
+//
+// Steps the simulation the way the game loop does, pushing every tick into
+// the rewind history, with a scripted player walking each of the eight
+// directions in turn. Prints the per-tick cost and the final state hash,
+// then replays the recorded inputs from a fresh state and checks every
+// tick's hash against the live run. Exits with 1 when the replay diverges,
+// so runs can be compared across builds, compilers and machines.
+//
+// Given an image path, the final state is also drawn through the overdraw
+// view on a headless EGL context: the world quad plus a sprite cell for
+// every entity in a window-sized view around the player. The fragment
+// counters are printed and the heatmap is written as a BMP.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#include "../sim_state.h"
+#include "../platform.h"
+
+#ifdef TILEGAME_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#include "../load_shaders.h"
+#include "../overdraw.h"
+#endif
+
+#define RUNNER_DEFAULT_TICKS 6000
+#define RUNNER_DEFAULT_ENTITIES 10000
+#define RUNNER_DEFAULT_SEED 1234
+#define RUNNER_HISTORY_TICKS 600
+
+// the player walks for 45 ticks, then stands for 15, then turns
+#define RUNNER_WALK_TICKS 45
+#define RUNNER_REST_TICKS 15
+
+// the game's window, and a 64 pixel sprite cell at its world scale of 2
+#define RUNNER_VIEW_WIDTH 1280
+#define RUNNER_VIEW_HEIGHT 640
+#define RUNNER_SPRITE_SIZE 128
+
+static uint8_t scripted_input(uint32_t tick)
+{
+	uint32_t phase = tick % (RUNNER_WALK_TICKS + RUNNER_REST_TICKS);
+	if (phase >= RUNNER_WALK_TICKS)
+		return 0;
+	uint32_t dir = tick / (RUNNER_WALK_TICKS + RUNNER_REST_TICKS) % 8;
+	return (uint8_t)(1 << dir);
+}
+
+static SimState* create_state(uint32_t entities, uint32_t seed)
+{
+	SimState* state = sim_state_create(entities, seed);
+	if (!state)
+		return NULL;
+	for (uint32_t i = 0; i < entities; i++)
+		sim_spawn(state, (int32_t)(i % 1024) * 64, (int32_t)(i / 1024) * 64, PLAYER_STANCE_DOWN);
+	return state;
+}
+
+#ifdef TILEGAME_EGL
+static bool create_context()
+{
+	PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	EGLDisplay display = get_platform_display ?
+		get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) : eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	EGLint major, minor;
+	if (display == EGL_NO_DISPLAY || !eglInitialize(display, &major, &minor))
+		return false;
+
+	eglBindAPI(EGL_OPENGL_API);
+	const EGLint context_attribs[] = {
+		EGL_CONTEXT_MAJOR_VERSION, 4,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE
+	};
+	EGLContext context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, context_attribs);
+	if (context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+		return false;
+	return gladLoadGLLoader((GLADloadproc)eglGetProcAddress) != 0;
+}
+
+// A quad in tilegame.vert's layout (position, colour, texture coordinate)
+// from a rectangle in view pixels, y down.
+static void push_quad(std::vector<float>* vertices, float x0, float y0, float x1, float y1)
+{
+	float l = x0 / RUNNER_VIEW_WIDTH * 2.0f - 1.0f, r = x1 / RUNNER_VIEW_WIDTH * 2.0f - 1.0f;
+	float t = 1.0f - y0 / RUNNER_VIEW_HEIGHT * 2.0f, b = 1.0f - y1 / RUNNER_VIEW_HEIGHT * 2.0f;
+	const float corners[6][4] = {
+		{ l, t, 0.0f, 0.0f }, { l, b, 0.0f, 1.0f }, { r, b, 1.0f, 1.0f },
+		{ l, t, 0.0f, 0.0f }, { r, b, 1.0f, 1.0f }, { r, t, 1.0f, 0.0f },
+	};
+	for (int i = 0; i < 6; i++) {
+		const float vertex[8] = { corners[i][0], corners[i][1], 0.0f, 1.0f, 1.0f, 1.0f, corners[i][2], corners[i][3] };
+		vertices->insert(vertices->end(), vertex, vertex + 8);
+	}
+}
+
+static bool export_overdraw(const SimState* state, const char* path)
+{
+	if (!create_context()) {
+		printf("Unable to create a headless GL 4.3 context\n");
+		return false;
+	}
+
+	ShaderInfo count_shaders[] = {
+		{ GL_VERTEX_SHADER, "Resources/shaders/tilegame.vert" },
+		{ GL_FRAGMENT_SHADER, "Resources/shaders/overdraw.frag" },
+		{ GL_NONE, NULL }
+	};
+	ShaderInfo heatmap_shaders[] = {
+		{ GL_VERTEX_SHADER, "Resources/shaders/present.vert" },
+		{ GL_FRAGMENT_SHADER, "Resources/shaders/heatmap.frag" },
+		{ GL_NONE, NULL }
+	};
+	GLuint count_program = load_shaders(count_shaders);
+	GLuint heatmap_program = load_shaders(heatmap_shaders);
+	OverdrawView view;
+	if (!count_program || !heatmap_program ||
+		!overdraw_init(&view, RUNNER_VIEW_WIDTH, RUNNER_VIEW_HEIGHT, count_program, 0, heatmap_program)) {
+		printf("Unable to set up the overdraw view\n");
+		return false;
+	}
+
+	// the world covers the view, as in the game, with the entities on top
+	std::vector<float> vertices;
+	push_quad(&vertices, 0.0f, 0.0f, RUNNER_VIEW_WIDTH, RUNNER_VIEW_HEIGHT);
+	int32_t left = state->pos_x[SIM_PLAYER_ENTITY] - RUNNER_VIEW_WIDTH / 2;
+	int32_t top = state->pos_y[SIM_PLAYER_ENTITY] - RUNNER_VIEW_HEIGHT / 2;
+	uint32_t drawn = 0;
+	for (uint32_t i = 0; i < state->header->count; i++) {
+		float x = (float)(state->pos_x[i] - left), y = (float)(state->pos_y[i] - top);
+		if (x + RUNNER_SPRITE_SIZE <= 0.0f || y + RUNNER_SPRITE_SIZE <= 0.0f || x >= RUNNER_VIEW_WIDTH || y >= RUNNER_VIEW_HEIGHT)
+			continue;
+		push_quad(&vertices, x, y, x + RUNNER_SPRITE_SIZE, y + RUNNER_SPRITE_SIZE);
+		drawn++;
+	}
+
+	GLuint vao, vbo;
+	glGenVertexArrays(1, &vao);
+	glGenBuffers(1, &vbo);
+	glBindVertexArray(vao);
+	glBindBuffer(GL_ARRAY_BUFFER, vbo);
+	glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+	for (int a = 0; a < 3; a++) {
+		static const int sizes[3] = { 3, 3, 2 }, offsets[3] = { 0, 3, 6 };
+		glVertexAttribPointer(a, sizes[a], GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(offsets[a] * sizeof(float)));
+		glEnableVertexAttribArray(a);
+	}
+
+	overdraw_begin(&view);
+	glUseProgram(view.count_program);
+	glDrawArrays(GL_TRIANGLES, 0, (GLsizei)(vertices.size() / 8));
+	overdraw_end(&view);
+	bool ok = overdraw_export(&view, path);
+
+	if (ok) {
+		const OverdrawStats* stats = &view.stats;
+		printf("overdraw of %u entities in %ux%u: %llu fragments, %.2f per pixel, %.2f per covered pixel, deepest %u\n",
+			drawn, RUNNER_VIEW_WIDTH, RUNNER_VIEW_HEIGHT, (unsigned long long)stats->fragments, stats->overdraw,
+			stats->average_layers, stats->max_layers);
+		printf("layers:");
+		for (int b = 0; b < OVERDRAW_BUCKETS; b++)
+			printf(" %s %.1f%%", overdraw_bucket_name(b), stats->covered_pixels ? stats->histogram[b] * 100.0 / stats->covered_pixels : 0.0);
+		printf("\nheatmap written to %s\n", path);
+	}
+
+	glDeleteBuffers(1, &vbo);
+	glDeleteVertexArrays(1, &vao);
+	overdraw_free(&view);
+	glDeleteProgram(count_program);
+	glDeleteProgram(heatmap_program);
+	return ok;
+}
+#else
+static bool export_overdraw(const SimState* state, const char* path)
+{
+	printf("%s not written: the overdraw export needs a build with EGL\n", path);
+	return false;
+}
+#endif
+
+int main(int argc, char** argv)
+{
+	uint32_t ticks = argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 10) : RUNNER_DEFAULT_TICKS;
+	uint32_t entities = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 10) : RUNNER_DEFAULT_ENTITIES;
+	uint32_t seed = argc > 3 ? (uint32_t)strtoul(argv[3], NULL, 10) : RUNNER_DEFAULT_SEED;
+	const char* overdraw_path = argc > 4 ? argv[4] : NULL;
+	if (ticks == 0 || entities == 0) {
+		printf("usage: %s [ticks] [entities] [seed] [overdraw.bmp]\n", argv[0]);
+		return 1;
+	}
+
+	SimState* state = create_state(entities, seed);
+	SimHistory history;
+	if (!state || !sim_history_init(&history, state, RUNNER_HISTORY_TICKS)) {
+		printf("Unable to create a simulation of %u entities\n", entities);
+		return 1;
+	}
+
+	std::vector<uint8_t> inputs(ticks);
+	std::vector<uint64_t> hashes(ticks);
+
+	double start = platform_time_us();
+	uint64_t cpu_start = platform_process_cpu_us();
+	for (uint32_t t = 0; t < ticks; t++) {
+		inputs[t] = scripted_input(t);
+		sim_set_input(state, SIM_PLAYER_ENTITY, inputs[t]);
+		sim_step(state);
+		hashes[t] = sim_history_push(&history, state);
+	}
+	double wall_us = platform_time_us() - start;
+	uint64_t cpu_us = platform_process_cpu_us() - cpu_start;
+
+	printf("%u ticks, %u entities, seed %u\n", ticks, entities, seed);
+	printf("tick %.1f us (%.2f ns/entity), %.0f ticks/s, CPU %.0f%%\n",
+		wall_us / ticks, wall_us * 1000.0 / ((double)ticks * entities), ticks * 1000000.0 / wall_us,
+		wall_us > 0.0 ? cpu_us * 100.0 / wall_us : 0.0);
+	printf("player at %d,%d, final hash %016llx\n",
+		state->pos_x[SIM_PLAYER_ENTITY], state->pos_y[SIM_PLAYER_ENTITY], (unsigned long long)hashes[ticks - 1]);
+
+	SimState* replay = create_state(entities, seed);
+	int diverged = replay ? sim_replay(replay, inputs.data(), hashes.data(), ticks) : 0;
+	if (diverged >= 0)
+		printf("replay diverged at tick %d\n", diverged);
+	else
+		printf("replay matches\n");
+
+	bool exported = !overdraw_path || export_overdraw(state, overdraw_path);
+
+	sim_state_destroy(replay);
+	sim_history_free(&history);
+	sim_state_destroy(state);
+	return diverged >= 0 || !exported ? 1 : 0;
+}
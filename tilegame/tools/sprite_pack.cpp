@@ -0,0 +1,109 @@
+// sprite_pack.cpp : Trims the cells of sprite sheets to their alpha bounds
+// and repacks them into .sprites atlases.
+//
+// usage: sprite_pack <sheet> <cell width> <cell height> [<sheet> <cell width> <cell height> ...]
+//
+// Each atlas is written next to its sheet with the .sprites extension. The
+// report lists, per sheet, the pixels a frame set covers when every frame
+// is drawn as a full cell against trimmed quads, and the texture size
+// before and after repacking; a sheet that repacking would not shrink is
+// kept, with its frames trimmed in place. For example:
+//
+//   sprite_pack Resources/textures/8dir.png 64 64 Resources/textures/DudeWalking.png 28 49
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_image.h"
+
+#include "../sprite_atlas.h"
+
+static double percent_saved(uint64_t before, uint64_t after)
+{
+	return before ? 100.0 * (1.0 - (double)after / (double)before) : 0.0;
+}
+
+// Older sheets mark the background with a key colour instead of alpha. When
+// no pixel is transparent, every pixel of the top-left pixel's colour is.
+static bool key_out_background(uint8_t* rgba, int width, int height)
+{
+	size_t count = (size_t)width * height;
+	for (size_t i = 0; i < count; i++) {
+		if (rgba[i * 4 + 3] == 0)
+			return false;
+	}
+	for (size_t i = 0; i < count; i++) {
+		if (memcmp(rgba + i * 4, rgba, 3) == 0)
+			rgba[i * 4 + 3] = 0;
+	}
+	return true;
+}
+
+static bool pack(const char* path, int cell_width, int cell_height, SpriteAtlasStats* total)
+{
+	int width, height, channels;
+	unsigned char* data = stbi_load(path, &width, &height, &channels, 4);
+	if (!data) {
+		printf("%s: unable to load (%s)\n", path, stbi_failure_reason());
+		return false;
+	}
+
+	bool keyed = key_out_background(data, width, height);
+
+	auto start = std::chrono::steady_clock::now();
+	SpriteAtlas atlas;
+	SpriteAtlasStats stats;
+	bool ok = sprite_atlas_build(data, width, height, cell_width, cell_height, 0, &atlas, &stats);
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	stbi_image_free(data);
+
+	if (!ok) {
+		printf("%s: unable to slice into %dx%d cells\n", path, cell_width, cell_height);
+		return false;
+	}
+
+	char out_path[1024];
+	sprite_atlas_path(path, out_path, sizeof(out_path));
+	ok = sprite_atlas_write(out_path, &atlas);
+
+	printf("%s: %u frames of %dx%d (%u empty, %u duplicate%s) in %.1f ms\n", path, atlas.header.frame_count,
+		cell_width, cell_height, stats.empty_frames, stats.duplicate_frames, keyed ? ", background keyed out" : "", ms);
+	printf("  drawn pixels  %10llu -> %10llu  (%.1f%% saved)\n", (unsigned long long)stats.cell_pixels,
+		(unsigned long long)stats.trimmed_pixels, percent_saved(stats.cell_pixels, stats.trimmed_pixels));
+	printf("  texture       %4dx%-5d -> %4ux%-5u (%.1f%% saved%s)\n", width, height, atlas.header.width, atlas.header.height,
+		percent_saved(stats.sheet_pixels, stats.atlas_pixels), stats.kept_sheet ? ", packing did not shrink it, sheet kept" : "");
+	sprite_atlas_free(&atlas);
+
+	if (!ok) {
+		printf("%s: unable to write\n", out_path);
+		return false;
+	}
+
+	total->cell_pixels += stats.cell_pixels;
+	total->trimmed_pixels += stats.trimmed_pixels;
+	total->sheet_pixels += stats.sheet_pixels;
+	total->atlas_pixels += stats.atlas_pixels;
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 4 || (argc - 1) % 3 != 0) {
+		printf("usage: %s <sheet> <cell width> <cell height> [<sheet> <cell width> <cell height> ...]\n", argv[0]);
+		return 1;
+	}
+
+	SpriteAtlasStats total = {};
+	int failed = 0;
+	for (int i = 1; i < argc; i += 3) {
+		if (!pack(argv[i], atoi(argv[i + 1]), atoi(argv[i + 2]), &total))
+			failed++;
+	}
+
+	printf("total: drawn pixels %.1f%% saved, texture pixels %.1f%% saved\n",
+		percent_saved(total.cell_pixels, total.trimmed_pixels), percent_saved(total.sheet_pixels, total.atlas_pixels));
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,91 @@
+// texture_cook.cpp : Offline cook step that encodes source images to BC7 .ctex files.
+//
+// usage: texture_cook <image> [<image> ...]
+//
+// Each image is written next to its source with the .ctex extension and a
+// size report is printed for it. Runs without a GL context.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "../stb_image.h"
+
+#include "../texture_codec.h"
+
+static size_t rgba_mip_chain_bytes(uint32_t w, uint32_t h)
+{
+	size_t bytes = 0;
+	for (;;) {
+		bytes += (size_t)w * h * 4;
+		if (w == 1 && h == 1)
+			break;
+		w = w > 1 ? w / 2 : 1;
+		h = h > 1 ? h / 2 : 1;
+	}
+	return bytes;
+}
+
+static bool cook(const char* path, size_t* raw_total, size_t* cooked_total)
+{
+	int width, height, channels;
+	unsigned char* data = stbi_load(path, &width, &height, &channels, 4);
+	if (!data) {
+		printf("%s: unable to load (%s)\n", path, stbi_failure_reason());
+		return false;
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	CookedTexture texture;
+	bool ok = tex_cook_bc7(data, width, height, &texture);
+	double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	stbi_image_free(data);
+
+	if (!ok) {
+		printf("%s: encoding failed\n", path);
+		return false;
+	}
+
+	char out_path[1024];
+	tex_cooked_path(path, out_path, sizeof(out_path));
+	ok = tex_write_cooked(out_path, &texture);
+
+	size_t raw = rgba_mip_chain_bytes(width, height);
+	size_t cooked = 0;
+	for (uint32_t i = 0; i < texture.level_count; i++)
+		cooked += texture.levels[i].bytes;
+	tex_free_cooked(&texture);
+
+	if (!ok) {
+		printf("%s: unable to write %s\n", path, out_path);
+		return false;
+	}
+
+	printf("%-48s %5dx%-5d %9zu -> %8zu bytes (%.1fx) %8.1f ms\n",
+		path, width, height, raw, cooked, (double)raw / cooked, ms);
+	*raw_total += raw;
+	*cooked_total += cooked;
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2) {
+		printf("usage: %s <image> [<image> ...]\n", argv[0]);
+		return 1;
+	}
+
+	size_t raw_total = 0, cooked_total = 0;
+	int failures = 0;
+
+	for (int i = 1; i < argc; i++) {
+		if (!cook(argv[i], &raw_total, &cooked_total))
+			failures++;
+	}
+
+	if (cooked_total)
+		printf("total: %zu -> %zu bytes of VRAM (%.1fx)\n", raw_total, cooked_total, (double)raw_total / cooked_total);
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,644 @@
+#include "stdafx.h"
+#include "vfs.h"
+#include "mem_stats.h"
+
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define VFS_QUEUE_SIZE 64
+#define VFS_TOUCH_STRIDE 4096
+
+typedef struct VfsMount {
+	char mount_point[VFS_MAX_PATH];
+	size_t mount_length;
+	char dir[VFS_MAX_PATH];				// loose directory, empty for archives
+	PlatformMapping archive;
+	const VfsArchiveEntry* entries;
+	const char* names;
+	uint32_t entry_count;
+	uint8_t* resident;					// per VFS_PAGE_BLOCK: faulted in by the I/O thread
+	size_t block_count;
+} VfsMount;
+
+typedef struct VfsLocation {
+	int mount;							// -1 for a loose file
+	const VfsArchiveEntry* entry;
+	char disk_path[VFS_MAX_PATH * 2];
+} VfsLocation;
+
+typedef enum VfsSlotState {
+	VFS_SLOT_EMPTY,
+	VFS_SLOT_PENDING,
+	VFS_SLOT_READY
+} VfsSlotState;
+
+typedef struct VfsCacheSlot {
+	char path[VFS_MAX_PATH];
+	VfsSlotState state;
+	VfsFile file;
+} VfsCacheSlot;
+
+typedef enum VfsRequestType {
+	VFS_REQUEST_PREFETCH,
+	VFS_REQUEST_READ_AHEAD
+} VfsRequestType;
+
+typedef struct VfsRequest {
+	VfsRequestType type;
+	int slot;
+	int mount;
+	uint64_t offset;
+	uint64_t bytes;
+} VfsRequest;
+
+// Mounts are only appended while the game runs; the I/O thread reads the
+// first mount_count entries without taking the lock.
+static VfsMount mounts[VFS_MAX_MOUNTS];
+static std::atomic<int> mount_count(0);
+
+static std::mutex vfs_lock;
+static std::condition_variable io_wake;
+static std::condition_variable slot_ready;
+static std::thread io_thread;
+static bool io_running = false;
+static bool io_stop = false;
+
+static VfsRequest queue[VFS_QUEUE_SIZE];
+static int queue_head = 0;
+static int queue_count = 0;
+
+static VfsCacheSlot slots[VFS_CACHE_SLOTS];
+static size_t cache_bytes = 0;
+
+static VfsStats frame_stats;
+static VfsStats last_frame_stats;
+static VfsStats total_stats;
+
+static void normalize_path(const char* path, char* out)
+{
+	while (path[0] == '.' && (path[1] == '/' || path[1] == '\\'))
+		path += 2;
+
+	size_t i = 0;
+	for (; path[i] && i < VFS_MAX_PATH - 1; i++)
+		out[i] = path[i] == '\\' ? '/' : path[i];
+	out[i] = 0;
+}
+
+static int compare_name(const VfsMount* mount, const VfsArchiveEntry* entry, const char* name, size_t length)
+{
+	const char* entry_name = mount->names + entry->name_offset;
+	size_t n = entry->name_length < length ? entry->name_length : length;
+	int c = memcmp(entry_name, name, n);
+	if (c != 0)
+		return c;
+	return entry->name_length < length ? -1 : (entry->name_length > length ? 1 : 0);
+}
+
+static const VfsArchiveEntry* find_entry(const VfsMount* mount, const char* name)
+{
+	size_t length = strlen(name);
+	uint32_t lo = 0, hi = mount->entry_count;
+	while (lo < hi) {
+		uint32_t mid = (lo + hi) / 2;
+		int c = compare_name(mount, &mount->entries[mid], name, length);
+		if (c == 0)
+			return &mount->entries[mid];
+		if (c < 0)
+			lo = mid + 1;
+		else
+			hi = mid;
+	}
+	return NULL;
+}
+
+static bool resolve(const char* path, VfsLocation* location)
+{
+	uint64_t size;
+	for (int m = mount_count.load(std::memory_order_acquire) - 1; m >= 0; m--) {
+		const VfsMount* mount = &mounts[m];
+		const char* rel = path;
+		if (mount->mount_length) {
+			if (strncmp(path, mount->mount_point, mount->mount_length) != 0 || path[mount->mount_length] != '/')
+				continue;
+			rel = path + mount->mount_length + 1;
+		}
+
+		if (mount->archive.data) {
+			location->entry = find_entry(mount, rel);
+			if (location->entry) {
+				location->mount = m;
+				return true;
+			}
+		} else {
+			snprintf(location->disk_path, sizeof(location->disk_path), "%s/%s", mount->dir, rel);
+			if (platform_file_size(location->disk_path, &size)) {
+				location->mount = -1;
+				return true;
+			}
+		}
+	}
+
+	// not under any mount: a plain path on disk
+	snprintf(location->disk_path, sizeof(location->disk_path), "%s", path);
+	location->mount = -1;
+	location->entry = NULL;
+	return platform_file_size(path, &size);
+}
+
+static void touch_pages(const uint8_t* data, size_t size)
+{
+	volatile uint8_t sink = 0;
+	for (size_t i = 0; i < size; i += VFS_TOUCH_STRIDE)
+		sink += data[i];
+	if (size)
+		sink += data[size - 1];
+	(void)sink;
+}
+
+// Faults in the blocks of an archive range that are not resident yet and
+// returns how many bytes that touched. Called without the lock held.
+static uint64_t fault_in_range(VfsMount* mount, uint64_t offset, uint64_t bytes)
+{
+	if (offset >= mount->archive.size || bytes == 0)
+		return 0;
+	if (bytes > mount->archive.size - offset)
+		bytes = mount->archive.size - offset;
+
+	size_t first = (size_t)(offset / VFS_PAGE_BLOCK);
+	size_t last = (size_t)((offset + bytes - 1) / VFS_PAGE_BLOCK);
+	uint64_t touched = 0;
+	for (size_t b = first; b <= last; b++) {
+		{
+			std::lock_guard<std::mutex> guard(vfs_lock);
+			if (mount->resident[b])
+				continue;
+		}
+		uint64_t start = (uint64_t)b * VFS_PAGE_BLOCK;
+		uint64_t length = std::min<uint64_t>(VFS_PAGE_BLOCK, mount->archive.size - start);
+		touch_pages(mount->archive.data + start, (size_t)length);
+		touched += length;
+
+		std::lock_guard<std::mutex> guard(vfs_lock);
+		mount->resident[b] = 1;
+	}
+	return touched;
+}
+
+// Loads a resolved file. 'was_resident' is set when no disk access was
+// needed because the I/O thread had already brought the data in.
+static bool load_location(const VfsLocation* location, VfsFile* file, bool* was_resident, uint64_t* faulted)
+{
+	memset(file, 0, sizeof(*file));
+	*was_resident = false;
+	*faulted = 0;
+
+	if (location->mount >= 0) {
+		VfsMount* mount = &mounts[location->mount];
+		file->data = mount->archive.data + location->entry->data_offset;
+		file->size = (size_t)location->entry->size;
+		*faulted = fault_in_range(mount, location->entry->data_offset, location->entry->size);
+		*was_resident = *faulted == 0;
+		return true;
+	}
+
+	uint64_t size;
+	if (!platform_file_size(location->disk_path, &size))
+		return false;
+
+	if (size >= VFS_MMAP_THRESHOLD && platform_map_file(location->disk_path, &file->mapping)) {
+		file->data = file->mapping.data;
+		file->size = file->mapping.size;
+		touch_pages(file->data, file->size);
+		*faulted = file->size;
+		return true;
+	}
+
+	size_t read_size;
+	file->owned = platform_read_file(location->disk_path, &read_size);
+	if (!file->owned)
+		return false;
+	file->data = file->owned;
+	file->size = read_size;
+	*faulted = read_size;
+	return true;
+}
+
+static void add_stats(VfsStats* stats, uint64_t bytes_read, uint64_t bytes_prefetched, uint32_t reads, uint32_t hits, double wait_ms)
+{
+	stats->bytes_read += bytes_read;
+	stats->bytes_prefetched += bytes_prefetched;
+	stats->reads += reads;
+	stats->cache_hits += hits;
+	stats->io_wait_ms += wait_ms;
+}
+
+static void record(uint64_t bytes_read, uint64_t bytes_prefetched, uint32_t reads, uint32_t hits, double wait_ms)
+{
+	add_stats(&frame_stats, bytes_read, bytes_prefetched, reads, hits, wait_ms);
+	add_stats(&total_stats, bytes_read, bytes_prefetched, reads, hits, wait_ms);
+}
+
+// Caller holds the lock.
+static bool push_request(const VfsRequest* request)
+{
+	if (!io_running || queue_count == VFS_QUEUE_SIZE)
+		return false;
+	queue[(queue_head + queue_count) % VFS_QUEUE_SIZE] = *request;
+	queue_count++;
+	io_wake.notify_one();
+	return true;
+}
+
+static void free_file_data(VfsFile* file)
+{
+	if (file->owned)
+		free(file->owned);
+	platform_unmap_file(&file->mapping);
+	memset(file, 0, sizeof(*file));
+}
+
+static void serve_prefetch(int slot)
+{
+	char path[VFS_MAX_PATH];
+	{
+		std::lock_guard<std::mutex> guard(vfs_lock);
+		memcpy(path, slots[slot].path, sizeof(path));
+	}
+
+	VfsLocation location;
+	VfsFile file;
+	bool was_resident;
+	uint64_t faulted = 0;
+	bool ok = resolve(path, &location) && load_location(&location, &file, &was_resident, &faulted);
+
+	std::lock_guard<std::mutex> guard(vfs_lock);
+	VfsCacheSlot* s = &slots[slot];
+	if (ok && file.owned && cache_bytes + file.size > VFS_CACHE_BYTES) {
+		// over budget: the read will go to the disk again
+		free_file_data(&file);
+		ok = false;
+	}
+	if (ok) {
+		s->file = file;
+		s->state = VFS_SLOT_READY;
+		if (file.owned) {
+			cache_bytes += file.size;
+			mem_track_alloc(MEM_CPU_FILE_CACHE, file.size);
+		}
+		record(0, faulted, 0, 0, 0.0);
+	} else {
+		s->state = VFS_SLOT_EMPTY;
+	}
+	slot_ready.notify_all();
+}
+
+static void io_thread_main()
+{
+	std::unique_lock<std::mutex> lock(vfs_lock);
+	for (;;) {
+		io_wake.wait(lock, [] { return io_stop || queue_count > 0; });
+		if (io_stop)
+			break;
+
+		VfsRequest request = queue[queue_head];
+		queue_head = (queue_head + 1) % VFS_QUEUE_SIZE;
+		queue_count--;
+		lock.unlock();
+
+		if (request.type == VFS_REQUEST_PREFETCH) {
+			serve_prefetch(request.slot);
+		} else {
+			uint64_t faulted = fault_in_range(&mounts[request.mount], request.offset, request.bytes);
+			std::lock_guard<std::mutex> guard(vfs_lock);
+			record(0, faulted, 0, 0, 0.0);
+		}
+
+		lock.lock();
+	}
+}
+
+bool vfs_init()
+{
+	std::lock_guard<std::mutex> guard(vfs_lock);
+	if (io_running)
+		return true;
+	io_stop = false;
+	queue_head = 0;
+	queue_count = 0;
+	memset(&frame_stats, 0, sizeof(frame_stats));
+	memset(&last_frame_stats, 0, sizeof(last_frame_stats));
+	memset(&total_stats, 0, sizeof(total_stats));
+	io_thread = std::thread(io_thread_main);
+	io_running = true;
+	return true;
+}
+
+void vfs_shutdown()
+{
+	{
+		std::lock_guard<std::mutex> guard(vfs_lock);
+		io_stop = true;
+		io_wake.notify_all();
+	}
+	if (io_thread.joinable())
+		io_thread.join();
+
+	std::lock_guard<std::mutex> guard(vfs_lock);
+	io_running = false;
+	queue_count = 0;
+
+	for (int i = 0; i < VFS_CACHE_SLOTS; i++) {
+		VfsCacheSlot* s = &slots[i];
+		if (s->state == VFS_SLOT_READY && s->file.owned)
+			mem_track_free(MEM_CPU_FILE_CACHE, s->file.size);
+		if (s->state == VFS_SLOT_READY)
+			free_file_data(&s->file);
+		s->state = VFS_SLOT_EMPTY;
+	}
+	cache_bytes = 0;
+
+	for (int m = 0; m < mount_count; m++) {
+		platform_unmap_file(&mounts[m].archive);
+		free(mounts[m].resident);
+	}
+	memset(mounts, 0, sizeof(mounts));
+	mount_count = 0;
+}
+
+static VfsMount* begin_mount(const char* mount_point)
+{
+	int m = mount_count.load();
+	if (m == VFS_MAX_MOUNTS) {
+		printf("Too many file system mounts\n");
+		return NULL;
+	}
+	VfsMount* mount = &mounts[m];
+	memset(mount, 0, sizeof(*mount));
+	normalize_path(mount_point, mount->mount_point);
+	mount->mount_length = strlen(mount->mount_point);
+	while (mount->mount_length && mount->mount_point[mount->mount_length - 1] == '/')
+		mount->mount_point[--mount->mount_length] = 0;
+	return mount;
+}
+
+bool vfs_mount_dir(const char* dir, const char* mount_point)
+{
+	VfsMount* mount = begin_mount(mount_point);
+	if (!mount)
+		return false;
+	normalize_path(dir, mount->dir);
+	mount_count.fetch_add(1, std::memory_order_release);
+	return true;
+}
+
+bool vfs_mount_archive(const char* path, const char* mount_point)
+{
+	VfsMount* mount = begin_mount(mount_point);
+	if (!mount || !platform_map_file(path, &mount->archive))
+		return false;
+
+	const PlatformMapping* archive = &mount->archive;
+	const VfsArchiveHeader* header = (const VfsArchiveHeader*)archive->data;
+	size_t table_bytes = archive->size >= sizeof(VfsArchiveHeader) ? (size_t)header->entry_count * sizeof(VfsArchiveEntry) : 0;
+	bool ok = archive->size >= sizeof(VfsArchiveHeader) &&
+		header->magic == VFS_ARCHIVE_MAGIC && header->version == VFS_ARCHIVE_VERSION &&
+		sizeof(VfsArchiveHeader) + table_bytes + header->names_bytes <= archive->size;
+
+	if (ok) {
+		mount->entries = (const VfsArchiveEntry*)(archive->data + sizeof(VfsArchiveHeader));
+		mount->names = (const char*)mount->entries + table_bytes;
+		mount->entry_count = header->entry_count;
+		for (uint32_t i = 0; ok && i < mount->entry_count; i++) {
+			const VfsArchiveEntry* e = &mount->entries[i];
+			ok = (uint64_t)e->name_offset + e->name_length <= header->names_bytes &&
+				e->data_offset <= archive->size && e->size <= archive->size - e->data_offset;
+		}
+	}
+
+	if (ok) {
+		mount->block_count = (archive->size + VFS_PAGE_BLOCK - 1) / VFS_PAGE_BLOCK;
+		mount->resident = (uint8_t*)calloc(mount->block_count, 1);
+		ok = mount->resident != NULL;
+	}
+
+	if (!ok) {
+		printf("%s is not a valid archive\n", path);
+		platform_unmap_file(&mount->archive);
+		return false;
+	}
+	mount_count.fetch_add(1, std::memory_order_release);
+	return true;
+}
+
+static int find_slot(const char* path)
+{
+	for (int i = 0; i < VFS_CACHE_SLOTS; i++) {
+		if (slots[i].state != VFS_SLOT_EMPTY && strcmp(slots[i].path, path) == 0)
+			return i;
+	}
+	return -1;
+}
+
+// Takes a prefetched file out of the cache, waiting for the I/O thread when
+// it is still reading it.
+static bool take_prefetched(const char* path, VfsFile* file)
+{
+	std::unique_lock<std::mutex> lock(vfs_lock);
+	int slot = find_slot(path);
+	if (slot < 0)
+		return false;
+
+	VfsCacheSlot* s = &slots[slot];
+	slot_ready.wait(lock, [s] { return s->state != VFS_SLOT_PENDING; });
+	if (s->state != VFS_SLOT_READY || strcmp(s->path, path) != 0)
+		return false;
+
+	*file = s->file;
+	if (file->owned) {
+		cache_bytes -= file->size;
+		mem_track_free(MEM_CPU_FILE_CACHE, file->size);
+	}
+	memset(&s->file, 0, sizeof(s->file));
+	s->state = VFS_SLOT_EMPTY;
+	return true;
+}
+
+bool vfs_read(const char* path, VfsFile* file)
+{
+	char normalized[VFS_MAX_PATH];
+	normalize_path(path, normalized);
+	memset(file, 0, sizeof(*file));
+
+	double start = platform_time_us();
+	bool hit = take_prefetched(normalized, file);
+	bool ok = hit;
+
+	VfsLocation location;
+	if (!ok && resolve(normalized, &location)) {
+		bool was_resident;
+		uint64_t faulted;
+		ok = load_location(&location, file, &was_resident, &faulted);
+		hit = ok && was_resident;
+
+		// archives are packed in load order: bring in what follows
+		if (ok && location.mount >= 0) {
+			VfsRequest request;
+			request.type = VFS_REQUEST_READ_AHEAD;
+			request.slot = -1;
+			request.mount = location.mount;
+			request.offset = location.entry->data_offset + location.entry->size;
+			request.bytes = VFS_READ_AHEAD_BYTES;
+			std::lock_guard<std::mutex> guard(vfs_lock);
+			push_request(&request);
+		}
+	}
+	double wait_ms = (platform_time_us() - start) / 1000.0;
+
+	std::lock_guard<std::mutex> guard(vfs_lock);
+	record(ok ? file->size : 0, 0, ok ? 1 : 0, hit ? 1 : 0, wait_ms);
+	return ok;
+}
+
+void vfs_close(VfsFile* file)
+{
+	free_file_data(file);
+}
+
+bool vfs_exists(const char* path)
+{
+	char normalized[VFS_MAX_PATH];
+	normalize_path(path, normalized);
+	VfsLocation location;
+	return resolve(normalized, &location);
+}
+
+void vfs_prefetch(const char* path)
+{
+	char normalized[VFS_MAX_PATH];
+	normalize_path(path, normalized);
+
+	std::lock_guard<std::mutex> guard(vfs_lock);
+	if (!io_running || find_slot(normalized) >= 0)
+		return;
+
+	for (int i = 0; i < VFS_CACHE_SLOTS; i++) {
+		if (slots[i].state != VFS_SLOT_EMPTY)
+			continue;
+		VfsRequest request;
+		request.type = VFS_REQUEST_PREFETCH;
+		request.slot = i;
+		request.mount = -1;
+		request.offset = 0;
+		request.bytes = 0;
+		if (push_request(&request)) {
+			memcpy(slots[i].path, normalized, sizeof(normalized));
+			slots[i].state = VFS_SLOT_PENDING;
+		}
+		return;
+	}
+}
+
+void vfs_begin_frame()
+{
+	std::lock_guard<std::mutex> guard(vfs_lock);
+	last_frame_stats = frame_stats;
+	memset(&frame_stats, 0, sizeof(frame_stats));
+}
+
+void vfs_get_stats(VfsStats* last_frame, VfsStats* total)
+{
+	std::lock_guard<std::mutex> guard(vfs_lock);
+	if (last_frame)
+		*last_frame = last_frame_stats;
+	if (total)
+		*total = total_stats;
+}
+
+static uint64_t align_up(uint64_t value)
+{
+	return (value + VFS_ARCHIVE_ALIGN - 1) & ~(uint64_t)(VFS_ARCHIVE_ALIGN - 1);
+}
+
+bool vfs_pack_archive(const char* archive_path, const char* root, const char** files, int count)
+{
+	char normalized_root[VFS_MAX_PATH];
+	normalize_path(root, normalized_root);
+	size_t root_length = strlen(normalized_root);
+
+	std::vector<std::string> names(count);
+	std::vector<uint64_t> sizes(count);
+	for (int i = 0; i < count; i++) {
+		char name[VFS_MAX_PATH];
+		normalize_path(files[i], name);
+		const char* rel = name;
+		if (root_length && strncmp(name, normalized_root, root_length) == 0 && name[root_length] == '/')
+			rel = name + root_length + 1;
+		names[i] = rel;
+		if (!platform_file_size(files[i], &sizes[i])) {
+			printf("%s: unable to read\n", files[i]);
+			return false;
+		}
+	}
+
+	// entry table sorted by name, data in the order given
+	std::vector<int> order(count);
+	for (int i = 0; i < count; i++)
+		order[i] = i;
+	std::sort(order.begin(), order.end(), [&names](int a, int b) { return names[a] < names[b]; });
+
+	VfsArchiveHeader header;
+	header.magic = VFS_ARCHIVE_MAGIC;
+	header.version = VFS_ARCHIVE_VERSION;
+	header.entry_count = (uint32_t)count;
+	header.names_bytes = 0;
+
+	std::vector<VfsArchiveEntry> entries(count);
+	std::string blob;
+	for (int i = 0; i < count; i++) {
+		VfsArchiveEntry* e = &entries[i];
+		e->name_offset = (uint32_t)blob.size();
+		e->name_length = (uint32_t)names[order[i]].size();
+		blob += names[order[i]];
+	}
+	header.names_bytes = (uint32_t)blob.size();
+
+	std::vector<uint64_t> offsets(count);
+	uint64_t offset = align_up(sizeof(header) + count * sizeof(VfsArchiveEntry) + blob.size());
+	for (int i = 0; i < count; i++) {
+		offsets[i] = offset;
+		offset = align_up(offset + sizes[i]);
+	}
+	for (int i = 0; i < count; i++) {
+		entries[i].data_offset = offsets[order[i]];
+		entries[i].size = sizes[order[i]];
+	}
+
+	FILE* out = platform_fopen(archive_path, "wb");
+	if (!out)
+		return false;
+
+	static const uint8_t padding[VFS_ARCHIVE_ALIGN] = { 0 };
+	bool ok = fwrite(&header, sizeof(header), 1, out) == 1 &&
+		(count == 0 || fwrite(entries.data(), sizeof(VfsArchiveEntry), count, out) == (size_t)count) &&
+		fwrite(blob.data(), 1, blob.size(), out) == blob.size();
+	uint64_t written = sizeof(header) + count * sizeof(VfsArchiveEntry) + blob.size();
+
+	for (int i = 0; ok && i < count; i++) {
+		ok = fwrite(padding, 1, (size_t)(offsets[i] - written), out) == offsets[i] - written;
+		size_t size;
+		uint8_t* data = ok ? platform_read_file(files[i], &size) : NULL;
+		ok = data && size == sizes[i] && fwrite(data, 1, size, out) == size;
+		free(data);
+		written = offsets[i] + sizes[i];
+	}
+
+	fclose(out);
+	return ok;
+}
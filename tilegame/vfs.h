@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "platform.h"
+
+//----------------------------------------------------------------------------
+//
+//  Virtual file system. Loose directories and packed archives are mounted
+//    under one namespace of forward-slash paths ("shaders/tilegame.vert").
+//    Mounts are searched newest first, so an archive mounted over a
+//    directory overrides the files it contains. Paths that no mount
+//    resolves are read from disk as they are, which keeps tools that pass
+//    real paths working without mounting anything.
+//
+//  Archives are mapped into memory whole and their files are returned as
+//    views into the mapping, without a copy. Loose files of at least
+//    VFS_MMAP_THRESHOLD bytes are mapped as well; smaller ones are read
+//    into a heap buffer.
+//
+//  A dedicated I/O thread serves vfs_prefetch() hints by reading the file
+//    into the cache (or faulting in its pages when it is mapped), so the
+//    vfs_read() that follows finds it in memory. After each archive read it
+//    also reads ahead the next VFS_READ_AHEAD_BYTES of the archive, which
+//    is packed in load order. Time the calling thread spends blocked on the
+//    disk or waiting for the I/O thread is counted as I/O wait.
+//
+//  Archive layout (little endian): VfsArchiveHeader, entry_count
+//    VfsArchiveEntry sorted by name, the names, then the file data with
+//    each file aligned to VFS_ARCHIVE_ALIGN bytes.
+//
+
+#define VFS_MAX_MOUNTS 8
+#define VFS_MAX_PATH 256
+#define VFS_CACHE_SLOTS 64
+#define VFS_CACHE_BYTES (64 * 1024 * 1024)
+#define VFS_MMAP_THRESHOLD (256 * 1024)
+#define VFS_READ_AHEAD_BYTES (1024 * 1024)
+#define VFS_PAGE_BLOCK (64 * 1024)
+
+#define VFS_ARCHIVE_MAGIC 0x4b504754	// "TGPK"
+#define VFS_ARCHIVE_VERSION 1
+#define VFS_ARCHIVE_ALIGN 64
+
+typedef struct VfsArchiveHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t entry_count;
+	uint32_t names_bytes;
+} VfsArchiveHeader;
+
+typedef struct VfsArchiveEntry {
+	uint32_t name_offset;		// from the start of the names
+	uint32_t name_length;
+	uint64_t data_offset;		// from the start of the archive
+	uint64_t size;
+} VfsArchiveEntry;
+
+typedef struct VfsFile {
+	const uint8_t* data;
+	size_t size;
+	uint8_t* owned;				// heap buffer behind 'data', or NULL
+	PlatformMapping mapping;	// loose file mapped for this read
+} VfsFile;
+
+typedef struct VfsStats {
+	uint64_t bytes_read;		// returned by vfs_read()
+	uint64_t bytes_prefetched;	// read or faulted in by the I/O thread
+	uint32_t reads;
+	uint32_t cache_hits;		// reads the I/O thread had already brought into memory
+	double io_wait_ms;
+} VfsStats;
+
+// Starts the I/O thread. Without it (or after vfs_shutdown()) everything
+// still works, reads just happen on the calling thread.
+bool
+vfs_init();
+
+// Stops the I/O thread, drops the cache and unmounts everything.
+void
+vfs_shutdown();
+
+// Mounts the directory 'dir' at 'mount_point' ("" for the root).
+bool
+vfs_mount_dir(const char* dir, const char* mount_point);
+
+bool
+vfs_mount_archive(const char* path, const char* mount_point);
+
+// Reads the whole of 'path'. The data stays valid until vfs_close().
+bool
+vfs_read(const char* path, VfsFile* file);
+
+void
+vfs_close(VfsFile* file);
+
+bool
+vfs_exists(const char* path);
+
+// Hint that 'path' will be read soon. Never blocks.
+void
+vfs_prefetch(const char* path);
+
+// Starts a new frame of statistics.
+void
+vfs_begin_frame();
+
+// Statistics of the last complete frame and totals since vfs_init().
+void
+vfs_get_stats(VfsStats* last_frame, VfsStats* total);
+
+// Packs 'count' files into an archive. Each file is stored under its path
+// relative to 'root' and the data is laid out in the order given.
+bool
+vfs_pack_archive(const char* archive_path, const char* root, const char** files, int count);
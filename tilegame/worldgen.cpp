@@ -0,0 +1,303 @@
+#include "stdafx.h"
+#include "worldgen.h"
+#include "platform.h"
+
+#include <string.h>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define WORLDGEN_SSE2 1
+#endif
+
+#define LATTICE_SIZE (WORLDGEN_REGION / WORLDGEN_MIN_PERIOD + 2)
+#define REGION_TILES (WORLDGEN_REGION * WORLDGEN_REGION)
+
+// seeds of the fields, mixed into the world seed
+#define SEED_ELEVATION 0x51ed270bu
+#define SEED_MOISTURE 0xa3c59ac3u
+#define SEED_ROCK 0x2f6b8d17u
+
+void worldgen_init(WorldGen* gen, uint32_t seed)
+{
+	memset(gen, 0, sizeof(*gen));
+	gen->seed = seed;
+	gen->octaves = 5;
+	gen->base_period = 128;
+	gen->persistence = 0.5f;
+	gen->sea_level = 0.38f;
+	gen->shore = 0.03f;
+	gen->cliff = 0.68f;
+	gen->cliff_edge = 0.05f;
+	gen->forest = 0.54f;
+	gen->smooth_steps = 3;
+#ifdef WORLDGEN_SSE2
+	gen->simd = true;
+#endif
+}
+
+bool worldgen_set_level(WorldGen* gen, const uint8_t* rgba, int width, int height, int32_t x, int32_t y)
+{
+	free(gen->level);
+	gen->level = (uint8_t*)malloc((size_t)width * height);
+	if (!gen->level)
+		return false;
+	for (int i = 0; i < width * height; i++) {
+		const uint8_t* p = rgba + (size_t)i * 4;
+		gen->level[i] = p[0] >= 128 && p[1] < 128 && p[2] < 128 ? CHUNK_TILE_WALL : CHUNK_TILE_FLOOR;
+	}
+	gen->level_x = x;
+	gen->level_y = y;
+	gen->level_width = width;
+	gen->level_height = height;
+	return true;
+}
+
+void worldgen_free(WorldGen* gen)
+{
+	free(gen->level);
+	gen->level = NULL;
+}
+
+static inline uint32_t
+hash_u32(uint32_t x)
+{
+	x ^= x >> 16;
+	x *= 0x7feb352du;
+	x ^= x >> 15;
+	x *= 0x846ca68bu;
+	x ^= x >> 16;
+	return x;
+}
+
+static inline uint32_t
+hash_tile(uint32_t seed, int32_t x, int32_t y)
+{
+	return hash_u32(seed ^ (uint32_t)x * 0x8da6b343u ^ (uint32_t)y * 0xd8163841u);
+}
+
+static inline float
+hash_unit(uint32_t h)
+{
+	return (h >> 8) * (1.0f / 16777216.0f);
+}
+
+static inline int32_t
+floor_div(int32_t x, int32_t d)
+{
+	return x >= 0 ? x / d : -((-x + d - 1) / d);
+}
+
+// Adds one octave of value noise times 'amplitude' to the region whose top
+// left tile is (x0, y0). x0 and the period are multiples of 4, so each run
+// of four tiles lies in one lattice cell.
+static void
+add_octave(uint32_t seed, int32_t period, float amplitude, int32_t x0, int32_t y0, float* out, bool simd)
+{
+	int32_t lx0 = floor_div(x0, period), ly0 = floor_div(y0, period);
+	int32_t cells_x = floor_div(x0 + WORLDGEN_REGION - 1, period) - lx0 + 2;
+	int32_t cells_y = floor_div(y0 + WORLDGEN_REGION - 1, period) - ly0 + 2;
+	float lattice[LATTICE_SIZE * LATTICE_SIZE];
+	for (int32_t j = 0; j < cells_y; j++) {
+		for (int32_t i = 0; i < cells_x; i++)
+			lattice[j * LATTICE_SIZE + i] = hash_unit(hash_tile(seed, lx0 + i, ly0 + j));
+	}
+
+	float inv_period = 1.0f / period;
+	for (int y = 0; y < WORLDGEN_REGION; y++) {
+		int32_t ty = y0 + y, cy = floor_div(ty, period);
+		float fy = (float)(ty - cy * period) * inv_period;
+		float sy = fy * fy * (3.0f - 2.0f * fy);
+		const float* row0 = &lattice[(cy - ly0) * LATTICE_SIZE];
+		const float* row1 = row0 + LATTICE_SIZE;
+		float* dst = out + y * WORLDGEN_REGION;
+
+		for (int x = 0; x < WORLDGEN_REGION; x += 4) {
+			int32_t tx = x0 + x, cx = floor_div(tx, period);
+			int32_t i = cx - lx0, base = tx - cx * period;
+			float v00 = row0[i], v10 = row0[i + 1], v01 = row1[i], v11 = row1[i + 1];
+#ifdef WORLDGEN_SSE2
+			if (simd) {
+				__m128 fx = _mm_mul_ps(_mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(base), _mm_setr_epi32(0, 1, 2, 3))), _mm_set1_ps(inv_period));
+				__m128 sx = _mm_mul_ps(_mm_mul_ps(fx, fx), _mm_sub_ps(_mm_set1_ps(3.0f), _mm_mul_ps(_mm_set1_ps(2.0f), fx)));
+				__m128 a = _mm_add_ps(_mm_set1_ps(v00), _mm_mul_ps(_mm_set1_ps(v10 - v00), sx));
+				__m128 b = _mm_add_ps(_mm_set1_ps(v01), _mm_mul_ps(_mm_set1_ps(v11 - v01), sx));
+				__m128 v = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), _mm_set1_ps(sy)));
+				_mm_storeu_ps(dst + x, _mm_add_ps(_mm_loadu_ps(dst + x), _mm_mul_ps(_mm_set1_ps(amplitude), v)));
+				continue;
+			}
+#endif
+			for (int k = 0; k < 4; k++) {
+				float fx = (float)(base + k) * inv_period;
+				float sx = fx * fx * (3.0f - 2.0f * fx);
+				float a = v00 + (v10 - v00) * sx;
+				float b = v01 + (v11 - v01) * sx;
+				float v = a + (b - a) * sy;
+				dst[x + k] = dst[x + k] + amplitude * v;
+			}
+		}
+	}
+}
+
+// Octaves summed and scaled back to [0, 1).
+static void
+fbm(const WorldGen* gen, uint32_t seed, int32_t x0, int32_t y0, float* out)
+{
+	memset(out, 0, REGION_TILES * sizeof(float));
+	float amplitude = 1.0f, total = 0.0f;
+	int32_t period = gen->base_period;
+	for (int o = 0; o < gen->octaves && period >= WORLDGEN_MIN_PERIOD; o++) {
+		add_octave(seed + o * 0x9e3779b9u, period, amplitude, x0, y0, out, gen->simd);
+		total += amplitude;
+		amplitude *= gen->persistence;
+		period >>= 1;
+	}
+	float scale = 1.0f / total;
+	for (int i = 0; i < REGION_TILES; i++)
+		out[i] *= scale;
+}
+
+// One step of the automaton from 'src' to 'dst'. The outermost ring only
+// copies; it and one more ring per step lose their meaning, which the
+// margin absorbs.
+static void
+smooth_step(const uint8_t* src, uint8_t* dst, bool simd)
+{
+	const int r = WORLDGEN_REGION;
+	memcpy(dst, src, r);
+	memcpy(dst + (r - 1) * r, src + (r - 1) * r, r);
+	for (int y = 1; y < r - 1; y++) {
+		const uint8_t* above = src + (y - 1) * r;
+		const uint8_t* row = src + y * r;
+		const uint8_t* below = src + (y + 1) * r;
+		uint8_t* out = dst + y * r;
+		out[0] = row[0];
+		out[r - 1] = row[r - 1];
+		int x = 1;
+#ifdef WORLDGEN_SSE2
+		if (simd) {
+			const __m128i four = _mm_set1_epi8(4), one = _mm_set1_epi8(1);
+			for (; x + 16 < r; x += 16) {
+				__m128i sum = _mm_setzero_si128();
+				const uint8_t* rows[3] = { above, row, below };
+				for (int k = 0; k < 3; k++) {
+					sum = _mm_add_epi8(sum, _mm_loadu_si128((const __m128i*)(rows[k] + x - 1)));
+					sum = _mm_add_epi8(sum, _mm_loadu_si128((const __m128i*)(rows[k] + x)));
+					sum = _mm_add_epi8(sum, _mm_loadu_si128((const __m128i*)(rows[k] + x + 1)));
+				}
+				_mm_storeu_si128((__m128i*)(out + x), _mm_and_si128(_mm_cmpgt_epi8(sum, four), one));
+			}
+		}
+#endif
+		for (; x < r - 1; x++) {
+			int sum = above[x - 1] + above[x] + above[x + 1] + row[x - 1] + row[x] + row[x + 1] + below[x - 1] + below[x] + below[x + 1];
+			out[x] = sum >= 5;
+		}
+	}
+}
+
+static void
+overlay_level(const WorldGen* gen, int32_t cx, int32_t cy, uint8_t* tiles)
+{
+	int32_t x0 = cx * CHUNK_SIZE - gen->level_x, y0 = cy * CHUNK_SIZE - gen->level_y;
+	int32_t left = x0 > 0 ? x0 : 0, top = y0 > 0 ? y0 : 0;
+	int32_t right = x0 + CHUNK_SIZE < gen->level_width ? x0 + CHUNK_SIZE : gen->level_width;
+	int32_t bottom = y0 + CHUNK_SIZE < gen->level_height ? y0 + CHUNK_SIZE : gen->level_height;
+	for (int32_t y = top; y < bottom; y++) {
+		if (left < right)
+			memcpy(&tiles[(y - y0) * CHUNK_SIZE + left - x0], &gen->level[y * gen->level_width + left], right - left);
+	}
+}
+
+void worldgen_chunk(const WorldGen* gen, int32_t cx, int32_t cy, uint8_t* tiles)
+{
+	int32_t x0 = cx * CHUNK_SIZE - WORLDGEN_MARGIN, y0 = cy * CHUNK_SIZE - WORLDGEN_MARGIN;
+	float elevation[REGION_TILES], moisture[REGION_TILES];
+	uint8_t rock[2][REGION_TILES];
+	fbm(gen, gen->seed ^ SEED_ELEVATION, x0, y0, elevation);
+	fbm(gen, gen->seed ^ SEED_MOISTURE, x0, y0, moisture);
+
+	// the highest ground is rock, the band below it half rock at random
+	float edge = gen->cliff - gen->cliff_edge;
+	for (int y = 0; y < WORLDGEN_REGION; y++) {
+		for (int x = 0; x < WORLDGEN_REGION; x++) {
+			float e = elevation[y * WORLDGEN_REGION + x];
+			bool scattered = e >= edge && (hash_tile(gen->seed ^ SEED_ROCK, x0 + x, y0 + y) & 1);
+			rock[0][y * WORLDGEN_REGION + x] = e >= gen->cliff || scattered;
+		}
+	}
+	int current = 0;
+	for (int s = 0; s < gen->smooth_steps && s < WORLDGEN_MARGIN; s++) {
+		smooth_step(rock[current], rock[current ^ 1], gen->simd);
+		current ^= 1;
+	}
+
+	for (int y = 0; y < CHUNK_SIZE; y++) {
+		for (int x = 0; x < CHUNK_SIZE; x++) {
+			int i = (y + WORLDGEN_MARGIN) * WORLDGEN_REGION + x + WORLDGEN_MARGIN;
+			float e = elevation[i];
+			uint8_t tile;
+			if (rock[current][i])
+				tile = CHUNK_TILE_WALL;
+			else if (e < gen->sea_level)
+				tile = CHUNK_TILE_WATER;
+			else if (e < gen->sea_level + gen->shore)
+				tile = CHUNK_TILE_SAND;
+			else if (moisture[i] > gen->forest)
+				tile = CHUNK_TILE_TREE;
+			else
+				tile = CHUNK_TILE_FLOOR;
+			tiles[y * CHUNK_SIZE + x] = tile;
+		}
+	}
+	if (gen->level)
+		overlay_level(gen, cx, cy, tiles);
+}
+
+static BatchPool worldgen_pool;
+
+typedef struct WorldGenBatch {
+	const WorldGen* gen;
+	WorldGenRequest* requests;
+} WorldGenBatch;
+
+static void
+generate_request(void* user, uint32_t index)
+{
+	WorldGenBatch* batch = (WorldGenBatch*)user;
+	WorldGenRequest* request = &batch->requests[index];
+	worldgen_chunk(batch->gen, request->cx, request->cy, request->tiles);
+}
+
+bool worldgen_workers_start(int threads)
+{
+	return batch_pool_start(&worldgen_pool, threads);
+}
+
+void worldgen_workers_stop()
+{
+	batch_pool_stop(&worldgen_pool);
+}
+
+void worldgen_generate_batch(const WorldGen* gen, WorldGenRequest* requests, uint32_t count, WorldGenStats* stats)
+{
+	double start = platform_time_us();
+	WorldGenBatch batch = { gen, requests };
+	batch_pool_run(&worldgen_pool, generate_request, &batch, count);
+
+	stats->chunks = count;
+	stats->ms = (float)((platform_time_us() - start) / 1000.0);
+}
+
+static bool
+load_generated(void* user, int32_t cx, int32_t cy, uint8_t* tiles)
+{
+	worldgen_chunk((const WorldGen*)user, cx, cy, tiles);
+	return true;
+}
+
+void worldgen_source(ChunkSource* source, WorldGen* gen)
+{
+	source->load = load_generated;
+	source->save = NULL;
+	source->user = gen;
+}
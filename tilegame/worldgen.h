@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "chunk_stream.h"
+#include "batch_pool.h"
+
+//----------------------------------------------------------------------------
+//
+//  Procedural chunks. Two fields of value noise, elevation and moisture,
+//    are summed over octaves (fBm) across a chunk and WORLDGEN_MARGIN tiles
+//    around it. Biome rules turn them into water, sand, grass and forest;
+//    cliffs start from the highest ground with a ragged hashed edge and are
+//    smoothed by a cellular automaton, a tile becoming rock when at least 5
+//    of the 9 tiles around it are. The margin keeps every tile's
+//    neighbourhood in world coordinates, so chunks join without seams.
+//
+//  Every value derives from the seed and the tile's world position only,
+//    so a chunk comes out the same on any thread and in any order.
+//
+//  Noise is interpolated four tiles at a time with SSE2 from lattice values
+//    hashed once per chunk and octave; the automaton counts 16 tiles at a
+//    time. The scalar paths do the same float operations in the same order
+//    and give the same tiles.
+//
+//  An authored level, a Resources/Levels image, can be laid over the
+//    generated tiles: the chunks it covers take its tiles where it has them.
+//
+//  worldgen_generate_batch() generates many chunks on the batch pool
+//    workers started by worldgen_workers_start() and the calling thread,
+//    for bulk generation ahead of play. The game does not use it: its chunk
+//    stream asks worldgen_source() for chunks one at a time on the loader
+//    thread.
+//
+
+#define WORLDGEN_MARGIN 4			// must be a multiple of 4, at least smooth_steps
+#define WORLDGEN_REGION (CHUNK_SIZE + 2 * WORLDGEN_MARGIN)
+#define WORLDGEN_MIN_PERIOD 4
+#define WORLDGEN_MAX_WORKERS BATCH_POOL_MAX_WORKERS
+
+typedef struct WorldGen {
+	uint32_t seed;
+	int octaves;
+	int base_period;			// tiles per lattice cell of the first octave, a power of two
+	float persistence;			// amplitude of each octave over the one before
+	float sea_level;			// elevation below which there is water
+	float shore;				// sand above the sea level
+	float cliff;				// elevation where rock starts
+	float cliff_edge;			// band below it where rock is scattered before smoothing
+	float forest;				// moisture above which grass is forest
+	int smooth_steps;
+	bool simd;
+	// authored level over the generated tiles, see worldgen_set_level()
+	uint8_t* level;
+	int32_t level_x;
+	int32_t level_y;
+	int32_t level_width;
+	int32_t level_height;
+} WorldGen;
+
+typedef struct WorldGenRequest {
+	int32_t cx;
+	int32_t cy;
+	uint8_t* tiles;				// CHUNK_TILES
+} WorldGenRequest;
+
+typedef struct WorldGenStats {
+	uint32_t chunks;
+	float ms;
+} WorldGenStats;
+
+// Default rules for 'seed'.
+void
+worldgen_init(WorldGen* gen, uint32_t seed);
+
+// Lays a level image over the world with its top left tile at (x, y). Red
+// pixels are walls, as in fov_grid_from_level(), the rest floor. Replaces
+// the level set before.
+bool
+worldgen_set_level(WorldGen* gen, const uint8_t* rgba, int width, int height, int32_t x, int32_t y);
+
+void
+worldgen_free(WorldGen* gen);
+
+void
+worldgen_chunk(const WorldGen* gen, int32_t cx, int32_t cy, uint8_t* tiles);
+
+// Starts 'threads' workers, at most WORLDGEN_MAX_WORKERS. Without workers,
+// batches run on the calling thread.
+bool
+worldgen_workers_start(int threads);
+
+void
+worldgen_workers_stop();
+
+void
+worldgen_generate_batch(const WorldGen* gen, WorldGenRequest* requests, uint32_t count, WorldGenStats* stats);
+
+// Generates the chunks a ChunkStream asks for. 'gen' must outlive the stream.
+void
+worldgen_source(ChunkSource* source, WorldGen* gen);